@@ -0,0 +1,1025 @@
+/* vim: set tabstop=8 shiftwidth=8:
+ * name: bench.c
+ * funx: microbenchmark of hot functions in libzts, libzutil, libzbuddy, libzconv and libparam_xml
+ */
+
+#include <stdio.h>
+#include <stdlib.h> /* for rand, srand, qsort, etc */
+#include <string.h> /* for memset, memcpy, strstr, etc */
+#include <inttypes.h> /* for uintN_t, PRId64, etc */
+#include <time.h> /* for clock_gettime() */
+
+#include "tstool_config.h"
+#include "common.h"
+#include "buddy.h"
+#include "ts.h"
+#include "if.h"
+#include "zconv.h"
+#include "param_xml.h"
+
+static int rpt_lvl = WRN_LVL; /* report level: ERR, WRN, INF, DBG */
+
+#define BENCH_MAX               (64) /* benchmark count */
+#define REP_MAX                 (100)
+#define NPKT                    (4096) /* packets of generated stream, 770KB */
+#define PAT_PID                 (0x0000)
+#define PMT_PID                 (0x0100)
+#define VID_PID                 (0x0101) /* PCR_PID too */
+#define AUD_PID                 (0x0102)
+#define SECT_SIZE               (1024) /* for ts_crc() */
+#define TXT_LINE                (64) /* text lines for next_nbyte_hex() */
+#define TXT_SIZE                (3 * TS_PKT_SIZE + 4)
+#define BUDDY_PTR               (64) /* live blocks in buddy pool */
+#define BUDDY_SIZE              (1024) /* request sizes */
+#define UTF8_SIZE               (256) /* EPG text for utf8_gb() */
+#define EPG_REP                 (4) /* EPG sentence repeated, as a long description */
+#define EPG_CHR                 (86) /* characters of EPG sentence */
+#define EPG_ASC                 (16) /* ASCII of them, others are 3-byte UTF-8 */
+#define EPG_UTF8                (EPG_REP * (EPG_ASC + 3 * (EPG_CHR - EPG_ASC)))
+#define EPG_GB                  (EPG_REP * (EPG_ASC + 2 * (EPG_CHR - EPG_ASC)))
+#define EPG_UTF16               (EPG_REP * 2 * EPG_CHR)
+#define TXT_ASCII               (240) /* EIT text in English for latin_utf8(), etc */
+#define XML_SVC                 (100) /* services in EPG description for xml2param() */
+#define XML_EVT                 (8) /* events of each service */
+
+struct bench {
+        const char *name;
+        const char *unit; /* what one op is */
+        size_t bytes; /* per op, 0: no GB/s */
+        int (*init)(void);
+        void (*run)(int64_t n);
+};
+
+/* EPG description, for xml2param() */
+struct bx_evt {
+        struct znode cvfl; /* common variable for list */
+        uint16_t event_id;
+        uint32_t start_time;
+        uint8_t *text;
+        int text_len;
+};
+
+struct bx_svc {
+        struct znode cvfl; /* common variable for list */
+        uint16_t service_id;
+        struct bx_evt *evt0;
+};
+
+struct bx_epg {
+        uint16_t transport_stream_id;
+        struct bx_svc *svc0;
+};
+
+static struct pdesc pd_bx_evt[] = {
+        {0, 0, 1, PT_UINTX_SS(struct bx_evt, event_id, uint16_t), "event_id", NULL, 0},
+        {0, 0, 1, PT_UINTu_SS(struct bx_evt, start_time, uint32_t), "start_time", NULL, 0},
+        {0, 0, 1, PT_UINTX_XS(struct bx_evt, text, text_len, uint8_t), "title", NULL, 0},
+        {0, 0, 0, PT_NULL, "", NULL, 0}
+};
+
+static struct pdesc pd_bx_svc[] = {
+        {0, 0, 1, PT_UINTu_SS(struct bx_svc, service_id, uint16_t), "service_id", NULL, 0},
+        {0, 0, 1, PT_LIST__XS(struct bx_svc, evt0, struct bx_evt), "evt", pd_bx_evt, 0},
+        {0, 0, 0, PT_NULL, "", NULL, 0}
+};
+
+static struct pdesc pd_bx_epg[] = {
+        {0, 0, 1, PT_UINTu_SS(struct bx_epg, transport_stream_id, uint16_t), "transport_stream_id", NULL, 0},
+        {0, 0, 1, PT_LIST__XS(struct bx_epg, svc0, struct bx_svc), "svc", pd_bx_svc, 0},
+        {0, 0, 0, PT_NULL, "", NULL, 0}
+};
+
+struct result {
+        char name[32];
+        double ns; /* ns/op, median */
+        double best; /* ns/op, min */
+        double ops; /* op/s */
+        double gbs; /* GB/s, 0 if no bytes */
+};
+
+static int rep = 5; /* repetitions, median is reported */
+static int rep_ms = 200; /* time of each repetition */
+static char filter[64] = ""; /* run benchmark with name containing it only */
+static char file_o[FILENAME_MAX] = ""; /* result file */
+static char file_c0[FILENAME_MAX] = ""; /* compare: old result */
+static char file_c1[FILENAME_MAX] = ""; /* compare: new result */
+static volatile uint32_t sink; /* keep result, against dead code elimination */
+
+/* input data */
+static uint8_t *pkt = NULL; /* NPKT packets */
+static char txt[TXT_LINE][TXT_SIZE]; /* " 47 XX ..., " */
+static void *mp = NULL; /* buddy pool */
+static void *mp_ptr[BUDDY_PTR];
+static size_t mp_size[BUDDY_SIZE];
+static struct ts_obj *obj = NULL;
+static char utf8[UTF8_SIZE + 4];
+static size_t utf8_len;
+static xmlChar *xml_buf = NULL; /* EPG description in XML */
+static int xml_len;
+static char gb[2 * UTF8_SIZE + 4];
+static char epg_utf8[EPG_UTF8 + 4]; /* the same EPG text in 3 encodings */
+static char epg_gb[EPG_GB + 4];
+static uint16_t epg_utf16[EPG_UTF16 / 2 + 2];
+static char epg_out[EPG_UTF8 + 4];
+static uint16_t epg_out16[EPG_UTF16 / 2 + 2];
+static char eng[TXT_ASCII + 4];
+static uint16_t eng16[TXT_ASCII + 4];
+
+static int init_pkt(void);
+static int init_tsh(void);
+static int init_txt(void);
+static int init_buddy(void);
+static int init_utf8(void);
+static int init_epg(void);
+static int init_eng(void);
+static int init_xml(void);
+static void run_tsh(int64_t n);
+static void run_crc(int64_t n);
+static void run_b2t(int64_t n);
+static void run_hex(int64_t n);
+static void run_buddy(int64_t n);
+static void run_utf8_gb(int64_t n);
+static void run_epg_utf8_gb(int64_t n);
+static void run_epg_gb_utf8(int64_t n);
+static void run_epg_utf16_gb(int64_t n);
+static void run_epg_gb_utf16(int64_t n);
+static void run_latin_utf8(int64_t n);
+static void run_utf8_utf16(int64_t n);
+static void run_utf16_utf8(int64_t n);
+static void run_xml_dom(int64_t n);
+static void run_xml_reader(int64_t n);
+static int free_epg(struct bx_epg *epg);
+
+static const struct bench bench[] = {
+        {"ts_parse_tsh",        "pkt",  TS_PKT_SIZE,    init_tsh,       run_tsh},
+        {"ts_crc",              "sect", SECT_SIZE,      init_pkt,       run_crc},
+        {"b2t",                 "pkt",  TS_PKT_SIZE,    init_pkt,       run_b2t},
+        {"next_nbyte_hex",      "pkt",  TS_PKT_SIZE,    init_txt,       run_hex},
+        {"buddy_malloc",        "pair", 0,              init_buddy,     run_buddy},
+        {"utf8_gb",             "str",  UTF8_SIZE,      init_utf8,      run_utf8_gb},
+        {"utf8_gb_epg",         "str",  EPG_UTF8,       init_epg,       run_epg_utf8_gb},
+        {"gb_utf8_epg",         "str",  EPG_GB,         init_epg,       run_epg_gb_utf8},
+        {"utf16_gb_epg",        "str",  EPG_UTF16,      init_epg,       run_epg_utf16_gb},
+        {"gb_utf16_epg",        "str",  EPG_GB,         init_epg,       run_epg_gb_utf16},
+        {"latin_utf8",          "str",  TXT_ASCII,      init_eng,       run_latin_utf8},
+        {"utf8_utf16",          "str",  TXT_ASCII,      init_eng,       run_utf8_utf16},
+        {"utf16_utf8",          "str",  2 * TXT_ASCII,  init_eng,       run_utf16_utf8},
+        {"xml2param",           "doc",  0,              init_xml,       run_xml_dom},
+        {"xml2param_reader",    "doc",  0,              init_xml,       run_xml_reader},
+        {NULL,                  NULL,   0,              NULL,           NULL}
+};
+
+static int deal_with_parameter(int argc, char *argv[]);
+static int show_help();
+static int show_version();
+static int64_t now_ns(void);
+static int measure(const struct bench *b, struct result *r);
+static int cmp_double(const void *a, const void *b);
+static int load_result(const char *fname, struct result *r, int max);
+static int compare(void);
+static int make_sect(uint8_t *p, uint16_t pid, uint8_t table_id, const uint8_t *body, int len, uint8_t cc);
+static int make_pes(uint8_t *p, uint16_t pid, int is_start, int64_t PCR, uint8_t cc);
+
+int main(int argc, char *argv[])
+{
+        const struct bench *b;
+        struct result res[BENCH_MAX];
+        int cnt = 0;
+        FILE *fd_o = NULL;
+        int i;
+
+        if(0 != deal_with_parameter(argc, argv)) {
+                return -1;
+        }
+        if('\0' != file_c0[0]) {
+                return compare();
+        }
+
+        srand(20090401); /* same input for every build */
+        fprintf(stdout, "%-16s %6s %12s %12s %12s %8s\n",
+                "name", "unit", "ns/op", "best", "op/s", "GB/s");
+        for(b = bench; b->name; b++) {
+                struct result *r = &res[cnt];
+
+                if('\0' != filter[0] && NULL == strstr(b->name, filter)) {
+                        continue;
+                }
+                if(0 != b->init()) {
+                        RPTERR("%s: init failed", b->name);
+                        return -1;
+                }
+                if(0 != measure(b, r)) {
+                        return -1;
+                }
+                fprintf(stdout, "%-16s %6s %12.2f %12.2f %12.0f %8.3f\n",
+                        r->name, b->unit, r->ns, r->best, r->ops, r->gbs);
+                cnt++;
+        }
+
+        if('\0' != file_o[0]) {
+                fd_o = fopen(file_o, "w");
+                if(NULL == fd_o) {
+                        RPTERR("open \"%s\" failed", file_o);
+                        return -1;
+                }
+                fprintf(fd_o, "# bench of tstools v%s (%s), rep %d, %d ms\n",
+                        VERSION_STR, REVISION, rep, rep_ms);
+                fprintf(fd_o, "# name ns/op best op/s GB/s\n");
+                for(i = 0; i < cnt; i++) {
+                        fprintf(fd_o, "%s %.3f %.3f %.0f %.4f\n",
+                                res[i].name, res[i].ns, res[i].best, res[i].ops, res[i].gbs);
+                }
+                fclose(fd_o);
+        }
+
+        if(obj) {
+                ts_destroy(obj);
+        }
+        if(mp) {
+                buddy_destroy(mp);
+        }
+        free(pkt);
+        if(xml_buf) {
+                xmlFree(xml_buf);
+        }
+        return 0;
+}
+
+static int deal_with_parameter(int argc, char *argv[])
+{
+        int i;
+        intmax_t dat;
+
+        for(i = 1; i < argc; i++) {
+                if('-' == argv[i][0]) {
+                        if(0 == strcmp(argv[i], "-n")) {
+                                i++;
+                                if(i >= argc) {
+                                        RPTERR("no parameter for 'n'!\n");
+                                        return -1;
+                                }
+                                sscanf(argv[i], "%"SCNiMAX, &dat);
+                                if(1 <= dat && dat <= REP_MAX) {
+                                        rep = (int)dat;
+                                }
+                                else {
+                                        RPTERR("bad variable for 'n': %jd(1 <= x <= %d)!\n", dat, REP_MAX);
+                                        return -1;
+                                }
+                        }
+                        else if(0 == strcmp(argv[i], "-t")) {
+                                i++;
+                                if(i >= argc) {
+                                        RPTERR("no parameter for 't'!\n");
+                                        return -1;
+                                }
+                                sscanf(argv[i], "%"SCNiMAX, &dat);
+                                if(10 <= dat && dat <= 60000) {
+                                        rep_ms = (int)dat;
+                                }
+                                else {
+                                        RPTERR("bad variable for 't': %jd(10 <= x <= 60000)!\n", dat);
+                                        return -1;
+                                }
+                        }
+                        else if(0 == strcmp(argv[i], "-f")) {
+                                i++;
+                                if(i >= argc) {
+                                        RPTERR("no parameter for 'f'!\n");
+                                        return -1;
+                                }
+                                strncpy(filter, argv[i], sizeof(filter) - 1);
+                        }
+                        else if(0 == strcmp(argv[i], "-o")) {
+                                i++;
+                                if(i >= argc) {
+                                        RPTERR("no parameter for 'o'!\n");
+                                        return -1;
+                                }
+                                strncpy(file_o, argv[i], FILENAME_MAX - 1);
+                        }
+                        else if(0 == strcmp(argv[i], "-c")) {
+                                if(i + 2 >= argc) {
+                                        RPTERR("need two result files for 'c'!\n");
+                                        return -1;
+                                }
+                                strncpy(file_c0, argv[++i], FILENAME_MAX - 1);
+                                strncpy(file_c1, argv[++i], FILENAME_MAX - 1);
+                        }
+                        else if(0 == strcmp(argv[i], "-h") ||
+                                0 == strcmp(argv[i], "--help")) {
+                                show_help();
+                                return -1;
+                        }
+                        else if(0 == strcmp(argv[i], "-v") ||
+                                0 == strcmp(argv[i], "--version")) {
+                                show_version();
+                                return -1;
+                        }
+                        else {
+                                RPTERR("wrong parameter: %s", argv[i]);
+                                return -1;
+                        }
+                }
+                else {
+                        RPTERR("wrong parameter: %s", argv[i]);
+                        return -1;
+                }
+        }
+        return 0;
+}
+
+static int show_help()
+{
+        const struct bench *b;
+
+        fprintf(stdout,
+                "'bench' measure hot functions of tstools libraries.\n"
+                "\n"
+                "Usage: bench [OPTION]\n"
+                "\n"
+                "Options:\n"
+                "\n"
+                " -n <rep>         repetitions, median is reported, default: 5\n"
+                " -t <ms>          time of each repetition, default: 200\n"
+                " -f <str>         only benchmark with name containing <str>\n"
+                " -o <file>        write result to <file>, for -c\n"
+                " -c <old> <new>   compare two result files, no benchmark\n"
+                "\n"
+                " -h, --help       print this information only\n"
+                " -v, --version    print my version only\n"
+                "\n"
+                "Each benchmark is warmed up and calibrated first, input is generated\n"
+                "with a fixed seed, so results of two builds can be compared.\n"
+                "\n"
+                "Benchmarks:\n");
+        for(b = bench; b->name; b++) {
+                fprintf(stdout, "  %s\n", b->name);
+        }
+        fprintf(stdout,
+                "\n"
+                "Examples:\n"
+                "  make bench && bench/bench -o old.txt\n\n"
+                "  bench/bench -f ts_ -n 11 -o new.txt\n\n"
+                "  bench/bench -c old.txt new.txt\n\n"
+                "\n"
+                "Report bugs to <zhoucheng@tsinghua.org.cn>.\n");
+        return 0;
+}
+
+static int show_version()
+{
+        fprintf(stdout,
+                "bench of tstools v%s (%s)\n"
+                "Build time: %s %s\n"
+                "\n"
+                "Copyright (C) 2009,2010,2011,2012,2013,2014 ZHOU Cheng.\n"
+                "License GPLv3+: GNU GPL version 3 or later <http://gnu.org/licenses/gpl.html>\n"
+                "This is free software; contact author for additional information.\n"
+                "There is NO warranty; not even for MERCHANTABILITY or FITNESS FOR\n"
+                "A PARTICULAR PURPOSE.\n"
+                "\n"
+                "Written by ZHOU Cheng.\n",
+                VERSION_STR, REVISION, __DATE__, __TIME__);
+        return 0;
+}
+
+static int64_t now_ns(void)
+{
+        struct timespec ts;
+
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+        return (int64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+/* warm up and calibrate, then rep times of about rep_ms each */
+static int measure(const struct bench *b, struct result *r)
+{
+        double ns[REP_MAX];
+        int64_t n = 1;
+        int64_t t;
+        int i;
+
+        /* warm up: double n until 20ms */
+        while(1) {
+                t = now_ns();
+                b->run(n);
+                t = now_ns() - t;
+                if(t >= 20000000 || n >= ((int64_t)1 << 40)) {
+                        break;
+                }
+                n <<= 1;
+        }
+        n = (int64_t)((double)n * rep_ms * 1000000 / (double)(t + 1));
+        if(n < 1) {
+                n = 1;
+        }
+
+        for(i = 0; i < rep; i++) {
+                t = now_ns();
+                b->run(n);
+                t = now_ns() - t;
+                ns[i] = (double)t / (double)n;
+        }
+        qsort(ns, rep, sizeof(double), cmp_double);
+
+        strncpy(r->name, b->name, sizeof(r->name) - 1);
+        r->name[sizeof(r->name) - 1] = '\0';
+        r->ns = ((rep & 1) ? ns[rep / 2] : (ns[rep / 2 - 1] + ns[rep / 2]) / 2);
+        r->best = ns[0];
+        r->ops = 1e9 / r->ns;
+        r->gbs = (double)b->bytes / r->ns; /* byte/ns is GB/s */
+        return 0;
+}
+
+static int cmp_double(const void *a, const void *b)
+{
+        double x = *(const double *)a;
+        double y = *(const double *)b;
+
+        return (x < y) ? -1 : ((x > y) ? 1 : 0);
+}
+
+static int load_result(const char *fname, struct result *r, int max)
+{
+        FILE *fd;
+        char line[256];
+        int cnt = 0;
+
+        fd = fopen(fname, "r");
+        if(NULL == fd) {
+                RPTERR("open \"%s\" failed", fname);
+                return -1;
+        }
+        while(cnt < max && fgets(line, sizeof(line), fd)) {
+                if('#' == line[0]) {
+                        continue;
+                }
+                if(5 == sscanf(line, "%31s %lf %lf %lf %lf",
+                               r[cnt].name, &r[cnt].ns, &r[cnt].best, &r[cnt].ops, &r[cnt].gbs)) {
+                        cnt++;
+                }
+        }
+        fclose(fd);
+        return cnt;
+}
+
+/* change of ns/op, minus means faster */
+static int compare(void)
+{
+        struct result r0[BENCH_MAX];
+        struct result r1[BENCH_MAX];
+        int n0;
+        int n1;
+        int i;
+        int j;
+
+        n0 = load_result(file_c0, r0, BENCH_MAX);
+        n1 = load_result(file_c1, r1, BENCH_MAX);
+        if(n0 < 0 || n1 < 0) {
+                return -1;
+        }
+        fprintf(stdout, "%-16s %12s %12s %8s\n", "name", "old ns/op", "new ns/op", "change");
+        for(j = 0; j < n1; j++) {
+                for(i = 0; i < n0; i++) {
+                        if(0 == strcmp(r0[i].name, r1[j].name)) {
+                                break;
+                        }
+                }
+                if(i == n0) {
+                        fprintf(stdout, "%-16s %12s %12.2f %8s\n", r1[j].name, "-", r1[j].ns, "new");
+                        continue;
+                }
+                fprintf(stdout, "%-16s %12.2f %12.2f %+7.1f%%\n",
+                        r1[j].name, r0[i].ns, r1[j].ns,
+                        (r1[j].ns - r0[i].ns) * 100.0 / r0[i].ns);
+        }
+        return 0;
+}
+
+/* stream: PAT and PMT every 400 packets, PCR every 40 packets,
+ * video with PES every 100 packets and audio 1 of 8 packets
+ */
+static int init_pkt(void)
+{
+        static const uint8_t pat[] = {0x00, 0x01, 0xE0 | (PMT_PID >> 8), PMT_PID & 0xFF};
+        static const uint8_t pmt[] = {0xE0 | (VID_PID >> 8), VID_PID & 0xFF, 0xF0, 0x00,
+                                      0x02, 0xE0 | (VID_PID >> 8), VID_PID & 0xFF, 0xF0, 0x00,
+                                      0x04, 0xE0 | (AUD_PID >> 8), AUD_PID & 0xFF, 0xF0, 0x00};
+        uint8_t cc[3] = {0, 0, 0}; /* continuity_counter of PMT, VID, AUD */
+        int64_t PCR = 0;
+        int i;
+
+        if(pkt) {
+                return 0;
+        }
+        pkt = (uint8_t *)malloc(NPKT * TS_PKT_SIZE);
+        if(NULL == pkt) {
+                RPTERR("malloc failed");
+                return -1;
+        }
+        for(i = 0; i < NPKT; i++) {
+                uint8_t *p = pkt + i * TS_PKT_SIZE;
+
+                if(0 == i % 400) {
+                        make_sect(p, PAT_PID, 0x00, pat, sizeof(pat), (uint8_t)(i / 400));
+                }
+                else if(1 == i % 400) {
+                        make_sect(p, PMT_PID, 0x02, pmt, sizeof(pmt), cc[0]++);
+                }
+                else if(7 == i % 8) {
+                        make_pes(p, AUD_PID, (0 == i % 64), -1, cc[2]++);
+                }
+                else {
+                        make_pes(p, VID_PID, (2 == i % 100), ((2 == i % 40) ? PCR : -1), cc[1]++);
+                }
+                PCR += 188 * 8 * 27000000LL / 10000000; /* 10Mbps */
+        }
+        return 0;
+}
+
+static int init_tsh(void)
+{
+        struct ts_cfg cfg;
+
+        if(0 != init_pkt()) {
+                return -1;
+        }
+        if(NULL == mp) {
+                mp = buddy_create(24, 6);
+                if(NULL == mp) {
+                        RPTERR("buddy_create failed");
+                        return -1;
+                }
+        }
+        obj = ts_create(mp);
+        if(NULL == obj) {
+                RPTERR("ts_create failed");
+                return -1;
+        }
+        memset(&cfg, 0, sizeof(struct ts_cfg));
+        cfg.need_cc = 1;
+        cfg.need_af = 1;
+        cfg.need_timestamp = 1;
+        cfg.need_psi = 1;
+        cfg.need_pes = 1;
+        ts_ioctl(obj, TS_SCFG, &cfg);
+        return 0;
+}
+
+static int init_txt(void)
+{
+        int i;
+
+        if(0 != init_pkt()) {
+                return -1;
+        }
+        for(i = 0; i < TXT_LINE; i++) {
+                txt[i][0] = ' ';
+                b2t(txt[i] + 1, pkt + i * 41 * TS_PKT_SIZE, TS_PKT_SIZE);
+        }
+        return 0;
+}
+
+static int init_buddy(void)
+{
+        int i;
+
+        if(NULL == mp) {
+                mp = buddy_create(24, 6);
+                if(NULL == mp) {
+                        RPTERR("buddy_create failed");
+                        return -1;
+                }
+        }
+        for(i = 0; i < BUDDY_SIZE; i++) {
+                mp_size[i] = (size_t)(16 + rand() % 2032); /* list node ~ section */
+        }
+        memset(mp_ptr, 0, sizeof(mp_ptr));
+        return 0;
+}
+
+/* EPG text: Chinese with some ASCII */
+static int init_utf8(void)
+{
+        static const uint16_t ucs[] = {
+                0x4E2D, 0x592E, 0x7535, 0x89C6, 0x53F0, 0x65B0, 0x95FB, 0x8054,
+                0x64AD, 0x5929, 0x6C14, 0x9884, 0x62A5, 0x4ECA, 0x65E5, 0x8BF4,
+                0x6CD5, 0x7535, 0x5F71, 0x4F53, 0x80B2, 0x8D5B, 0x4E8B, 0x76F4
+        };
+        char *p = utf8;
+
+        while(p - utf8 < UTF8_SIZE - 3) {
+                if(0 == rand() % 5) {
+                        *p++ = (char)('0' + rand() % 10);
+                }
+                else {
+                        uint16_t u = ucs[rand() % (sizeof(ucs) / sizeof(ucs[0]))];
+
+                        *p++ = (char)(0xE0 | (u >> 12));
+                        *p++ = (char)(0x80 | ((u >> 6) & 0x3F));
+                        *p++ = (char)(0x80 | (u & 0x3F));
+                }
+        }
+        *p = '\0';
+        utf8_len = (size_t)(p - utf8);
+        return 0;
+}
+
+/* EPG text: a real-world event description, punctuation and time included */
+static int init_epg(void)
+{
+        static const uint16_t ucs[EPG_CHR] = {
+                0x300A, 0x65B0, 0x95FB, 0x8054, 0x64AD, 0x300B, 0x4E2D, 0x592E,
+                0x7535, 0x89C6, 0x53F0, 0x6BCF, 0x65E5, 0x64AD, 0x51FA, 0x7684,
+                0x65B0, 0x95FB, 0x8282, 0x76EE, 0xFF0C, 0x5185, 0x5BB9, 0x5305,
+                0x62EC, 0x56FD, 0x5185, 0x5916, 0x91CD, 0x8981, 0x65F6, 0x4E8B,
+                0x3001, 0x653F, 0x6CBB, 0x7ECF, 0x6D4E, 0x3001, 0x793E, 0x4F1A,
+                0x6C11, 0x751F, 0x4E0E, 0x5929, 0x6C14, 0x9884, 0x62A5, 0x3002,
+                0x7B2C, 0x0032, 0x0030, 0x0032, 0x0034, 0x671F, 0xFF1A, 0x4ECA,
+                0x65E5, 0x8981, 0x95FB, 0xFF0C, 0x56FD, 0x9645, 0x5FEB, 0x8BAF,
+                0xFF0C, 0x4F53, 0x80B2, 0x8D5B, 0x4E8B, 0x76F4, 0x64AD, 0x9884,
+                0x544A, 0x0020, 0x0032, 0x0030, 0x003A, 0x0030, 0x0030, 0x002D,
+                0x0032, 0x0030, 0x003A, 0x0033, 0x0030, 0x3002
+        };
+        char *p = epg_utf8;
+        int r;
+        int i;
+
+        for(r = 0; r < EPG_REP; r++) {
+                for(i = 0; i < EPG_CHR; i++) {
+                        uint16_t u = ucs[i];
+
+                        if(u < 0x80) {
+                                *p++ = (char)u;
+                                continue;
+                        }
+                        *p++ = (char)(0xE0 | (u >> 12));
+                        *p++ = (char)(0x80 | ((u >> 6) & 0x3F));
+                        *p++ = (char)(0x80 | (u & 0x3F));
+                }
+        }
+        *p = '\0';
+
+        utf8_gb(epg_utf8, epg_gb, EPG_UTF8);
+        utf8_utf16(epg_utf8, epg_utf16, EPG_UTF8, BIG_ENDIAN); /* as DVB string */
+        if(EPG_UTF8 != p - epg_utf8 || EPG_GB != strlen(epg_gb)) {
+                RPTERR("bad EPG text: %d, %d", (int)(p - epg_utf8), (int)strlen(epg_gb));
+                return -1;
+        }
+        return 0;
+}
+
+/* EIT text in English: all ASCII */
+static int init_eng(void)
+{
+        static const char *s = "Evening news: headlines, weather and sport. "
+                               "Live from the studio with reports on 2 continents. ";
+        size_t len = strlen(s);
+        size_t i;
+
+        for(i = 0; i < TXT_ASCII; i++) {
+                eng[i] = s[i % len];
+        }
+        eng[TXT_ASCII] = '\0';
+        utf8_utf16(eng, eng16, TXT_ASCII, BIG_ENDIAN); /* as DVB string */
+        return 0;
+}
+
+/* EPG description: XML_SVC services, XML_EVT events each */
+static int init_xml(void)
+{
+        struct bx_epg epg;
+        xmlDocPtr doc;
+        xmlNodePtr root;
+        int i;
+        int j;
+
+        if(xml_buf) {
+                return 0;
+        }
+        memset(&epg, 0, sizeof(struct bx_epg));
+        epg.transport_stream_id = 1;
+        for(i = 0; i < XML_SVC; i++) {
+                struct bx_svc *svc = (struct bx_svc *)xmlMalloc(sizeof(struct bx_svc));
+
+                if(NULL == svc) {
+                        return -1;
+                }
+                memset(svc, 0, sizeof(struct bx_svc));
+                svc->service_id = (uint16_t)(i + 1);
+                zlst_push((zhead_t *)&(epg.svc0), svc);
+                for(j = 0; j < XML_EVT; j++) {
+                        struct bx_evt *evt = (struct bx_evt *)xmlMalloc(sizeof(struct bx_evt));
+                        int k;
+
+                        if(NULL == evt) {
+                                return -1;
+                        }
+                        memset(evt, 0, sizeof(struct bx_evt));
+                        evt->event_id = (uint16_t)rand();
+                        evt->start_time = (uint32_t)(1262304000 + j * 3600);
+                        evt->text_len = 16 + rand() % 48;
+                        evt->text = (uint8_t *)xmlMalloc((size_t)(evt->text_len));
+                        if(NULL == evt->text) {
+                                return -1;
+                        }
+                        for(k = 0; k < evt->text_len; k++) {
+                                evt->text[k] = (uint8_t)rand();
+                        }
+                        zlst_push((zhead_t *)&(svc->evt0), evt);
+                }
+        }
+
+        doc = xmlNewDoc((xmlChar *)"1.0");
+        root = xmlNewDocNode(doc, NULL, (const xmlChar *)"epg", NULL);
+        param2xml(&epg, root, pd_bx_epg);
+        xmlDocSetRootElement(doc, root);
+        xmlDocDumpFormatMemory(doc, &xml_buf, &xml_len, 1);
+        xmlFreeDoc(doc);
+        free_epg(&epg);
+        return (xml_buf ? 0 : -1);
+}
+
+static void run_tsh(int64_t n)
+{
+        static int64_t ADDR = 0; /* go on between runs */
+        struct ts_ipt *ipt = &(obj->ipt);
+        int64_t i;
+
+        for(i = 0; i < n; i++) {
+                memcpy(ipt->TS, pkt + (ADDR / TS_PKT_SIZE % NPKT) * TS_PKT_SIZE, TS_PKT_SIZE);
+                ipt->ADDR = ADDR;
+                ipt->has_addr = 1;
+                ipt->has_ts = 1;
+                ts_parse_tsh(obj);
+
+                /* errors are cleared by application, as tsana does */
+                if(obj->has_err) {
+                        memset(&(obj->err), 0, sizeof(struct ts_err));
+                        obj->has_err = 0;
+                }
+                ADDR += TS_PKT_SIZE;
+        }
+        sink += (uint32_t)obj->CTS;
+}
+
+static void run_crc(int64_t n)
+{
+        uint32_t crc = 0;
+        int64_t i;
+
+        for(i = 0; i < n; i++) {
+                crc ^= ts_crc(pkt + (i & 255) * SECT_SIZE, SECT_SIZE, 32);
+        }
+        sink += crc;
+}
+
+static void run_b2t(int64_t n)
+{
+        char out[TXT_SIZE];
+        int64_t i;
+
+        for(i = 0; i < n; i++) {
+                b2t(out, pkt + (i % NPKT) * TS_PKT_SIZE, TS_PKT_SIZE);
+                sink += (uint8_t)out[3 * (i & 127)];
+        }
+}
+
+static void run_hex(int64_t n)
+{
+        uint8_t out[TS_PKT_SIZE];
+        int64_t i;
+
+        for(i = 0; i < n; i++) {
+                char *p = txt[i % TXT_LINE];
+
+                sink += (uint32_t)next_nbyte_hex(out, &p, TS_PKT_SIZE);
+                sink += out[i & 127];
+        }
+}
+
+/* one free and one malloc, BUDDY_PTR blocks in pool */
+static void run_buddy(int64_t n)
+{
+        int64_t i;
+
+        for(i = 0; i < n; i++) {
+                int k = (int)((i * 37) % BUDDY_PTR);
+
+                if(mp_ptr[k]) {
+                        buddy_free(mp, mp_ptr[k]);
+                }
+                mp_ptr[k] = buddy_malloc(mp, mp_size[i % BUDDY_SIZE]);
+        }
+        sink += (uint32_t)(uintptr_t)mp_ptr[0];
+}
+
+static void run_utf8_gb(int64_t n)
+{
+        int64_t i;
+
+        for(i = 0; i < n; i++) {
+                sink += (uint32_t)utf8_gb(utf8, gb, utf8_len);
+        }
+}
+
+static void run_epg_utf8_gb(int64_t n)
+{
+        int64_t i;
+
+        for(i = 0; i < n; i++) {
+                sink += (uint32_t)utf8_gb(epg_utf8, epg_out, EPG_UTF8);
+        }
+}
+
+static void run_epg_gb_utf8(int64_t n)
+{
+        int64_t i;
+
+        for(i = 0; i < n; i++) {
+                sink += (uint32_t)gb_utf8(epg_gb, epg_out, EPG_GB);
+        }
+}
+
+static void run_epg_utf16_gb(int64_t n)
+{
+        int64_t i;
+
+        for(i = 0; i < n; i++) {
+                sink += (uint32_t)utf16_gb(epg_utf16, epg_out, EPG_UTF16, BIG_ENDIAN);
+        }
+}
+
+static void run_epg_gb_utf16(int64_t n)
+{
+        int64_t i;
+
+        for(i = 0; i < n; i++) {
+                sink += (uint32_t)gb_utf16(epg_gb, epg_out16, EPG_GB, BIG_ENDIAN);
+        }
+}
+
+static void run_latin_utf8(int64_t n)
+{
+        int64_t i;
+
+        for(i = 0; i < n; i++) {
+                sink += (uint32_t)latin_utf8((const uint8_t *)eng, epg_out, TXT_ASCII, CODING_DVB6937);
+        }
+}
+
+static void run_utf8_utf16(int64_t n)
+{
+        int64_t i;
+
+        for(i = 0; i < n; i++) {
+                sink += (uint32_t)utf8_utf16(eng, epg_out16, TXT_ASCII, BIG_ENDIAN);
+        }
+}
+
+static void run_utf16_utf8(int64_t n)
+{
+        int64_t i;
+
+        for(i = 0; i < n; i++) {
+                sink += (uint32_t)utf16_utf8(eng16, epg_out, 2 * TXT_ASCII, BIG_ENDIAN);
+        }
+}
+
+static void run_xml_dom(int64_t n)
+{
+        int64_t i;
+
+        for(i = 0; i < n; i++) {
+                struct bx_epg epg;
+                xmlDocPtr doc;
+
+                memset(&epg, 0, sizeof(struct bx_epg));
+                doc = xmlReadMemory((const char *)xml_buf, xml_len, NULL, NULL, 0);
+                xml2param(&epg, xmlDocGetRootElement(doc), pd_bx_epg);
+                xmlFreeDoc(doc);
+                sink += (uint32_t)free_epg(&epg);
+        }
+}
+
+static void run_xml_reader(int64_t n)
+{
+        int64_t i;
+
+        for(i = 0; i < n; i++) {
+                struct bx_epg epg;
+                xmlTextReaderPtr reader;
+
+                memset(&epg, 0, sizeof(struct bx_epg));
+                reader = xmlReaderForMemory((const char *)xml_buf, xml_len, NULL, NULL, 0);
+                xml2param_reader(&epg, reader, "epg", pd_bx_epg);
+                xmlFreeTextReader(reader);
+                sink += (uint32_t)free_epg(&epg);
+        }
+}
+
+/* return event count */
+static int free_epg(struct bx_epg *epg)
+{
+        struct bx_svc *svc;
+        int cnt = 0;
+
+        while(NULL != (svc = (struct bx_svc *)zlst_pop((zhead_t *)&(epg->svc0)))) {
+                struct bx_evt *evt;
+
+                while(NULL != (evt = (struct bx_evt *)zlst_pop((zhead_t *)&(svc->evt0)))) {
+                        if(evt->text) {
+                                xmlFree(evt->text);
+                        }
+                        xmlFree(evt);
+                        cnt++;
+                }
+                xmlFree(svc);
+        }
+        return cnt;
+}
+
+static int make_sect(uint8_t *p, uint16_t pid, uint8_t table_id, const uint8_t *body, int len, uint8_t cc)
+{
+        uint8_t *pkt0 = p;
+        uint8_t *sect;
+        int section_length = 5 + len + 4;
+        uint32_t crc;
+
+        *p++ = 0x47;
+        *p++ = 0x40 | (pid >> 8); /* payload_unit_start_indicator */
+        *p++ = pid & 0xFF;
+        *p++ = 0x10 | (cc & 0x0F); /* payload only */
+        *p++ = 0x00; /* pointer_field */
+
+        sect = p;
+        *p++ = table_id;
+        *p++ = 0xB0 | (section_length >> 8);
+        *p++ = section_length & 0xFF;
+        *p++ = 0x00; /* transport_stream_id or program_number */
+        *p++ = 0x01;
+        *p++ = 0xC1; /* version_number 0, current_next_indicator 1 */
+        *p++ = 0x00; /* section_number */
+        *p++ = 0x00; /* last_section_number */
+        memcpy(p, body, len);
+        p += len;
+
+        crc = ts_crc(sect, p - sect, 32);
+        *p++ = (crc >> 24) & 0xFF;
+        *p++ = (crc >> 16) & 0xFF;
+        *p++ = (crc >> 8) & 0xFF;
+        *p++ = crc & 0xFF;
+
+        memset(p, 0xFF, TS_PKT_SIZE - (p - pkt0));
+        return 0;
+}
+
+/* PCR < 0 means packet without PCR */
+static int make_pes(uint8_t *p, uint16_t pid, int is_start, int64_t PCR, uint8_t cc)
+{
+        uint8_t *pkt0 = p;
+
+        *p++ = 0x47;
+        *p++ = (is_start ? 0x40 : 0x00) | (pid >> 8);
+        *p++ = pid & 0xFF;
+        if(PCR < 0) {
+                *p++ = 0x10 | (cc & 0x0F); /* payload only */
+        }
+        else {
+                int64_t base = PCR / 300;
+                int ext = (int)(PCR % 300);
+
+                *p++ = 0x30 | (cc & 0x0F); /* AF and payload */
+                *p++ = 7; /* adaption_field_length */
+                *p++ = 0x10; /* PCR_flag */
+                *p++ = (base >> 25) & 0xFF;
+                *p++ = (base >> 17) & 0xFF;
+                *p++ = (base >> 9) & 0xFF;
+                *p++ = (base >> 1) & 0xFF;
+                *p++ = ((base & 0x01) << 7) | 0x7E | (ext >> 8);
+                *p++ = ext & 0xFF;
+        }
+        if(is_start) {
+                int64_t PTS = ((PCR < 0) ? 0 : PCR / 300) + 90 * 100;
+
+                *p++ = 0x00; /* packet_start_code_prefix */
+                *p++ = 0x00;
+                *p++ = 0x01;
+                *p++ = (VID_PID == pid) ? 0xE0 : 0xC0; /* stream_id */
+                *p++ = 0x00; /* PES_packet_length: 0 */
+                *p++ = 0x00;
+                *p++ = 0x80;
+                *p++ = 0x80; /* PTS only */
+                *p++ = 5; /* PES_header_data_length */
+                *p++ = 0x21 | ((PTS >> 29) & 0x0E);
+                *p++ = (PTS >> 22) & 0xFF;
+                *p++ = 0x01 | ((PTS >> 14) & 0xFE);
+                *p++ = (PTS >> 7) & 0xFF;
+                *p++ = 0x01 | ((PTS << 1) & 0xFE);
+        }
+        while(p < pkt0 + TS_PKT_SIZE) {
+                *p++ = (uint8_t)rand(); /* ES data */
+        }
+        return 0;
+}
@@ -45,7 +45,11 @@ int main(int argc, char *argv[])
                 b2t(tbuf, bbuf, 188);
                 fprintf(stdout, "%s", tbuf);
 
-                fprintf(stdout, "*addr, %"PRIX64", \n", pkt_addr);
+                fprintf(stdout, "*addr, %"PRIX64", ", pkt_addr);
+                if(fd_i->has_cts) {
+                        fprintf(stdout, "*cts, %"PRIX64", ", fd_i->CTS);
+                }
+                fprintf(stdout, "\n");
 
                 pkt_addr += npline;
         }
@@ -97,6 +101,12 @@ static void show_help()
                 "'catip' read TS over IP, translate 0xXY to 'XY ' format, then send to stdout.\n"
                 "\n"
                 "Usage: catip [OPTION] udp://*@*:* [OPTION]\n"
+                "       catip [OPTION] rtp://*@*:* [OPTION]\n"
+                "       catip [OPTION] rtp://*@*:*+*@*:* [OPTION]\n"
+                "       catip [OPTION] pcap://[*][:*]/*.pcap [OPTION]\n"
+                "       catip [OPTION] shift://[<second>]/*.tsh [OPTION]\n"
+                "\n"
+                "rtp://*@*:* use FEC(SMPTE 2022-1) on port + 2 and port + 4 if the sender has it.\n"
                 "\n"
                 "Options:\n"
                 "\n"
@@ -107,6 +117,11 @@ static void show_help()
                 "  catip udp://:1234\n\n"
                 "  catip udp://224.165.54.31:1234\n\n"
                 "  catip udp://192.165.54.36@224.165.54.31:1234\n\n"
+                "  catip rtp://224.165.54.31:1234\n\n"
+                "  catip rtp://224.165.54.31:1234+225.165.54.31:1234\n\n"
+                "  catip pcap://224.165.54.31:1234/home/user/capture.pcapng\n\n"
+                "  catip capture.pcap\n\n"
+                "  catip shift://600/data/ch1.tsh | tsana -pcr\n\n"
                 "\n"
                 "Report bugs to <zhoucheng@tsinghua.org.cn>.\n");
         return;
@@ -42,7 +42,7 @@ $(NAME)$(EXE): .depend $(obj-y)
 	$(LD)$@ $(obj-y) $(LDFLAGS)
 
 test_$(NAME)$(EXE): test_$(NAME).c $(LIB_SHARED)
-	gcc -o $@ $< -L. -l$(NAME)
+	gcc $(INCDIRS) -o $@ $< -L. -l$(NAME) $(LDFLAGS)
 
 .depend:
 	@rm -f .depend
@@ -0,0 +1,451 @@
+/* vim: set tabstop=8 shiftwidth=8: */
+#include <stdio.h>
+#include <stdlib.h> /* for realloc(), free() */
+#include <string.h> /* for memcpy(), memset() */
+
+#include "zlst.h"
+#include "param_bin.h"
+
+/* report level */
+#define RPT_ERR (1) /* error, system error */
+#define RPT_WRN (2) /* warning, maybe wrong, maybe OK */
+#define RPT_INF (3) /* important information */
+#define RPT_DBG (4) /* debug information */
+
+/* report micro */
+#define RPT(lvl, ...) do \
+{ \
+        if(lvl <= rpt_lvl) \
+        { \
+                switch(lvl) \
+                { \
+                        case RPT_ERR: fprintf(stderr, "%s: %d: err: ", __FILE__, __LINE__); break; \
+                        case RPT_WRN: fprintf(stderr, "%s: %d: wrn: ", __FILE__, __LINE__); break; \
+                        case RPT_INF: fprintf(stderr, "%s: %d: inf: ", __FILE__, __LINE__); break; \
+                        case RPT_DBG: fprintf(stderr, "%s: %d: dbg: ", __FILE__, __LINE__); break; \
+                        default:      fprintf(stderr, "%s: %d: ???: ", __FILE__, __LINE__); break; \
+                } \
+                fprintf(stderr, __VA_ARGS__); \
+                fprintf(stderr, "\n"); \
+        } \
+} while (0)
+
+static int rpt_lvl = RPT_WRN; /* report level: ERR, WRN, INF, DBG */
+
+#define PBIN_ALIGN(x, a) (((x) + (a) - 1) & ~((size_t)(a) - 1))
+#define PBIN_BOM (0x0102)
+#define PBIN_GROW (4096) /* first buffer size */
+
+/* (count, offset) of buffer or list */
+struct pbin_ref {
+        uint32_t off;
+        uint32_t cnt;
+};
+
+/* output buffer */
+struct pbin {
+        uint8_t *buf;
+        size_t len;
+        size_t max;
+};
+
+static size_t rec_size(struct pdesc *pdesc);
+static size_t item_pos(struct pdesc *pdesc, size_t pos, size_t *cia, size_t *dat);
+static uint32_t schema(uint32_t hash, struct pdesc *pdesc);
+static int pbin_grow(struct pbin *pb, size_t size, size_t *off);
+static int param2rec(void *mem_base, struct pdesc *pdesc, struct pbin *pb, size_t rec);
+static int rec2param(void *mem_base, struct pdesc *pdesc, const uint8_t *buf, size_t len, size_t rec);
+static int ref_ok(const struct pbin_ref *ref, size_t size, size_t len);
+
+/* module interface */
+DLL_SPEC int param2bin(void *mem_base, struct pdesc *pdesc, uint8_t **buf, size_t *len)
+{
+        struct pbin pb = {NULL, 0, 0};
+        struct pbin_head head;
+        size_t off;
+        size_t root;
+
+        if(0 != pbin_grow(&pb, sizeof(struct pbin_head), &off) ||
+           0 != pbin_grow(&pb, rec_size(pdesc), &root) ||
+           0 != param2rec(mem_base, pdesc, &pb, root)) {
+                free(pb.buf);
+                return -1;
+        }
+
+        memset(&head, 0, sizeof(struct pbin_head));
+        memcpy(head.magic, PBIN_MAGIC, 4);
+        head.version = PBIN_VERSION;
+        head.bom = PBIN_BOM;
+        head.schema = pbin_schema(pdesc);
+        head.size = (uint32_t)(pb.len);
+        head.root = (uint32_t)root;
+        memcpy(pb.buf + off, &head, sizeof(struct pbin_head));
+
+        *buf = pb.buf;
+        *len = pb.len;
+        return 0;
+}
+
+DLL_SPEC int bin2param(void *mem_base, struct pdesc *pdesc, const uint8_t *buf, size_t len)
+{
+        struct pbin_head head;
+
+        if(len < sizeof(struct pbin_head)) {
+                RPT(RPT_ERR, "bin2param: too short(%zd)", len);
+                return -1;
+        }
+        memcpy(&head, buf, sizeof(struct pbin_head));
+        if(0 != memcmp(head.magic, PBIN_MAGIC, 4)) {
+                RPT(RPT_ERR, "bin2param: bad magic");
+                return -1;
+        }
+        if(PBIN_VERSION != head.version || PBIN_BOM != head.bom) {
+                RPT(RPT_ERR, "bin2param: version(%d) or byte order(0x%04X) not supported",
+                    head.version, head.bom);
+                return -1;
+        }
+        if(pbin_schema(pdesc) != head.schema) {
+                RPT(RPT_ERR, "bin2param: schema(0x%08X) mismatch, snapshot of other struct",
+                    head.schema);
+                return -1;
+        }
+        if(head.size > len || (size_t)(head.root) + rec_size(pdesc) > head.size) {
+                RPT(RPT_ERR, "bin2param: bad size(%u) or root(%u)", head.size, head.root);
+                return -1;
+        }
+        return rec2param(mem_base, pdesc, buf, head.size, head.root);
+}
+
+/* FNV-1a of type, count, size and name of each item, recursively */
+DLL_SPEC uint32_t pbin_schema(struct pdesc *pdesc)
+{
+        return schema(2166136261U, pdesc);
+}
+
+/* subfunctions */
+static size_t rec_size(struct pdesc *pdesc)
+{
+        struct pdesc *cur_pdesc;
+        size_t pos = 0;
+        size_t cia;
+        size_t dat;
+
+        for(cur_pdesc = pdesc; PT_TYP_NULL != cur_pdesc->type; cur_pdesc++) {
+                pos = item_pos(cur_pdesc, pos, &cia, &dat);
+        }
+        return PBIN_ALIGN(pos, 8);
+}
+
+/* place of one item in record: cia for "count in array", dat for data; return next pos */
+static size_t item_pos(struct pdesc *pdesc, size_t pos, size_t *cia, size_t *dat)
+{
+        size_t align;
+        size_t body;
+
+        if(PT_CNT_X == PT_CNT(pdesc->type)) {
+                pos = PBIN_ALIGN(pos, 4);
+                *cia = pos;
+                pos += 4;
+        }
+
+        if(PT_TYP_LIST == PT_TYP(pdesc->type) || PT_ACS_X == PT_ACS(pdesc->type)) {
+                align = 4;
+                body = pdesc->count * sizeof(struct pbin_ref);
+        }
+        else if(PT_TYP_STRU == PT_TYP(pdesc->type)) {
+                align = 8;
+                body = pdesc->count * rec_size(pdesc->pdesc);
+        }
+        else {
+                /* natural alignment for int and float, none for string */
+                align = ((pdesc->size & (pdesc->size - 1)) ? 1 : pdesc->size);
+                align = ((align > 8) ? 8 : align);
+                body = pdesc->count * pdesc->size;
+        }
+        pos = PBIN_ALIGN(pos, align);
+        *dat = pos;
+        return pos + body;
+}
+
+static uint32_t schema(uint32_t hash, struct pdesc *pdesc)
+{
+        struct pdesc *cur_pdesc;
+
+        for(cur_pdesc = pdesc; PT_TYP_NULL != cur_pdesc->type; cur_pdesc++) {
+                uint32_t word[3];
+                const uint8_t *p;
+                size_t i;
+
+                word[0] = (uint32_t)(cur_pdesc->type);
+                word[1] = (uint32_t)(cur_pdesc->count);
+                word[2] = (uint32_t)(cur_pdesc->size);
+                for(p = (const uint8_t *)word, i = 0; i < sizeof(word); i++) {
+                        hash = (hash ^ p[i]) * 16777619U;
+                }
+                for(p = (const uint8_t *)(cur_pdesc->name); *p; p++) {
+                        hash = (hash ^ *p) * 16777619U;
+                }
+                if(PT_TYP_STRU == PT_TYP(cur_pdesc->type) ||
+                   PT_TYP_LIST == PT_TYP(cur_pdesc->type)) {
+                        hash = schema(hash, cur_pdesc->pdesc);
+                }
+        }
+        return hash;
+}
+
+/* zeroed space at the tail, 8-byte aligned */
+static int pbin_grow(struct pbin *pb, size_t size, size_t *off)
+{
+        size_t need;
+
+        *off = PBIN_ALIGN(pb->len, 8);
+        need = *off + size;
+        if(need > UINT32_MAX) {
+                RPT(RPT_ERR, "param2bin: too big(%zd)", need);
+                return -1;
+        }
+        if(need > pb->max) {
+                size_t max = ((pb->max) ? (pb->max * 2) : PBIN_GROW);
+                uint8_t *p;
+
+                max = ((max < need) ? need : max);
+                p = (uint8_t *)realloc(pb->buf, max);
+                if(!p) {
+                        RPT(RPT_ERR, "param2bin: realloc failed");
+                        return -1;
+                }
+                pb->buf = p;
+                pb->max = max;
+        }
+        memset(pb->buf + pb->len, 0, need - pb->len);
+        pb->len = need;
+        return 0;
+}
+
+/* pay attention: pb->buf may be moved by pbin_grow(), so use offset only */
+static int param2rec(void *mem_base, struct pdesc *pdesc, struct pbin *pb, size_t rec)
+{
+        struct pdesc *cur_pdesc;
+        size_t pos = 0;
+
+        for(cur_pdesc = pdesc; PT_TYP_NULL != cur_pdesc->type; cur_pdesc++) {
+                uint8_t *mem = (uint8_t *)mem_base + cur_pdesc->offset;
+                int count = cur_pdesc->count;
+                size_t cia = 0;
+                size_t dat;
+                int i;
+
+                pos = item_pos(cur_pdesc, pos, &cia, &dat);
+                if(PT_CNT_X == PT_CNT(cur_pdesc->type)) {
+                        uint32_t cnt;
+
+                        cnt = *(int *)((uint8_t *)mem_base + cur_pdesc->aoffset);
+                        count = (((int)cnt < count) ? (int)cnt : count);
+                        cnt = (uint32_t)count;
+                        memcpy(pb->buf + rec + cia, &cnt, 4);
+                }
+
+                if(PT_TYP_VLST == PT_TYP(cur_pdesc->type)) {
+                        RPT(RPT_ERR, "param2bin: PT_VLST(%s) not supported", cur_pdesc->name);
+                        return -1;
+                }
+                else if(PT_TYP_LIST == PT_TYP(cur_pdesc->type)) {
+                        size_t rsz = rec_size(cur_pdesc->pdesc);
+
+                        for(i = 0; i < count; i++) {
+                                struct znode *list = ((struct znode **)mem)[i];
+                                struct znode *znode;
+                                struct pbin_ref ref;
+                                size_t off;
+
+                                for(ref.cnt = 0, znode = list; znode; znode = znode->next) {
+                                        ref.cnt++;
+                                }
+                                if(0 != pbin_grow(pb, ref.cnt * rsz, &off)) {
+                                        return -1;
+                                }
+                                ref.off = (uint32_t)off;
+                                memcpy(pb->buf + rec + dat + i * sizeof(struct pbin_ref), &ref, sizeof(ref));
+                                for(znode = list; znode; znode = znode->next, off += rsz) {
+                                        if(0 != param2rec(znode, cur_pdesc->pdesc, pb, off)) {
+                                                return -1;
+                                        }
+                                }
+                        }
+                }
+                else if(PT_ACS_X == PT_ACS(cur_pdesc->type)) {
+                        int *cob = (int *)((uint8_t *)mem_base + cur_pdesc->boffset);
+                        int is_stru = (PT_TYP_STRU == PT_TYP(cur_pdesc->type));
+                        size_t rsz = (is_stru ? rec_size(cur_pdesc->pdesc) : cur_pdesc->size);
+
+                        for(i = 0; i < count; i++) {
+                                uint8_t *p = ((uint8_t **)mem)[i];
+                                struct pbin_ref ref = {0, 0};
+                                size_t off;
+
+                                if(p && cob[i] > 0) {
+                                        ref.cnt = (uint32_t)(cob[i]);
+                                        if(0 != pbin_grow(pb, ref.cnt * rsz, &off)) {
+                                                return -1;
+                                        }
+                                        ref.off = (uint32_t)off;
+                                        if(is_stru) {
+                                                uint32_t j;
+
+                                                for(j = 0; j < ref.cnt; j++) {
+                                                        if(0 != param2rec(p + j * cur_pdesc->size, cur_pdesc->pdesc,
+                                                                          pb, off + j * rsz)) {
+                                                                return -1;
+                                                        }
+                                                }
+                                        }
+                                        else {
+                                                memcpy(pb->buf + off, p, ref.cnt * rsz);
+                                        }
+                                }
+                                memcpy(pb->buf + rec + dat + i * sizeof(struct pbin_ref), &ref, sizeof(ref));
+                        }
+                }
+                else if(PT_TYP_STRU == PT_TYP(cur_pdesc->type)) {
+                        size_t rsz = rec_size(cur_pdesc->pdesc);
+
+                        for(i = 0; i < count; i++) {
+                                if(0 != param2rec(mem + i * cur_pdesc->size, cur_pdesc->pdesc,
+                                                  pb, rec + dat + i * rsz)) {
+                                        return -1;
+                                }
+                        }
+                }
+                else {
+                        memcpy(pb->buf + rec + dat, mem, count * cur_pdesc->size);
+                }
+        }
+        return 0;
+}
+
+static int rec2param(void *mem_base, struct pdesc *pdesc, const uint8_t *buf, size_t len, size_t rec)
+{
+        struct pdesc *cur_pdesc;
+        size_t pos = 0;
+
+        for(cur_pdesc = pdesc; PT_TYP_NULL != cur_pdesc->type; cur_pdesc++) {
+                uint8_t *mem = (uint8_t *)mem_base + cur_pdesc->offset;
+                int count = cur_pdesc->count;
+                size_t cia = 0;
+                size_t dat;
+                int i;
+
+                pos = item_pos(cur_pdesc, pos, &cia, &dat);
+                if(PT_CNT_X == PT_CNT(cur_pdesc->type)) {
+                        uint32_t cnt;
+
+                        memcpy(&cnt, buf + rec + cia, 4);
+                        if(cnt > (uint32_t)count) {
+                                RPT(RPT_ERR, "bin2param: %s: count(%u) > %d", cur_pdesc->name, cnt, count);
+                                return -1;
+                        }
+                        count = (int)cnt;
+                        *(int *)((uint8_t *)mem_base + cur_pdesc->aoffset) = count;
+                }
+
+                if(PT_TYP_VLST == PT_TYP(cur_pdesc->type)) {
+                        RPT(RPT_ERR, "bin2param: PT_VLST(%s) not supported", cur_pdesc->name);
+                        return -1;
+                }
+                else if(PT_TYP_LIST == PT_TYP(cur_pdesc->type)) {
+                        size_t rsz = rec_size(cur_pdesc->pdesc);
+
+                        for(i = 0; i < count; i++) {
+                                zhead_t *head = (zhead_t *)(mem + i * sizeof(void *));
+                                struct pbin_ref ref;
+                                uint32_t j;
+
+                                memcpy(&ref, buf + rec + dat + i * sizeof(struct pbin_ref), sizeof(ref));
+                                if(*(struct znode **)head) {
+                                        RPT(RPT_ERR, "bin2param: %s: not an empty list", cur_pdesc->name);
+                                        return -1;
+                                }
+                                if(!ref_ok(&ref, rsz, len)) {
+                                        RPT(RPT_ERR, "bin2param: %s: bad list", cur_pdesc->name);
+                                        return -1;
+                                }
+                                for(j = 0; j < ref.cnt; j++) {
+                                        struct znode *list;
+
+                                        list = (struct znode *)xmlMalloc(cur_pdesc->size);
+                                        if(!list) {
+                                                RPT(RPT_ERR, "bin2param: malloc znode failed");
+                                                return -1;
+                                        }
+                                        memset(list, 0, cur_pdesc->size);
+                                        zlst_push(head, list);
+                                        if(0 != rec2param(list, cur_pdesc->pdesc, buf, len, ref.off + j * rsz)) {
+                                                return -1;
+                                        }
+                                }
+                        }
+                }
+                else if(PT_ACS_X == PT_ACS(cur_pdesc->type)) {
+                        int *cob = (int *)((uint8_t *)mem_base + cur_pdesc->boffset);
+                        int is_stru = (PT_TYP_STRU == PT_TYP(cur_pdesc->type));
+                        size_t rsz = (is_stru ? rec_size(cur_pdesc->pdesc) : cur_pdesc->size);
+
+                        for(i = 0; i < count; i++) {
+                                uint8_t **p = (uint8_t **)mem + i;
+                                struct pbin_ref ref;
+
+                                memcpy(&ref, buf + rec + dat + i * sizeof(struct pbin_ref), sizeof(ref));
+                                cob[i] = (int)(ref.cnt);
+                                *p = NULL;
+                                if(0 == ref.cnt) {
+                                        continue;
+                                }
+                                if(!ref_ok(&ref, rsz, len)) {
+                                        RPT(RPT_ERR, "bin2param: %s: bad buffer", cur_pdesc->name);
+                                        cob[i] = 0;
+                                        return -1;
+                                }
+                                *p = (uint8_t *)xmlMalloc(ref.cnt * cur_pdesc->size);
+                                if(!*p) {
+                                        RPT(RPT_ERR, "bin2param: malloc failed");
+                                        cob[i] = 0;
+                                        return -1;
+                                }
+                                if(is_stru) {
+                                        uint32_t j;
+
+                                        memset(*p, 0, ref.cnt * cur_pdesc->size);
+                                        for(j = 0; j < ref.cnt; j++) {
+                                                if(0 != rec2param(*p + j * cur_pdesc->size, cur_pdesc->pdesc,
+                                                                  buf, len, ref.off + j * rsz)) {
+                                                        return -1;
+                                                }
+                                        }
+                                }
+                                else {
+                                        memcpy(*p, buf + ref.off, ref.cnt * rsz);
+                                }
+                        }
+                }
+                else if(PT_TYP_STRU == PT_TYP(cur_pdesc->type)) {
+                        size_t rsz = rec_size(cur_pdesc->pdesc);
+
+                        for(i = 0; i < count; i++) {
+                                if(0 != rec2param(mem + i * cur_pdesc->size, cur_pdesc->pdesc,
+                                                  buf, len, rec + dat + i * rsz)) {
+                                        return -1;
+                                }
+                        }
+                }
+                else {
+                        memcpy(mem, buf + rec + dat, count * cur_pdesc->size);
+                }
+        }
+        return 0;
+}
+
+/* the whole buffer or list in snapshot */
+static int ref_ok(const struct pbin_ref *ref, size_t size, size_t len)
+{
+        return ((uint64_t)(ref->off) + (uint64_t)(ref->cnt) * size <= (uint64_t)len);
+}
@@ -0,0 +1,51 @@
+/* vim: set tabstop=8 shiftwidth=8:
+ * name: param_bin
+ * funx: flat binary snapshot of parameter, with the same pdesc tree as param_xml
+ *          _______             _______
+ *         |       | param2bin |       |
+ *         | param |---------->|  bin  | one fwrite/fread or mmap
+ *         |       |<--------- |       |
+ *         |_______| bin2param |_______|
+ *
+ * layout: head, then records, all offset from the head, 8-byte aligned
+ *         record: each pdesc item in order, fixed size for a pdesc array
+ *         (count, offset) pair for buffer(PT_ACS_X) and list(PT_LIST),
+ *         records of a list are one array, so record i is at offset + i * size
+ */
+
+#ifndef _PARAM_BIN_H
+#define _PARAM_BIN_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "param_xml.h" /* for struct pdesc, DLL_SPEC, etc */
+
+#define PBIN_MAGIC   "PBIN"
+#define PBIN_VERSION (1) /* change it if layout rule changed */
+
+struct pbin_head {
+        char magic[4]; /* PBIN_MAGIC */
+        uint16_t version; /* PBIN_VERSION */
+        uint16_t bom; /* 0x0102 in host order, else it is from other endian */
+        uint32_t schema; /* hash of pdesc tree, else it is from other struct */
+        uint32_t size; /* byte of whole snapshot, head included */
+        uint32_t root; /* offset of root record */
+        uint32_t reserved;
+};
+
+/* module interface, reentrant
+ * param2bin: *buf is malloc()ed, free() it after use
+ * bin2param: list node and buffer are xmlMalloc()ed, as xml2param does
+ * PT_VLST is not supported
+ */
+DLL_SPEC int param2bin(void *mem_base, struct pdesc *pdesc, uint8_t **buf, size_t *len);
+DLL_SPEC int bin2param(void *mem_base, struct pdesc *pdesc, const uint8_t *buf, size_t len);
+DLL_SPEC uint32_t pbin_schema(struct pdesc *pdesc);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _PARAM_BIN_H */
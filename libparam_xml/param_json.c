@@ -0,0 +1,915 @@
+/* vim: set tabstop=8 shiftwidth=8: */
+#include <stdio.h>
+#include <stdlib.h> /* for realloc(), strtoll(), etc */
+#include <string.h> /* for memcpy(), memset(), strlen() */
+#include <math.h> /* for isfinite() */
+
+#include "zlst.h"
+#include "param_json.h"
+
+/* report level */
+#define RPT_ERR (1) /* error, system error */
+#define RPT_WRN (2) /* warning, maybe wrong, maybe OK */
+#define RPT_INF (3) /* important information */
+#define RPT_DBG (4) /* debug information */
+
+/* report micro */
+#define RPT(lvl, ...) do \
+{ \
+        if(lvl <= rpt_lvl) \
+        { \
+                switch(lvl) \
+                { \
+                        case RPT_ERR: fprintf(stderr, "%s: %d: err: ", __FILE__, __LINE__); break; \
+                        case RPT_WRN: fprintf(stderr, "%s: %d: wrn: ", __FILE__, __LINE__); break; \
+                        case RPT_INF: fprintf(stderr, "%s: %d: inf: ", __FILE__, __LINE__); break; \
+                        case RPT_DBG: fprintf(stderr, "%s: %d: dbg: ", __FILE__, __LINE__); break; \
+                        default:      fprintf(stderr, "%s: %d: ???: ", __FILE__, __LINE__); break; \
+                } \
+                fprintf(stderr, __VA_ARGS__); \
+                fprintf(stderr, "\n"); \
+        } \
+} while (0)
+
+static int rpt_lvl = RPT_WRN; /* report level: ERR, WRN, INF, DBG */
+
+#define PJSON_GROW (4096) /* first buffer size */
+#define PJSON_KEY (64) /* longest key we care */
+#define PJSON_NUM (64) /* longest number text */
+#define PJSON_TYP "_typ" /* key of adesc name in PT_VLST node */
+
+/* input cursor */
+struct jrd {
+        const char *beg;
+        const char *cur;
+        const char *end;
+};
+
+static int pjson_put(struct pjson *pj, const char *str, size_t len);
+static int put_str(struct pjson *pj, const char *str, size_t max);
+static int put_num(struct pjson *pj, int type, size_t size, const uint8_t *mem);
+static int put_item(void *mem_base, struct pdesc *pdesc, struct pjson *pj);
+static int put_value(void *mem_base, struct pdesc *pdesc, int i, struct pjson *pj);
+
+static int skip_ws(struct jrd *jr);
+static int expect(struct jrd *jr, char c);
+static int get_str(struct jrd *jr, char *dst, size_t max);
+static int get_num(struct jrd *jr, int type, size_t size, uint8_t *mem);
+static int get_members(void *mem_base, struct pdesc *pdesc, struct jrd *jr);
+static int get_obj(void *mem_base, struct pdesc *pdesc, struct jrd *jr);
+static int get_item(void *mem_base, struct pdesc *pdesc, struct jrd *jr);
+static int get_value(void *mem_base, struct pdesc *pdesc, int i, struct jrd *jr);
+static int get_list(void *mem, struct pdesc *pdesc, struct jrd *jr);
+static int get_vlst(void *mem, struct pdesc *pdesc, struct jrd *jr);
+static int get_buf(void *mem_base, struct pdesc *pdesc, int i, struct jrd *jr);
+static int skip_value(struct jrd *jr);
+static int bad_json(struct jrd *jr, const char *hint);
+
+/* module interface */
+DLL_SPEC int param2json(void *mem_base, struct pdesc *pdesc, struct pjson *pj)
+{
+        struct pdesc *cur_pdesc;
+
+        if(0 != pjson_put(pj, "{", 1)) {
+                return -1;
+        }
+        for(cur_pdesc = pdesc; PT_TYP_NULL != cur_pdesc->type; cur_pdesc++) {
+                if(cur_pdesc != pdesc && 0 != pjson_put(pj, ",", 1)) {
+                        return -1;
+                }
+                if(0 != put_item(mem_base, cur_pdesc, pj)) {
+                        return -1;
+                }
+        }
+        return pjson_put(pj, "}", 1);
+}
+
+DLL_SPEC int json2param(void *mem_base, struct pdesc *pdesc, const char *buf, size_t len)
+{
+        struct jrd jr;
+
+        jr.beg = buf;
+        jr.cur = buf;
+        jr.end = buf + len;
+        return get_obj(mem_base, pdesc, &jr);
+}
+
+DLL_SPEC int pjson_cat(struct pjson *pj, const char *str)
+{
+        return pjson_put(pj, str, strlen(str));
+}
+
+/* subfunctions: param to JSON */
+static int pjson_put(struct pjson *pj, const char *str, size_t len)
+{
+        if(pj->len + len + 1 > pj->max) {
+                size_t max = ((pj->max) ? (pj->max * 2) : PJSON_GROW);
+                char *p;
+
+                max = ((max < pj->len + len + 1) ? (pj->len + len + 1) : max);
+                p = (char *)realloc(pj->buf, max);
+                if(!p) {
+                        RPT(RPT_ERR, "param2json: realloc failed");
+                        return -1;
+                }
+                pj->buf = p;
+                pj->max = max;
+        }
+        memcpy(pj->buf + pj->len, str, len);
+        pj->len += len;
+        pj->buf[pj->len] = '\0';
+        return 0;
+}
+
+/* quoted and escaped, at most max byte of str */
+static int put_str(struct pjson *pj, const char *str, size_t max)
+{
+        const char *run = str; /* bytes need no escape */
+        size_t i;
+
+        if(0 != pjson_put(pj, "\"", 1)) {
+                return -1;
+        }
+        for(i = 0; i < max && str[i]; i++) {
+                unsigned char c = (unsigned char)str[i];
+                char esc[8];
+
+                if(c >= 0x20 && '"' != c && '\\' != c) {
+                        continue;
+                }
+                if(0 != pjson_put(pj, run, (size_t)(str + i - run))) {
+                        return -1;
+                }
+                switch(c) {
+                        case '"':  strcpy(esc, "\\\""); break;
+                        case '\\': strcpy(esc, "\\\\"); break;
+                        case '\n': strcpy(esc, "\\n"); break;
+                        case '\r': strcpy(esc, "\\r"); break;
+                        case '\t': strcpy(esc, "\\t"); break;
+                        default: sprintf(esc, "\\u%04X", (unsigned int)c); break;
+                }
+                if(0 != pjson_put(pj, esc, strlen(esc))) {
+                        return -1;
+                }
+                run = str + i + 1;
+        }
+        if(0 != pjson_put(pj, run, (size_t)(str + i - run))) {
+                return -1;
+        }
+        return pjson_put(pj, "\"", 1);
+}
+
+static int put_num(struct pjson *pj, int type, size_t size, const uint8_t *mem)
+{
+        char str[PJSON_NUM];
+        int len;
+
+        switch(PT_TYP(type)) {
+                case PT_TYP_SINT: {
+                        int64_t dat;
+
+                        switch(size) {
+                                case 1: dat = *(const int8_t *)mem; break;
+                                case 2: dat = *(const int16_t *)mem; break;
+                                case 4: dat = *(const int32_t *)mem; break;
+                                default: dat = *(const int64_t *)mem; break;
+                        }
+                        len = sprintf(str, "%"PRId64, dat);
+                        break;
+                }
+                case PT_TYP_UINT: {
+                        uint64_t dat;
+
+                        switch(size) {
+                                case 1: dat = *(const uint8_t *)mem; break;
+                                case 2: dat = *(const uint16_t *)mem; break;
+                                case 4: dat = *(const uint32_t *)mem; break;
+                                default: dat = *(const uint64_t *)mem; break;
+                        }
+                        len = sprintf(str, "%"PRIu64, dat);
+                        break;
+                }
+                default: { /* PT_TYP_FLOT */
+                        long double dat;
+
+                        if(sizeof(float) == size) {
+                                dat = *(const float *)mem;
+                        }
+                        else if(sizeof(double) == size) {
+                                dat = *(const double *)mem;
+                        }
+                        else {
+                                dat = *(const long double *)mem;
+                        }
+                        if(!isfinite((double)dat)) {
+                                return pjson_put(pj, "null", 4); /* no NaN or Inf in JSON */
+                        }
+                        len = sprintf(str, "%.*Lg", ((sizeof(float) == size) ? 9 : 17), dat);
+                        break;
+                }
+        }
+        return pjson_put(pj, str, (size_t)len);
+}
+
+static int put_item(void *mem_base, struct pdesc *pdesc, struct pjson *pj)
+{
+        int count = pdesc->count;
+        int is_arr = ((1 != count) || (PT_CNT_X == PT_CNT(pdesc->type)));
+        int i;
+
+        if(PT_CNT_X == PT_CNT(pdesc->type)) {
+                int *cia = (int *)((uint8_t *)mem_base + pdesc->aoffset);
+
+                count = ((*cia < count) ? *cia : count);
+        }
+
+        if(0 != put_str(pj, pdesc->name, PJSON_KEY) || 0 != pjson_put(pj, ":", 1)) {
+                return -1;
+        }
+        if(is_arr && 0 != pjson_put(pj, "[", 1)) {
+                return -1;
+        }
+        for(i = 0; i < count; i++) {
+                if(i && 0 != pjson_put(pj, ",", 1)) {
+                        return -1;
+                }
+                if(0 != put_value(mem_base, pdesc, i, pj)) {
+                        return -1;
+                }
+        }
+        if(is_arr && 0 != pjson_put(pj, "]", 1)) {
+                return -1;
+        }
+        return 0;
+}
+
+/* i-th of item */
+static int put_value(void *mem_base, struct pdesc *pdesc, int i, struct pjson *pj)
+{
+        uint8_t *mem = (uint8_t *)mem_base + pdesc->offset;
+
+        if(PT_TYP_LIST == PT_TYP(pdesc->type) || PT_TYP_VLST == PT_TYP(pdesc->type)) {
+                struct znode *list;
+
+                if(0 != pjson_put(pj, "[", 1)) {
+                        return -1;
+                }
+                for(list = ((struct znode **)mem)[i]; list; list = list->next) {
+                        struct pdesc *sub_pdesc = pdesc->pdesc;
+
+                        if(list != ((struct znode **)mem)[i] && 0 != pjson_put(pj, ",", 1)) {
+                                return -1;
+                        }
+                        if(PT_TYP_VLST == PT_TYP(pdesc->type)) {
+                                struct adesc *adesc;
+
+                                if(!(pdesc->aux)) {
+                                        RPT(RPT_ERR, "param2json: %s: bad adesc", pdesc->name);
+                                        return -1;
+                                }
+                                for(adesc = (struct adesc *)(pdesc->aux); adesc->name; adesc++) {
+                                        if(list->name && 0 == strcmp(adesc->name, list->name)) {
+                                                break;
+                                        }
+                                }
+                                if(!(adesc->name)) {
+                                        adesc = (struct adesc *)(pdesc->aux);
+                                }
+                                sub_pdesc = adesc->pdesc;
+
+                                /* "_typ" first, then members as param2json() */
+                                if(0 != pjson_cat(pj, "{\""PJSON_TYP"\":") ||
+                                   0 != put_str(pj, adesc->name, PJSON_KEY)) {
+                                        return -1;
+                                }
+                                if(PT_TYP_NULL != sub_pdesc->type) {
+                                        struct pjson sub = {NULL, 0, 0};
+                                        int rslt;
+
+                                        rslt = param2json(list, sub_pdesc, &sub);
+                                        if(0 == rslt) {
+                                                sub.buf[0] = ','; /* "{" */
+                                                rslt = pjson_put(pj, sub.buf, sub.len);
+                                        }
+                                        free(sub.buf);
+                                        if(0 != rslt) {
+                                                return -1;
+                                        }
+                                }
+                                else if(0 != pjson_put(pj, "}", 1)) {
+                                        return -1;
+                                }
+                                continue;
+                        }
+                        if(0 != param2json(list, sub_pdesc, pj)) {
+                                return -1;
+                        }
+                }
+                return pjson_put(pj, "]", 1);
+        }
+
+        if(PT_ACS_X == PT_ACS(pdesc->type)) {
+                int cob = ((int *)((uint8_t *)mem_base + pdesc->boffset))[i];
+                uint8_t *p = ((uint8_t **)mem)[i];
+                int j;
+
+                if(!p || cob <= 0) {
+                        return pjson_put(pj, "null", 4);
+                }
+                if(0 != pjson_put(pj, "[", 1)) {
+                        return -1;
+                }
+                for(j = 0; j < cob; j++, p += pdesc->size) {
+                        if(j && 0 != pjson_put(pj, ",", 1)) {
+                                return -1;
+                        }
+                        if(PT_TYP_STRU == PT_TYP(pdesc->type)) {
+                                if(0 != param2json(p, pdesc->pdesc, pj)) {
+                                        return -1;
+                                }
+                        }
+                        else if(0 != put_num(pj, pdesc->type, pdesc->size, p)) {
+                                return -1;
+                        }
+                }
+                return pjson_put(pj, "]", 1);
+        }
+
+        mem += i * pdesc->size;
+        switch(PT_TYP(pdesc->type)) {
+                case PT_TYP_STRU:
+                        return param2json(mem, pdesc->pdesc, pj);
+                case PT_TYP_STRI:
+                        return put_str(pj, (const char *)mem, pdesc->size);
+                case PT_TYP_ENUM: {
+                        struct enume *enum_item;
+
+                        for(enum_item = (struct enume *)(pdesc->aux); enum_item->key; enum_item++) {
+                                if(*((int *)mem) == enum_item->value) {
+                                        break;
+                                }
+                        }
+                        if(!enum_item->key) {
+                                enum_item = (struct enume *)(pdesc->aux);
+                        }
+                        return put_str(pj, enum_item->key, PJSON_KEY);
+                }
+                default:
+                        return put_num(pj, pdesc->type, pdesc->size, mem);
+        }
+}
+
+/* subfunctions: JSON to param */
+static int skip_ws(struct jrd *jr)
+{
+        while(jr->cur < jr->end &&
+              (' ' == *jr->cur || '\t' == *jr->cur || '\n' == *jr->cur || '\r' == *jr->cur)) {
+                jr->cur++;
+        }
+        return ((jr->cur < jr->end) ? *jr->cur : -1);
+}
+
+static int expect(struct jrd *jr, char c)
+{
+        if(c != skip_ws(jr)) {
+                char hint[16];
+
+                sprintf(hint, "need '%c'", c);
+                return bad_json(jr, hint);
+        }
+        jr->cur++;
+        return 0;
+}
+
+/* dst: NULL to skip, at most max - 1 byte and '\0' */
+static int get_str(struct jrd *jr, char *dst, size_t max)
+{
+        size_t len = 0;
+
+        if(0 != expect(jr, '"')) {
+                return -1;
+        }
+        while(jr->cur < jr->end && '"' != *jr->cur) {
+                char utf8[4];
+                int n = 1;
+
+                utf8[0] = *jr->cur++;
+                if('\\' == utf8[0]) {
+                        if(jr->cur >= jr->end) {
+                                break;
+                        }
+                        switch(*jr->cur++) {
+                                case 'b': utf8[0] = '\b'; break;
+                                case 'f': utf8[0] = '\f'; break;
+                                case 'n': utf8[0] = '\n'; break;
+                                case 'r': utf8[0] = '\r'; break;
+                                case 't': utf8[0] = '\t'; break;
+                                case 'u': {
+                                        char hex[5];
+                                        unsigned long u;
+
+                                        if(jr->end - jr->cur < 4) {
+                                                return bad_json(jr, "bad \\u");
+                                        }
+                                        memcpy(hex, jr->cur, 4);
+                                        hex[4] = '\0';
+                                        if(4 != strspn(hex, "0123456789abcdefABCDEF")) {
+                                                return bad_json(jr, "bad \\u");
+                                        }
+                                        jr->cur += 4;
+                                        u = strtoul(hex, NULL, 16);
+                                        if(0xD800 <= u && u <= 0xDBFF && jr->end - jr->cur >= 6 &&
+                                           '\\' == jr->cur[0] && 'u' == jr->cur[1]) {
+                                                unsigned long lo;
+
+                                                memcpy(hex, jr->cur + 2, 4);
+                                                lo = strtoul(hex, NULL, 16);
+                                                if(0xDC00 <= lo && lo <= 0xDFFF) {
+                                                        u = 0x10000 + ((u - 0xD800) << 10) + (lo - 0xDC00);
+                                                        jr->cur += 6;
+                                                }
+                                        }
+                                        if(0 == u) {
+                                                /* C string can not hold it */
+                                                return bad_json(jr, "\\u0000 in string");
+                                        }
+                                        if(0xD800 <= u && u <= 0xDFFF) {
+                                                /* no UTF-8 for it */
+                                                return bad_json(jr, "lone surrogate");
+                                        }
+                                        if(u < 0x80) {
+                                                utf8[0] = (char)u;
+                                        }
+                                        else if(u < 0x800) {
+                                                utf8[0] = (char)(0xC0 | (u >> 6));
+                                                utf8[1] = (char)(0x80 | (u & 0x3F));
+                                                n = 2;
+                                        }
+                                        else if(u < 0x10000) {
+                                                utf8[0] = (char)(0xE0 | (u >> 12));
+                                                utf8[1] = (char)(0x80 | ((u >> 6) & 0x3F));
+                                                utf8[2] = (char)(0x80 | (u & 0x3F));
+                                                n = 3;
+                                        }
+                                        else {
+                                                utf8[0] = (char)(0xF0 | (u >> 18));
+                                                utf8[1] = (char)(0x80 | ((u >> 12) & 0x3F));
+                                                utf8[2] = (char)(0x80 | ((u >> 6) & 0x3F));
+                                                utf8[3] = (char)(0x80 | (u & 0x3F));
+                                                n = 4;
+                                        }
+                                        break;
+                                }
+                                default: utf8[0] = jr->cur[-1]; break; /* '"', '\\', '/' */
+                        }
+                }
+                if(dst && len + n < max) {
+                        memcpy(dst + len, utf8, n);
+                        len += n;
+                }
+        }
+        if(jr->cur >= jr->end) {
+                return bad_json(jr, "no end of string");
+        }
+        jr->cur++; /* '"' */
+        if(dst && max) {
+                dst[len] = '\0';
+        }
+        return 0;
+}
+
+static int get_num(struct jrd *jr, int type, size_t size, uint8_t *mem)
+{
+        char str[PJSON_NUM];
+        size_t len = 0;
+
+        skip_ws(jr);
+        if(jr->end - jr->cur >= 4 && 0 == memcmp(jr->cur, "null", 4)) {
+                jr->cur += 4;
+                return 0; /* keep it */
+        }
+        while(jr->cur < jr->end && len < sizeof(str) - 1 &&
+              strchr("+-0123456789.eE", *jr->cur)) {
+                str[len++] = *jr->cur++;
+        }
+        str[len] = '\0';
+        if(0 == len) {
+                return bad_json(jr, "need number");
+        }
+
+        switch(PT_TYP(type)) {
+                case PT_TYP_SINT: {
+                        int64_t dat = (int64_t)strtoll(str, NULL, 10);
+
+                        switch(size) {
+                                case 1: *(int8_t *)mem = (int8_t)dat; break;
+                                case 2: *(int16_t *)mem = (int16_t)dat; break;
+                                case 4: *(int32_t *)mem = (int32_t)dat; break;
+                                default: *(int64_t *)mem = dat; break;
+                        }
+                        break;
+                }
+                case PT_TYP_UINT: {
+                        uint64_t dat = (uint64_t)strtoull(str, NULL, 10);
+
+                        switch(size) {
+                                case 1: *(uint8_t *)mem = (uint8_t)dat; break;
+                                case 2: *(uint16_t *)mem = (uint16_t)dat; break;
+                                case 4: *(uint32_t *)mem = (uint32_t)dat; break;
+                                default: *(uint64_t *)mem = dat; break;
+                        }
+                        break;
+                }
+                default: { /* PT_TYP_FLOT */
+                        long double dat = strtold(str, NULL);
+
+                        if(sizeof(float) == size) {
+                                *(float *)mem = (float)dat;
+                        }
+                        else if(sizeof(double) == size) {
+                                *(double *)mem = (double)dat;
+                        }
+                        else {
+                                *(long double *)mem = dat;
+                        }
+                        break;
+                }
+        }
+        return 0;
+}
+
+static int get_obj(void *mem_base, struct pdesc *pdesc, struct jrd *jr)
+{
+        if(0 != expect(jr, '{')) {
+                return -1;
+        }
+        return get_members(mem_base, pdesc, jr);
+}
+
+/* after '{' or ',' of an object, till '}' */
+static int get_members(void *mem_base, struct pdesc *pdesc, struct jrd *jr)
+{
+        struct pdesc *cur_pdesc;
+
+        /* clear pdesc->ioa, as xml2param() */
+        for(cur_pdesc = pdesc; PT_TYP_NULL != cur_pdesc->type; cur_pdesc++) {
+                cur_pdesc->ioa = 0;
+        }
+
+        if('}' == skip_ws(jr)) {
+                jr->cur++;
+                return 0;
+        }
+        while(1) {
+                char key[PJSON_KEY];
+                int c;
+
+                if(0 != get_str(jr, key, sizeof(key)) || 0 != expect(jr, ':')) {
+                        return -1;
+                }
+
+                /* search cur_pdesc */
+                for(cur_pdesc = pdesc; PT_TYP_NULL != cur_pdesc->type; cur_pdesc++) {
+                        if(0 == strcmp(cur_pdesc->name, key)) {
+                                break;
+                        }
+                }
+                if(PT_TYP_NULL == cur_pdesc->type) {
+                        RPT(RPT_WRN, "no mark in param is \"%s\"", key);
+                        if(0 != skip_value(jr)) {
+                                return -1;
+                        }
+                }
+                else if(0 != get_item(mem_base, cur_pdesc, jr)) {
+                        return -1;
+                }
+
+                c = skip_ws(jr);
+                jr->cur++;
+                if('}' == c) {
+                        return 0;
+                }
+                if(',' != c) {
+                        jr->cur--;
+                        return bad_json(jr, "need ',' or '}'");
+                }
+        }
+}
+
+static int get_item(void *mem_base, struct pdesc *pdesc, struct jrd *jr)
+{
+        int is_arr = ((1 != pdesc->count) || (PT_CNT_X == PT_CNT(pdesc->type)));
+        int i;
+
+        if(!is_arr) {
+                return get_value(mem_base, pdesc, 0, jr);
+        }
+
+        if(0 != expect(jr, '[')) {
+                return -1;
+        }
+        if(']' == skip_ws(jr)) {
+                jr->cur++;
+                i = 0;
+        }
+        else {
+                for(i = 0; 1; i++) {
+                        int c;
+
+                        if(i < pdesc->count) {
+                                if(0 != get_value(mem_base, pdesc, i, jr)) {
+                                        return -1;
+                                }
+                        }
+                        else {
+                                RPT(RPT_WRN, "json2param: %s: idx(%d) >= count(%d), ignore",
+                                    pdesc->name, i, pdesc->count);
+                                if(0 != skip_value(jr)) {
+                                        return -1;
+                                }
+                        }
+                        c = skip_ws(jr);
+                        jr->cur++;
+                        if(']' == c) {
+                                i++;
+                                break;
+                        }
+                        if(',' != c) {
+                                jr->cur--;
+                                return bad_json(jr, "need ',' or ']'");
+                        }
+                }
+        }
+        if(PT_CNT_X == PT_CNT(pdesc->type)) {
+                int *cia; /* count in array */
+                cia = (int *)((uint8_t *)mem_base + pdesc->aoffset);
+                *cia = ((i < pdesc->count) ? i : pdesc->count);
+        }
+        return 0;
+}
+
+/* i-th of item */
+static int get_value(void *mem_base, struct pdesc *pdesc, int i, struct jrd *jr)
+{
+        uint8_t *mem = (uint8_t *)mem_base + pdesc->offset;
+
+        if(PT_TYP_LIST == PT_TYP(pdesc->type)) {
+                return get_list(mem + i * sizeof(void *), pdesc, jr);
+        }
+        if(PT_TYP_VLST == PT_TYP(pdesc->type)) {
+                return get_vlst(mem + i * sizeof(void *), pdesc, jr);
+        }
+        if(PT_ACS_X == PT_ACS(pdesc->type)) {
+                return get_buf(mem_base, pdesc, i, jr);
+        }
+
+        mem += i * pdesc->size;
+        switch(PT_TYP(pdesc->type)) {
+                case PT_TYP_STRU:
+                        return get_obj(mem, pdesc->pdesc, jr);
+                case PT_TYP_STRI:
+                        return get_str(jr, (char *)mem, pdesc->size);
+                case PT_TYP_ENUM: {
+                        char key[PJSON_KEY];
+                        struct enume *enum_item;
+
+                        if(0 != get_str(jr, key, sizeof(key))) {
+                                return -1;
+                        }
+                        for(enum_item = (struct enume *)(pdesc->aux); enum_item->key; enum_item++) {
+                                if(0 == strcmp(key, enum_item->key)) {
+                                        break;
+                                }
+                        }
+                        *(int *)mem = enum_item->value;
+                        return 0;
+                }
+                default:
+                        return get_num(jr, pdesc->type, pdesc->size, mem);
+        }
+}
+
+static int get_list(void *mem, struct pdesc *pdesc, struct jrd *jr)
+{
+        if(*(struct znode **)mem) {
+                RPT(RPT_ERR, "json2param: %s: not an empty list", pdesc->name);
+                return -1;
+        }
+        if(0 != expect(jr, '[')) {
+                return -1;
+        }
+        if(']' == skip_ws(jr)) {
+                jr->cur++;
+                return 0;
+        }
+        while(1) {
+                struct znode *list;
+                int c;
+
+                list = (struct znode *)xmlMalloc(pdesc->size);
+                if(!list) {
+                        RPT(RPT_ERR, "json2param: malloc znode failed");
+                        return -1;
+                }
+                memset(list, 0, pdesc->size);
+                zlst_push((zhead_t *)mem, list);
+                if(0 != get_obj(list, pdesc->pdesc, jr)) {
+                        return -1;
+                }
+
+                c = skip_ws(jr);
+                jr->cur++;
+                if(']' == c) {
+                        return 0;
+                }
+                if(',' != c) {
+                        jr->cur--;
+                        return bad_json(jr, "need ',' or ']'");
+                }
+        }
+}
+
+static int get_vlst(void *mem, struct pdesc *pdesc, struct jrd *jr)
+{
+        if(*(struct znode **)mem) {
+                RPT(RPT_ERR, "json2param: %s: not an empty list", pdesc->name);
+                return -1;
+        }
+        if(!(pdesc->aux)) {
+                RPT(RPT_ERR, "json2param: %s: bad adesc", pdesc->name);
+                return -1;
+        }
+        if(0 != expect(jr, '[')) {
+                return -1;
+        }
+        if(']' == skip_ws(jr)) {
+                jr->cur++;
+                return 0;
+        }
+        while(1) {
+                char key[PJSON_KEY];
+                char typ[PJSON_KEY];
+                struct adesc *adesc;
+                struct znode *list;
+                int c;
+
+                if(0 != expect(jr, '{') ||
+                   0 != get_str(jr, key, sizeof(key)) || 0 != expect(jr, ':') ||
+                   0 != get_str(jr, typ, sizeof(typ))) {
+                        return -1;
+                }
+                if(0 != strcmp(key, PJSON_TYP)) {
+                        return bad_json(jr, "need \""PJSON_TYP"\" first");
+                }
+                for(adesc = (struct adesc *)(pdesc->aux); adesc->name; adesc++) {
+                        if(0 == strcmp(adesc->name, typ)) {
+                                break;
+                        }
+                }
+                if(!(adesc->name)) {
+                        RPT(RPT_ERR, "json2param: %s: unknown %s", pdesc->name, typ);
+                        return -1;
+                }
+
+                list = (struct znode *)xmlMalloc(adesc->size);
+                if(!list) {
+                        RPT(RPT_ERR, "json2param: malloc znode failed");
+                        return -1;
+                }
+                memset(list, 0, adesc->size);
+                zlst_set_name(list, adesc->name);
+                zlst_push((zhead_t *)mem, list);
+
+                c = skip_ws(jr);
+                jr->cur++;
+                if(',' == c) {
+                        if(0 != get_members(list, adesc->pdesc, jr)) {
+                                return -1;
+                        }
+                }
+                else if('}' != c) {
+                        jr->cur--;
+                        return bad_json(jr, "need ',' or '}'");
+                }
+
+                c = skip_ws(jr);
+                jr->cur++;
+                if(']' == c) {
+                        return 0;
+                }
+                if(',' != c) {
+                        jr->cur--;
+                        return bad_json(jr, "need ',' or ']'");
+                }
+        }
+}
+
+/* buffer: count elements first, then malloc and fill */
+static int get_buf(void *mem_base, struct pdesc *pdesc, int i, struct jrd *jr)
+{
+        int *cob = ((int *)((uint8_t *)mem_base + pdesc->boffset)) + i;
+        uint8_t **p = ((uint8_t **)((uint8_t *)mem_base + pdesc->offset)) + i;
+        const char *head;
+        int cnt;
+        int c;
+        int j;
+
+        *cob = 0;
+        *p = NULL;
+        skip_ws(jr);
+        if(jr->end - jr->cur >= 4 && 0 == memcmp(jr->cur, "null", 4)) {
+                jr->cur += 4;
+                return 0;
+        }
+        if(0 != expect(jr, '[')) {
+                return -1;
+        }
+        head = jr->cur;
+        for(cnt = 0; ']' != (c = skip_ws(jr)); cnt++) {
+                const char *from = jr->cur;
+
+                if(-1 == c) {
+                        return bad_json(jr, "no end of array");
+                }
+                if(0 != skip_value(jr)) {
+                        return -1;
+                }
+                if(jr->cur == from) {
+                        return bad_json(jr, "need value");
+                }
+                if(',' == skip_ws(jr)) {
+                        jr->cur++;
+                }
+        }
+        jr->cur = head;
+        if(0 == cnt) {
+                return expect(jr, ']');
+        }
+
+        *p = (uint8_t *)xmlMalloc(cnt * pdesc->size);
+        if(!*p) {
+                RPT(RPT_ERR, "json2param: malloc failed");
+                return -1;
+        }
+        memset(*p, 0, cnt * pdesc->size);
+        *cob = cnt;
+        for(j = 0; j < cnt; j++) {
+                uint8_t *the_mem = *p + j * pdesc->size;
+
+                if(j && 0 != expect(jr, ',')) {
+                        return -1;
+                }
+                if(PT_TYP_STRU == PT_TYP(pdesc->type)) {
+                        if(0 != get_obj(the_mem, pdesc->pdesc, jr)) {
+                                return -1;
+                        }
+                }
+                else if(0 != get_num(jr, pdesc->type, pdesc->size, the_mem)) {
+                        return -1;
+                }
+        }
+        return expect(jr, ']');
+}
+
+/* any value, for key not in pdesc */
+static int skip_value(struct jrd *jr)
+{
+        int c = skip_ws(jr);
+        int depth = 0;
+
+        if('"' == c) {
+                return get_str(jr, NULL, 0);
+        }
+        if('{' != c && '[' != c) {
+                /* number, true, false, null */
+                while(jr->cur < jr->end && NULL == strchr(",}] \t\r\n", *jr->cur)) {
+                        jr->cur++;
+                }
+                return 0;
+        }
+        while(jr->cur < jr->end) {
+                c = *jr->cur;
+                if('"' == c) {
+                        if(0 != get_str(jr, NULL, 0)) {
+                                return -1;
+                        }
+                        continue;
+                }
+                jr->cur++;
+                if('{' == c || '[' == c) {
+                        depth++;
+                }
+                else if('}' == c || ']' == c) {
+                        if(0 == --depth) {
+                                return 0;
+                        }
+                }
+        }
+        return bad_json(jr, "no end of object or array");
+}
+
+static int bad_json(struct jrd *jr, const char *hint)
+{
+        RPT(RPT_ERR, "json2param: %s at byte %zd", hint, (size_t)(jr->cur - jr->beg));
+        return -1;
+}
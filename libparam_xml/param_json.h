@@ -0,0 +1,46 @@
+/* vim: set tabstop=8 shiftwidth=8:
+ * name: param_json
+ * funx: JSON text of parameter, with the same pdesc tree as param_xml
+ *          _______              ________
+ *         |       | param2json |        |
+ *         | param |----------->|  JSON  | no DOM, direct into buffer
+ *         |       |<---------- |        |
+ *         |_______| json2param |________|
+ *
+ * mapping: struct -> object, item name -> key
+ *          SINT, UINT, FLOT -> number(decimal), STRI, ENUM -> string
+ *          buffer(PT_ACS_X) -> array, null if empty
+ *          PT_LIST -> array of object
+ *          PT_VLST -> array of object, "_typ" is the first key, name of adesc
+ *          item with count != 1 or PT_CNT_X -> array of the above
+ */
+
+#ifndef _PARAM_JSON_H
+#define _PARAM_JSON_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "param_xml.h" /* for struct pdesc, DLL_SPEC, etc */
+
+/* growable output buffer, '\0' terminated, init with {NULL, 0, 0}, free(buf) after use */
+struct pjson {
+        char *buf;
+        size_t len; /* without '\0' */
+        size_t max;
+};
+
+/* module interface, reentrant
+ * param2json: append JSON object of mem_base to pj
+ * json2param: list node and buffer are xmlMalloc()ed, as xml2param does
+ */
+DLL_SPEC int param2json(void *mem_base, struct pdesc *pdesc, struct pjson *pj);
+DLL_SPEC int json2param(void *mem_base, struct pdesc *pdesc, const char *buf, size_t len);
+DLL_SPEC int pjson_cat(struct pjson *pj, const char *str); /* append raw text, e.g. "{\"ts\":" */
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _PARAM_JSON_H */
@@ -82,6 +82,9 @@ static int xml2stru(void *mem_base, xmlNode *xnode, struct pdesc *pdesc);
 static int xml2list(void *mem_base, xmlNode *xnode, struct pdesc *pdesc);
 static int xml2vlst(void *mem_base, xmlNode *xnode, struct pdesc *pdesc);
 
+static int reader2param(void *mem_base, xmlTextReaderPtr reader, struct pdesc *pdesc);
+static int reader2list(void *mem_base, xmlTextReaderPtr reader, struct pdesc *pdesc);
+
 /* for speed reason, define sint2str micro and uint2str micro here */
 #define UINT64_MAX_DEC_LENGTH 20 /* UINT64_MAX is 1.8e+19 level */
 
@@ -237,7 +240,188 @@ DLL_SPEC int xml2param(void *mem_base, xmlNode *xnode, struct pdesc *pdesc)
         return 0;
 }
 
+DLL_SPEC int xml2param_reader(void *mem_base, xmlTextReaderPtr reader, const char *root, struct pdesc *pdesc)
+{
+        int rslt;
+
+        /* skip to root node */
+        while(1 == (rslt = xmlTextReaderRead(reader))) {
+                if(XML_READER_TYPE_ELEMENT == xmlTextReaderNodeType(reader)) {
+                        break;
+                }
+        }
+        if(1 != rslt) {
+                RPT(RPT_ERR, "xml2param_reader: no root node");
+                return -1;
+        }
+        if(root && !xmlStrEqual(xmlTextReaderConstName(reader), (const xmlChar *)root)) {
+                RPT(RPT_ERR, "xml2param_reader: root node != %s", root);
+                return -1;
+        }
+        return reader2param(mem_base, reader, pdesc);
+}
+
+DLL_SPEC int xml2param_file(void *mem_base, const char *file, const char *root, struct pdesc *pdesc)
+{
+        xmlTextReaderPtr reader;
+        int rslt;
+
+        reader = xmlReaderForFile(file, NULL, 0);
+        if(!reader) {
+                RPT(RPT_ERR, "xml2param_file: open %s failed", file);
+                return -1;
+        }
+        rslt = xml2param_reader(mem_base, reader, root, pdesc);
+        xmlFreeTextReader(reader);
+        return rslt;
+}
+
 /* subfunctions */
+/* streaming: reader is on the start tag of mem_base node, stop at its end tag
+ * list is walked node by node, other item is expanded alone, then as xml2param()
+ */
+static int reader2param(void *mem_base, xmlTextReaderPtr reader, struct pdesc *pdesc)
+{
+        struct pdesc *cur_pdesc;
+        int depth;
+        int rslt;
+
+        /* clear pdesc->ioa */
+        for(cur_pdesc = pdesc; PT_TYP_NULL != cur_pdesc->type; cur_pdesc++) {
+                cur_pdesc->ioa = 0;
+        }
+
+        if(xmlTextReaderIsEmptyElement(reader)) {
+                return 0;
+        }
+        depth = xmlTextReaderDepth(reader);
+
+        rslt = xmlTextReaderRead(reader);
+        while(1 == rslt) {
+                int type = xmlTextReaderNodeType(reader);
+                const xmlChar *name;
+                xmlNode *sub_xnode;
+
+                if(XML_READER_TYPE_END_ELEMENT == type && depth == xmlTextReaderDepth(reader)) {
+                        return 0;
+                }
+                if(XML_READER_TYPE_ELEMENT != type) {
+                        rslt = xmlTextReaderRead(reader); /* text, comment, etc */
+                        continue;
+                }
+
+                /* search cur_pdesc */
+                name = xmlTextReaderConstName(reader);
+                for(cur_pdesc = pdesc; PT_TYP_NULL != cur_pdesc->type; cur_pdesc++) {
+                        if(xmlStrEqual((xmlChar *)(cur_pdesc->name), name)) {
+                                break;
+                        }
+                }
+                if(PT_TYP_NULL == cur_pdesc->type) {
+                        RPT(RPT_WRN, "no mark in param is \"%s\"", (char *)name);
+                        rslt = xmlTextReaderNext(reader);
+                        continue;
+                }
+
+                if(PT_TYP_LIST == PT_TYP(cur_pdesc->type)) {
+                        rslt = reader2list(mem_base, reader, cur_pdesc);
+                        continue;
+                }
+
+                sub_xnode = xmlTextReaderExpand(reader);
+                if(!sub_xnode) {
+                        RPT(RPT_ERR, "reader2param: expand \"%s\" failed", (char *)name);
+                        return -1;
+                }
+                switch(PT_TYP(cur_pdesc->type)) {
+                        case PT_TYP_SINT: xml2sint(mem_base, sub_xnode, cur_pdesc); break;
+                        case PT_TYP_UINT: xml2uint(mem_base, sub_xnode, cur_pdesc); break;
+                        case PT_TYP_FLOT: xml2flot(mem_base, sub_xnode, cur_pdesc); break;
+                        case PT_TYP_STRI: xml2stri(mem_base, sub_xnode, cur_pdesc); break;
+                        case PT_TYP_ENUM: xml2enum(mem_base, sub_xnode, cur_pdesc); break;
+                        case PT_TYP_STRU: xml2stru(mem_base, sub_xnode, cur_pdesc); break;
+                        case PT_TYP_VLST: xml2vlst(mem_base, sub_xnode, cur_pdesc); break;
+                        default: RPT(RPT_INF, "reader2param: bad type(0x%X)", cur_pdesc->type); break;
+                }
+                rslt = xmlTextReaderNext(reader);
+        }
+        RPT(RPT_ERR, "reader2param: bad xml, no end tag at depth %d", depth);
+        return -1;
+}
+
+/* as xml2list(), return with reader on the node after the list node */
+static int reader2list(void *mem_base, xmlTextReaderPtr reader, struct pdesc *pdesc)
+{
+        xmlChar *idx;
+        uint8_t *mem = (uint8_t *)mem_base + pdesc->offset;
+        int depth;
+        int rslt;
+
+        RPT(RPT_INF, "reader2list: %s", pdesc->name);
+
+        /* adjust pdesc->ioa, calc mem */
+        idx = xmlTextReaderGetAttribute(reader, xStrIdx);
+        if(idx) {
+                pdesc->ioa = atoi((char *)idx);
+                xmlFree(idx);
+        }
+        if(pdesc->ioa >= pdesc->count) {
+                RPT(RPT_INF, "reader2list: idx(%d) >= count(%d), ignore", pdesc->ioa, pdesc->count);
+                return xmlTextReaderNext(reader);
+        }
+        mem += (pdesc->ioa * sizeof(void *));
+
+        /* get list */
+        RPT(RPT_INF, "reader2list[%d]:", pdesc->ioa);
+        pdesc->ioa++;
+        if(*(struct znode **)mem) {
+                RPT(RPT_ERR, "reader2list: not an empty list");
+                return xmlTextReaderNext(reader);
+        };
+        if(PT_CNT_X == PT_CNT(pdesc->type)) {
+                int *cia; /* count in array */
+                cia = (int *)((uint8_t *)mem_base + pdesc->aoffset);
+                *cia = pdesc->ioa;
+        }
+        if(xmlTextReaderIsEmptyElement(reader)) {
+                return xmlTextReaderRead(reader);
+        }
+        depth = xmlTextReaderDepth(reader);
+
+        rslt = xmlTextReaderRead(reader);
+        while(1 == rslt) {
+                int type = xmlTextReaderNodeType(reader);
+                struct znode *list;
+
+                if(XML_READER_TYPE_END_ELEMENT == type && depth == xmlTextReaderDepth(reader)) {
+                        return xmlTextReaderRead(reader);
+                }
+                if(XML_READER_TYPE_ELEMENT != type) {
+                        rslt = xmlTextReaderRead(reader);
+                        continue;
+                }
+                if(!xmlStrEqual((xmlChar *)(pdesc->name), xmlTextReaderConstName(reader))) {
+                        rslt = xmlTextReaderNext(reader);
+                        continue;
+                }
+
+                /* add list node */
+                list = (struct znode *)xmlMalloc(pdesc->size);
+                if(!list) {
+                        RPT(RPT_INF, "reader2list: malloc znode failed");
+                        rslt = xmlTextReaderNext(reader);
+                        continue;
+                }
+                memset(list, 0, pdesc->size);
+                zlst_push((zhead_t *)mem, list);
+                if(0 != reader2param(list, reader, pdesc->pdesc)) {
+                        return -1;
+                }
+                rslt = xmlTextReaderRead(reader);
+        }
+        return rslt;
+}
+
 static int sint2xml(void *mem_base, xmlNode *xnode, struct pdesc *pdesc)
 {
         int i;
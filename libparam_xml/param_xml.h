@@ -55,6 +55,7 @@ extern "C" {
 
 #include <libxml/xmlmemory.h>
 #include <libxml/parser.h>
+#include <libxml/xmlreader.h>
 
 /* mask and mark */
 #define PT_TYP_MASK (0xF000) /* basic type */
@@ -177,6 +178,13 @@ struct pdesc {
 DLL_SPEC int param2xml(void *mem_base, xmlNode *xnode, struct pdesc *pdesc);
 DLL_SPEC int xml2param(void *mem_base, xmlNode *xnode, struct pdesc *pdesc);
 
+/* streaming xml2param, no DOM of the whole file: memory is bounded by one
+ * list node, result is the same as xmlParseFile() then xml2param()
+ * root: name of root node, NULL for any
+ */
+DLL_SPEC int xml2param_reader(void *mem_base, xmlTextReaderPtr reader, const char *root, struct pdesc *pdesc);
+DLL_SPEC int xml2param_file(void *mem_base, const char *file, const char *root, struct pdesc *pdesc);
+
 #ifdef __cplusplus
 }
 #endif
@@ -0,0 +1,390 @@
+/* vim: set tabstop=8 shiftwidth=8:
+ * funx: to test param_json module, round trip of LIST/VLST/buffer, then malformed JSON,
+ *       param_bin module, round trip without VLST, then truncated snapshot
+ * comp: gcc test_param_xml.c -I../libzlst -I/usr/include/libxml2 -L. -lparam_xml -L../libzlst -lzlst -lxml2
+ */
+
+#include <stdio.h>
+#include <stdlib.h> /* for free, etc */
+#include <string.h> /* for memset, strcmp, etc */
+#include <inttypes.h> /* for uint?_t, PRId64, etc */
+#include <unistd.h> /* for alarm */
+
+#include "zlst.h"
+#include "param_xml.h"
+#include "param_json.h"
+#include "param_bin.h"
+
+#define NODE_CNT (5) /* nodes of LIST and VLST */
+#define WATCHDOG (10) /* second, json2param() should never spin */
+
+struct node {
+        struct znode cvfl; /* common variable for list */
+        uint32_t id;
+        char tag[1][16];
+        uint8_t *data[1];
+        int data_len[1];
+};
+
+struct va { /* VLST node of type "va" */
+        struct znode cvfl;
+        int16_t a;
+};
+
+struct vb { /* VLST node of type "vb" */
+        struct znode cvfl;
+        char s[1][8];
+        uint16_t *w[1];
+        int w_len[1];
+};
+
+struct pt {
+        int32_t x;
+        int32_t y;
+};
+
+struct root {
+        uint16_t id;
+        int16_t s[4];
+        int s_cnt;
+        char name[2][16];
+        int mode;
+        double f;
+        uint8_t *buf[2];
+        int buf_len[2];
+        struct pt *pts[1];
+        int pts_len[1];
+        struct node *node0;
+        void *vl0;
+};
+
+static struct enume en_mode[] = {
+        {"off", 0},
+        {"on", 1},
+        {"auto", 2},
+        {NULL, 0}
+};
+
+static struct pdesc pd_node[] = {
+        {0, 0, 1, PT_UINTu_SS(struct node, id, uint32_t), "id", NULL, 0},
+        {0, 0, 1, PT_STRI__SS(struct node, tag), "tag", NULL, 0},
+        {0, 0, 1, PT_UINTX_XS(struct node, data, data_len, uint8_t), "data", NULL, 0},
+        {0, 0, 0, PT_NULL, "", NULL, 0}
+};
+
+static struct pdesc pd_va[] = {
+        {0, 0, 1, PT_SINT__SS(struct va, a, int16_t), "a", NULL, 0},
+        {0, 0, 0, PT_NULL, "", NULL, 0}
+};
+
+static struct pdesc pd_vb[] = {
+        {0, 0, 1, PT_STRI__SS(struct vb, s), "s", NULL, 0},
+        {0, 0, 1, PT_UINTx_XS(struct vb, w, w_len, uint16_t), "w", NULL, 0},
+        {0, 0, 0, PT_NULL, "", NULL, 0}
+};
+
+static struct adesc ad_v[] = {
+        {sizeof(struct va), pd_va, "va"},
+        {sizeof(struct vb), pd_vb, "vb"},
+        {0, NULL, NULL}
+};
+
+static struct pdesc pd_pt[] = {
+        {0, 0, 1, PT_SINT__SS(struct pt, x, int32_t), "x", NULL, 0},
+        {0, 0, 1, PT_SINT__SS(struct pt, y, int32_t), "y", NULL, 0},
+        {0, 0, 0, PT_NULL, "", NULL, 0}
+};
+
+static struct pdesc pd_root[] = {
+        {0, 0, 1, PT_UINTX_SS(struct root, id, uint16_t), "id", NULL, 0},
+        {0, 0, 4, PT_SINT__SX(struct root, s, s_cnt, int16_t), "s", NULL, 0},
+        {0, 0, 2, PT_STRI__SS(struct root, name), "name", NULL, 0},
+        {0, 0, 1, PT_ENUM__SS(struct root, mode), "mode", NULL, (intptr_t)en_mode},
+        {0, 0, 1, PT_FLOT__SS(struct root, f, double), "f", NULL, 0},
+        {0, 0, 2, PT_UINTu_XS(struct root, buf, buf_len, uint8_t), "buf", NULL, 0},
+        {0, 0, 1, PT_STRU__XS(struct root, pts, pts_len, struct pt), "pts", pd_pt, 0},
+        {0, 0, 1, PT_LIST__XS(struct root, node0, struct node), "node", pd_node, 0},
+        {0, 0, 1, PT_VLST__XS(struct root, vl0), "vl", NULL, (intptr_t)ad_v},
+        {0, 0, 0, PT_NULL, "", NULL, 0}
+};
+
+/* param_bin has no PT_VLST */
+static struct pdesc pd_rbin[] = {
+        {0, 0, 1, PT_UINTX_SS(struct root, id, uint16_t), "id", NULL, 0},
+        {0, 0, 4, PT_SINT__SX(struct root, s, s_cnt, int16_t), "s", NULL, 0},
+        {0, 0, 2, PT_STRI__SS(struct root, name), "name", NULL, 0},
+        {0, 0, 1, PT_ENUM__SS(struct root, mode), "mode", NULL, (intptr_t)en_mode},
+        {0, 0, 1, PT_FLOT__SS(struct root, f, double), "f", NULL, 0},
+        {0, 0, 2, PT_UINTu_XS(struct root, buf, buf_len, uint8_t), "buf", NULL, 0},
+        {0, 0, 1, PT_STRU__XS(struct root, pts, pts_len, struct pt), "pts", pd_pt, 0},
+        {0, 0, 1, PT_LIST__XS(struct root, node0, struct node), "node", pd_node, 0},
+        {0, 0, 0, PT_NULL, "", NULL, 0}
+};
+
+/* each one should be refused, not hang */
+static const char *bad[] = {
+        "",
+        "[1]",
+        "{\"id\":1",
+        "{\"id\":}",
+        "{\"id\":1,\"buf\":[[1,2",
+        "{\"id\":1,\"buf\":[[1,}]]}",
+        "{\"id\":1,\"buf\":[[1,2],3",
+        "{\"id\":1,\"pts\":[{\"x\":1},",
+        "{\"id\":1,\"name\":[\"abc",
+        "{\"id\":1,\"s\":[1,2,}",
+        "{\"id\":1,\"node\":[{\"id\":1,\"data\":[1,2]",
+        "{\"id\":1,\"node\":[{\"id\":1,\"data\":[1,}]}]}",
+        "{\"id\":1,\"vl\":[{\"a\":1}]}",
+        "{\"id\":1,\"vl\":[{\"_typ\":\"vc\"}]}",
+        "{\"id\":1,\"vl\":[{\"_typ\":\"vb\",\"w\":[1,",
+        "{\"id\":1,\"name\":[\"a\\u0000b\"]}",
+        "{\"id\":1,\"name\":[\"a\\uD800b\"]}",
+        "{\"id\":1,\"name\":[\"a\\uDC00b\"]}",
+        "{\"id\":1,\"name\":[\"a\\uD800\\u0041\"]}",
+        "{\"id\":1,\"name\":[\"a\\u00G1\"]}",
+        NULL
+};
+
+static int64_t fail_cnt = 0;
+static int64_t check_cnt = 0;
+
+static void fill(struct root *r);
+static void test_round_trip(void);
+static void test_bad(void);
+static void test_bin(void);
+static void test_bin_bad(void);
+static void check(const char *hint, int val, const char *json);
+
+int main(void)
+{
+        alarm(WATCHDOG);
+        test_round_trip();
+        test_bad();
+        test_bin();
+        test_bin_bad();
+        fprintf(stdout, "%"PRId64" check, %"PRId64" fail\n", check_cnt, fail_cnt);
+        return (0 == fail_cnt) ? 0 : 1;
+}
+
+static void fill(struct root *r)
+{
+        int i;
+        int j;
+
+        memset(r, 0, sizeof(struct root));
+        r->id = 0x1FFF;
+        r->s[0] = -32768;
+        r->s[1] = 0;
+        r->s[2] = 32767;
+        r->s_cnt = 3;
+        strcpy(r->name[0], "a\"b\\c\td");
+        strcpy(r->name[1], "");
+        r->mode = 2;
+        r->f = -0.125;
+
+        r->buf_len[0] = 3;
+        r->buf[0] = (uint8_t *)xmlMalloc(3);
+        r->buf[0][0] = 0x00;
+        r->buf[0][1] = 0x7F;
+        r->buf[0][2] = 0xFF;
+        r->buf_len[1] = 0; /* null */
+
+        r->pts_len[0] = 2;
+        r->pts[0] = (struct pt *)xmlMalloc(2 * sizeof(struct pt));
+        r->pts[0][0].x = 1;
+        r->pts[0][0].y = -1;
+        r->pts[0][1].x = 2147483647;
+        r->pts[0][1].y = -2147483647 - 1;
+
+        for(i = 0; i < NODE_CNT; i++) {
+                struct node *node = (struct node *)xmlMalloc(sizeof(struct node));
+                struct va *va;
+                struct vb *vb;
+
+                memset(node, 0, sizeof(struct node));
+                node->id = 4000000000U + i;
+                sprintf(node->tag[0], "node%d", i);
+                node->data_len[0] = i; /* 0: null */
+                if(i) {
+                        node->data[0] = (uint8_t *)xmlMalloc(i);
+                        for(j = 0; j < i; j++) {
+                                node->data[0][j] = (uint8_t)(0x10 * i + j);
+                        }
+                }
+                zlst_push((zhead_t *)&(r->node0), node);
+
+                if(i & 1) {
+                        vb = (struct vb *)xmlMalloc(sizeof(struct vb));
+                        memset(vb, 0, sizeof(struct vb));
+                        sprintf(vb->s[0], "vb%d", i);
+                        vb->w_len[0] = 2;
+                        vb->w[0] = (uint16_t *)xmlMalloc(2 * sizeof(uint16_t));
+                        vb->w[0][0] = 0xABCD;
+                        vb->w[0][1] = (uint16_t)i;
+                        zlst_set_name(vb, "vb");
+                        zlst_push((zhead_t *)&(r->vl0), vb);
+                }
+                else {
+                        va = (struct va *)xmlMalloc(sizeof(struct va));
+                        memset(va, 0, sizeof(struct va));
+                        va->a = (int16_t)(-i);
+                        zlst_set_name(va, "va");
+                        zlst_push((zhead_t *)&(r->vl0), va);
+                }
+        }
+}
+
+/* param2json -> json2param -> param2json, the same text */
+static void test_round_trip(void)
+{
+        struct root r0;
+        struct root r1;
+        struct pjson j0 = {NULL, 0, 0};
+        struct pjson j1 = {NULL, 0, 0};
+        int rslt;
+
+        fill(&r0);
+        rslt = param2json(&r0, pd_root, &j0);
+        check("param2json", rslt, "r0");
+        if(0 != rslt) {
+                return;
+        }
+
+        memset(&r1, 0, sizeof(struct root));
+        check("json2param", json2param(&r1, pd_root, j0.buf, j0.len), j0.buf);
+        check("param2json", param2json(&r1, pd_root, &j1), "r1");
+        check_cnt++;
+        if(!j1.buf || 0 != strcmp(j0.buf, j1.buf)) {
+                fail_cnt++;
+                fprintf(stderr, "round trip:\n%s\n%s\n", j0.buf, j1.buf ? j1.buf : "(null)");
+        }
+        free(j0.buf);
+        free(j1.buf);
+}
+
+static void test_bad(void)
+{
+        int i;
+        struct root r;
+        static const char *json = "{\"id\":1,\"name\":[\"\\u00e9\\uD83D\\uDE00\"]}";
+
+        for(i = 0; bad[i]; i++) {
+                struct root r;
+                int rslt;
+
+                memset(&r, 0, sizeof(struct root));
+                rslt = json2param(&r, pd_root, bad[i], strlen(bad[i]));
+                check("bad json", (-1 == rslt) ? 0 : -1, bad[i]);
+        }
+
+        /* surrogate pair is one 4-byte UTF-8 */
+        memset(&r, 0, sizeof(struct root));
+        check("json2param", json2param(&r, pd_root, json, strlen(json)), json);
+        check("utf8", strcmp(r.name[0], "\xC3\xA9\xF0\x9F\x98\x80"), json);
+}
+
+/* param2bin -> bin2param -> param2bin, the same bytes, and the same JSON text */
+static void test_bin(void)
+{
+        struct root r0;
+        struct root r1;
+        uint8_t *b0 = NULL;
+        uint8_t *b1 = NULL;
+        size_t l0 = 0;
+        size_t l1 = 0;
+        struct pjson j0 = {NULL, 0, 0};
+        struct pjson j1 = {NULL, 0, 0};
+        int rslt;
+
+        fill(&r0);
+        rslt = param2bin(&r0, pd_rbin, &b0, &l0);
+        check("param2bin", rslt, "r0");
+        if(0 != rslt) {
+                return;
+        }
+
+        memset(&r1, 0, sizeof(struct root));
+        check("bin2param", bin2param(&r1, pd_rbin, b0, l0), "b0");
+        check("param2bin", param2bin(&r1, pd_rbin, &b1, &l1), "r1");
+        check("bin round trip", (l0 == l1 && b1 && 0 == memcmp(b0, b1, l0)) ? 0 : -1, "b0 b1");
+
+        check("param2json", param2json(&r0, pd_rbin, &j0), "r0");
+        check("param2json", param2json(&r1, pd_rbin, &j1), "r1");
+        check_cnt++;
+        if(!j0.buf || !j1.buf || 0 != strcmp(j0.buf, j1.buf)) {
+                fail_cnt++;
+                fprintf(stderr, "bin round trip:\n%s\n%s\n",
+                        j0.buf ? j0.buf : "(null)", j1.buf ? j1.buf : "(null)");
+        }
+        free(b0);
+        free(b1);
+        free(j0.buf);
+        free(j1.buf);
+}
+
+/* each truncated or damaged snapshot should be refused */
+static void test_bin_bad(void)
+{
+        struct root r;
+        uint8_t *b = NULL;
+        uint8_t *t;
+        size_t l = 0;
+        size_t i;
+        char hint[32];
+
+        fill(&r);
+        if(0 != param2bin(&r, pd_rbin, &b, &l)) {
+                check("param2bin", -1, "r");
+                return;
+        }
+        t = (uint8_t *)malloc(l);
+        if(!t) {
+                free(b);
+                return;
+        }
+
+        /* cut short */
+        for(i = 0; i < l; i++) {
+                memset(&r, 0, sizeof(struct root));
+                memcpy(t, b, i);
+                sprintf(hint, "len %zd", i);
+                check("bad bin", (-1 == bin2param(&r, pd_rbin, t, i)) ? 0 : -1, hint);
+        }
+
+        /* size in head cut as well, at least 8 bytes, so into the last data not only padding */
+        for(i = sizeof(struct pbin_head); i + 8 <= l; i++) {
+                struct pbin_head head;
+
+                memset(&r, 0, sizeof(struct root));
+                memcpy(t, b, l);
+                memcpy(&head, t, sizeof(struct pbin_head));
+                head.size = (uint32_t)i;
+                memcpy(t, &head, sizeof(struct pbin_head));
+                sprintf(hint, "size %u", head.size);
+                check("bad bin", (-1 == bin2param(&r, pd_rbin, t, head.size)) ? 0 : -1, hint);
+        }
+
+        /* other magic or schema */
+        memset(&r, 0, sizeof(struct root));
+        memcpy(t, b, l);
+        t[0] ^= 0xFF;
+        check("bad bin", (-1 == bin2param(&r, pd_rbin, t, l)) ? 0 : -1, "magic");
+        memset(&r, 0, sizeof(struct root));
+        check("bad bin", (-1 == bin2param(&r, pd_node, b, l)) ? 0 : -1, "schema");
+
+        free(t);
+        free(b);
+}
+
+static void check(const char *hint, int val, const char *json)
+{
+        check_cnt++;
+        if(0 != val) {
+                fail_cnt++;
+                if(fail_cnt <= 10) {
+                        fprintf(stderr, "%s failed: %s\n", hint, json);
+                }
+        }
+        return;
+}
@@ -45,6 +45,7 @@ struct buddy_obj
         uint8_t *tree; /* binary tree, the array to describe the status of pool */
         size_t pool_size; /* pool size */
         uint8_t *pool; /* pool buffer */
+        size_t used; /* space allocated, sum of POW2(order) */
 
         /* for efficiency of report() */
         int level;
@@ -65,7 +66,7 @@ static void report(struct buddy_obj *p, size_t i, uint8_t order, size_t *acc);
 static void init_tree(struct buddy_obj *p);
 static int siz2nod(struct buddy_obj *p, size_t size, struct node *nod);
 static int ptr2nod(struct buddy_obj *p, uint8_t *ptr, struct node *nod);
-static void allocate_node(struct buddy_obj *p, size_t i);
+static void allocate_node(struct buddy_obj *p, size_t i, uint8_t order);
 static void free_node(struct buddy_obj *p, size_t i, uint8_t order);
 
 void *buddy_create(int maxo, int mino)
@@ -171,6 +172,22 @@ int buddy_report(void *id, int level, const char *hint)
         return 0;
 }
 
+int buddy_usage(void *id, size_t *used, size_t *total)
+{
+        struct buddy_obj *p = (struct buddy_obj *)id;
+
+        if(NULL == p) {
+                RPTERR("usage: bad id");
+                return -1;
+        }
+
+        (void)pthread_mutex_lock(&p->mux);
+        *used = p->used;
+        *total = p->pool_size;
+        (void)pthread_mutex_unlock(&p->mux);
+        return 0;
+}
+
 /* The malloc() function allocates size bytes and returns a pointer to the allocated memory.
  * The memory is not initialized.
  * If size is 0, then malloc() returns NULL.
@@ -193,7 +210,7 @@ void *buddy_malloc(void *id, size_t size)
         (void)pthread_mutex_lock(&p->mux);
         siz2nod(p, size, &new);
         if(new.ptr) {
-                allocate_node(p, new.index); /* modify parent node */
+                allocate_node(p, new.index, new.order); /* modify parent node */
         }
         (void)pthread_mutex_unlock(&p->mux);
 
@@ -231,7 +248,7 @@ void *buddy_calloc(void *id, size_t nmemb, size_t size)
         (void)pthread_mutex_lock(&p->mux);
         siz2nod(p, total_size, &new);
         if(new.ptr) {
-                allocate_node(p, new.index); /* modify parent node */
+                allocate_node(p, new.index, new.order); /* modify parent node */
                 memset(new.ptr, 0, total_size); /* set to zero */
         }
         (void)pthread_mutex_unlock(&p->mux);
@@ -274,7 +291,7 @@ void *buddy_realloc(void *id, void *ptr, size_t size)
                 (void)pthread_mutex_lock(&p->mux);
                 siz2nod(p, size, &new);
                 if(new.ptr) {
-                        allocate_node(p, new.index); /* modify parent node */
+                        allocate_node(p, new.index, new.order); /* modify parent node */
                 }
                 (void)pthread_mutex_unlock(&p->mux);
 
@@ -313,7 +330,7 @@ void *buddy_realloc(void *id, void *ptr, size_t size)
            new.ptr &&
            new.order != old.order) {
                 /* modify parent node */
-                allocate_node(p, new.index);
+                allocate_node(p, new.index, new.order);
                 free_node(p, old.index, old.order);
 
                 /* copy data */
@@ -425,6 +442,7 @@ static void init_tree(struct buddy_obj *p)
         size_t size;
         uint8_t order; /* current order */
 
+        p->used = 0;
         size = (size_t)1;
         for(order = p->maxo; order >= p->mino; order--) {
                 memset(tree, (int)order, size);
@@ -512,11 +530,12 @@ static int ptr2nod(struct buddy_obj *p, uint8_t *ptr, struct node *nod)
 }
 
 /* modify tree to allocate the node */
-static void allocate_node(struct buddy_obj *p, size_t i)
+static void allocate_node(struct buddy_obj *p, size_t i, uint8_t order)
 {
         uint8_t ol; /* left order */
         uint8_t or; /* right order */
 
+        p->used += POW2(order);
         p->tree[i] = 0; /* means it is allocated */
         while(0 != i) {
                 i = FBTP(i);
@@ -532,6 +551,7 @@ static void free_node(struct buddy_obj *p, size_t i, uint8_t order)
         uint8_t ol; /* left order */
         uint8_t or; /* right order */
 
+        p->used -= POW2(order);
         p->tree[i] = order; /* means it is freed */
         while(0 != i) {
                 i = FBTP(i);
@@ -34,6 +34,7 @@ extern "C" {
 int buddy_destroy(/*@null@*/ /*@only@*/ void *id);
 int buddy_init(/*@null@*/ void *id); /* buddy_create() has buddy_init() function */
 int buddy_report(/*@null@*/ void *id, int level, const char *hint); /* for debug */
+int buddy_usage(/*@null@*/ void *id, size_t *used, size_t *total); /* cheap, without tree walk */
 
 /*@null@*/ /*@dependent@*/ void *buddy_malloc(/*@null@*/ void *id, size_t size);
 /*@null@*/ /*@dependent@*/ void *buddy_realloc(/*@null@*/ void *id, void *ptr, size_t size);
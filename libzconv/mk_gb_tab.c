@@ -0,0 +1,117 @@
+/* vim: set tabstop=8 shiftwidth=8:
+ * name: mk_gb_tab.c
+ * funx: make GB_TAB.h, direct index tables from pair tables GB_UCS.h and UCS_GB.h
+ *       run on build host, see Makefile
+ *
+ * GB_UCS_TAB[row][col]: GB2312 0xA1A1 ~ 0xF7FE, one load per character
+ * UCS_GB_IDX[hi] -> page, UCS_GB_TAB[page][lo]: page 0 is empty, two loads per character
+ * 0x0000 in both tables means no mapping
+ */
+
+#include <stdio.h>
+#include <stdint.h> /* for uint?_t, etc */
+#include <string.h> /* for memset() */
+
+#define GB_ROW0                         (0xA1)
+#define GB_ROW1                         (0xF7)
+#define GB_COL0                         (0xA1)
+#define GB_COL1                         (0xFE)
+#define GB_ROWS                         (GB_ROW1 - GB_ROW0 + 1)
+#define GB_COLS                         (GB_COL1 - GB_COL0 + 1)
+
+static const uint16_t GB_UCS[] = {
+#include "GB_UCS.h"
+};
+
+static const uint16_t UCS_GB[] = {
+#include "UCS_GB.h"
+};
+
+static uint16_t gb_ucs[GB_ROWS][GB_COLS];
+static uint8_t ucs_gb_idx[256];
+static uint16_t ucs_gb[256][256];
+
+static void out_u16(const uint16_t *p, int cnt, const char *ind);
+
+int main(void)
+{
+        size_t i;
+        int hi;
+        int page_cnt = 1; /* page 0: empty */
+
+        memset(gb_ucs, 0, sizeof(gb_ucs));
+        for(i = 0; i < sizeof(GB_UCS) / sizeof(uint16_t); i += 2) {
+                int row = (GB_UCS[i] >> 8) - GB_ROW0;
+                int col = (GB_UCS[i] & 0xFF) - GB_COL0;
+
+                if(row < 0 || row >= GB_ROWS || col < 0 || col >= GB_COLS) {
+                        fprintf(stderr, "GB data(0x%04X) out of table!\n", GB_UCS[i]);
+                        return -1;
+                }
+                gb_ucs[row][col] = GB_UCS[i + 1];
+        }
+
+        memset(ucs_gb_idx, 0, sizeof(ucs_gb_idx));
+        memset(ucs_gb, 0, sizeof(ucs_gb));
+        for(i = 0; i < sizeof(UCS_GB) / sizeof(uint16_t); i += 2) {
+                hi = UCS_GB[i] >> 8;
+                if(0 == ucs_gb_idx[hi]) {
+                        ucs_gb_idx[hi] = (uint8_t)page_cnt++;
+                }
+                ucs_gb[ucs_gb_idx[hi]][UCS_GB[i] & 0xFF] = UCS_GB[i + 1];
+        }
+
+        fprintf(stdout,
+                "/* vim: set tabstop=8 shiftwidth=8:\n"
+                " * name: GB_TAB.h\n"
+                " * funx: made by mk_gb_tab from GB_UCS.h and UCS_GB.h, do NOT edit\n"
+                " */\n\n");
+        fprintf(stdout, "#define GB_ROW0 (0x%02X)\n", GB_ROW0);
+        fprintf(stdout, "#define GB_COL0 (0x%02X)\n", GB_COL0);
+        fprintf(stdout, "#define GB_ROWS (%d)\n", GB_ROWS);
+        fprintf(stdout, "#define GB_COLS (%d)\n\n", GB_COLS);
+
+        fprintf(stdout, "static const uint16_t GB_UCS_TAB[GB_ROWS][GB_COLS] = {\n");
+        for(hi = 0; hi < GB_ROWS; hi++) {
+                fprintf(stdout, "        { /* 0x%02X */\n", hi + GB_ROW0);
+                out_u16(gb_ucs[hi], GB_COLS, "                ");
+                fprintf(stdout, "        },\n");
+        }
+        fprintf(stdout, "};\n\n");
+
+        fprintf(stdout, "static const uint8_t UCS_GB_IDX[256] = {\n");
+        for(hi = 0; hi < 256; hi++) {
+                fprintf(stdout, "%s%3d,%s",
+                        (0 == (hi & 0x0F)) ? "        " : " ",
+                        ucs_gb_idx[hi],
+                        (0x0F == (hi & 0x0F)) ? "\n" : "");
+        }
+        fprintf(stdout, "};\n\n");
+
+        fprintf(stdout, "static const uint16_t UCS_GB_TAB[%d][256] = {\n", page_cnt);
+        fprintf(stdout, "        { /* empty */\n");
+        out_u16(ucs_gb[0], 256, "                ");
+        fprintf(stdout, "        },\n");
+        for(hi = 0; hi < 256; hi++) {
+                if(0 == ucs_gb_idx[hi]) {
+                        continue;
+                }
+                fprintf(stdout, "        { /* 0x%02Xxx */\n", hi);
+                out_u16(ucs_gb[ucs_gb_idx[hi]], 256, "                ");
+                fprintf(stdout, "        },\n");
+        }
+        fprintf(stdout, "};\n");
+        return 0;
+}
+
+static void out_u16(const uint16_t *p, int cnt, const char *ind)
+{
+        int i;
+
+        for(i = 0; i < cnt; i++) {
+                fprintf(stdout, "%s0x%04X,%s",
+                        (0 == (i & 0x07)) ? ind : " ",
+                        p[i],
+                        (0x07 == (i & 0x07) || i == cnt - 1) ? "\n" : "");
+        }
+}
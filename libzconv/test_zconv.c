@@ -1,20 +1,51 @@
 /* vim: set tabstop=8 shiftwidth=8:
- * funx: to test zconv module
+ * funx: to test zconv module, show charsets, then ASCII run and conformance of convert
  * comp: gcc test.c -L. -lzconv
  */
 
 #include <stdio.h>
-#include <stdint.h> /* for uint?_t, etc */
+#include <stdlib.h> /* for rand, srand, etc */
+#include <string.h> /* for memset, memcpy, memcmp, etc */
+#include <inttypes.h> /* for uint?_t, PRId64, etc */
 
 #include "zconv.h"
 
+#define STR_CHR (300) /* characters of random string at most */
+#define STR_MAX (4 * STR_CHR + 64) /* byte of buffer, room for offset */
+#define STR_CNT (3000) /* random strings of each test */
+#define DFLT_UCS (0x00D7) /* as zconv.c */
+
+/* random string: runs of ASCII and runs of others */
+#define RUN_ASCII (0) /* 0x01 ~ 0x7F */
+#define RUN_LATIN (1) /* 0x80 ~ 0xFF */
+#define RUN_BMP   (2) /* 0x80 ~ 0xFFFF, no surrogate */
+#define RUN_ALL   (3) /* RUN_BMP and 0x10000 ~ 0x10FFFF */
+#define RUN_GB    (4) /* GB2312 characters */
+
+static int64_t fail_cnt = 0;
+static int64_t check_cnt = 0;
+static uint16_t gb_tab[8000]; /* GB2312 code with mapping */
+static uint16_t gb_ucs[8000]; /* UCS of gb_tab[] */
+static int gb_cnt = 0;
+
 static uint8_t latin[256] = {
 };
 
 void show_latin(int coding, const char *hint);
 void show_gb(int X0, int X1, int Y0, int Y1, const char *hint);
 
-void main(void)
+static int gen_str(uint32_t *ucs, int max, int type);
+static int put_utf8(const uint32_t *ucs, int n, char *p);
+static int put_utf16(const uint32_t *ucs, int n, uint16_t *p, int endian);
+static int put_gb(const uint32_t *ucs, int n, char *p);
+static void init_gb(void);
+static void test_utf8_utf16(void);
+static void test_latin(void);
+static void test_gb(void);
+static void test_bad(void);
+static void check(const char *hint, int idx, const void *val, const void *ref, size_t len, int wc, int wc_ref);
+
+int main(void)
 {
         int i;
         uint8_t *p;
@@ -56,7 +87,14 @@ void main(void)
         show_latin(CODING_DVB8859_15, "DVB8859-15");
         show_latin(CODING_ISO8859_16, "ISO8859-16");
 
-        return;
+        srand(20110210); /* same strings each run */
+        init_gb();
+        test_utf8_utf16();
+        test_latin();
+        test_gb();
+        test_bad();
+        fprintf(stdout, "%"PRId64" check, %"PRId64" fail\n", check_cnt, fail_cnt);
+        return (0 == fail_cnt) ? 0 : 1;
 }
 
 void show_latin(int coding, const char *hint)
@@ -113,3 +151,327 @@ void show_gb(int Y0, int X0, int Y1, int X1, const char *hint)
         }
         fprintf(stdout, "\n");
 }
+
+/* ASCII run of any length and any alignment, against the code one by one */
+static void test_utf8_utf16(void)
+{
+        static uint32_t ucs[STR_CHR];
+        static char src8[STR_MAX];
+        static char ref8[STR_MAX];
+        static char out8[STR_MAX];
+        static uint16_t src16[STR_MAX];
+        static uint16_t ref16[STR_MAX];
+        static uint16_t out16[STR_MAX];
+        int i;
+
+        for(i = 0; i < STR_CNT; i++) {
+                int endian = (i & 1) ? BIG_ENDIAN : LITTLE_ENDIAN;
+                int off = rand() % 32; /* byte, for alignment */
+                int n;
+                int len8;
+                int len16;
+                int wc;
+
+                /* utf8 -> utf16, with supplementary */
+                n = gen_str(ucs, STR_CHR, RUN_ALL);
+                len8 = put_utf8(ucs, n, ref8);
+                len16 = put_utf16(ucs, n, ref16, endian);
+                memcpy(src8 + off, ref8, len8 + 1);
+                memset(out16, 0xFF, sizeof(out16));
+                wc = utf8_utf16(src8 + off, (uint16_t *)((char *)out16 + (off & ~1)), len8, endian);
+                check("utf8_utf16", i, (char *)out16 + (off & ~1), ref16, 2 * (len16 + 1), wc, n);
+
+                /* utf16 -> utf8, BMP only */
+                n = gen_str(ucs, STR_CHR, RUN_BMP);
+                len8 = put_utf8(ucs, n, ref8);
+                len16 = put_utf16(ucs, n, ref16, endian);
+                memcpy((char *)src16 + (off & ~1), ref16, 2 * (len16 + 1));
+                memset(out8, 0xFF, sizeof(out8));
+                wc = utf16_utf8((uint16_t *)((char *)src16 + (off & ~1)), out8 + off, 2 * len16, endian);
+                check("utf16_utf8", i, out8 + off, ref8, len8 + 1, wc, n);
+        }
+}
+
+static void test_latin(void)
+{
+        static uint32_t ucs[STR_CHR];
+        static uint8_t src[STR_MAX];
+        static char ref8[STR_MAX];
+        static char out8[STR_MAX];
+        int i;
+        int j;
+
+        for(i = 0; i < STR_CNT; i++) {
+                int off = rand() % 32;
+                int n = gen_str(ucs, STR_CHR, RUN_LATIN);
+                int len8 = put_utf8(ucs, n, ref8); /* ISO8859-1 is the first 256 of UCS */
+
+                for(j = 0; j < n; j++) {
+                        src[off + j] = (uint8_t)ucs[j];
+                }
+                src[off + n] = 0x00;
+                memset(out8, 0xFF, sizeof(out8));
+                j = latin_utf8(src + off, out8 + off, n, CODING_ISO8859_1);
+                check("latin_utf8", i, out8 + off, ref8, len8 + 1, j, n);
+        }
+}
+
+static void test_gb(void)
+{
+        static uint32_t ucs[STR_CHR];
+        static char src8[STR_MAX];
+        static char ref8[STR_MAX];
+        static char out8[STR_MAX];
+        static char refgb[STR_MAX];
+        static char srcgb[STR_MAX];
+        static char outgb[STR_MAX];
+        static uint16_t src16[STR_MAX];
+        static uint16_t ref16[STR_MAX];
+        static uint16_t out16[STR_MAX];
+        int i;
+
+        for(i = 0; i < STR_CNT; i++) {
+                int endian = (i & 1) ? BIG_ENDIAN : LITTLE_ENDIAN;
+                int off = rand() % 32;
+                int offw = off & ~1;
+                int n = gen_str(ucs, STR_CHR, RUN_GB);
+                int len8 = put_utf8(ucs, n, ref8);
+                int len16 = put_utf16(ucs, n, ref16, endian);
+                int lengb = put_gb(ucs, n, refgb);
+                int wc;
+
+                memcpy(src8 + off, ref8, len8 + 1);
+                memcpy(srcgb + off, refgb, lengb + 1);
+                memcpy((char *)src16 + offw, ref16, 2 * (len16 + 1));
+
+                memset(outgb, 0xFF, sizeof(outgb));
+                wc = utf8_gb(src8 + off, outgb + off, len8);
+                check("utf8_gb", i, outgb + off, refgb, lengb + 1, wc, n);
+
+                memset(out8, 0xFF, sizeof(out8));
+                wc = gb_utf8(srcgb + off, out8 + off, lengb);
+                check("gb_utf8", i, out8 + off, ref8, len8 + 1, wc, n);
+
+                memset(outgb, 0xFF, sizeof(outgb));
+                wc = utf16_gb((uint16_t *)((char *)src16 + offw), outgb + off, 2 * len16, endian);
+                check("utf16_gb", i, outgb + off, refgb, lengb + 1, wc, n);
+
+                memset(out16, 0xFF, sizeof(out16));
+                wc = gb_utf16(srcgb + off, (uint16_t *)((char *)out16 + offw), lengb, endian);
+                check("gb_utf16", i, (char *)out16 + offw, ref16, 2 * (len16 + 1), wc, n);
+        }
+}
+
+/* '\0' and bad data in or after ASCII run */
+static void test_bad(void)
+{
+        char src[128];
+        char out[256];
+        uint16_t src16[64];
+        uint16_t out16[64];
+        uint16_t ref16[64];
+        int wc;
+        int i;
+
+        /* '\0' in ASCII run, cnt is bigger */
+        memset(src, 'a', sizeof(src));
+        src[37] = '\0';
+        wc = utf8_gb(src, out, sizeof(src));
+        check("bad-zero-utf8_gb", 0, out, src, 38, wc, 37);
+        wc = latin_utf8((uint8_t *)src, out, sizeof(src), CODING_ISO8859_1);
+        check("bad-zero-latin_utf8", 0, out, src, 38, wc, 37);
+        wc = utf8_utf16(src, out16, sizeof(src), LITTLE_ENDIAN);
+        for(i = 0; i < 38; i++) {
+                ref16[i] = (uint16_t)(uint8_t)src[i];
+        }
+        check("bad-zero-utf8_utf16", 0, out16, ref16, 2 * 38, wc, 37);
+
+        /* bad tail after ASCII run: 0xC3 with 'r', DFLT_UCS and 'r' again */
+        strcpy(src, "abcdefghijklmnopq\xC3rstuvwxyz0123456789ABCDEFGHIJ");
+        wc = utf8_utf16(src, out16, strlen(src) + 1, LITTLE_ENDIAN);
+        for(i = 0; i < 17; i++) {
+                ref16[i] = (uint16_t)src[i];
+        }
+        ref16[17] = DFLT_UCS;
+        for(i = 18; src[i]; i++) {
+                ref16[i] = (uint16_t)src[i];
+        }
+        ref16[i] = 0x0000;
+        check("bad-tail-utf8_utf16", 0, out16, ref16, 2 * (i + 1), wc, i);
+
+        /* low surrogate in ASCII run of UTF-16: DFLT_UCS and go on */
+        for(i = 0; i < 40; i++) {
+                src16[i] = (uint16_t)('A' + i % 26);
+        }
+        src16[20] = 0xDC00;
+        src16[40] = 0x0000;
+        wc = utf16_utf8(src16, out, 2 * 41, LITTLE_ENDIAN);
+        for(i = 0; i < 20; i++) {
+                src[i] = (char)('A' + i % 26);
+        }
+        src[20] = (char)0xC3; /* U+00D7 */
+        src[21] = (char)0x97;
+        for(i = 21; i < 40; i++) {
+                src[i + 1] = (char)('A' + i % 26);
+        }
+        src[41] = '\0';
+        check("bad-surrogate-utf16_utf8", 0, out, src, 42, wc, 40);
+}
+
+static int gen_str(uint32_t *ucs, int max, int type)
+{
+        int n = 0;
+        int total = rand() % (max + 1);
+
+        while(n < total) {
+                int run = 1 + rand() % ((0 == rand() % 4) ? 4 : 70); /* short or long */
+                int is_ascii = (RUN_ASCII == type) || (rand() % 3);
+
+                for(; run > 0 && n < total; run--) {
+                        uint32_t u;
+
+                        if(is_ascii) {
+                                u = 1 + rand() % 0x7F;
+                        }
+                        else if(RUN_LATIN == type) {
+                                u = 0x80 + rand() % 0x80;
+                        }
+                        else if(RUN_GB == type) {
+                                u = gb_ucs[rand() % gb_cnt];
+                        }
+                        else {
+                                do {
+                                        switch(rand() % 4) {
+                                                case 0:  u = 0x80 + rand() % 0x780; break;
+                                                case 1:
+                                                case 2:  u = 0x800 + rand() % 0xF800; break;
+                                                default: u = (RUN_ALL == type) ?
+                                                             (0x10000 + rand() % 0x100000) :
+                                                             (0x80 + rand() % 0xFF80); break;
+                                        }
+                                } while(0xD800 <= u && u <= 0xDFFF);
+                        }
+                        ucs[n++] = u;
+                }
+        }
+        return n;
+}
+
+static int put_utf8(const uint32_t *ucs, int n, char *p)
+{
+        char *p0 = p;
+        int i;
+
+        for(i = 0; i < n; i++) {
+                uint32_t u = ucs[i];
+
+                if(u < 0x80) {
+                        *p++ = (char)u;
+                }
+                else if(u < 0x800) {
+                        *p++ = (char)(0xC0 | (u >> 6));
+                        *p++ = (char)(0x80 | (u & 0x3F));
+                }
+                else if(u < 0x10000) {
+                        *p++ = (char)(0xE0 | (u >> 12));
+                        *p++ = (char)(0x80 | ((u >> 6) & 0x3F));
+                        *p++ = (char)(0x80 | (u & 0x3F));
+                }
+                else {
+                        *p++ = (char)(0xF0 | (u >> 18));
+                        *p++ = (char)(0x80 | ((u >> 12) & 0x3F));
+                        *p++ = (char)(0x80 | ((u >> 6) & 0x3F));
+                        *p++ = (char)(0x80 | (u & 0x3F));
+                }
+        }
+        *p = '\0';
+        return (int)(p - p0);
+}
+
+/* return the number of 16-bit word */
+static int put_utf16(const uint32_t *ucs, int n, uint16_t *p, int endian)
+{
+        uint16_t w[2];
+        int cnt = 0;
+        int i;
+        int j;
+
+        for(i = 0; i <= n; i++) {
+                uint32_t u = (i < n) ? ucs[i] : 0;
+                int k = 1;
+
+                if(u < 0x10000) {
+                        w[0] = (uint16_t)u;
+                }
+                else {
+                        w[0] = (uint16_t)(0xD800 + ((u - 0x10000) >> 10));
+                        w[1] = (uint16_t)(0xDC00 + ((u - 0x10000) & 0x3FF));
+                        k = 2;
+                }
+                for(j = 0; j < k; j++) {
+                        uint8_t *b = (uint8_t *)(p + cnt + j);
+
+                        b[(BIG_ENDIAN == endian) ? 0 : 1] = (uint8_t)(w[j] >> 8);
+                        b[(BIG_ENDIAN == endian) ? 1 : 0] = (uint8_t)(w[j] >> 0);
+                }
+                cnt += k;
+        }
+        return cnt - 1; /* without 0x0000 */
+}
+
+static int put_gb(const uint32_t *ucs, int n, char *p)
+{
+        char *p0 = p;
+        int i;
+        int j;
+
+        for(i = 0; i < n; i++) {
+                if(ucs[i] < 0x80) {
+                        *p++ = (char)ucs[i];
+                        continue;
+                }
+                for(j = 0; j < gb_cnt && gb_ucs[j] != ucs[i]; j++) {
+                }
+                *p++ = (char)(gb_tab[j] >> 8);
+                *p++ = (char)(gb_tab[j] >> 0);
+        }
+        *p = '\0';
+        return (int)(p - p0);
+}
+
+/* GB2312 code with mapping, by gb_utf16() of each code */
+static void init_gb(void)
+{
+        int y, x;
+
+        for(y = 0xA1; y <= 0xF7; y++) {
+                for(x = 0xA1; x <= 0xFE; x++) {
+                        char dat[3];
+                        uint16_t u[2];
+
+                        dat[0] = (char)y;
+                        dat[1] = (char)x;
+                        dat[2] = '\0';
+                        gb_utf16(dat, u, 2, LITTLE_ENDIAN);
+                        if(DFLT_UCS == u[0] && 0xA1C1 != ((y << 8) | x)) {
+                                continue;
+                        }
+                        gb_tab[gb_cnt] = (uint16_t)((y << 8) | x);
+                        gb_ucs[gb_cnt] = u[0];
+                        gb_cnt++;
+                }
+        }
+}
+
+static void check(const char *hint, int idx, const void *val, const void *ref, size_t len, int wc, int wc_ref)
+{
+        check_cnt++;
+        if(wc != wc_ref || 0 != memcmp(val, ref, len)) {
+                fail_cnt++;
+                if(fail_cnt <= 10) {
+                        fprintf(stdout, "%s: case %d: wc %d, should be %d, %s\n",
+                                hint, idx, wc, wc_ref,
+                                (0 == memcmp(val, ref, len)) ? "same data" : "different data");
+                }
+        }
+}
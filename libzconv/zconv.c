@@ -2,8 +2,15 @@
 
 #include <stdio.h>
 #include <stdint.h> /* for uint?_t, etc */
+#include <string.h> /* for memcpy() */
 #include <sys/types.h> /* for ssize_t, etc */
 
+#if defined(__AVX2__)
+#       include <immintrin.h>
+#elif defined(__SSE2__)
+#       include <emmintrin.h>
+#endif
+
 #include "zconv.h"
 
 #define DFLT_UCS                        (0x00D7) /* look like 'X' */
@@ -296,13 +303,8 @@ static const uint16_t ISO8859_16_UCS[] = {
         0x0171, 0x00F9, 0x00FA, 0x00FB, 0x00FC, 0x0119, 0x021B, 0x00FF,
 };
 
-static const uint16_t GB_UCS[] = {
-#include "GB_UCS.h" /* big file, only be included here */
-};
-
-static const uint16_t UCS_GB[] = {
-#include "UCS_GB.h" /* big file, only be included here */
-};
+/* GB_UCS_TAB, UCS_GB_IDX and UCS_GB_TAB, made from GB_UCS.h and UCS_GB.h by mk_gb_tab */
+#include "GB_TAB.h" /* big file, only be included here */
 
 static int utf8_to_ucs4(const char **utf8, uint32_t *ucs4);
 static void ucs4_to_utf8(uint32_t ucs4, char **utf8);
@@ -310,7 +312,13 @@ static void ucs4_to_utf8(uint32_t ucs4, char **utf8);
 static void ucs4_to_utf16(uint32_t ucs4, uint16_t **utf16, int endian);
 static void utf16_to_ucs4(const uint16_t **utf16, uint32_t *ucs4, int endian);
 
-static uint16_t half_search(uint16_t dat, uint16_t dflt, ssize_t hi, const uint16_t *p);
+static inline uint16_t gb_to_ucs(uint16_t gb2);
+static inline uint16_t ucs_to_gb(uint16_t ucs2);
+
+/* not inline, keep the loop of one character small */
+static size_t ascii_8to8(const char *src, char *dst, size_t cnt) __attribute__ ((noinline));
+static size_t ascii_8to16(const char *src, uint16_t *dst, size_t cnt, int is_swap) __attribute__ ((noinline));
+static size_t ascii_16to8(const uint16_t *src, char *dst, size_t cnt, int is_swap) __attribute__ ((noinline));
 
 int latin_utf8(const uint8_t *latin, char *utf8, size_t cnt, int coding)
 {
@@ -320,6 +328,7 @@ int latin_utf8(const uint8_t *latin, char *utf8, size_t cnt, int coding)
         char *putf8 = utf8;
         uint32_t ucs4; /* UCS-4 data */
         const uint16_t *tab; /* DVB coding table */
+        int is_head = 1; /* the last one is not ASCII, try block after it */
 
         switch(coding) {
                 case CODING_DVB6937   : tab = DVB6937_UCS; break;
@@ -364,6 +373,20 @@ int latin_utf8(const uint8_t *latin, char *utf8, size_t cnt, int coding)
                 }
                 ucs4_to_utf8(ucs4, &putf8);
                 cnt--;
+                if(lt > 0x7F) {
+                        is_head = 1;
+                }
+                else {
+                        if(is_head) {
+                                size_t n = ascii_8to8((const char *)platin, putf8, cnt);
+
+                                platin += n;
+                                putf8 += n;
+                                cnt -= n;
+                                wc += (int)n;
+                        }
+                        is_head = 0;
+                }
                 wc++;
         }
         *putf8 = 0x00;
@@ -378,7 +401,7 @@ int utf8_gb(const char *utf8, char *gb, size_t cnt)
         uint32_t ucs4; /* UCS-4 data */
         uint16_t utf16; /* UTF-16 data */
         uint16_t gb2; /*  GB 2-byte data */
-        size_t max = sizeof(GB_UCS) / 4 - 1; /* high index */
+        int is_head = 1; /* the last one is not ASCII, try block after it */
 
         while(cnt > 0) {
                 cnt -= utf8_to_ucs4(&putf, &ucs4);
@@ -393,9 +416,19 @@ int utf8_gb(const char *utf8, char *gb, size_t cnt)
                 }
                 else if(utf16 <= 0x007F) {
                         *gb++ = (char)utf16;
+                        if(is_head) {
+                                size_t n = ascii_8to8(putf, gb, cnt);
+
+                                putf += n;
+                                gb += n;
+                                cnt -= n;
+                                wc += (int)n;
+                        }
+                        is_head = 0;
                 }
                 else {
-                        gb2 = half_search(utf16, DFLT_GB, max, UCS_GB);
+                        is_head = 1;
+                        gb2 = ucs_to_gb(utf16);
                         *gb++ = (char)(gb2 >> 8);
                         *gb++ = (char)(gb2 >> 0);
                 }
@@ -413,7 +446,7 @@ int gb_utf8(const char *gb, char *utf8, size_t cnt)
         uint32_t ucs4; /* UCS-4 data */
         uint16_t ucs2; /* UCS-2 data */
         uint16_t gb2; /*  GB 2-byte data */
-        size_t max = sizeof(GB_UCS) / 4 - 1; /* high index */
+        int is_head = 1; /* the last one is not ASCII, try block after it */
 
         while(cnt > 0) {
                 gb2 = (uint16_t)*gb++;
@@ -423,11 +456,21 @@ int gb_utf8(const char *gb, char *utf8, size_t cnt)
                 else if(gb2 <= 0x007F) {
                         *putf++ = (char)gb2;
                         cnt -= 1;
+                        if(is_head) {
+                                size_t n = ascii_8to8(gb, putf, cnt);
+
+                                gb += n;
+                                putf += n;
+                                cnt -= n;
+                                wc += (int)n;
+                        }
+                        is_head = 0;
                 }
                 else {
+                        is_head = 1;
                         gb2 <<= 8;
                         gb2 |= (uint16_t)(uint8_t)(*gb++);
-                        ucs2 = half_search(gb2, DFLT_UCS, max, GB_UCS);
+                        ucs2 = gb_to_ucs(gb2);
                         ucs4 = (uint32_t)ucs2;
                         ucs4_to_utf8(ucs4, &putf);
                         cnt -= 2;
@@ -444,7 +487,8 @@ int utf16_gb(const uint16_t *utf16, char *gb, size_t cnt, int endian)
         int wc = 0; /* word count */
         uint16_t utf_16; /* UTF-16 data */
         uint16_t gb2; /* GB 2-byte data */
-        size_t max = sizeof(UCS_GB) / 4 - 1; /* high index */
+        int is_swap = (1 != ((BIG_ENDIAN == endian) ? be16toh(1) : le16toh(1)));
+        int is_head = 1; /* the last one is not ASCII, try block after it */
 
         while(cnt > 0) {
                 utf_16 = *utf16++;
@@ -461,9 +505,19 @@ int utf16_gb(const uint16_t *utf16, char *gb, size_t cnt, int endian)
                 else if(utf_16 <= 0x007F) {
                         *gb++ = (char)utf_16;
                         cnt -= 2;
+                        if(is_head) {
+                                size_t n = ascii_16to8(utf16, gb, cnt / 2, is_swap);
+
+                                utf16 += n;
+                                gb += n;
+                                cnt -= 2 * n;
+                                wc += (int)n;
+                        }
+                        is_head = 0;
                 }
                 else {
-                        gb2 = half_search(utf_16, DFLT_GB, max, UCS_GB);
+                        is_head = 1;
+                        gb2 = ucs_to_gb(utf_16);
                         *gb++ = (char)(gb2 >> 8);
                         *gb++ = (char)(gb2 >> 0);
                         cnt -= 2;
@@ -480,7 +534,8 @@ int gb_utf16(const char *gb, uint16_t *utf16, size_t cnt, int endian)
         int wc = 0; /* word count */
         uint16_t gb2; /*  GB 2-byte data */
         uint16_t utf_16; /* UTF-16 data */
-        size_t max = sizeof(GB_UCS) / 4 - 1; /* high index */
+        int is_swap = (1 != ((BIG_ENDIAN == endian) ? htobe16(1) : htole16(1)));
+        int is_head = 1; /* the last one is not ASCII, try block after it */
 
         while(cnt > 0) {
                 gb2 = (uint16_t)*gb++;
@@ -491,11 +546,21 @@ int gb_utf16(const char *gb, uint16_t *utf16, size_t cnt, int endian)
                         utf_16 = gb2;
                         *utf16++ = (BIG_ENDIAN == endian) ? htobe16(utf_16) : htole16(utf_16);
                         cnt -= 1;
+                        if(is_head) {
+                                size_t n = ascii_8to16(gb, utf16, cnt, is_swap);
+
+                                gb += n;
+                                utf16 += n;
+                                cnt -= n;
+                                wc += (int)n;
+                        }
+                        is_head = 0;
                 }
                 else {
+                        is_head = 1;
                         gb2 <<= 8;
                         gb2 |= (uint16_t)(uint8_t)(*gb++);
-                        utf_16 = half_search(gb2, DFLT_UCS, max, GB_UCS);
+                        utf_16 = gb_to_ucs(gb2);
                         *utf16++ = (BIG_ENDIAN == endian) ? htobe16(utf_16) : htole16(utf_16);
                         cnt -= 2;
                 }
@@ -512,6 +577,8 @@ int utf8_utf16(const char *utf8, uint16_t *utf16, size_t cnt, int endian)
         const char *putf = utf8;
         uint16_t *putf16 = utf16;
         uint32_t ucs4; /* UCS-4 data */
+        int is_swap = (1 != ((BIG_ENDIAN == endian) ? htobe16(1) : htole16(1)));
+        int is_head = 1; /* the last one is not ASCII, try block after it */
 
         while(cnt > 0) {
                 cnt -= utf8_to_ucs4(&putf, &ucs4);
@@ -519,6 +586,20 @@ int utf8_utf16(const char *utf8, uint16_t *utf16, size_t cnt, int endian)
                         break;
                 }
                 ucs4_to_utf16(ucs4, &putf16, endian);
+                if(ucs4 > 0x7F) {
+                        is_head = 1;
+                }
+                else {
+                        if(is_head) {
+                                size_t n = ascii_8to16(putf, putf16, cnt, is_swap);
+
+                                putf += n;
+                                putf16 += n;
+                                cnt -= n;
+                                wc += (int)n;
+                        }
+                        is_head = 0;
+                }
                 wc++;
         }
         *putf16 = 0x0000;
@@ -532,6 +613,8 @@ int utf16_utf8(const uint16_t *utf16, char *utf8, size_t cnt, int endian)
         const uint16_t *putf16 = utf16;
         char *putf8 = utf8;
         uint32_t ucs4; /* UCS-4 data */
+        int is_swap = (1 != ((BIG_ENDIAN == endian) ? be16toh(1) : le16toh(1)));
+        int is_head = 1; /* the last one is not ASCII, try block after it */
 
         while(cnt > 0) {
                 utf16_to_ucs4(&putf16, &ucs4, endian);
@@ -540,6 +623,20 @@ int utf16_utf8(const uint16_t *utf16, char *utf8, size_t cnt, int endian)
                 }
                 ucs4_to_utf8(ucs4, &putf8);
                 cnt -= 2;
+                if(ucs4 > 0x7F) {
+                        is_head = 1;
+                }
+                else {
+                        if(is_head) {
+                                size_t n = ascii_16to8(putf16, putf8, cnt / 2, is_swap);
+
+                                putf16 += n;
+                                putf8 += n;
+                                cnt -= 2 * n;
+                                wc += (int)n;
+                        }
+                        is_head = 0;
+                }
                 wc++;
         }
         *putf8 = 0x00;
@@ -710,35 +807,216 @@ static void utf16_to_ucs4(const uint16_t **utf16, uint32_t *ucs4, int endian)
         return;
 }
 
-static uint16_t half_search(uint16_t key, uint16_t dflt, ssize_t hi, const uint16_t *hash)
+/* one load, 0x0000 in table means no mapping */
+static inline uint16_t gb_to_ucs(uint16_t gb2)
+{
+        unsigned int row = (unsigned int)(gb2 >> 8) - GB_ROW0;
+        unsigned int col = (unsigned int)(gb2 & 0xFF) - GB_COL0;
+        uint16_t ucs2;
+
+        if(row >= GB_ROWS || col >= GB_COLS) {
+                return DFLT_UCS;
+        }
+        ucs2 = GB_UCS_TAB[row][col];
+        return (ucs2 ? ucs2 : DFLT_UCS);
+}
+
+/* two loads: page of high byte, then low byte in page */
+static inline uint16_t ucs_to_gb(uint16_t ucs2)
+{
+        uint16_t gb2 = UCS_GB_TAB[UCS_GB_IDX[ucs2 >> 8]][ucs2 & 0xFF];
+
+        return (gb2 ? gb2 : DFLT_GB);
+}
+
+/* ASCII run: EIT text is mostly ASCII, so convert it block by block
+ * only blocks of 0x01 ~ 0x7F are done here, '\0' and non-ASCII are left
+ * to the code of one character, so result is the same as before
+ * block is tried only at the head of an ASCII run, the short ones like
+ * "2024" in CJK text cost one call, and the loop of one character is kept small
+ * AVX2 if built with -mavx2(e.g. configure --extra-cflags=-mavx2),
+ * SSE2 on x86-64 and x86 with SSE2, 8-byte SWAR on others
+ * no block crosses a page, '\0' in cnt-byte is not an overrun
+ */
+#define PAGE_SIZE_MIN                   (4096)
+#define IS_PAGE_CROSS(p, n)             ((((uintptr_t)(p)) & (PAGE_SIZE_MIN - 1)) > PAGE_SIZE_MIN - (n))
+
+#define SWAR_7F                         (0x7F7F7F7F7F7F7F7FULL)
+#define SWAR_80                         (0x8080808080808080ULL)
+#define SWAR16_007F                     (0x007F007F007F007FULL)
+#define SWAR16_0080                     (0x0080008000800080ULL)
+#define SWAR16_00FF                     (0x00FF00FF00FF00FFULL)
+#define SWAR16_FF80                     (0xFF80FF80FF80FF80ULL)
+
+/* high bit of each byte: 1 if 0x01 ~ 0x7F */
+#define SWAR_IS_ASCII(w)                (~(w) & (((w) & SWAR_7F) + SWAR_7F) & SWAR_80)
+
+/* 8-bit to 8-bit, return the number of byte done */
+static size_t ascii_8to8(const char *src, char *dst, size_t cnt)
+{
+        size_t i = 0;
+
+#if defined(__AVX2__)
+        for(; i + 32 <= cnt && !IS_PAGE_CROSS(src + i, 32); i += 32) {
+                __m256i v = _mm256_loadu_si256((const __m256i *)(src + i));
+                __m256i z = _mm256_cmpeq_epi8(v, _mm256_setzero_si256());
+
+                if(0 != _mm256_movemask_epi8(_mm256_or_si256(v, z))) {
+                        break;
+                }
+                _mm256_storeu_si256((__m256i *)(dst + i), v);
+        }
+#endif
+#if defined(__SSE2__)
+        for(; i + 16 <= cnt && !IS_PAGE_CROSS(src + i, 16); i += 16) {
+                __m128i v = _mm_loadu_si128((const __m128i *)(src + i));
+                __m128i z = _mm_cmpeq_epi8(v, _mm_setzero_si128());
+
+                if(0 != _mm_movemask_epi8(_mm_or_si128(v, z))) {
+                        break;
+                }
+                _mm_storeu_si128((__m128i *)(dst + i), v);
+        }
+#endif
+        for(; i + 8 <= cnt && !IS_PAGE_CROSS(src + i, 8); i += 8) {
+                uint64_t w;
+
+                memcpy(&w, src + i, 8);
+                if(SWAR_80 != SWAR_IS_ASCII(w)) {
+                        break;
+                }
+                memcpy(dst + i, &w, 8);
+        }
+        return i;
+}
+
+/* 8-bit to 16-bit, return the number of byte done */
+static size_t ascii_8to16(const char *src, uint16_t *dst, size_t cnt, int is_swap)
 {
-        ssize_t i;
-        ssize_t li = 0;
-        const uint16_t *p;
-        uint16_t value;
-        uint16_t rslt;
-
-        while(1) {
-                if(li > hi) {
-                        /* mismatch, use default data */
-                        rslt = dflt;
+        size_t i = 0;
+        size_t j;
+
+#if defined(__AVX2__)
+        for(; i + 32 <= cnt && !IS_PAGE_CROSS(src + i, 32); i += 32) {
+                __m256i v = _mm256_loadu_si256((const __m256i *)(src + i));
+                __m256i z = _mm256_cmpeq_epi8(v, _mm256_setzero_si256());
+                __m256i lo;
+                __m256i hi;
+
+                if(0 != _mm256_movemask_epi8(_mm256_or_si256(v, z))) {
                         break;
                 }
+                lo = _mm256_cvtepu8_epi16(_mm256_castsi256_si128(v));
+                hi = _mm256_cvtepu8_epi16(_mm256_extracti128_si256(v, 1));
+                if(is_swap) {
+                        lo = _mm256_slli_epi16(lo, 8);
+                        hi = _mm256_slli_epi16(hi, 8);
+                }
+                _mm256_storeu_si256((__m256i *)(dst + i), lo);
+                _mm256_storeu_si256((__m256i *)(dst + i + 16), hi);
+        }
+#endif
+#if defined(__SSE2__)
+        for(; i + 16 <= cnt && !IS_PAGE_CROSS(src + i, 16); i += 16) {
+                __m128i v = _mm_loadu_si128((const __m128i *)(src + i));
+                __m128i zero = _mm_setzero_si128();
+                __m128i z = _mm_cmpeq_epi8(v, zero);
+
+                if(0 != _mm_movemask_epi8(_mm_or_si128(v, z))) {
+                        break;
+                }
+                if(is_swap) {
+                        _mm_storeu_si128((__m128i *)(dst + i), _mm_unpacklo_epi8(zero, v));
+                        _mm_storeu_si128((__m128i *)(dst + i + 8), _mm_unpackhi_epi8(zero, v));
+                }
+                else {
+                        _mm_storeu_si128((__m128i *)(dst + i), _mm_unpacklo_epi8(v, zero));
+                        _mm_storeu_si128((__m128i *)(dst + i + 8), _mm_unpackhi_epi8(v, zero));
+                }
+        }
+#endif
+        for(; i + 8 <= cnt && !IS_PAGE_CROSS(src + i, 8); i += 8) {
+                uint64_t w;
 
-                i = (li + hi) >> 1; /* half */
-                p = (hash + (i << 1)); /* 2-data per item(key, value) */
-                value = *p;
-                if(key == value) {
-                        rslt = *(p + 1);
+                memcpy(&w, src + i, 8);
+                if(SWAR_80 != SWAR_IS_ASCII(w)) {
                         break;
                 }
-                else if(key > value) {
-                        li = i + 1;
+                for(j = 0; j < 8; j++) {
+                        uint16_t c = (uint16_t)(uint8_t)src[i + j];
+
+                        dst[i + j] = is_swap ? (uint16_t)(c << 8) : c;
                 }
-                else { //(key < value)
-                        hi = i - 1;
+        }
+        return i;
+}
+
+/* 16-bit to 8-bit, cnt and return are the number of 16-bit word */
+static size_t ascii_16to8(const uint16_t *src, char *dst, size_t cnt, int is_swap)
+{
+        size_t i = 0;
+        size_t j;
+
+#if defined(__AVX2__)
+        for(; i + 32 <= cnt && !IS_PAGE_CROSS(src + i, 64); i += 32) {
+                __m256i a = _mm256_loadu_si256((const __m256i *)(src + i));
+                __m256i b = _mm256_loadu_si256((const __m256i *)(src + i + 16));
+                __m256i zero = _mm256_setzero_si256();
+                __m256i z;
+                __m256i h;
+
+                if(is_swap) {
+                        a = _mm256_or_si256(_mm256_srli_epi16(a, 8), _mm256_slli_epi16(a, 8));
+                        b = _mm256_or_si256(_mm256_srli_epi16(b, 8), _mm256_slli_epi16(b, 8));
+                }
+                z = _mm256_or_si256(_mm256_cmpeq_epi16(a, zero), _mm256_cmpeq_epi16(b, zero));
+                h = _mm256_and_si256(_mm256_or_si256(a, b), _mm256_set1_epi16((short)0xFF80));
+                if(0 != _mm256_movemask_epi8(z) ||
+                   -1 != _mm256_movemask_epi8(_mm256_cmpeq_epi16(h, zero))) {
+                        break;
+                }
+                /* packus works in 128-bit lane: a0 b0 a1 b1 -> a0 a1 b0 b1 */
+                a = _mm256_permute4x64_epi64(_mm256_packus_epi16(a, b), 0xD8);
+                _mm256_storeu_si256((__m256i *)(dst + i), a);
+        }
+#endif
+#if defined(__SSE2__)
+        for(; i + 16 <= cnt && !IS_PAGE_CROSS(src + i, 32); i += 16) {
+                __m128i a = _mm_loadu_si128((const __m128i *)(src + i));
+                __m128i b = _mm_loadu_si128((const __m128i *)(src + i + 8));
+                __m128i zero = _mm_setzero_si128();
+                __m128i z;
+                __m128i h;
+
+                if(is_swap) {
+                        a = _mm_or_si128(_mm_srli_epi16(a, 8), _mm_slli_epi16(a, 8));
+                        b = _mm_or_si128(_mm_srli_epi16(b, 8), _mm_slli_epi16(b, 8));
                 }
+                z = _mm_or_si128(_mm_cmpeq_epi16(a, zero), _mm_cmpeq_epi16(b, zero));
+                h = _mm_and_si128(_mm_or_si128(a, b), _mm_set1_epi16((short)0xFF80));
+                if(0 != _mm_movemask_epi8(z) ||
+                   0xFFFF != _mm_movemask_epi8(_mm_cmpeq_epi16(h, zero))) {
+                        break;
+                }
+                _mm_storeu_si128((__m128i *)(dst + i), _mm_packus_epi16(a, b));
         }
+#endif
+        for(; i + 4 <= cnt && !IS_PAGE_CROSS(src + i, 8); i += 4) {
+                uint64_t w;
+
+                memcpy(&w, src + i, 8);
+                if(is_swap) {
+                        w = ((w >> 8) & SWAR16_00FF) | ((w & SWAR16_00FF) << 8);
+                }
+                if(0 != (w & SWAR16_FF80) ||
+                   SWAR16_0080 != (((w & SWAR16_007F) + SWAR16_007F) & SWAR16_0080)) {
+                        break;
+                }
+                for(j = 0; j < 4; j++) {
+                        uint16_t u = src[i + j];
 
-        return rslt;
+                        dst[i + j] = (char)(is_swap ? (u >> 8) : u);
+                }
+        }
+        return i;
 }
@@ -0,0 +1,855 @@
+/* vim: set tabstop=8 shiftwidth=8:
+ * funx: to test zts module, STC and CTS calc against long double formula, EIT in table store,
+ *       order of table store and tidy after import, PES assembler, PCR metrics
+ * comp: gcc test_zts.c -I../libzlst -I../libzbuddy -L. -lzts -L../libzlst -lzlst -L../libzbuddy -lzbuddy
+ */
+
+#include <stdio.h>
+#include <stdlib.h> /* for rand, srand, etc */
+#include <string.h> /* for memset, memcpy, etc */
+#include <inttypes.h> /* for uint?_t, PRId64, etc */
+
+#include "buddy.h"
+#include "ts.h"
+
+#define PMT_PID0 (0x0100)
+#define PCR_PID0 (0x0101)
+#define EIT_SVC (500) /* service count for table store */
+#define EIT_OTHER (300) /* service count of EIT other, 37 is prime to it */
+#define EIT_T0  (1262304000) /* 2010-01-01 00:00:00 */
+#define EIT_TSID (0x0001)
+#define EIT_ONID (0x2233)
+#define APES_PID (0x0201)
+
+static uint8_t cc[0x2000]; /* continuity_counter of each PID */
+static int64_t fail_cnt = 0;
+static int64_t check_cnt = 0;
+
+static int make_sect(uint8_t *pkt, uint16_t pid, uint8_t table_id, const uint8_t *body, int len);
+static int make_pkt(uint8_t *pkt, uint16_t pid, int64_t PCR);
+static int make_eit(uint8_t *pkt, uint8_t table_id, uint16_t sid, uint8_t section_number,
+                    uint8_t version, uint16_t event_id, int64_t start);
+static void test_eit(struct ts_obj *obj);
+static void test_crc_skip(struct ts_obj *obj);
+static void test_tabl_store(struct ts_obj *obj);
+static void test_psi_update(void *mp);
+static void test_apes(void *mp);
+static void test_pcrm(void *mp);
+static struct ts_prog *pcrm_run(struct ts_obj *obj, double FO, double DR, int jitter, int cnt, int has_ats);
+static int make_pes(uint8_t *pes, int es_len, int is_bounded, uint8_t seed);
+static int feed_pes(struct ts_obj *obj, const uint8_t *pes, int len);
+static int apes_cmp(struct ts_apes *apes, const uint8_t *pes, int len);
+static void feed_sect(struct ts_obj *obj, uint16_t pid, uint8_t table_id, const uint8_t *body, int len);
+static int evt_cnt(struct ts_obj *obj, int type, uint16_t PID);
+static int64_t stc_ref(struct ts_prog *prog, int64_t ADDR);
+static void check(const char *hint, int64_t cnt, int64_t val, int64_t ref, int64_t tol);
+
+int main(void)
+{
+        void *mp;
+        struct ts_obj *obj;
+        struct ts_ipt *ipt;
+        struct ts_cfg cfg;
+        int64_t i;
+        int64_t ADDR = 0;
+        int64_t PCR = 0;
+        int64_t clk_per_pkt = 0; /* Q16, 27MHz clk per packet */
+        int pcr_gap = 0;
+        static const uint8_t pat[] = {0x00, 0x01, 0xE0 | (PMT_PID0 >> 8), PMT_PID0 & 0xFF};
+        static const uint8_t pmt[] = {0xE0 | (PCR_PID0 >> 8), PCR_PID0 & 0xFF, 0xF0, 0x00,
+                                      0x02, 0xE0 | (PCR_PID0 >> 8), PCR_PID0 & 0xFF, 0xF0, 0x00};
+
+        mp = buddy_create(20, 6);
+        obj = ts_create(mp);
+        if(!obj) {
+                fprintf(stderr, "ts_create failed\n");
+                return -1;
+        }
+        memset(&cfg, 0, sizeof(struct ts_cfg));
+        cfg.need_af = 1;
+        cfg.need_timestamp = 1;
+        cfg.need_af = 1;
+        cfg.need_psi = 1;
+        ts_ioctl(obj, TS_SCFG, &cfg);
+        ipt = &(obj->ipt);
+
+        srand(20090401);
+        for(i = 0; i < 400000; i++) {
+                int64_t ref_cts = -1;
+                int64_t ref_stc = -1;
+
+                /* new bitrate sometimes: 1Mbps ~ 100Mbps */
+                if(0 == i % 5000) {
+                        int64_t bps = 1000000 + (int64_t)(rand() % 1000) * 99000;
+
+                        clk_per_pkt = ((int64_t)188 * 8 * STC_1S << 16) / bps;
+                }
+
+                memset(ipt, 0, sizeof(struct ts_ipt));
+                if(0 == i % 400) {
+                        make_sect(ipt->TS, 0x0000, 0x00, pat, sizeof(pat));
+                }
+                else if(1 == i % 400) {
+                        make_sect(ipt->TS, PMT_PID0, 0x02, pmt, sizeof(pmt));
+                }
+                else if(pcr_gap <= 0) {
+                        int64_t jitter = (rand() % 41) - 20; /* +-20 clk */
+
+                        make_pkt(ipt->TS, PCR_PID0, ts_timestamp_add(PCR, jitter, STC_OVF));
+                        pcr_gap = 2 + rand() % 60;
+                }
+                else {
+                        make_pkt(ipt->TS, PCR_PID0, -1);
+                        pcr_gap--;
+                }
+
+                /* lost some packets sometimes */
+                if(0 == rand() % 3000) {
+                        int64_t lost = 1 + rand() % 2000;
+
+                        ADDR += lost * TS_PKT_SIZE;
+                        PCR = ts_timestamp_add(PCR, (lost * clk_per_pkt) >> 16, STC_OVF);
+                }
+                ipt->ADDR = ADDR;
+                ipt->has_addr = 1;
+                ipt->has_ts = 1;
+
+                /* reference, before ts_parse_tsh() */
+                if(obj->prog0 &&
+                   obj->prog0->is_STC_sync && obj->prog0->PCRa != obj->prog0->PCRb) {
+                        ref_cts = stc_ref(obj->prog0, ADDR);
+                        ref_stc = ref_cts; /* only one program in this stream */
+                }
+
+                if(0 != ts_parse_tsh(obj)) {
+                        fprintf(stderr, "ts_parse_tsh failed\n");
+                        return -1;
+                }
+                if(ref_cts >= 0) {
+                        check("CTS", i, obj->CTS, ref_cts, 1);
+                        check("STC", i, obj->STC, ref_stc, 1);
+                }
+                ts_parse_tsb(obj);
+
+                /* errors are cleared by application, as tsana does */
+                memset(&(obj->err), 0, sizeof(struct ts_err));
+                obj->has_err = 0;
+
+                ADDR += TS_PKT_SIZE;
+                PCR = ts_timestamp_add(PCR, clk_per_pkt >> 16, STC_OVF);
+        }
+
+        test_eit(obj);
+        test_crc_skip(obj);
+        test_tabl_store(obj);
+        test_psi_update(mp);
+        test_apes(mp);
+        test_pcrm(mp);
+
+        /* timestamp wrap around */
+        check("add", 0, ts_timestamp_add(STC_OVF - 1, 2, STC_OVF), 1, 1);
+        check("diff", 0, ts_timestamp_diff(1, STC_OVF - 1, STC_OVF), 2, 1);
+        check("diff", 0, ts_timestamp_diff(STC_OVF - 1, 1, STC_OVF), -2, 1);
+
+        ts_destroy(obj);
+        buddy_destroy(mp);
+
+        fprintf(stdout, "%"PRId64" check, %"PRId64" fail\n", check_cnt, fail_cnt);
+        return (0 == fail_cnt) ? 0 : 1;
+}
+
+static int make_sect(uint8_t *pkt, uint16_t pid, uint8_t table_id, const uint8_t *body, int len)
+{
+        uint8_t *p = pkt;
+        uint8_t *sect;
+        int section_length = 5 + len + 4;
+        uint32_t crc;
+
+        *p++ = 0x47;
+        *p++ = 0x40 | (pid >> 8); /* payload_unit_start_indicator */
+        *p++ = pid & 0xFF;
+        *p++ = 0x10 | cc[pid]; /* payload only */
+        cc[pid] = (cc[pid] + 1) & 0x0F;
+        *p++ = 0x00; /* pointer_field */
+
+        sect = p;
+        *p++ = table_id;
+        *p++ = 0xB0 | (section_length >> 8);
+        *p++ = section_length & 0xFF;
+        *p++ = 0x00; /* transport_stream_id or program_number */
+        *p++ = 0x01;
+        *p++ = 0xC1; /* version_number 0, current_next_indicator 1 */
+        *p++ = 0x00; /* section_number */
+        *p++ = 0x00; /* last_section_number */
+        memcpy(p, body, len);
+        p += len;
+
+        crc = ts_crc(sect, p - sect, 32);
+        *p++ = (crc >> 24) & 0xFF;
+        *p++ = (crc >> 16) & 0xFF;
+        *p++ = (crc >> 8) & 0xFF;
+        *p++ = crc & 0xFF;
+
+        memset(p, 0xFF, TS_PKT_SIZE - (p - pkt));
+        return 0;
+}
+
+/* PCR < 0 means packet without PCR */
+static int make_pkt(uint8_t *pkt, uint16_t pid, int64_t PCR)
+{
+        uint8_t *p = pkt;
+
+        *p++ = 0x47;
+        *p++ = pid >> 8;
+        *p++ = pid & 0xFF;
+        if(PCR < 0) {
+                *p++ = 0x10 | cc[pid]; /* payload only */
+        }
+        else {
+                int64_t base = PCR / 300;
+                int ext = (int)(PCR % 300);
+
+                *p++ = 0x30 | cc[pid]; /* AF and payload */
+                *p++ = 7; /* adaption_field_length */
+                *p++ = 0x10; /* PCR_flag */
+                *p++ = (base >> 25) & 0xFF;
+                *p++ = (base >> 17) & 0xFF;
+                *p++ = (base >> 9) & 0xFF;
+                *p++ = (base >> 1) & 0xFF;
+                *p++ = ((base & 0x01) << 7) | 0x7E | (ext >> 8);
+                *p++ = ext & 0xFF;
+        }
+        cc[pid] = (cc[pid] + 1) & 0x0F;
+
+        memset(p, 0xA5, TS_PKT_SIZE - (p - pkt));
+        return 0;
+}
+
+/* EIT p/f and schedule of EIT_SVC services, each section a packet */
+static void test_eit(struct ts_obj *obj)
+{
+        struct ts_ipt *ipt = &(obj->ipt);
+        struct ts_event evt[8];
+        int sid;
+        int n;
+
+        for(sid = 1; sid <= EIT_SVC; sid++) {
+                int i;
+
+                for(i = 0; i < 5; i++) {
+                        memset(ipt, 0, sizeof(struct ts_ipt));
+                        if(i < 2) {
+                                /* present and following */
+                                make_eit(ipt->TS, 0x4E, sid, i, 0, sid * 10 + i, EIT_T0 + i * 3600);
+                        }
+                        else {
+                                /* schedule, one event each 3-hour segment, the last segment first */
+                                int seg = 4 - i;
+
+                                make_eit(ipt->TS, 0x50, sid, seg * 8, 0, sid * 10 + 2 + seg,
+                                         EIT_T0 + seg * 3 * 3600);
+                        }
+                        ipt->has_ts = 1;
+                        ts_parse_tsh(obj);
+                        ts_parse_tsb(obj);
+                        memset(&(obj->err), 0, sizeof(struct ts_err));
+                        obj->has_err = 0;
+                }
+        }
+
+        for(sid = 1; sid <= EIT_SVC; sid++) {
+                check("pf", sid, ts_eit_pf(obj, EIT_ONID, EIT_TSID, sid, evt, evt + 1), 3, 0);
+                check("present", sid, evt[0].event_id, sid * 10, 0);
+                check("following", sid, evt[1].event_id, sid * 10 + 1, 0);
+                check("start", sid, evt[1].start_time, EIT_T0 + 3600, 0);
+
+                n = ts_eit_schedule(obj, EIT_ONID, EIT_TSID, sid, EIT_T0, EIT_T0 + 86400, evt, 8);
+                check("schedule", sid, n, 3, 0);
+                check("sort", sid, evt[0].event_id, sid * 10 + 2, 0);
+                check("sort", sid, evt[2].event_id, sid * 10 + 4, 0);
+        }
+        n = ts_eit_schedule(obj, EIT_ONID, EIT_TSID, 1, EIT_T0 + 3 * 3600, EIT_T0 + 6 * 3600, evt, 8);
+        check("window", 0, n, 1, 0);
+        check("window", 0, evt[0].event_id, 13, 0);
+        check("other onid", 0, ts_eit_pf(obj, EIT_ONID + 1, EIT_TSID, 1, evt, evt + 1), 0, 0);
+
+        /* the earliest ones, not the first ones of table 0x50, when evt[] is short */
+        memset(ipt, 0, sizeof(struct ts_ipt));
+        make_eit(ipt->TS, 0x51, 1, 0, 0, 7, EIT_T0 - 3600);
+        ipt->has_ts = 1;
+        ts_parse_tsh(obj);
+        ts_parse_tsb(obj);
+        n = ts_eit_schedule(obj, EIT_ONID, EIT_TSID, 1, EIT_T0 - 86400, EIT_T0 + 86400, evt, 2);
+        check("earliest", 0, n, 2, 0);
+        check("earliest", 0, evt[0].event_id, 7, 0);
+        check("earliest", 0, evt[1].event_id, 12, 0);
+
+        /* new version of present replaces the sub-table */
+        memset(ipt, 0, sizeof(struct ts_ipt));
+        make_eit(ipt->TS, 0x4E, 1, 0, 1, 99, EIT_T0 + 3600);
+        ipt->has_ts = 1;
+        ts_parse_tsh(obj);
+        ts_parse_tsb(obj);
+        check("version", 0, ts_eit_pf(obj, EIT_ONID, EIT_TSID, 1, evt, evt + 1), 1, 0);
+        check("version", 0, evt[0].event_id, 99, 0);
+        return;
+}
+
+/* the same section repeated skips CRC, the changed one does not */
+static void test_crc_skip(struct ts_obj *obj)
+{
+        struct ts_ipt *ipt = &(obj->ipt);
+        struct ts_stat stat0, stat1;
+        struct ts_event evt[2];
+        int i;
+
+        ts_ioctl(obj, TS_STAT, &stat0);
+        for(i = 0; i < 10 * TS_CRC_PERIOD; i++) {
+                memset(ipt, 0, sizeof(struct ts_ipt));
+                make_eit(ipt->TS, 0x4E, 1, 0, 1, 99, EIT_T0 + 3600);
+                ipt->has_ts = 1;
+                ts_parse_tsh(obj);
+                ts_parse_tsb(obj);
+                check("crc_error", i, obj->err.CRC_error, 0, 0);
+        }
+        ts_ioctl(obj, TS_STAT, &stat1);
+        check("crc", 0, stat1.crc - stat0.crc, 10, 0);
+        check("crc_skip", 0, stat1.crc_skip - stat0.crc_skip, 10 * (TS_CRC_PERIOD - 1), 0);
+
+        /* event_id changed, CRC_32 not */
+        memset(ipt, 0, sizeof(struct ts_ipt));
+        make_eit(ipt->TS, 0x4E, 1, 0, 1, 99, EIT_T0 + 3600);
+        ipt->TS[5 + 14 + 1] ^= 0x01;
+        ipt->has_ts = 1;
+        ts_parse_tsh(obj);
+        ts_parse_tsb(obj);
+        check("crc_error", 0, obj->err.CRC_error, 1, 0);
+        check("crc_error", 0, ts_eit_pf(obj, EIT_ONID, EIT_TSID, 1, evt, evt + 1), 1, 0);
+        check("crc_error", 0, evt[0].event_id, 99, 0);
+        memset(&(obj->err), 0, sizeof(struct ts_err));
+        obj->has_err = 0;
+        return;
+}
+
+/* tabl0 sorted by (table_id, table_id_extension), the same one of other TS kept;
+ * then lost PID, tabl_hash and sect_hash as xml2list does, TS_TIDY finds them again
+ */
+static void test_tabl_store(struct ts_obj *obj)
+{
+        struct ts_ipt *ipt = &(obj->ipt);
+        struct ts_event evt[2];
+        struct ts_tabl *tabl;
+        struct znode *znode;
+        uint8_t *sect = ipt->TS + 5;
+        uint32_t crc;
+        int64_t crc_skip;
+        int cnt = 0;
+        int bad = 0;
+        int i;
+
+        /* present of service 1 in TS EIT_TSID + 1 */
+        memset(ipt, 0, sizeof(struct ts_ipt));
+        make_eit(ipt->TS, 0x4E, 1, 0, 0, 77, EIT_T0);
+        sect[8] = (EIT_TSID + 1) >> 8;
+        sect[9] = (EIT_TSID + 1) & 0xFF;
+        crc = ts_crc(sect, 3 + 27 - 4, 32);
+        sect[26] = (crc >> 24) & 0xFF;
+        sect[27] = (crc >> 16) & 0xFF;
+        sect[28] = (crc >> 8) & 0xFF;
+        sect[29] = crc & 0xFF;
+        ipt->has_ts = 1;
+        ts_parse_tsh(obj);
+        ts_parse_tsb(obj);
+        check("other ts", 0, ts_eit_pf(obj, EIT_ONID, EIT_TSID + 1, 1, evt, evt + 1), 1, 0);
+        check("other ts", 0, evt[0].event_id, 77, 0);
+
+        /* EIT other of EIT_OTHER services, not in order of service_id */
+        for(i = 0; i < EIT_OTHER; i++) {
+                memset(ipt, 0, sizeof(struct ts_ipt));
+                make_eit(ipt->TS, 0x4F, (uint16_t)(1 + (i * 37) % EIT_OTHER), 0, 0, 1, EIT_T0);
+                ipt->has_ts = 1;
+                ts_parse_tsh(obj);
+                ts_parse_tsb(obj);
+        }
+
+        for(znode = (struct znode *)(obj->tabl0); znode; znode = znode->next) {
+                cnt++;
+                if(znode->next && znode->next->key < znode->key) {
+                        bad++;
+                }
+        }
+        check("tabl sort", 0, bad, 0, 0);
+        check("tabl cnt", 0, cnt, 1 + EIT_SVC * 2 + 1 + 1 + EIT_OTHER, 0); /* PAT, 0x4E and 0x50 each, 0x51, other TS, 0x4F */
+
+        for(tabl = obj->tabl0; tabl; tabl = (struct ts_tabl *)(((struct znode *)tabl)->next)) {
+                tabl->PID = 0x0000;
+                tabl->hnext = NULL;
+                for(znode = (struct znode *)(tabl->sect0); znode; znode = znode->next) {
+                        ((struct ts_sect *)znode)->tabl = NULL;
+                        ((struct ts_sect *)znode)->hnext = NULL;
+                }
+        }
+        memset(obj->tabl_hash, 0, TS_TABL_HASH * sizeof(struct ts_tabl *));
+        memset(obj->sect_hash, 0, TS_SECT_HASH * sizeof(struct ts_sect *));
+        ts_ioctl(obj, TS_TIDY, 0);
+        check("tidy", 0, ts_eit_pf(obj, EIT_ONID, EIT_TSID, EIT_SVC, evt, evt + 1), 3, 0);
+        check("tidy", 0, evt[0].event_id, EIT_SVC * 10, 0);
+        check("tidy", 0, ts_eit_pf(obj, EIT_ONID, EIT_TSID + 1, 1, evt, evt + 1), 1, 0);
+        check("tidy", 0, (NULL != ts_tabl_search(obj, 0x0000, 0x00, 0x0000, 0)), 1, 0);
+
+        /* the same section again: found, CRC skipped, no second node */
+        crc_skip = obj->stat.crc_skip;
+        memset(ipt, 0, sizeof(struct ts_ipt));
+        make_eit(ipt->TS, 0x4E, 2, 0, 0, 20, EIT_T0);
+        ipt->has_ts = 1;
+        ts_parse_tsh(obj);
+        ts_parse_tsb(obj);
+        tabl = ts_tabl_search(obj, 0x0012, 0x4E, 2, ((uint32_t)EIT_TSID << 16) | EIT_ONID);
+        for(cnt = 0, znode = (struct znode *)(tabl ? tabl->sect0 : NULL); znode; znode = znode->next) {
+                cnt++;
+        }
+        check("tidy sect", 0, cnt, 2, 0);
+        check("tidy sect", 0, obj->stat.crc_skip - crc_skip, 1, 0);
+        return;
+}
+
+/* PAT and PMT changed without TS_INIT, pid node and elem survive */
+static void test_psi_update(void *mp)
+{
+        struct ts_obj *obj;
+        struct ts_cfg cfg;
+        struct ts_pid *pid;
+        int i;
+        static const uint8_t pat[] = {0x00, 0x01, 0xE0 | (PMT_PID0 >> 8), PMT_PID0 & 0xFF};
+        static const uint8_t pat_move[] = {0x00, 0x01, 0xE2, 0x00};
+        static const uint8_t pat_add[] = {0x00, 0x01, 0xE2, 0x00,
+                                          0x00, 0x02, 0xE3, 0x00};
+        static const uint8_t pmt[] = {0xE0 | (PCR_PID0 >> 8), PCR_PID0 & 0xFF, 0xF0, 0x00,
+                                      0x02, 0xE0 | (PCR_PID0 >> 8), PCR_PID0 & 0xFF, 0xF0, 0x00,
+                                      0x04, 0xE1, 0x02, 0xF0, 0x00};
+        /* 0x0102 deleted, 0x0101 stream_type 0x1B, 0x0103 added, PCR on 0x0103 */
+        static const uint8_t pmt_new[] = {0xE1, 0x03, 0xF0, 0x00,
+                                          0x1B, 0xE0 | (PCR_PID0 >> 8), PCR_PID0 & 0xFF, 0xF0, 0x00,
+                                          0x03, 0xE1, 0x03, 0xF0, 0x00};
+
+        obj = ts_create(mp);
+        memset(&cfg, 0, sizeof(struct ts_cfg));
+        cfg.need_cc = 1;
+        cfg.need_psi = 1;
+        cfg.need_psi_update = 1;
+        ts_ioctl(obj, TS_SCFG, &cfg);
+
+        feed_sect(obj, 0x0000, 0x00, pat, sizeof(pat));
+        feed_sect(obj, PMT_PID0, 0x02, pmt, sizeof(pmt));
+        check("parsed", 0, obj->is_pat_pmt_parsed, 1, 0);
+        check("no evt", 0, obj->has_evt, 0, 0);
+        for(i = 0; i < 5; i++) {
+                memset(&(obj->ipt), 0, sizeof(struct ts_ipt));
+                make_pkt(obj->ipt.TS, PCR_PID0, -1);
+                obj->ipt.has_ts = 1;
+                ts_parse_tsh(obj);
+                ts_parse_tsb(obj);
+        }
+        pid = (struct ts_pid *)zlst_search((zhead_t *)&(obj->pid0), PCR_PID0);
+        check("pid", 0, (NULL != pid), 1, 0);
+
+        /* new PMT */
+        feed_sect(obj, PMT_PID0, 0x02, pmt_new, sizeof(pmt_new));
+        check("pmt", 0, evt_cnt(obj, TS_EVT_PMT, PMT_PID0), 1, 0);
+        check("pcr_pid", 0, evt_cnt(obj, TS_EVT_PCR_PID, 0x0103), 1, 0);
+        check("elem_type", 0, evt_cnt(obj, TS_EVT_ELEM_TYPE, PCR_PID0), 1, 0);
+        check("elem_add", 0, evt_cnt(obj, TS_EVT_ELEM_ADD, 0x0103), 1, 0);
+        check("elem_del", 0, evt_cnt(obj, TS_EVT_ELEM_DEL, 0x0102), 1, 0);
+        check("pid kept", 0, (pid == (struct ts_pid *)zlst_search((zhead_t *)&(obj->pid0), PCR_PID0)), 1, 0);
+        check("pid kept", 0, pid->CC, (cc[PCR_PID0] + 15) & 0x0F, 0);
+        check("pid elem", 0, pid->elem->stream_type, 0x1B, 0);
+        check("pcr_pid", 0, obj->prog0->PCR_PID, 0x0103, 0);
+        check("parsed", 0, obj->is_pat_pmt_parsed, 1, 0);
+
+        /* the same PMT again, no event */
+        feed_sect(obj, PMT_PID0, 0x02, pmt_new, sizeof(pmt_new));
+        check("no evt", 0, obj->has_evt, 0, 0);
+
+        /* PMT moved */
+        feed_sect(obj, 0x0000, 0x00, pat_move, sizeof(pat_move));
+        check("pat", 0, evt_cnt(obj, TS_EVT_PAT, 0x0000), 1, 0);
+        check("pmt_pid", 0, evt_cnt(obj, TS_EVT_PMT_PID, 0x0200), 1, 0);
+        check("pmt_pid", 0, obj->prog0->PMT_PID, 0x0200, 0);
+        feed_sect(obj, 0x0200, 0x02, pmt_new, sizeof(pmt_new));
+        check("pmt_pid", 0, evt_cnt(obj, TS_EVT_PMT, 0x0200), 1, 0);
+        check("pmt_pid", 0, obj->evt_cnt, 1, 0); /* elem list kept */
+
+        /* program added, then deleted */
+        feed_sect(obj, 0x0000, 0x00, pat_add, sizeof(pat_add));
+        check("prog_add", 0, evt_cnt(obj, TS_EVT_PROG_ADD, 0x0300), 1, 0);
+        check("prog_add", 0, obj->is_pat_pmt_parsed, 0, 0);
+        feed_sect(obj, 0x0000, 0x00, pat_move, sizeof(pat_move));
+        check("prog_del", 0, evt_cnt(obj, TS_EVT_PROG_DEL, 0x0300), 1, 0);
+        check("prog_del", 0, (NULL == ((struct znode *)(obj->prog0))->next), 1, 0);
+        check("prog_del", 0, obj->is_pat_pmt_parsed, 1, 0);
+
+        ts_destroy(obj);
+        return;
+}
+
+/* bounded, unbounded, and two PES packets out of one TS packet */
+static void test_apes(void *mp)
+{
+        struct ts_obj *obj;
+        struct ts_cfg cfg;
+        int pid = APES_PID;
+        int n;
+        int len_a, len_b, len_c;
+        static uint8_t pes_a[400];
+        static uint8_t pes_b[600];
+        static uint8_t pes_c[100];
+        static const uint8_t pat[] = {0x00, 0x01, 0xE0 | (PMT_PID0 >> 8), PMT_PID0 & 0xFF};
+        static const uint8_t pmt[] = {0xE0 | (APES_PID >> 8), APES_PID & 0xFF, 0xF0, 0x00,
+                                      0x02, 0xE0 | (APES_PID >> 8), APES_PID & 0xFF, 0xF0, 0x00};
+
+        obj = ts_create(mp);
+        memset(&cfg, 0, sizeof(struct ts_cfg));
+        cfg.need_af = 1;
+        cfg.need_psi = 1;
+        cfg.need_pes = 1;
+        ts_ioctl(obj, TS_SCFG, &cfg);
+        ts_ioctl(obj, TS_APES, &pid);
+
+        feed_sect(obj, 0x0000, 0x00, pat, sizeof(pat));
+        feed_sect(obj, PMT_PID0, 0x02, pmt, sizeof(pmt));
+
+        len_a = make_pes(pes_a, 300, 1, 0x11); /* 2 packets */
+        len_b = make_pes(pes_b, 500, 0, 0x22); /* 3 packets */
+        len_c = make_pes(pes_c, 50, 1, 0x33); /* 1 packet */
+
+        /* bounded: ready with its last packet */
+        n = feed_pes(obj, pes_a, len_a);
+        check("apes bounded", 0, n, 2, 0);
+        check("apes bounded", 0, obj->has_apes, 1, 0);
+        check("apes bounded", 0, apes_cmp(obj->apes[0], pes_a, len_a), 0, 0);
+        check("apes bounded", 0, obj->apes[0]->is_broken, 0, 0);
+        check("apes bounded", 0, obj->apes[0]->es_offset, 14, 0);
+
+        /* unbounded: not ready until next PES head */
+        n = feed_pes(obj, pes_b, len_b);
+        check("apes unbounded", 0, n, 3, 0);
+        check("apes unbounded", 0, obj->has_apes, 0, 0);
+
+        /* next PES head closes the unbounded one and brings a whole bounded one */
+        feed_pes(obj, pes_c, len_c);
+        check("apes two", 0, obj->has_apes, 2, 0);
+        check("apes two", 0, apes_cmp(obj->apes[0], pes_b, len_b), 0, 0);
+        check("apes two", 0, apes_cmp(obj->apes[1], pes_c, len_c), 0, 0);
+        check("apes two", 0, obj->apes[1]->is_broken, 0, 0);
+
+        /* and the assembler goes on */
+        feed_pes(obj, pes_c, len_c);
+        check("apes next", 0, obj->has_apes, 1, 0);
+        check("apes next", 0, apes_cmp(obj->apes[0], pes_c, len_c), 0, 0);
+        feed_pes(obj, pes_a, len_a);
+        check("apes next", 0, obj->has_apes, 1, 0);
+        check("apes next", 0, apes_cmp(obj->apes[0], pes_a, len_a), 0, 0);
+
+        ts_destroy(obj);
+        return;
+}
+
+/* PCR_FO, PCR_DR, PCR_OJ with ATS, PCR_AC with ADDR, on synthetic PCR */
+static void test_pcrm(void *mp)
+{
+        struct ts_obj *obj;
+        struct ts_prog *prog;
+        struct ts_pcrm_hist hist;
+
+        /* 10ppm, no drift, no jitter */
+        obj = ts_create(mp);
+        prog = pcrm_run(obj, 270.0, 0.0, 0, 6000, 1);
+        check("pcrm FO", 0, (int64_t)(prog->pcrm.FO * 100), 27000, 100);
+        check("pcrm DR", 0, (int64_t)(prog->pcrm.DR * 100), 0, 2);
+        check("pcrm OJ", 0, ts_pcrm_quantile(&(prog->pcrm.OJ_hist), 990), 1, 2);
+        ts_destroy(obj);
+
+        /* drift 0.5Hz/s, FO lags the ramp about DR * 16s(MGF1 tau) */
+        obj = ts_create(mp);
+        prog = pcrm_run(obj, 270.0, 0.5, 0, 20000, 1);
+        check("pcrm FO", 0, (int64_t)(prog->pcrm.FO * 100), 27000 + 50 * 200, 50 * 16);
+        check("pcrm DR", 0, (int64_t)(prog->pcrm.DR * 100), 50, 5);
+        ts_destroy(obj);
+
+        /* jitter +-500clk */
+        obj = ts_create(mp);
+        prog = pcrm_run(obj, 270.0, 0.0, 500, 6000, 1);
+        check("pcrm FO", 0, (int64_t)(prog->pcrm.FO * 100), 27000, 500);
+        check("pcrm OJ", 0, ts_pcrm_quantile(&(prog->pcrm.OJ_hist), 990), 1023, 512);
+        ts_destroy(obj);
+
+        /* no ATS: only PCR_AC, the same as PCR_jitter, PCR - 2 * PCRb + PCRa in +-2000clk */
+        obj = ts_create(mp);
+        prog = pcrm_run(obj, 270.0, 0.0, 500, 1000, 0);
+        check("pcrm AC", 0, prog->pcrm.AC, obj->PCR_jitter, 0);
+        check("pcrm AC", 0, prog->pcrm.AC_hist.cnt, 1000 - 2, 0);
+        check("pcrm AC", 0, ts_pcrm_quantile(&(prog->pcrm.AC_hist), 990), 2047, 1024);
+        check("pcrm n", 0, prog->pcrm.n, 0, 0);
+
+        /* PCR jump 1s: no rate across the discontinuity */
+        memset(&(obj->ipt), 0, sizeof(struct ts_ipt));
+        make_pkt(obj->ipt.TS, PCR_PID0, ts_timestamp_add(prog->PCRb, STC_1S, STC_OVF));
+        obj->ipt.has_ts = 1;
+        obj->ipt.ADDR = prog->ADDb + 10 * TS_PKT_SIZE;
+        obj->ipt.has_addr = 1;
+        ts_parse_tsh(obj);
+        ts_parse_tsb(obj);
+        check("pcr jump", 0, obj->err.PCR_discontinuity_indicator_error, 1, 0);
+        check("pcr jump", 0, prog->is_rate_ok, 0, 0);
+        ts_destroy(obj);
+
+        /* top bucket has no upper bound */
+        memset(&hist, 0, sizeof(struct ts_pcrm_hist));
+        hist.bucket[3] = 9;
+        hist.bucket[TS_PCRM_HIST - 1] = 1;
+        hist.cnt = 10;
+        check("pcrm quantile", 0, ts_pcrm_quantile(&hist, 900), 7, 0);
+        check("pcrm quantile", 0, ts_pcrm_quantile(&hist, 990), INT64_MAX, 0);
+        return;
+}
+
+/* cnt PCR packets 10ms apart, PCR clock offset FO(Hz) drifting DR(Hz/s), random jitter(clk) */
+static struct ts_prog *pcrm_run(struct ts_obj *obj, double FO, double DR, int jitter, int cnt, int has_ats)
+{
+        struct ts_cfg cfg;
+        int i;
+        static const uint8_t pat[] = {0x00, 0x01, 0xE0 | (PMT_PID0 >> 8), PMT_PID0 & 0xFF};
+        static const uint8_t pmt[] = {0xE0 | (PCR_PID0 >> 8), PCR_PID0 & 0xFF, 0xF0, 0x00,
+                                      0x02, 0xE0 | (PCR_PID0 >> 8), PCR_PID0 & 0xFF, 0xF0, 0x00};
+
+        memset(&cfg, 0, sizeof(struct ts_cfg));
+        cfg.need_af = 1;
+        cfg.need_timestamp = 1;
+        cfg.need_psi = 1;
+        ts_ioctl(obj, TS_SCFG, &cfg);
+
+        feed_sect(obj, 0x0000, 0x00, pat, sizeof(pat));
+        feed_sect(obj, PMT_PID0, 0x02, pmt, sizeof(pmt));
+
+        srand(20260401);
+        for(i = 0; i < cnt; i++) {
+                int64_t AT = (int64_t)i * 10 * STC_MS;
+                double t = (double)i / 100;
+                double phase = FO * t + DR * t * t / 2;
+                int64_t PCR = AT + (int64_t)(phase + 0.5) + STC_1S;
+
+                if(jitter) {
+                        PCR += (rand() % (2 * jitter + 1)) - jitter;
+                }
+
+                memset(&(obj->ipt), 0, sizeof(struct ts_ipt));
+                make_pkt(obj->ipt.TS, PCR_PID0, ts_timestamp_add(PCR, 0, STC_OVF));
+                obj->ipt.has_ts = 1;
+                obj->ipt.ADDR = (int64_t)i * 10 * TS_PKT_SIZE;
+                obj->ipt.has_addr = 1;
+                obj->ipt.ATS = AT % ATS_OVF;
+                obj->ipt.has_ats = has_ats;
+                ts_parse_tsh(obj);
+                ts_parse_tsb(obj);
+                memset(&(obj->err), 0, sizeof(struct ts_err));
+                obj->has_err = 0;
+        }
+        return obj->prog0;
+}
+
+/* video PES with PTS, PES_packet_length 0 if not bounded */
+static int make_pes(uint8_t *pes, int es_len, int is_bounded, uint8_t seed)
+{
+        uint8_t *p = pes;
+        int PES_packet_length = 8 + es_len;
+        int i;
+
+        if(!is_bounded) {
+                PES_packet_length = 0;
+        }
+        *p++ = 0x00;
+        *p++ = 0x00;
+        *p++ = 0x01;
+        *p++ = 0xE0; /* stream_id */
+        *p++ = (PES_packet_length >> 8) & 0xFF;
+        *p++ = PES_packet_length & 0xFF;
+        *p++ = 0x80;
+        *p++ = 0x80; /* PTS_DTS_flags */
+        *p++ = 5; /* PES_header_data_length */
+        *p++ = 0x21; /* PTS 0 */
+        *p++ = 0x00;
+        *p++ = 0x01;
+        *p++ = 0x00;
+        *p++ = 0x01;
+        for(i = 0; i < es_len; i++) {
+                *p++ = (uint8_t)(seed + i * 7);
+        }
+        return (int)(p - pes);
+}
+
+/* cut PES into packets on APES_PID, stuffing in AF of the last one, return packet count */
+static int feed_pes(struct ts_obj *obj, const uint8_t *pes, int len)
+{
+        int n = 0;
+        int off = 0;
+
+        while(off < len) {
+                uint8_t *p = obj->ipt.TS;
+                int size = len - off;
+
+                memset(&(obj->ipt), 0, sizeof(struct ts_ipt));
+                *p++ = 0x47;
+                *p++ = ((0 == off) ? 0x40 : 0x00) | (APES_PID >> 8);
+                *p++ = APES_PID & 0xFF;
+                if(size >= 184) {
+                        size = 184;
+                        *p++ = 0x10 | cc[APES_PID]; /* payload only */
+                }
+                else {
+                        *p++ = 0x30 | cc[APES_PID]; /* AF and payload */
+                        *p++ = 183 - size; /* adaption_field_length */
+                        if(183 - size > 0) {
+                                *p++ = 0x00;
+                                memset(p, 0xFF, 182 - size);
+                                p += 182 - size;
+                        }
+                }
+                cc[APES_PID] = (cc[APES_PID] + 1) & 0x0F;
+                memcpy(p, pes + off, size);
+                off += size;
+
+                obj->ipt.has_ts = 1;
+                ts_parse_tsh(obj);
+                ts_parse_tsb(obj);
+                memset(&(obj->err), 0, sizeof(struct ts_err));
+                obj->has_err = 0;
+                n++;
+        }
+        return n;
+}
+
+/* 0 if apes holds the same bytes as pes */
+static int apes_cmp(struct ts_apes *apes, const uint8_t *pes, int len)
+{
+        int i;
+        size_t off = 0;
+
+        if(apes->size != (size_t)len) {
+                return -1;
+        }
+        for(i = 0; i < apes->iov_cnt; i++) {
+                if(off + apes->iov[i].iov_len > (size_t)len ||
+                   0 != memcmp(apes->iov[i].iov_base, pes + off, apes->iov[i].iov_len)) {
+                        return -1;
+                }
+                off += apes->iov[i].iov_len;
+        }
+        return ((off == (size_t)len) ? 0 : -1);
+}
+
+static void feed_sect(struct ts_obj *obj, uint16_t pid, uint8_t table_id, const uint8_t *body, int len)
+{
+        memset(&(obj->ipt), 0, sizeof(struct ts_ipt));
+        make_sect(obj->ipt.TS, pid, table_id, body, len);
+        obj->ipt.has_ts = 1;
+        ts_parse_tsh(obj);
+        ts_parse_tsb(obj);
+        memset(&(obj->err), 0, sizeof(struct ts_err));
+        obj->has_err = 0;
+        return;
+}
+
+static int evt_cnt(struct ts_obj *obj, int type, uint16_t PID)
+{
+        int i;
+        int cnt = 0;
+
+        for(i = 0; i < obj->evt_cnt; i++) {
+                if(type == obj->evt[i].type && PID == obj->evt[i].PID) {
+                        cnt++;
+                }
+        }
+        return cnt;
+}
+
+static int make_eit(uint8_t *pkt, uint8_t table_id, uint16_t sid, uint8_t section_number,
+                    uint8_t version, uint16_t event_id, int64_t start)
+{
+        uint8_t *p = pkt;
+        uint8_t *sect;
+        int section_length = 11 + 12 + 4;
+        int mjd = (int)(start / 86400) + 40587;
+        int sec = (int)(start % 86400);
+        uint32_t crc;
+
+        *p++ = 0x47;
+        *p++ = 0x40; /* payload_unit_start_indicator, PID 0x0012 */
+        *p++ = 0x12;
+        *p++ = 0x10 | cc[0x12]; /* payload only */
+        cc[0x12] = (cc[0x12] + 1) & 0x0F;
+        *p++ = 0x00; /* pointer_field */
+
+        sect = p;
+        *p++ = table_id;
+        *p++ = 0xF0 | (section_length >> 8);
+        *p++ = section_length & 0xFF;
+        *p++ = sid >> 8;
+        *p++ = sid & 0xFF;
+        *p++ = 0xC1 | (version << 1);
+        *p++ = section_number;
+        *p++ = (0x4E == table_id) ? 0x01 : 0xF8; /* last_section_number */
+        *p++ = EIT_TSID >> 8;
+        *p++ = EIT_TSID & 0xFF;
+        *p++ = EIT_ONID >> 8;
+        *p++ = EIT_ONID & 0xFF;
+        *p++ = section_number; /* segment_last_section_number */
+        *p++ = table_id; /* last_table_id */
+
+        *p++ = event_id >> 8;
+        *p++ = event_id & 0xFF;
+        *p++ = mjd >> 8;
+        *p++ = mjd & 0xFF;
+        *p++ = ((sec / 36000) << 4) | (sec / 3600 % 10); /* BCD */
+        *p++ = ((sec % 3600 / 600) << 4) | (sec % 3600 / 60 % 10);
+        *p++ = ((sec % 60 / 10) << 4) | (sec % 10);
+        *p++ = 0x01; /* duration: 01:00:00 */
+        *p++ = 0x00;
+        *p++ = 0x00;
+        *p++ = 0x80; /* running_status 4, no descriptor */
+        *p++ = 0x00;
+
+        crc = ts_crc(sect, p - sect, 32);
+        *p++ = (crc >> 24) & 0xFF;
+        *p++ = (crc >> 16) & 0xFF;
+        *p++ = (crc >> 8) & 0xFF;
+        *p++ = crc & 0xFF;
+
+        memset(p, 0xFF, TS_PKT_SIZE - (p - pkt));
+        return 0;
+}
+
+/* the formula used by libzts before fixed-point rate */
+static int64_t stc_ref(struct ts_prog *prog, int64_t ADDR)
+{
+        long double delta;
+
+        delta = (long double)ts_timestamp_diff(prog->PCRb, prog->PCRa, STC_OVF);
+        delta *= (ADDR - prog->ADDb);
+        delta /= (prog->ADDb - prog->ADDa);
+        return ts_timestamp_add(prog->PCRb, (int64_t)delta, STC_OVF);
+}
+
+static void check(const char *hint, int64_t cnt, int64_t val, int64_t ref, int64_t tol)
+{
+        int64_t diff = val - ref;
+
+        check_cnt++;
+        if(diff < -tol || +tol < diff) {
+                fail_cnt++;
+                if(fail_cnt <= 10) {
+                        fprintf(stderr, "%s of packet %"PRId64": %"PRId64", expect %"PRId64"(+-%"PRId64")\n",
+                                hint, cnt, val, ref, tol);
+                }
+        }
+        return;
+}
@@ -6,6 +6,7 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h> /* for memset, memcpy, etc */
+#include <time.h> /* for clock_gettime() */
 #ifdef _MSC_VER
         #ifdef _M_X64
                 #define __PRI64 "l"
@@ -21,6 +22,7 @@
         #include <inttypes.h> /* for int?_t, PRId64, etc */
 #endif
 
+#include "config.h" /* for ARCH_* macro, generated by configure */
 #include "buddy.h"
 #include "ts.h"
 
@@ -43,9 +45,14 @@
 #endif
 
 #define BIT(n) (1<<(n))
+#define IS_APES(obj, pid) ((obj)->apes_map[(pid) >> 3] & BIT((pid) & 0x07))
 #define NORMAL_SECTION_LENGTH_MAX (1021)
 #define PRIVATE_SECTION_LENGTH_MAX (4093)
 
+/* stage clock, only when cfg.need_timing */
+#define STAT_CLK(obj) ((obj)->cfg.need_timing ? stat_clk() : 0)
+#define STAT_ADD(obj, stage, clk0) do {if((obj)->cfg.need_timing) {(obj)->stat.clk[stage] += stat_clk() - (clk0); (obj)->stat.clk_cnt[stage]++;}} while(0 == 1)
+
 static int rpt_lvl = RPT_WRN; /* report level: ERR, WRN, INF, DBG */
 
 struct ts_pid_table {
@@ -202,11 +209,42 @@ static int ts_parse_pesh(struct ts_obj *obj); /* PES layer information */
 static int ts_parse_pesh_switch(struct ts_obj *obj);
 static int ts_parse_pesh_detail(struct ts_obj *obj);
 
+static void apes_push(struct ts_obj *obj, struct ts_pid *pid);
+static void apes_append(struct ts_obj *obj, struct ts_apes *apes, uint8_t *data, size_t len);
+static void apes_flat(struct ts_apes *apes);
+static void apes_free(struct ts_pid *pid);
+
+static int64_t prog_stc(struct ts_obj *obj, struct ts_prog *prog);
+static void prog_rate(struct ts_prog *prog);
+static void pcrm_update(struct ts_obj *obj, struct ts_prog *prog);
+static void pcrm_hist_add(struct ts_pcrm_hist *hist, int64_t x);
+
 static struct ts_pid *update_pid_list(struct ts_obj *obj, struct ts_pid *new_pid);
-static void free_pid(void *mp, struct ts_pid *pid);
-static void free_sect(void *mp, struct ts_sect *sect);
-static void free_tabl(void *mp, struct ts_tabl *tabl);
-static void free_prog(void *mp, struct ts_prog *prog);
+static struct ts_pid *link_pid_list(struct ts_obj *obj, struct ts_pid *new_pid);
+static void unlink_pid(struct ts_obj *obj, struct ts_pid *pid);
+static struct ts_prog *new_prog(struct ts_obj *obj, uint16_t program_number, uint16_t PMT_PID);
+static int pat_update(struct ts_obj *obj);
+static int pat_has_prog(struct ts_tabl *tabl, uint16_t program_number);
+static void add_evt(struct ts_obj *obj, int type, uint16_t program_number, uint16_t PID, uint8_t stream_type);
+static void free_pid(struct ts_obj *obj, struct ts_pid *pid);
+static void free_sect(struct ts_obj *obj, struct ts_sect *sect);
+static void free_tabl(struct ts_obj *obj, struct ts_tabl *tabl);
+static void free_prog(struct ts_obj *obj, struct ts_prog *prog);
+static void free_elem(struct ts_obj *obj, struct ts_elem *elem);
+static size_t tabl_idx(uint16_t PID, uint8_t table_id, uint16_t table_id_extension, uint32_t ext2);
+static void tabl_insert(struct ts_obj *obj, struct ts_tabl *tabl);
+static void tabl_hash_add(struct ts_obj *obj, struct ts_tabl *tabl);
+static int store_hash(struct ts_obj *obj);
+static uint16_t tabl_pid(uint8_t table_id);
+static size_t sect_idx(struct ts_tabl *tabl, uint8_t section_number);
+static struct ts_sect *sect_search(struct ts_obj *obj, struct ts_tabl *tabl, uint8_t section_number);
+static void sect_hash_add(struct ts_obj *obj, struct ts_tabl *tabl, struct ts_sect *sect);
+static void sect_hash_del(struct ts_obj *obj, struct ts_sect *sect);
+static int eit_event(struct ts_sect *sect, int idx, struct ts_event *evt);
+static int eit_cmp(const void *a, const void *b);
+static void *mp_malloc(struct ts_obj *obj, size_t size);
+static void mp_free(struct ts_obj *obj, void *ptr);
+static uint64_t stat_clk(void);
 static int is_all_prog_parsed(struct ts_obj *obj);
 static int pid_type(uint16_t pid);
 static const struct table_id_table *table_type(uint8_t id);
@@ -240,6 +278,10 @@ struct ts_obj *ts_create(/*@null@*/ void *mp)
         obj->prog0 = NULL; /* no prog list now */
         obj->tabl0 = NULL; /* no tabl list now */
         obj->ca0 = NULL; /* no ca list now */
+        obj->apes_ring = NULL; /* PES assembler not used now */
+        memset(obj->apes_map, 0, sizeof(obj->apes_map));
+        obj->tabl_hash = NULL; /* table store not used now, see store_hash() */
+        obj->sect_hash = NULL;
         init(obj);
 
         return obj;
@@ -253,6 +295,11 @@ int ts_destroy(/*@only@*/ /*@null@*/ struct ts_obj *obj)
         }
 
         init(obj); /* free all list */
+        if(obj->apes_ring) {
+                free(obj->apes_ring);
+        }
+        free(obj->tabl_hash);
+        free(obj->sect_hash);
         free(obj);
         return 0;
 }
@@ -280,6 +327,27 @@ int ts_ioctl(struct ts_obj *obj, int cmd, void *arg)
                 case TS_TIDY:
                         tidy(obj);
                         break;
+                case TS_APES:
+                        if(arg && 0x0000 <= *(int *)arg && *(int *)arg < 0x2000) {
+                                int pid = *(int *)arg;
+
+                                obj->apes_map[pid >> 3] |= BIT(pid & 0x07);
+                        }
+                        else if(arg && 0x2000 == *(int *)arg) {
+                                memset(obj->apes_map, 0xFF, sizeof(obj->apes_map));
+                        }
+                        else {
+                                RPTERR("bad pid");
+                        }
+                        break;
+                case TS_STAT:
+                        if(arg) {
+                                memcpy((struct ts_stat *)arg, &(obj->stat), sizeof(struct ts_stat));
+                        }
+                        else {
+                                RPTERR("bad stat");
+                        }
+                        break;
                 default:
                         RPTERR("bad cmd");
                         break;
@@ -296,25 +364,30 @@ static void init(/*@out@*/ struct ts_obj *obj)
 
         /* clear the pid list */
         while(NULL != (pid = (struct ts_pid *)zlst_pop((zhead_t *)&(obj->pid0)))) {
-                free_pid(obj->mp, pid);
+                free_pid(obj, pid);
         }
         obj->pid0 = NULL;
 
         /* clear the prog list */
         while(NULL != (prog = (struct ts_prog *)zlst_pop((zhead_t *)&(obj->prog0)))) {
-                free_prog(obj->mp, prog);
+                free_prog(obj, prog);
         }
         obj->prog0 = NULL;
 
         /* clear the table list */
         while(NULL != (tabl = (struct ts_tabl *)zlst_pop((zhead_t *)&(obj->tabl0)))) {
-                free_tabl(obj->mp, tabl);
+                free_tabl(obj, tabl);
         }
         obj->tabl0 = NULL;
+        memset(obj->tabl_tail, 0, sizeof(obj->tabl_tail));
+        if(obj->tabl_hash) {
+                memset(obj->tabl_hash, 0, TS_TABL_HASH * sizeof(struct ts_tabl *));
+                memset(obj->sect_hash, 0, TS_SECT_HASH * sizeof(struct ts_sect *));
+        }
 
         /* clear the ca list */
         while(NULL != (ca = (struct ts_ca *)zlst_pop((zhead_t *)&(obj->ca0)))) {
-                buddy_free(obj->mp, ca);
+                mp_free(obj, ca);
         }
         obj->ca0 = NULL;
 
@@ -334,8 +407,22 @@ static void init(/*@out@*/ struct ts_obj *obj)
         obj->STC = STC_OVF;
         obj->has_scrambling = 0;
         obj->has_CAT = 0;
+        obj->has_apes = 0;
+        obj->apes[0] = NULL;
+        obj->apes[1] = NULL;
+        obj->apes_wr = 0;
+        obj->apes_low = INT64_MAX;
+        obj->has_evt = 0;
+        obj->evt_cnt = 0;
+        obj->evt_lost = 0;
 
         memset(&(obj->err), 0, sizeof(struct ts_err)); /* no error */
+        memset(&(obj->stat), 0, sizeof(struct ts_stat)); /* count from 0 */
+#if (defined(ARCH_X86) || defined(ARCH_X86_64)) && defined(__GNUC__)
+        obj->stat.clk_unit = "cycle";
+#else
+        obj->stat.clk_unit = "ns";
+#endif
         return;
 }
 
@@ -345,6 +432,7 @@ static void tidy(struct ts_obj *obj)
         struct ts_prog *prog;
         struct ts_elem *elem;
         struct ts_tabl *tabl;
+        struct ts_tabl *tabl0;
         struct ts_pid *pid;
 
         /* add PAT pid */
@@ -367,6 +455,8 @@ static void tidy(struct ts_obj *obj)
                 prog->ADDb = 0;
                 prog->PCRb = STC_OVF;
                 prog->is_STC_sync = 0;
+                prog->is_rate_ok = 0;
+                memset(&(prog->pcrm), 0, sizeof(struct ts_pcrm));
 
                 /* add PMT pid */
                 memset(&new_pid, 0, sizeof(struct ts_pid));
@@ -403,10 +493,34 @@ static void tidy(struct ts_obj *obj)
                 }
         }
 
-        /* tabl list */
-        for(tabl = obj->tabl0; tabl; tabl = (struct ts_tabl *)(((struct znode *)tabl)->next)) {
-                RPTINF("tidy tabl: 0x%02X", (unsigned int)(tabl->table_id));
-                tabl->STC = STC_OVF;
+        /* tabl list, insert again for order, tabl_tail and the hash: node of xml2list is not in them */
+        if(obj->tabl0 && 0 == store_hash(obj)) {
+                memset(obj->tabl_hash, 0, TS_TABL_HASH * sizeof(struct ts_tabl *));
+                memset(obj->tabl_tail, 0, sizeof(obj->tabl_tail));
+                memset(obj->sect_hash, 0, TS_SECT_HASH * sizeof(struct ts_sect *));
+                tabl0 = obj->tabl0;
+                obj->tabl0 = NULL;
+                while(NULL != (tabl = tabl0)) {
+                        struct znode *znode;
+
+                        tabl0 = (struct ts_tabl *)(((struct znode *)tabl)->next);
+                        RPTINF("tidy tabl: 0x%02X", (unsigned int)(tabl->table_id));
+                        if(0x0000 == tabl->PID) {
+                                tabl->PID = tabl_pid(tabl->table_id); /* psi.xml without PID */
+                        }
+                        if(0x00 == tabl->table_id || 0x01 == tabl->table_id) {
+                                tabl->table_id_extension = 0; /* one PAT or CAT for one TS */
+                        }
+                        else if(0x0000 == tabl->table_id_extension && tabl->sect0) {
+                                tabl->table_id_extension = tabl->sect0->table_id_extension;
+                        }
+                        tabl_insert(obj, tabl);
+                        tabl_hash_add(obj, tabl);
+                        for(znode = (struct znode *)(tabl->sect0); znode; znode = znode->next) {
+                                sect_hash_add(obj, tabl, (struct ts_sect *)znode);
+                        }
+                        tabl->STC = STC_OVF;
+                }
         }
 
         /* pid list */
@@ -435,43 +549,44 @@ static void tidy(struct ts_obj *obj)
         return;
 }
 
-static void free_pid(void *mp, struct ts_pid *pid)
+static void free_pid(struct ts_obj *obj, struct ts_pid *pid)
 {
         struct ts_pkt *pkt;
 
         /* clear the pkt list */
         while(NULL != (pkt = (struct ts_pkt *)zlst_pop((zhead_t *)&(pid->pkt0)))) {
-                buddy_free(mp, pkt);
+                mp_free(obj, pkt);
         }
 
-        buddy_free(mp, pid);
+        apes_free(pid);
+        mp_free(obj, pid);
         return;
 }
 
-static void free_sect(void *mp, struct ts_sect *sect)
+static void free_sect(struct ts_obj *obj, struct ts_sect *sect)
 {
         if(sect->section) {
-                buddy_free(mp, sect->section);
+                mp_free(obj, sect->section);
         }
 
-        buddy_free(mp, sect);
+        mp_free(obj, sect);
         return;
 }
 
-static void free_tabl(void *mp, struct ts_tabl *tabl)
+static void free_tabl(struct ts_obj *obj, struct ts_tabl *tabl)
 {
         struct ts_sect *sect;
 
         /* clear the sect list */
         while(NULL != (sect = (struct ts_sect *)zlst_pop((zhead_t *)&(tabl->sect0)))) {
-                free_sect(mp, sect);
+                free_sect(obj, sect);
         }
 
-        buddy_free(mp, tabl);
+        mp_free(obj, tabl);
         return;
 }
 
-static void free_prog(void *mp, struct ts_prog *prog)
+static void free_prog(struct ts_obj *obj, struct ts_prog *prog)
 {
         struct ts_elem *elem;
         struct ts_sect *sect;
@@ -479,41 +594,82 @@ static void free_prog(void *mp, struct ts_prog *prog)
 
         /* clear the elem list */
         while(NULL != (elem = (struct ts_elem *)zlst_pop((zhead_t *)&(prog->elem0)))) {
-
-                if(elem->es_info) {
-                        buddy_free(mp, elem->es_info);
-                        elem->es_info_len = 0;
-                }
-                while(NULL != (ca = (struct ts_ca *)zlst_pop((zhead_t *)&(elem->ca0)))) {
-                        buddy_free(mp, ca);
-                }
-                buddy_free(mp, elem);
+                free_elem(obj, elem);
         }
 
         /* clear the sect list */
         while(NULL != (sect = (struct ts_sect *)zlst_pop((zhead_t *)&(prog->tabl.sect0)))) {
-                free_sect(mp, sect);
+                free_sect(obj, sect);
         }
 
         if(prog->program_info) {
-                buddy_free(mp, prog->program_info);
+                mp_free(obj, prog->program_info);
                 prog->program_info_len = 0;
         }
         while(NULL != (ca = (struct ts_ca *)zlst_pop((zhead_t *)&(prog->ca0)))) {
-                buddy_free(mp, ca);
+                mp_free(obj, ca);
         }
         if(prog->service_name) {
-                buddy_free(mp, prog->service_name);
+                mp_free(obj, prog->service_name);
                 prog->service_name_len = 0;
         }
         if(prog->service_provider) {
-                buddy_free(mp, prog->service_provider);
+                mp_free(obj, prog->service_provider);
                 prog->service_provider_len = 0;
         }
-        buddy_free(mp, prog);
+        mp_free(obj, prog);
+        return;
+}
+
+static void free_elem(struct ts_obj *obj, struct ts_elem *elem)
+{
+        struct ts_ca *ca;
+
+        if(elem->es_info) {
+                mp_free(obj, elem->es_info);
+                elem->es_info = NULL;
+                elem->es_info_len = 0;
+        }
+        while(NULL != (ca = (struct ts_ca *)zlst_pop((zhead_t *)&(elem->ca0)))) {
+                mp_free(obj, ca);
+        }
+        mp_free(obj, elem);
+        return;
+}
+
+static void *mp_malloc(struct ts_obj *obj, size_t size)
+{
+        void *ptr = buddy_malloc(obj->mp, size);
+
+        if(ptr) {
+                obj->stat.alloc++;
+        }
+        return ptr;
+}
+
+static void mp_free(struct ts_obj *obj, void *ptr)
+{
+        obj->stat.free++;
+        buddy_free(obj->mp, ptr);
         return;
 }
 
+static uint64_t stat_clk(void)
+{
+#if (defined(ARCH_X86) || defined(ARCH_X86_64)) && defined(__GNUC__)
+        uint32_t lo;
+        uint32_t hi;
+
+        __asm__ __volatile__("rdtsc" : "=a"(lo), "=d"(hi));
+        return ((uint64_t)hi << 32) | lo;
+#else
+        struct timespec ts;
+
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+        return (uint64_t)ts.tv_sec * 1000000000 + (uint64_t)ts.tv_nsec;
+#endif
+}
+
 int ts_parse_tsh(struct ts_obj *obj)
 {
         struct ts_ipt *ipt;
@@ -521,6 +677,8 @@ int ts_parse_tsh(struct ts_obj *obj)
         struct ts_tsh *tsh;
         struct ts_err *err;
         struct ts_pid *pid; /* maybe NULL */
+        uint64_t clk0;
+        uint64_t clk1;
 
         if(!obj) {
                 RPTERR("ts_parse_tsh: bad obj");
@@ -533,6 +691,9 @@ int ts_parse_tsh(struct ts_obj *obj)
                 RPTERR("ts_parse_tsh: no ts packet");
                 return -1;
         }
+        clk0 = STAT_CLK(obj);
+        obj->stat.pkt++;
+        obj->stat.byte += TS_PKT_SIZE;
         obj->cur = ipt->TS;
         obj->tail = obj->cur + TS_PKT_SIZE;
 
@@ -558,6 +719,14 @@ int ts_parse_tsh(struct ts_obj *obj)
         obj->sect = NULL; /* not an end of a section */
         obj->has_rate = 0; /* not a new rate calculate peroid */
         obj->has_ess = 0; /* not a new PES head */
+        obj->has_evt = 0; /* no PSI change */
+        obj->evt_cnt = 0;
+        while(obj->has_apes) {
+                /* application has used the last PES packet(s) */
+                obj->has_apes--;
+                obj->apes[obj->has_apes]->size = 0;
+                obj->apes[obj->has_apes]->iov_cnt = 0;
+        }
 
         /* begin */
         dat = *(obj->cur)++;
@@ -606,7 +775,9 @@ int ts_parse_tsh(struct ts_obj *obj)
         }
 
         if((BIT(1) & tsh->adaption_field_control) && obj->cfg.need_af) {
+                clk1 = STAT_CLK(obj);
                 ts_parse_af(obj);
+                STAT_ADD(obj, TS_STAGE_AF, clk1);
         }
 
         if(BIT(0) & tsh->adaption_field_control) {
@@ -670,15 +841,7 @@ int ts_parse_tsh(struct ts_obj *obj)
                         struct ts_prog *prog = obj->prog0; /* may be NULL */
 
                         if(prog && (prog->is_STC_sync) && (prog->PCRa != prog->PCRb)) {
-                                long double delta;
-
-                                /* CTSx - PCRb   ADDx - ADDb */
-                                /* ----------- = ----------- */
-                                /* PCRb - PCRa   ADDb - ADDa */
-                                delta = (long double)ts_timestamp_diff(prog->PCRb, prog->PCRa, STC_OVF);
-                                delta *= (obj->ADDR - prog->ADDb);
-                                delta /= (prog->ADDb - prog->ADDa);
-                                obj->CTS = ts_timestamp_add(prog->PCRb, (int64_t)delta, STC_OVF);
+                                obj->CTS = prog_stc(obj, prog);
                         }
                 }
                 obj->CTS_base = obj->CTS / 300;
@@ -691,15 +854,7 @@ int ts_parse_tsh(struct ts_obj *obj)
                         struct ts_prog *prog = pid->prog; /* may be NULL */
 
                         if(prog && (prog->is_STC_sync) && (prog->PCRa != prog->PCRb)) {
-                                long double delta;
-
-                                /* STCx - PCRb   ADDx - ADDb */
-                                /* ----------- = ----------- */
-                                /* PCRb - PCRa   ADDb - ADDa */
-                                delta = (long double)ts_timestamp_diff(prog->PCRb, prog->PCRa, STC_OVF);
-                                delta *= (obj->ADDR - prog->ADDb);
-                                delta /= (prog->ADDb - prog->ADDa);
-                                obj->STC = ts_timestamp_add(prog->PCRb, (int64_t)delta, STC_OVF);
+                                obj->STC = prog_stc(obj, prog);
                         }
                 }
                 obj->STC_base = obj->STC / 300;
@@ -728,10 +883,13 @@ int ts_parse_tsh(struct ts_obj *obj)
         /* PSI/SI section collect */
         if(obj->cfg.need_psi || obj->cfg.need_si) {
                 if((tsh->PID < 0x0020) || IS_TYPE(TS_TYPE_PMT, pid->type)) {
+                        clk1 = STAT_CLK(obj);
                         ts_ts2sect(obj);
+                        STAT_ADD(obj, TS_STAGE_SECT, clk1);
                 }
         }
 
+        STAT_ADD(obj, TS_STAGE_TSH, clk0);
         return 0;
 }
 
@@ -769,8 +927,8 @@ static int state_next_pat(struct ts_obj *obj)
         }
 
         /* section parse has done in ts_parse_tsh()! */
-        RPTDBG("search 0x00 in table_list");
-        tabl = (struct ts_tabl *)zlst_search((zhead_t *)&(obj->tabl0), 0x00);
+        RPTDBG("search 0x00 in table store");
+        tabl = ts_tabl_search(obj, 0x0000, 0x00, 0x0000, 0);
         if(!tabl) {
                 return -1;
         }
@@ -952,6 +1110,9 @@ static int state_next_pkt(struct ts_obj *obj)
                                 continue;
                         }
 
+                        /* PCR metrics: use PCRa and PCRb before flush */
+                        pcrm_update(obj, prog);
+
                         /* PCRa: the PCR packet before last PCR packet */
                         prog->PCRa = prog->PCRb;
                         prog->ADDa = prog->ADDb;
@@ -968,6 +1129,9 @@ static int state_next_pkt(struct ts_obj *obj)
                                 prog->is_STC_sync = 0;
                         }
 
+                        /* rate for STC calc of packets after PCRb, not across a discontinuity */
+                        prog_rate(prog);
+
                         /* is_STC_sync */
                         if(!prog->is_STC_sync) {
                                 int is_first_count_clear = 0;
@@ -1070,7 +1234,14 @@ static int state_next_pkt(struct ts_obj *obj)
         /* PES head & ES data */
         if(obj->cfg.need_pes && elem && (0 == tsh->transport_scrambling_control)) {
                 if(IS_TYPE(TS_TYPE_AUD, pid->type) || IS_TYPE(TS_TYPE_VID, pid->type)) {
+                        uint64_t clk0 = STAT_CLK(obj);
+
                         ts_parse_pesh(obj);
+                        STAT_ADD(obj, TS_STAGE_PESH, clk0);
+                }
+
+                if(obj->PES_len && IS_APES(obj, obj->PID)) {
+                        apes_push(obj, pid);
                 }
 
                 if(obj->has_pts) {
@@ -1273,7 +1444,7 @@ static int ts_ts2sect(struct ts_obj *obj)
 
                         if((int)(pid->section_length) > pid->payload_total) {
                                 /* multi-packets section, make pkt list */
-                                struct ts_pkt *new_pkt = (struct ts_pkt *)buddy_malloc(obj->mp, sizeof(struct ts_pkt));
+                                struct ts_pkt *new_pkt = (struct ts_pkt *)mp_malloc(obj, sizeof(struct ts_pkt));
                                 if(!new_pkt) {
                                         RPTERR("malloc for pkt node failed");
                                         return -1;
@@ -1285,13 +1456,13 @@ static int ts_ts2sect(struct ts_obj *obj)
                         }
                         else {
                                 /* single packet section, for efficienc: directly make section without pkt list */
-                                struct ts_sect *new_sect = (struct ts_sect *)buddy_malloc(obj->mp, sizeof(struct ts_sect));
+                                struct ts_sect *new_sect = (struct ts_sect *)mp_malloc(obj, sizeof(struct ts_sect));
                                 if(!new_sect) {
                                         RPTERR("malloc section node failed");
                                         goto ts2sect_free_pkt_list;
                                 }
 
-                                new_sect->section = (uint8_t *)buddy_malloc(obj->mp, 3 + pid->section_length);
+                                new_sect->section = (uint8_t *)mp_malloc(obj, 3 + pid->section_length);
                                 if(!new_sect->section) {
                                         RPTERR("malloc data buffer of section node failed");
                                         goto ts2sect_free_pkt_list;
@@ -1315,7 +1486,7 @@ static int ts_ts2sect(struct ts_obj *obj)
         }
         else { /* (pid->pkt0) */
                 /* next packet of this section */
-                struct ts_pkt *new_pkt = (struct ts_pkt *)buddy_malloc(obj->mp, sizeof(struct ts_pkt));
+                struct ts_pkt *new_pkt = (struct ts_pkt *)mp_malloc(obj, sizeof(struct ts_pkt));
                 if(!new_pkt) {
                         RPTERR("malloc for packet node failed");
                         goto ts2sect_free_pkt_list;
@@ -1387,13 +1558,13 @@ static int ts_ts2sect(struct ts_obj *obj)
                         struct ts_sect *new_sect;
                         int left_length;
 
-                        new_sect = (struct ts_sect *)buddy_malloc(obj->mp, sizeof(struct ts_sect));
+                        new_sect = (struct ts_sect *)mp_malloc(obj, sizeof(struct ts_sect));
                         if(!new_sect) {
                                 RPTERR("malloc section node failed");
                                 goto ts2sect_free_pkt_list;
                         }
 
-                        new_sect->section = (uint8_t *)buddy_malloc(obj->mp, 3 + pid->section_length);
+                        new_sect->section = (uint8_t *)mp_malloc(obj, 3 + pid->section_length);
                         if(!new_sect->section) {
                                 RPTERR("malloc data buffer of section node failed");
                                 goto ts2sect_free_pkt_list;
@@ -1417,7 +1588,7 @@ static int ts_ts2sect(struct ts_obj *obj)
                                         memcpy(p, pkt->pkt + TS_PKT_SIZE - pkt->payload_size, (size_t)(pkt->payload_size));
                                         p += pkt->payload_size;
                                         left_length -= pkt->payload_size;
-                                        buddy_free(obj->mp, pkt);
+                                        mp_free(obj, pkt);
 #ifdef DEBUG_SECTION_FRAGMENT
                                         fprintf(stderr, "- %3d = %4d ", pkt->payload_size, left_length);
 #endif
@@ -1458,7 +1629,7 @@ static int ts_ts2sect(struct ts_obj *obj)
 #ifdef DEBUG_SECTION_FRAGMENT
                                                 fprintf(stderr, "(%d-byte padding data)\n", pkt->payload_size);
 #endif
-                                                buddy_free(obj->mp, pkt);
+                                                mp_free(obj, pkt);
                                         }
                                         break;
                                 }
@@ -1471,8 +1642,9 @@ static int ts_ts2sect(struct ts_obj *obj)
         return 0;
 
 ts2sect_free_pkt_list:
+        obj->stat.sect_drop++;
         while(NULL != (pkt = (struct ts_pkt *)zlst_pop((zhead_t *)&(pid->pkt0)))) {
-                buddy_free(obj->mp, pkt);
+                mp_free(obj, pkt);
         }
         return -1;
 }
@@ -1484,6 +1656,17 @@ static int ts_parse_sect(struct ts_obj *obj, struct ts_sect *new_sect)
         struct ts_pid *pid = obj->pid;
         struct ts_err *err = &(obj->err);
         struct znode **psect0;
+        int is_dup = 0;
+        int is_store = 0; /* tabl in table store, not PMT of prog */
+        struct ts_sect *old_sect; /* the same section stored, or NULL */
+        uint16_t ext = 0; /* key of tabl in table store */
+        uint32_t ext2 = 0;
+        int crc_period = (obj->cfg.crc_period > 0) ? obj->cfg.crc_period : TS_CRC_PERIOD;
+        uint64_t clk0 = STAT_CLK(obj);
+
+        new_sect->tabl = NULL;
+        new_sect->hnext = NULL;
+        new_sect->skip_cnt = 0;
 
         /* get section head info */
         p = new_sect->section;
@@ -1493,6 +1676,8 @@ static int ts_parse_sect(struct ts_obj *obj, struct ts_sect *new_sect)
         new_sect->section_length   = *p++ & 0x0F;
         new_sect->section_length <<= 8;
         new_sect->section_length  |= *p++;
+        obj->stat.sect++;
+        obj->stat.sect_byte += 3 + new_sect->section_length;
         if(1 == new_sect->section_syntax_indicator) {
                 const struct table_id_table *table_id_table;
 
@@ -1565,28 +1750,7 @@ static int ts_parse_sect(struct ts_obj *obj, struct ts_sect *new_sect)
                 goto release_sect;
         }
 
-        /* check CRC */
-        if(new_sect->check_CRC) {
-                p = new_sect->section + 3 + new_sect->section_length - 4;
-                obj->CRC_32   = *p++;
-                obj->CRC_32 <<= 8;
-                obj->CRC_32  |= *p++;
-                obj->CRC_32 <<= 8;
-                obj->CRC_32  |= *p++;
-                obj->CRC_32 <<= 8;
-                obj->CRC_32  |= *p++;
-
-                obj->CRC_32_calc = ts_crc(new_sect->section, 3 + new_sect->section_length - 4, 32);
-                if(obj->CRC_32_calc != obj->CRC_32) {
-                        err->CRC_error = 1;
-                        err->has_level2_error++;
-                        obj->has_err++;
-                        goto release_sect;
-                }
-                new_sect->CRC_32 = obj->CRC_32;
-        }
-
-        /* locate "tabl" and "psect0" */
+        /* locate "tabl", NULL for new sub-table in table store */
         if(0x02 == new_sect->table_id) {
                 /* is PMT section */
                 if(!(pid->prog)) {
@@ -1601,38 +1765,120 @@ static int ts_parse_sect(struct ts_obj *obj, struct ts_sect *new_sect)
                         goto release_sect;
                 }
                 tabl = &(pid->prog->tabl);
+                old_sect = (struct ts_sect *)zlst_search((zhead_t *)&(tabl->sect0),
+                                                         (int)(new_sect->section_number));
+        }
+        else {
+                /* not PMT section, sub-table in table store */
+                uint8_t *buf = new_sect->section;
+
+                ext = new_sect->table_id_extension;
+                if(0x00 == new_sect->table_id || 0x01 == new_sect->table_id) {
+                        ext = 0; /* one PAT or CAT for one TS */
+                }
+                else if(0x42 == new_sect->table_id || 0x46 == new_sect->table_id) {
+                        if(new_sect->section_length >= 7) {
+                                ext2 = (buf[8] << 8) | buf[9]; /* original_network_id */
+                        }
+                }
+                else if(0x4E <= new_sect->table_id && new_sect->table_id <= 0x6F) {
+                        if(new_sect->section_length >= 9) {
+                                ext2 = ((uint32_t)buf[8] << 24) | (buf[9] << 16) | /* transport_stream_id */
+                                       (buf[10] << 8) | buf[11]; /* original_network_id */
+                        }
+                }
+
+                RPTDBG("search 0x%02X/0x%04X in table store", (unsigned int)(new_sect->table_id), ext);
+                tabl = ts_tabl_search(obj, pid->PID, new_sect->table_id, ext, ext2);
+                old_sect = (tabl) ? sect_search(obj, tabl, new_sect->section_number) : NULL;
+                is_store = 1;
+        }
+
+        /* check CRC, skip it if new_sect is the same as old_sect */
+        if(new_sect->check_CRC) {
+                size_t len = 3 + new_sect->section_length - 4;
+
+                p = new_sect->section + len;
+                obj->CRC_32   = *p++;
+                obj->CRC_32 <<= 8;
+                obj->CRC_32  |= *p++;
+                obj->CRC_32 <<= 8;
+                obj->CRC_32  |= *p++;
+                obj->CRC_32 <<= 8;
+                obj->CRC_32  |= *p++;
+
+                if(old_sect &&
+                   old_sect->section_length == new_sect->section_length &&
+                   old_sect->CRC_32 == obj->CRC_32 &&
+                   ++(old_sect->skip_cnt) < crc_period &&
+                   0 == memcmp(old_sect->section, new_sect->section, len)) {
+                        /* verified when old_sect was stored, so is new_sect */
+                        obj->CRC_32_calc = obj->CRC_32;
+                        obj->stat.crc_skip++;
+                }
+                else {
+                        if(old_sect) {
+                                old_sect->skip_cnt = 0;
+                        }
+                        obj->CRC_32_calc = ts_crc(new_sect->section, len, 32);
+                        obj->stat.crc++;
+                        obj->stat.crc_byte += len;
+                        if(obj->CRC_32_calc != obj->CRC_32) {
+                                err->CRC_error = 1;
+                                err->has_level2_error++;
+                                obj->has_err++;
+                                goto release_sect;
+                        }
+                }
+                new_sect->CRC_32 = obj->CRC_32;
+        }
 
+        /* create or update "tabl" */
+        if(!is_store) {
                 if(0xFF == tabl->version_number) {
                         /* first PMT of this prog */
                         tabl->version_number = new_sect->version_number;
                         tabl->last_section_number = new_sect->last_section_number;
                 }
         }
-        else {
-                /* not PMT section */
-                RPTDBG("search 0x%02X in table_list", (unsigned int)(new_sect->table_id));
-                tabl = (struct ts_tabl *)zlst_search((zhead_t *)&(obj->tabl0),
-                                                     (int)(new_sect->table_id));
+        else if(!tabl) {
+                if(0 != store_hash(obj)) {
+                        goto release_sect;
+                }
+                tabl = (struct ts_tabl *)mp_malloc(obj, sizeof(struct ts_tabl));
                 if(!tabl) {
-                        tabl = (struct ts_tabl *)buddy_malloc(obj->mp, sizeof(struct ts_tabl));
-                        if(!tabl) {
-                                RPTERR("malloc ts_tabl node failed");
-                                goto release_sect;
-                        }
+                        RPTERR("malloc ts_tabl node failed");
+                        goto release_sect;
+                }
 
-                        tabl->sect0 = NULL;
-                        tabl->table_id = new_sect->table_id;
-                        tabl->version_number = new_sect->version_number;
-                        tabl->last_section_number = new_sect->last_section_number;
-                        tabl->STC = STC_OVF;
+                tabl->sect0 = NULL;
+                tabl->PID = pid->PID;
+                tabl->table_id = new_sect->table_id;
+                tabl->table_id_extension = ext;
+                tabl->ext2 = ext2;
+                tabl->version_number = new_sect->version_number;
+                tabl->last_section_number = new_sect->last_section_number;
+                tabl->STC = STC_OVF;
 
-                        RPTDBG("insert 0x%02X in table_list", (unsigned int)(tabl->table_id));
-                        if(0 != zlst_insert((zhead_t *)&(obj->tabl0), tabl,
-                                            (int)(tabl->table_id))) {
-                                free_tabl(obj->mp, tabl);
-                                goto release_sect;
-                        }
+                RPTDBG("insert 0x%02X/0x%04X in table store", (unsigned int)(tabl->table_id), ext);
+                tabl_insert(obj, tabl);
+                tabl_hash_add(obj, tabl);
+        }
+        else if(new_sect->table_id > 0x02 &&
+                new_sect->section_syntax_indicator &&
+                new_sect->version_number != tabl->version_number) {
+                struct ts_sect *sect_node;
+
+                /* new version of SI sub-table, PSI is left to section_crc32_error */
+                RPTDBG("version_number(%d -> %d), free old sections",
+                    (int)(tabl->version_number), (int)(new_sect->version_number));
+                tabl->version_number = new_sect->version_number;
+                tabl->last_section_number = new_sect->last_section_number;
+                while(NULL != (sect_node = (struct ts_sect *)zlst_pop((zhead_t *)&(tabl->sect0)))) {
+                        sect_hash_del(obj, sect_node);
+                        free_sect(obj, sect_node);
                 }
+                old_sect = NULL;
         }
         psect0 = (struct znode **)&(tabl->sect0);
 
@@ -1661,7 +1907,7 @@ static int ts_parse_sect(struct ts_obj *obj, struct ts_sect *new_sect)
                 tabl->version_number = new_sect->version_number;
                 tabl->last_section_number = new_sect->last_section_number;
                 while(NULL != (sect_node = (struct ts_sect *)zlst_pop((zhead_t *)psect0))) {
-                        free_sect(obj->mp, sect_node);
+                        free_sect(obj, sect_node);
                 };
         }
 #endif
@@ -1669,8 +1915,33 @@ static int ts_parse_sect(struct ts_obj *obj, struct ts_sect *new_sect)
         /* locate sect pointer */
         RPTDBG("search %d/%d in sect_list",
                (int)(new_sect->section_number), (int)(new_sect->last_section_number));
-        obj->sect = (struct ts_sect *)zlst_search((zhead_t *)psect0,
-                                                  (int)(new_sect->section_number));
+        obj->sect = old_sect;
+        if(obj->sect && obj->sect->CRC_32 != new_sect->CRC_32) {
+                int mask;
+
+                switch(new_sect->table_id) {
+                        case 0x00: mask = ERR_4_0_0; break;
+                        case 0x01: mask = ERR_4_0_1; break;
+                        case 0x02: mask = ERR_4_0_2; break;
+                        default:   mask = 0; break;
+                }
+                err->section_crc32_error |= mask;
+                err->has_other_error += ((mask) ? 1 : 0);
+                obj->has_err += ((mask) ? 1 : 0);
+
+                if(obj->cfg.need_psi_update && ((ERR_4_0_0 | ERR_4_0_2) & mask)) {
+                        /* new PAT or PMT, drop the old section and parse the new one */
+                        RPTINF("apply new section(table %02X) in place", (unsigned int)(new_sect->table_id));
+                        zlst_delete((zhead_t *)psect0, old_sect);
+                        if(is_store) {
+                                sect_hash_del(obj, old_sect);
+                        }
+                        free_sect(obj, old_sect);
+                        tabl->version_number = new_sect->version_number;
+                        tabl->last_section_number = new_sect->last_section_number;
+                        obj->sect = NULL;
+                }
+        }
         if(NULL == obj->sect) {
                 if(0x42 == new_sect->table_id && !(obj->is_pat_pmt_parsed)) {
                         /* got SDT before PMT will lost service info, so ignore this SDT */
@@ -1682,6 +1953,9 @@ static int ts_parse_sect(struct ts_obj *obj, struct ts_sect *new_sect)
                                     (int)(new_sect->section_number))) {
                         goto release_sect;
                 }
+                if(is_store) {
+                        sect_hash_add(obj, tabl, new_sect);
+                }
                 obj->sect = new_sect; /* has section */
         }
         else {
@@ -1689,19 +1963,7 @@ static int ts_parse_sect(struct ts_obj *obj, struct ts_sect *new_sect)
                     (unsigned int)(obj->sect->section_number),
                     (unsigned int)(obj->sect->last_section_number),
                     (unsigned int)(obj->sect->table_id));
-                if(obj->sect->CRC_32 != new_sect->CRC_32) {
-                        int mask;
-
-                        switch(new_sect->table_id) {
-                                case 0x00: mask = ERR_4_0_0; break;
-                                case 0x01: mask = ERR_4_0_1; break;
-                                case 0x02: mask = ERR_4_0_2; break;
-                                default:   mask = 0; break;
-                        }
-                        err->section_crc32_error |= mask;
-                        err->has_other_error += ((mask) ? 1 : 0);
-                        obj->has_err += ((mask) ? 1 : 0);
-                }
+                is_dup = 1;
                 goto release_sect;
         }
         /* new_sect is in list now, do not free new_sect from here to "return 0"! */
@@ -1724,10 +1986,18 @@ static int ts_parse_sect(struct ts_obj *obj, struct ts_sect *new_sect)
                         RPTDBG("meet table(0x%02X), ignore", (unsigned int)(new_sect->table_id));
                         break;
         }
+        STAT_ADD(obj, TS_STAGE_SECP, clk0);
         return 0;
 
 release_sect:
-        free_sect(obj->mp, new_sect);
+        if(is_dup) {
+                obj->stat.sect_dup++;
+        }
+        else {
+                obj->stat.sect_drop++;
+        }
+        free_sect(obj, new_sect);
+        STAT_ADD(obj, TS_STAGE_SECP, clk0);
         return -1;
 }
 
@@ -1756,6 +2026,9 @@ static int ts_parse_secb_pat(struct ts_obj *obj)
 
         /* to avoid stack overflow, FIXME */
         if(obj->prog0) {
+                if(obj->cfg.need_psi_update) {
+                        return pat_update(obj);
+                }
                 return 0;
         }
 
@@ -1764,40 +2037,25 @@ static int ts_parse_secb_pat(struct ts_obj *obj)
         obj->has_got_transport_stream_id = 1;
 
         while(cur < crc) {
-                memset(new_pid, 0, sizeof(struct ts_pid));
+                uint16_t program_number;
 
-                /* add program */
-                prog = (struct ts_prog *)buddy_malloc(obj->mp, sizeof(struct ts_prog));
-                if(!prog) {
-                        RPTERR("malloc prog node failed");
-                        return -1;
-                }
-                prog->elem0 = NULL;
-                prog->tabl.sect0 = NULL;
-                prog->program_info_len = 0;
-                prog->program_info = NULL;
-                prog->ca0 = NULL;
-                prog->service_name_len = 0;
-                prog->service_name = NULL;
-                prog->service_provider_len = 0;
-                prog->service_provider = NULL;
+                memset(new_pid, 0, sizeof(struct ts_pid));
 
                 dat = *cur++;
-                prog->program_number = dat;
+                program_number = dat;
 
                 dat = *cur++;
-                prog->program_number <<= 8;
-                prog->program_number |= dat;
+                program_number <<= 8;
+                program_number |= dat;
 
                 dat = *cur++;
-                prog->PMT_PID = dat & 0x1F;
+                new_pid->PID = dat & 0x1F;
 
                 dat = *cur++;
-                prog->PMT_PID <<= 8;
-                prog->PMT_PID |= dat;
-                new_pid->PID = prog->PMT_PID;
+                new_pid->PID <<= 8;
+                new_pid->PID |= dat;
 
-                if(0 == prog->program_number) {
+                if(0 == program_number) {
                         /* network PID, not a program */
                         new_pid->type = TS_TYPE_NIT;
 
@@ -1806,13 +2064,19 @@ static int ts_parse_secb_pat(struct ts_obj *obj)
                                 err->has_other_error++;
                                 obj->has_err++;
                         }
-                        free_prog(obj->mp, prog);
+                        prog = obj->prog0; /* as other PID below 0x0020 */
                 }
                 else {
                         struct znode *znode;
 
                         new_pid->type = TS_TYPE_PMT;
 
+                        /* add program */
+                        prog = new_prog(obj, program_number, new_pid->PID);
+                        if(!prog) {
+                                return -1;
+                        }
+
                         if(!(obj->prog0)) {
                                 /* traverse pid_list: if it des not belong to any program, use prog0 */
                                 for(znode = (struct znode *)(obj->pid0); znode; znode = znode->next) {
@@ -1823,39 +2087,10 @@ static int ts_parse_secb_pat(struct ts_obj *obj)
                                 }
                         }
 
-                        /* program info */
-                        prog->program_info_len = 0;
-                        prog->program_info = NULL;
-                        prog->ca0 = NULL;
-
-                        /* SDT info */
-                        prog->service_name_len = 0;
-                        prog->service_name = NULL;
-                        prog->service_provider_len = 0;
-                        prog->service_provider = NULL;
-
-                        /* elementary stream list */
-                        prog->elem0 = NULL;
-
-                        /* PMT table */
-                        prog->is_parsed = 0;
-                        prog->tabl.sect0 = NULL;
-                        prog->tabl.table_id = 0x02;
-                        prog->tabl.version_number = 0xFF; /* never reached version */
-                        prog->tabl.last_section_number = 0; /* no use */
-                        prog->tabl.STC = STC_OVF;
-
-                        /* for STC calc */
-                        prog->ADDa = 0;
-                        prog->PCRa = STC_OVF;
-                        prog->ADDb = 0;
-                        prog->PCRb = STC_OVF;
-                        prog->is_STC_sync = 0;
-
                         RPTDBG("insert 0x%04X in prog_list", (unsigned int)(prog->program_number));
                         if(0 != zlst_insert((zhead_t *)&(obj->prog0), prog,
                                             (int)(prog->program_number))) {
-                                free_prog(obj->mp, prog);
+                                free_prog(obj, prog);
                                 return -1;
                         }
                 }
@@ -1914,7 +2149,7 @@ static int ts_parse_secb_cat(struct ts_obj *obj)
                         (void)update_pid_list(obj, new_pid);
 
                         /* ca node */
-                        ca = (struct ts_ca *)buddy_malloc(obj->mp, sizeof(struct ts_ca));
+                        ca = (struct ts_ca *)mp_malloc(obj, sizeof(struct ts_ca));
                         if(!ca) {
                                 RPTERR("malloc ca node failed");
                                 return -1;
@@ -1948,6 +2183,12 @@ static int ts_parse_secb_pmt(struct ts_obj *obj)
         struct ts_prog *prog;
         struct ts_pid ts_new_pid, *new_pid = &ts_new_pid;
         uint8_t *next; /* point to the data after descriptors */
+        int is_update; /* new version of parsed PMT */
+        uint16_t old_PCR_PID;
+        struct ts_elem *old0 = NULL; /* elem list of old version */
+        struct ts_elem *elem;
+        int rslt = 0;
+        struct ts_pid *(*add_pid)(struct ts_obj *obj, struct ts_pid *new_pid);
 
         /* PMT_error */
         if(!(0 <= obj->sect_interval && obj->sect_interval <= 500 * STC_MS)) {
@@ -1964,13 +2205,46 @@ static int ts_parse_secb_pmt(struct ts_obj *obj)
         /* search prog(table_id_extension in pmt is program_number) */
         RPTDBG("search 0x%04X in prog_list", (unsigned int)(sect->table_id_extension));
         prog = (struct ts_prog *)zlst_search((zhead_t *)&(obj->prog0), (int)(sect->table_id_extension));
-        if((!prog) || (prog->is_parsed)) {
+        if((!prog) || (prog->is_parsed && !(obj->cfg.need_psi_update))) {
                 return -1; /* parsed program, ignore */
         }
+        is_update = prog->is_parsed;
+        old_PCR_PID = prog->PCR_PID;
+
+        /* keep statistic and CC of PID when update */
+        add_pid = (is_update) ? link_pid_list : update_pid_list;
+        if(is_update) {
+                struct znode *znode;
+                struct ts_ca *ca;
+
+                /* PID of old version leave the program, link them again if still in PMT */
+                for(znode = (struct znode *)(obj->pid0); znode; znode = znode->next) {
+                        struct ts_pid *pid = (struct ts_pid *)znode;
+
+                        if(pid->prog == prog && pid->PID != prog->PMT_PID &&
+                           pid->PID >= 0x0020 && pid->PID != 0x1FFF) {
+                                unlink_pid(obj, pid);
+                        }
+                }
+                if(prog->program_info) {
+                        mp_free(obj, prog->program_info);
+                        prog->program_info = NULL;
+                        prog->program_info_len = 0;
+                }
+                while(NULL != (ca = (struct ts_ca *)zlst_pop((zhead_t *)&(prog->ca0)))) {
+                        mp_free(obj, ca);
+                }
+                old0 = prog->elem0;
+                prog->elem0 = NULL;
+                add_evt(obj, TS_EVT_PMT, prog->program_number, prog->PMT_PID, 0);
+        }
 
         /* init prog here */
         prog->is_parsed = 1;
         obj->is_psi_si = 1;
+        if(obj->cfg.need_psi_update && is_all_prog_parsed(obj)) {
+                obj->is_pat_pmt_parsed = 1; /* PMT of new program */
+        }
 
         /* parse each parameter about prog */
         dat = *cur++;
@@ -1990,13 +2264,15 @@ static int ts_parse_secb_pmt(struct ts_obj *obj)
                         err->program_info_length_error = 1;
                         err->has_other_error++;
                         obj->has_err++;
-                        return -1;
+                        rslt = -1;
+                        goto pmt_free_old;
                 }
                 else {
-                        prog->program_info = (uint8_t *)buddy_malloc(obj->mp, (size_t)(prog->program_info_len));
+                        prog->program_info = (uint8_t *)mp_malloc(obj, (size_t)(prog->program_info_len));
                         if(!(prog->program_info)) {
                                 RPTERR("malloc for prog_info buffer failed");
-                                return -1;
+                                rslt = -1;
+                                goto pmt_free_old;
                         }
                         memcpy(prog->program_info, cur, (size_t)(prog->program_info_len));
                         /* do not move cur here, program_info will be parsed */
@@ -2016,7 +2292,8 @@ static int ts_parse_secb_pmt(struct ts_obj *obj)
                         err->descriptor_error = 1;
                         err->has_other_error++;
                         obj->has_err++;
-                        return -1;
+                        rslt = -1;
+                        goto pmt_free_old;
                 }
                 if(0x09 == tag) { /* CA_descriptor in program_info */
                         uint16_t CA_system_ID;
@@ -2041,13 +2318,14 @@ static int ts_parse_secb_pmt(struct ts_obj *obj)
                         new_pid->prog = prog;
                         new_pid->type = TS_TYPE_ECM;
                         RPTINF("add ECM_PID(0x%04X)", (unsigned int)(CA_PID));
-                        (void)update_pid_list(obj, new_pid);
+                        (void)add_pid(obj, new_pid);
 
                         /* ca node */
-                        ca = (struct ts_ca *)buddy_malloc(obj->mp, sizeof(struct ts_ca));
+                        ca = (struct ts_ca *)mp_malloc(obj, sizeof(struct ts_ca));
                         if(!ca) {
                                 RPTERR("malloc ca node failed");
-                                return -1;
+                                rslt = -1;
+                                goto pmt_free_old;
                         }
 
                         /* init ca here */
@@ -2067,25 +2345,62 @@ static int ts_parse_secb_pmt(struct ts_obj *obj)
         new_pid->prog = prog;
         new_pid->type = ((0x1FFF != new_pid->PID) ? TS_TYPE_PCR : TS_TYPE_NULP);
         new_pid->is_CC_sync = 1;
-        (void)update_pid_list(obj, new_pid); /* PCR_PID */
+        (void)add_pid(obj, new_pid); /* PCR_PID */
+        if(is_update && old_PCR_PID != prog->PCR_PID) {
+                /* STC of this program restart with new PCR_PID */
+                prog->ADDa = 0;
+                prog->PCRa = STC_OVF;
+                prog->ADDb = 0;
+                prog->PCRb = STC_OVF;
+                prog->is_STC_sync = 0;
+                prog->is_rate_ok = 0;
+                memset(&(prog->pcrm), 0, sizeof(struct ts_pcrm));
+                add_evt(obj, TS_EVT_PCR_PID, prog->program_number, prog->PCR_PID, 0);
+        }
 
         while(cur < crc) {
-                struct ts_elem *elem;
+                uint16_t elem_PID = ((cur[1] & 0x1F) << 8) | cur[2];
+                int old_stream_type;
 
-                elem = (struct ts_elem *)buddy_malloc(obj->mp, sizeof(struct ts_elem));
-                if(!elem) {
-                        RPTERR("malloc elem node failed");
-                        return -1;
+                /* elem of old version with the same PID? */
+                for(elem = old0; elem; elem = (struct ts_elem *)(((struct znode *)elem)->next)) {
+                        if(elem->PID == elem_PID) {
+                                break;
+                        }
                 }
+                if(elem) {
+                        struct ts_ca *ca;
 
-                /* init elem here */
-                elem->es_info = NULL;
-                elem->es_info_len = 0;
-                elem->ca0 = NULL;
-                elem->PTS = STC_BASE_OVF;
-                elem->DTS = STC_BASE_OVF;
-                elem->STC = STC_OVF;
-                elem->is_pes_align = 0;
+                        /* reuse it, keep PTS, DTS, etc */
+                        zlst_delete((zhead_t *)&old0, elem);
+                        old_stream_type = elem->stream_type;
+                        if(elem->es_info) {
+                                mp_free(obj, elem->es_info);
+                        }
+                        while(NULL != (ca = (struct ts_ca *)zlst_pop((zhead_t *)&(elem->ca0)))) {
+                                mp_free(obj, ca);
+                        }
+                        elem->es_info = NULL;
+                        elem->es_info_len = 0;
+                }
+                else {
+                        elem = (struct ts_elem *)mp_malloc(obj, sizeof(struct ts_elem));
+                        if(!elem) {
+                                RPTERR("malloc elem node failed");
+                                rslt = -1;
+                                goto pmt_free_old;
+                        }
+
+                        /* init elem here */
+                        elem->es_info = NULL;
+                        elem->es_info_len = 0;
+                        elem->ca0 = NULL;
+                        elem->PTS = STC_BASE_OVF;
+                        elem->DTS = STC_BASE_OVF;
+                        elem->STC = STC_OVF;
+                        elem->is_pes_align = 0;
+                        old_stream_type = -1; /* new elem */
+                }
 
                 /* parse each parameter */
                 dat = *cur++;
@@ -2110,13 +2425,19 @@ static int ts_parse_secb_pmt(struct ts_obj *obj)
                                 err->es_info_length_error = 1;
                                 err->has_other_error++;
                                 obj->has_err++;
-                                return -1;
+                                elem->es_info_len = 0;
+                                free_elem(obj, elem);
+                                rslt = -1;
+                                goto pmt_free_old;
                         }
                         else {
-                                elem->es_info = (uint8_t *)buddy_malloc(obj->mp, (size_t)(elem->es_info_len));
+                                elem->es_info = (uint8_t *)mp_malloc(obj, (size_t)(elem->es_info_len));
                                 if(!(elem->es_info)) {
                                         RPTERR("malloc for es_info buffer failed");
-                                        return -1;
+                                        elem->es_info_len = 0;
+                                        free_elem(obj, elem);
+                                        rslt = -1;
+                                        goto pmt_free_old;
                                 }
                                 memcpy(elem->es_info, cur, (size_t)(elem->es_info_len));
                                 /* do not move cur here, es_info will be parsed */
@@ -2126,6 +2447,13 @@ static int ts_parse_secb_pmt(struct ts_obj *obj)
                 /* push elem */
                 RPTDBG("push 0x%04X in elem_list", (unsigned int)(elem->PID));
                 zlst_push((zhead_t *)&(prog->elem0), elem);
+                if(is_update && -1 == old_stream_type) {
+                        add_evt(obj, TS_EVT_ELEM_ADD, prog->program_number, elem->PID, elem->stream_type);
+                }
+                else if(is_update && old_stream_type != elem->stream_type) {
+                        elem->is_pes_align = 0;
+                        add_evt(obj, TS_EVT_ELEM_TYPE, prog->program_number, elem->PID, elem->stream_type);
+                }
 
                 /* add elementary PID */
                 memset(new_pid, 0, sizeof(struct ts_pid));
@@ -2133,7 +2461,7 @@ static int ts_parse_secb_pmt(struct ts_obj *obj)
                 new_pid->prog = prog;
                 new_pid->elem = elem;
                 new_pid->type = elem->type;
-                (void)update_pid_list(obj, new_pid); /* elementary_PID */
+                (void)add_pid(obj, new_pid); /* elementary_PID */
 
                 next = cur + elem->es_info_len;
                 while(cur < next) {
@@ -2148,7 +2476,8 @@ static int ts_parse_secb_pmt(struct ts_obj *obj)
                                 err->descriptor_error = 1;
                                 err->has_other_error++;
                                 obj->has_err++;
-                                return -1;
+                                rslt = -1;
+                                goto pmt_free_old;
                         }
                         if(0x09 == tag) { /* CA_descriptor in es_info */
                                 uint16_t CA_system_ID;
@@ -2174,13 +2503,14 @@ static int ts_parse_secb_pmt(struct ts_obj *obj)
                                 new_pid->elem = elem;
                                 new_pid->type = TS_TYPE_ECM;
                                 RPTINF("add ECM_PID(0x%04X)", (unsigned int)(CA_PID));
-                                (void)update_pid_list(obj, new_pid);
+                                (void)add_pid(obj, new_pid);
 
                                 /* ca node */
-                                ca = (struct ts_ca *)buddy_malloc(obj->mp, sizeof(struct ts_ca));
+                                ca = (struct ts_ca *)mp_malloc(obj, sizeof(struct ts_ca));
                                 if(!ca) {
                                         RPTERR("malloc ca node failed");
-                                        return -1;
+                                        rslt = -1;
+                                        goto pmt_free_old;
                                 }
 
                                 /* init ca here */
@@ -2195,7 +2525,13 @@ static int ts_parse_secb_pmt(struct ts_obj *obj)
                 }
         }
 
-        return 0;
+pmt_free_old:
+        /* elem not in new version */
+        while(NULL != (elem = (struct ts_elem *)zlst_shift((zhead_t *)&old0))) {
+                add_evt(obj, TS_EVT_ELEM_DEL, prog->program_number, elem->PID, elem->stream_type);
+                free_elem(obj, elem);
+        }
+        return rslt;
 }
 
 static int ts_parse_secb_sdt(struct ts_obj *obj)
@@ -2287,9 +2623,9 @@ static int ts_parse_secb_sdt(struct ts_obj *obj)
                                 prog->service_provider_len = (int)(*pt++);
                                 if(0 != prog->service_provider_len) {
                                         if(prog->service_provider) {
-                                                buddy_free(obj->mp, prog->service_provider);
+                                                mp_free(obj, prog->service_provider);
                                         }
-                                        prog->service_provider = (uint8_t *)buddy_malloc(obj->mp, (size_t)(1 + prog->service_provider_len));
+                                        prog->service_provider = (uint8_t *)mp_malloc(obj, (size_t)(1 + prog->service_provider_len));
                                         if(!(prog->service_provider)) {
                                                 RPTERR("malloc for service_provider buffer failed");
                                                 return -1;
@@ -2303,9 +2639,9 @@ static int ts_parse_secb_sdt(struct ts_obj *obj)
                                 prog->service_name_len = (int)(*pt++);
                                 if(0 != prog->service_name_len) {
                                         if(prog->service_name) {
-                                                buddy_free(obj->mp, prog->service_name);
+                                                mp_free(obj, prog->service_name);
                                         }
-                                        prog->service_name = (uint8_t *)buddy_malloc(obj->mp, (size_t)(1 + prog->service_name_len));
+                                        prog->service_name = (uint8_t *)mp_malloc(obj, (size_t)(1 + prog->service_name_len));
                                         if(!(prog->service_name)) {
                                                 RPTERR("malloc for service_name buffer failed");
                                                 return -1;
@@ -2366,6 +2702,7 @@ static int ts_parse_pesh(struct ts_obj *obj)
 
         /* PES head */
         if(tsh->payload_unit_start_indicator) {
+                obj->stat.pesh++;
 
                 /* PES head start */
                 dat = *(obj->cur)++;
@@ -2732,53 +3069,1088 @@ static int ts_parse_pesh_detail(struct ts_obj *obj)
         return 0;
 }
 
-static struct ts_pid *update_pid_list(struct ts_obj *obj, struct ts_pid *new_pid)
+/* PES assembler: collect PES fragments of each packet into apes_ring,
+ * PES packet in ring is described with iov, no copy until the ring wrap
+ */
+static void apes_push(struct ts_obj *obj, struct ts_pid *pid)
 {
-        struct ts_pid *pid;
-
-        pid = (struct ts_pid *)zlst_search((zhead_t *)&(obj->pid0), (int)(new_pid->PID));
-        if(pid) {
-                /* is in pid_list already, just update information */
-                pid->PID = new_pid->PID;
-                pid->prog = new_pid->prog;
-                pid->elem = new_pid->elem;
-                pid->type = new_pid->type;
-                pid->cnt = new_pid->cnt;
-                pid->lcnt = new_pid->lcnt;
-                pid->cnt_es = new_pid->cnt_es;
-                pid->lcnt_es = new_pid->lcnt_es;
-                pid->CC = new_pid->CC;
-                pid->is_CC_sync = new_pid->is_CC_sync;
+        struct ts_apes *apes;
+        struct ts_pesh *pesh;
+
+        if(!(pid->apes)) {
+                if(!(obj->apes_ring)) {
+                        obj->apes_ring = (uint8_t *)malloc(TS_APES_RING);
+                        if(!(obj->apes_ring)) {
+                                RPTERR("malloc PES ring failed");
+                                return;
+                        }
+                }
+                pid->apes = (struct ts_apes *)calloc(2, sizeof(struct ts_apes));
+                if(!(pid->apes)) {
+                        RPTERR("malloc PES assembler failed");
+                        return;
+                }
+                pid->apes_idx = 0;
         }
-        else {
-                pid = (struct ts_pid *)buddy_malloc(obj->mp, sizeof(struct ts_pid));
-                if(!pid) {
-                        RPTERR("malloc pid node failed");
-                        return NULL;
+        apes = pid->apes + pid->apes_idx;
+
+        if(obj->tsh.payload_unit_start_indicator) {
+                if(apes->size) {
+                        /* PES without PES_packet_length: end at next PES head */
+                        obj->apes[obj->has_apes++] = apes;
+                        pid->apes_idx ^= 1;
+                        apes = pid->apes + pid->apes_idx;
                 }
-                pid->pkt0 = NULL; /* wait to sync with section head */
 
-                pid->PID = new_pid->PID;
-                pid->type = new_pid->type;
-                pid->prog = new_pid->prog;
-                pid->elem = new_pid->elem;
-                pid->is_CC_sync = new_pid->is_CC_sync;
-                pid->CC = new_pid->CC;
-                pid->cnt = new_pid->cnt;
-                pid->lcnt = new_pid->lcnt;
-                pid->cnt_es = new_pid->cnt_es;
-                pid->lcnt_es = new_pid->lcnt_es;
+                /* new PES packet */
+                apes->PID = obj->PID;
+                apes->ADDR = obj->ADDR;
+                apes->STC = obj->STC;
+                memcpy(&(apes->pesh), &(obj->pesh), sizeof(struct ts_pesh));
+                apes->size = 0;
+                apes->es_offset = ((obj->ES_len) ? (size_t)(obj->ES - obj->PES) : 0);
+                apes->is_broken = 0;
+                apes->iov_cnt = 0;
+                apes->is_flat = 0;
+        }
+        else if(0 == apes->size) {
+                /* wait for PES head */
+                return;
+        }
 
-                RPTDBG("insert 0x%04X in pid_list", (unsigned int)(pid->PID));
-                if(0 != zlst_insert((zhead_t *)&(obj->pid0), pid,
-                                    (int)(pid->PID))) {
-                        free_pid(obj->mp, pid);
-                        return NULL;
+        if(obj->CC_lost) {
+                apes->is_broken = 1;
+        }
+        apes_append(obj, apes, obj->PES, (size_t)(obj->PES_len));
+
+        /* PES with PES_packet_length: end right now */
+        pesh = &(apes->pesh);
+        if(pesh->PES_packet_length &&
+           apes->size >= (size_t)(pesh->PES_packet_length) + 6) {
+                apes->is_broken |= (apes->size != (size_t)(pesh->PES_packet_length) + 6);
+                obj->apes[obj->has_apes++] = apes;
+                pid->apes_idx ^= 1;
+                if(1 == obj->has_apes) {
+                        pid->apes[pid->apes_idx].size = 0;
+                        pid->apes[pid->apes_idx].iov_cnt = 0;
+                }
+                /* else: the other one is apes[0], reset by next ts_parse_tsh() */
+        }
+        return;
+}
+
+static void apes_append(struct ts_obj *obj, struct ts_apes *apes, uint8_t *data, size_t len)
+{
+        uint8_t *dst;
+        int64_t off;
+
+        if(!(apes->is_flat)) {
+                /* keep data of one packet continuous in ring */
+                off = obj->apes_wr % TS_APES_RING;
+                if(off + (int64_t)len > TS_APES_RING) {
+                        obj->apes_wr += TS_APES_RING - off;
+                        off = 0;
+                }
+
+                /* bytes before (apes_wr + len - TS_APES_RING) will be overwritten */
+                if(obj->apes_low < obj->apes_wr + (int64_t)len - TS_APES_RING) {
+                        int64_t limit = obj->apes_wr + (int64_t)len - TS_APES_RING;
+                        struct znode *znode;
+
+                        obj->apes_low = INT64_MAX;
+                        for(znode = (struct znode *)(obj->pid0); znode; znode = znode->next) {
+                                struct ts_pid *pid_item = (struct ts_pid *)znode;
+                                int i;
+
+                                for(i = 0; pid_item->apes && i < 2; i++) {
+                                        struct ts_apes *item = pid_item->apes + i;
+
+                                        if(0 == item->size || item->is_flat) {
+                                                continue;
+                                        }
+                                        if(item->pos0 < limit) {
+                                                apes_flat(item);
+                                        }
+                                        else if(item->pos0 < obj->apes_low) {
+                                                obj->apes_low = item->pos0;
+                                        }
+                                }
+                        }
+                }
+        }
+
+        if(apes->is_flat) {
+                size_t need = apes->size + len;
+
+                if(need > apes->buf_max) {
+                        size_t max = ((apes->buf_max) ? (apes->buf_max << 1) : (TS_APES_RING >> 2));
+                        uint8_t *buf;
+
+                        while(max < need) {
+                                max <<= 1;
+                        }
+                        buf = (uint8_t *)realloc(apes->buf, max);
+                        if(!buf) {
+                                RPTERR("realloc PES buffer failed");
+                                apes->is_broken = 1;
+                                return;
+                        }
+                        apes->buf = buf;
+                        apes->buf_max = max;
+                }
+                memcpy(apes->buf + apes->size, data, len);
+                apes->size += len;
+                apes->iov[0].iov_base = apes->buf;
+                apes->iov[0].iov_len = apes->size;
+                return;
+        }
+
+        dst = obj->apes_ring + off;
+        memcpy(dst, data, len);
+        if(0 == apes->size) {
+                apes->pos0 = obj->apes_wr;
+                if(apes->pos0 < obj->apes_low) {
+                        obj->apes_low = apes->pos0;
+                }
+        }
+        obj->apes_wr += len;
+        apes->size += len;
+
+        if(apes->iov_cnt &&
+           (uint8_t *)(apes->iov[apes->iov_cnt - 1].iov_base) + apes->iov[apes->iov_cnt - 1].iov_len == dst) {
+                /* packets of this PID in series */
+                apes->iov[apes->iov_cnt - 1].iov_len += len;
+                return;
+        }
+        if(apes->iov_cnt >= apes->iov_max) {
+                int max = ((apes->iov_max) ? (apes->iov_max << 1) : 64);
+                struct ts_iov *iov;
+
+                iov = (struct ts_iov *)realloc(apes->iov, max * sizeof(struct ts_iov));
+                if(!iov) {
+                        RPTERR("realloc PES iov failed");
+                        apes->is_broken = 1;
+                        return;
+                }
+                apes->iov = iov;
+                apes->iov_max = max;
+        }
+        apes->iov[apes->iov_cnt].iov_base = dst;
+        apes->iov[apes->iov_cnt].iov_len = len;
+        apes->iov_cnt++;
+        return;
+}
+
+/* ring will wrap, copy fragments of apes into apes->buf */
+static void apes_flat(struct ts_apes *apes)
+{
+        size_t off = 0;
+        int i;
+
+        if(apes->size > apes->buf_max) {
+                size_t max = TS_APES_RING >> 2;
+                uint8_t *buf;
+
+                while(max < apes->size) {
+                        max <<= 1;
+                }
+                buf = (uint8_t *)realloc(apes->buf, max);
+                if(!buf) {
+                        RPTERR("realloc PES buffer failed");
+                        apes->is_broken = 1;
+                        apes->size = 0;
+                        apes->iov_cnt = 0;
+                        return;
+                }
+                apes->buf = buf;
+                apes->buf_max = max;
+        }
+
+        for(i = 0; i < apes->iov_cnt; i++) {
+                memcpy(apes->buf + off, apes->iov[i].iov_base, apes->iov[i].iov_len);
+                off += apes->iov[i].iov_len;
+        }
+        apes->iov[0].iov_base = apes->buf;
+        apes->iov[0].iov_len = off;
+        apes->iov_cnt = 1;
+        apes->is_flat = 1;
+        return;
+}
+
+static void apes_free(struct ts_pid *pid)
+{
+        int i;
+
+        if(!(pid->apes)) {
+                return;
+        }
+        for(i = 0; i < 2; i++) {
+                if(pid->apes[i].iov) {
+                        free(pid->apes[i].iov);
+                }
+                if(pid->apes[i].buf) {
+                        free(pid->apes[i].buf);
+                }
+        }
+        free(pid->apes);
+        pid->apes = NULL;
+        return;
+}
+
+/* STC of obj->ADDR according to prog, prog->is_STC_sync must be true
+ *
+ *      STCx - PCRb   ADDx - ADDb
+ *      ----------- = -----------
+ *      PCRb - PCRa   ADDb - ADDa
+ *
+ * packets arrive one by one, so add rate * (ADDx - last ADDx) to STCx
+ */
+static int64_t prog_stc(struct ts_obj *obj, struct ts_prog *prog)
+{
+        int64_t dADDR;
+        long double delta;
+
+        if(prog->is_rate_ok) {
+                uint64_t acc;
+
+                dADDR = obj->ADDR - prog->ADDx;
+                if(0 <= dADDR && dADDR < (1 << 16) &&
+                   obj->ADDR - prog->ADDb < ((int64_t)1 << 24)) {
+                        /* rate < 2^46 and dADDR < 2^16, no overflow; STCx < 2^38 */
+                        acc = (uint64_t)(prog->rate) * (uint64_t)dADDR + prog->STCx_frac;
+                        prog->STCx += (int64_t)(acc >> 32);
+                        prog->STCx_frac = (uint32_t)acc;
+                        prog->ADDx = obj->ADDR;
+                        return ts_timestamp_add(prog->PCRb, prog->STCx, STC_OVF);
+                }
+
+                dADDR = obj->ADDR - prog->ADDb;
+                if(0 <= dADDR && dADDR < ((int64_t)1 << 24)) {
+                        /* address jump, restart from ADDb: rate * dADDR in two parts */
+                        acc = (uint64_t)(prog->rate & 0xFFFFFFFF) * (uint64_t)dADDR;
+                        prog->STCx = (prog->rate >> 32) * dADDR + (int64_t)(acc >> 32);
+                        prog->STCx_frac = (uint32_t)acc;
+                        prog->ADDx = obj->ADDR;
+                        return ts_timestamp_add(prog->PCRb, prog->STCx, STC_OVF);
+                }
+        }
+
+        /* rare case, calc with PCRa and PCRb directly */
+        delta = (long double)ts_timestamp_diff(prog->PCRb, prog->PCRa, STC_OVF);
+        delta *= (obj->ADDR - prog->ADDb);
+        delta /= (prog->ADDb - prog->ADDa);
+        return ts_timestamp_add(prog->PCRb, (int64_t)delta, STC_OVF);
+}
+
+/* prepare rate for prog_stc(), once per PCR */
+static void prog_rate(struct ts_prog *prog)
+{
+        int64_t dPCR;
+        int64_t dADD;
+
+        prog->is_rate_ok = 0;
+        prog->ADDx = prog->ADDb;
+        prog->STCx = 0;
+        prog->STCx_frac = 0;
+        if(STC_OVF == prog->PCRa || STC_OVF == prog->PCRb) {
+                return;
+        }
+
+        dPCR = ts_timestamp_diff(prog->PCRb, prog->PCRa, STC_OVF);
+        dADD = prog->ADDb - prog->ADDa;
+        if(!(0 < dPCR && dPCR < (1 << 30)) || !(TS_PKT_SIZE <= dADD)) {
+                /* rare case, prog_stc() use long double instead */
+                return;
+        }
+
+        /* dPCR < 2^30 and dADD >= 2^7, so rate < 2^55 */
+        prog->rate = (int64_t)(((uint64_t)dPCR << 32) / (uint64_t)dADD);
+        prog->is_rate_ok = (prog->rate < ((int64_t)1 << 46));
+        return;
+}
+
+/* MGF1 of TR 101 290 Annex I: 10mHz low-pass, tau = 1 / (2 * pi * 10mHz) = 15.915s */
+#define PCRM_TAU ((int64_t)15915 * STC_MS)
+
+static void pcrm_update(struct ts_obj *obj, struct ts_prog *prog)
+{
+        struct ts_ipt *ipt = &(obj->ipt);
+        struct ts_af *af = &(obj->af);
+        struct ts_pcrm *pcrm = &(prog->pcrm);
+        int64_t AT; /* arrive time of this PCR */
+        int is_restart;
+
+        is_restart = (1 == af->discontinuity_indicator ||
+                      1 == obj->err.PCR_discontinuity_indicator_error);
+        if(is_restart) {
+                /* PCR restart, measure from this PCR again */
+                pcrm->is_sync = 0;
+        }
+
+        /* PCR_AC: PCR against STC interpolated with ADDR, as PCR_jitter without ATS */
+        if(!is_restart && prog->is_STC_sync && (STC_OVF != prog->PCRa) && (STC_OVF != prog->PCRb) &&
+           (prog->ADDb > prog->ADDa) && (obj->ADDR > prog->ADDb)) {
+                int64_t dPCR;
+                int64_t STC;
+
+                dPCR = ts_timestamp_diff(prog->PCRb, prog->PCRa, STC_OVF);
+                if(0 < dPCR && dPCR <= 100 * STC_MS) {
+                        STC = prog_stc(obj, prog);
+                        dPCR = ts_timestamp_diff(STC, prog->PCRb, STC_OVF);
+                        if(0 < dPCR && dPCR <= STC_1S) {
+                                pcrm->AC = ts_timestamp_diff(obj->PCR, STC, STC_OVF);
+                                pcrm_hist_add(&(pcrm->AC_hist), pcrm->AC);
+                        }
+                }
+        }
+
+        /* PCR_FO, PCR_DR, PCR_OJ: need arrive time */
+        if(ipt->has_ats) {
+                AT = ipt->ATS;
+        }
+        else if(ipt->has_cts) {
+                AT = ipt->CTS;
+        }
+        else {
+                return;
+        }
+
+        if(pcrm->is_sync) {
+                int64_t dAT;
+                int64_t dPCR;
+
+                dAT = ts_timestamp_diff(AT, pcrm->lAT, (ipt->has_ats ? (int64_t)ATS_OVF : STC_OVF));
+                dPCR = ts_timestamp_diff(obj->PCR, pcrm->lPCR, STC_OVF);
+                if(0 < dAT && dAT <= 100 * STC_MS) {
+                        pcrm->phase += (dPCR - dAT);
+                        if(0 == pcrm->n) {
+                                pcrm->phase_est = (double)(pcrm->phase);
+                                pcrm->FO = (double)(pcrm->phase) * STC_1S / dAT;
+                                pcrm->DR = 0.0;
+                        }
+                        else {
+                                /* alpha-beta loop on phase, growing window until MGF1 */
+                                double k = (double)(pcrm->n + 1);
+                                double K = (double)PCRM_TAU / dAT;
+                                double alpha;
+                                double beta;
+                                double lFO = pcrm->FO;
+
+                                k = ((k < K) ? k : K);
+                                k = ((k > 2.0) ? k : 2.0);
+                                alpha = 2.0 * (2.0 * k - 1.0) / (k * (k + 1.0));
+                                beta = 6.0 / (k * (k + 1.0));
+
+                                /* phase predicted with last FO, residual is OJ */
+                                pcrm->phase_est += lFO * dAT / STC_1S;
+                                pcrm->OJ = (int64_t)((double)(pcrm->phase) - pcrm->phase_est);
+                                pcrm->phase_est += alpha * (double)(pcrm->OJ);
+                                pcrm->FO += beta * (double)(pcrm->OJ) * STC_1S / dAT;
+                                if(k >= K) {
+                                        /* FO settled, 1st order IIR for DR */
+                                        double a = (double)dAT / (double)(PCRM_TAU + dAT);
+
+                                        pcrm->DR += a * ((pcrm->FO - lFO) * STC_1S / dAT - pcrm->DR);
+                                }
+                                pcrm_hist_add(&(pcrm->OJ_hist), pcrm->OJ);
+                        }
+                        pcrm->n++;
+                }
+                else {
+                        /* arrive time jump, restart filters */
+                        pcrm->n = 0;
+                        pcrm->phase = 0;
+                }
+        }
+        else {
+                pcrm->n = 0;
+                pcrm->phase = 0;
+        }
+
+        pcrm->lPCR = obj->PCR;
+        pcrm->lAT = AT;
+        pcrm->is_sync = 1;
+        return;
+}
+
+static void pcrm_hist_add(struct ts_pcrm_hist *hist, int64_t x)
+{
+        uint64_t ux = (uint64_t)((x < 0) ? -x : x);
+        int n = 0;
+
+        while(ux && n < TS_PCRM_HIST - 1) {
+                ux >>= 1;
+                n++;
+        }
+        hist->bucket[n]++;
+
+        if(0 == hist->cnt) {
+                hist->min = x;
+                hist->max = x;
+        }
+        hist->min = ((x < hist->min) ? x : hist->min);
+        hist->max = ((x > hist->max) ? x : hist->max);
+        hist->cnt++;
+        return;
+}
+
+int64_t ts_pcrm_quantile(const struct ts_pcrm_hist *hist, int permille)
+{
+        uint64_t aim;
+        uint64_t sum = 0;
+        int n;
+
+        if(!hist || 0 == hist->cnt) {
+                return 0;
+        }
+
+        aim = ((uint64_t)(hist->cnt) * permille + 999) / 1000;
+        for(n = 0; n < TS_PCRM_HIST - 1; n++) {
+                sum += hist->bucket[n];
+                if(sum >= aim) {
+                        return (((int64_t)1) << n) - 1;
+                }
+        }
+        return INT64_MAX; /* top bucket has no upper bound */
+}
+
+struct ts_tabl *ts_tabl_search(struct ts_obj *obj, uint16_t PID, uint8_t table_id,
+                               uint16_t table_id_extension, uint32_t ext2)
+{
+        struct ts_tabl *tabl;
+
+        if(!obj) {
+                RPTERR("bad obj");
+                return NULL;
+        }
+
+        if(!(obj->tabl_hash)) {
+                return NULL; /* no table store yet */
+        }
+        tabl = obj->tabl_hash[tabl_idx(PID, table_id, table_id_extension, ext2)];
+        for(; tabl; tabl = tabl->hnext) {
+                if(tabl->PID == PID &&
+                   tabl->table_id == table_id &&
+                   tabl->table_id_extension == table_id_extension &&
+                   tabl->ext2 == ext2) {
+                        return tabl;
+                }
+        }
+        return NULL;
+}
+
+int ts_eit_pf(struct ts_obj *obj, uint16_t original_network_id,
+              uint16_t transport_stream_id, uint16_t service_id,
+              struct ts_event *present, struct ts_event *following)
+{
+        struct ts_tabl *tabl;
+        struct ts_sect *sect;
+        uint32_t ext2 = ((uint32_t)transport_stream_id << 16) | original_network_id;
+        int rslt = 0;
+
+        if(!obj || !present || !following) {
+                RPTERR("bad parameter");
+                return -1;
+        }
+
+        tabl = ts_tabl_search(obj, 0x0012, 0x4E, service_id, ext2); /* actual */
+        if(!tabl) {
+                tabl = ts_tabl_search(obj, 0x0012, 0x4F, service_id, ext2); /* other */
+        }
+        if(!tabl) {
+                return 0;
+        }
+
+        /* section 0: present, section 1: following, one event at most */
+        sect = sect_search(obj, tabl, 0);
+        if(sect && 1 == eit_event(sect, 0, present)) {
+                rslt |= BIT(0);
+        }
+        sect = sect_search(obj, tabl, 1);
+        if(sect && 1 == eit_event(sect, 0, following)) {
+                rslt |= BIT(1);
+        }
+        return rslt;
+}
+
+int ts_eit_schedule(struct ts_obj *obj, uint16_t original_network_id,
+                    uint16_t transport_stream_id, uint16_t service_id,
+                    int64_t from, int64_t to, struct ts_event *evt, int max)
+{
+        uint32_t ext2 = ((uint32_t)transport_stream_id << 16) | original_network_id;
+        int table_id;
+        int cnt = 0;
+
+        if(!obj || !evt || max <= 0) {
+                RPTERR("bad parameter");
+                return -1;
+        }
+
+        /* 0x50~0x5F: actual, 0x60~0x6F: other */
+        for(table_id = 0x50; table_id <= 0x6F; table_id++) {
+                struct ts_tabl *tabl;
+                struct znode *znode;
+
+                tabl = ts_tabl_search(obj, 0x0012, (uint8_t)table_id, service_id, ext2);
+                if(!tabl) {
+                        continue;
+                }
+                for(znode = (struct znode *)(tabl->sect0); znode; znode = znode->next) {
+                        struct ts_sect *sect = (struct ts_sect *)znode;
+                        struct ts_event e;
+                        int idx;
+
+                        for(idx = 0; 1 == eit_event(sect, idx, &e); idx++) {
+                                int late;
+                                int k;
+
+                                if(e.start_time < 0 ||
+                                   e.start_time >= to ||
+                                   e.start_time + e.duration <= from) {
+                                        continue;
+                                }
+                                if(cnt < max) {
+                                        evt[cnt++] = e;
+                                        continue;
+                                }
+
+                                /* evt[] is full, keep the earliest: replace the latest one */
+                                for(late = 0, k = 1; k < max; k++) {
+                                        if(eit_cmp(evt + k, evt + late) > 0) {
+                                                late = k;
+                                        }
+                                }
+                                if(eit_cmp(&e, evt + late) < 0) {
+                                        evt[late] = e;
+                                }
+                        }
+                }
+        }
+
+        qsort(evt, (size_t)cnt, sizeof(struct ts_event), eit_cmp);
+        return cnt;
+}
+
+static size_t tabl_idx(uint16_t PID, uint8_t table_id, uint16_t table_id_extension, uint32_t ext2)
+{
+        uint32_t h;
+
+        h  = ((uint32_t)PID << 8 | table_id) * 0x9E3779B1U;
+        h ^= (table_id_extension ^ ext2 ^ (ext2 >> 16)) * 0x85EBCA6BU;
+        h ^= h >> 16;
+        return (size_t)(h & (TS_TABL_HASH - 1));
+}
+
+/* keep tabl0 sorted by (table_id, table_id_extension), after the ones with the same key;
+ * the place is found from tabl_tail[table_id], or the sub-table of a smaller
+ * table_id_extension in tabl_hash, not by a walk from tabl0
+ */
+static void tabl_insert(struct ts_obj *obj, struct ts_tabl *tabl)
+{
+        struct znode *znode = (struct znode *)tabl;
+        struct znode *prev = NULL; /* insert after it, NULL for head */
+        struct znode *x;
+        int t;
+
+        zlst_set_key(tabl, ((int)(tabl->table_id) << 16) | tabl->table_id_extension);
+        x = (struct znode *)(obj->tabl_tail[tabl->table_id]);
+        if(!x) {
+                /* first of this table_id, after the tail of a smaller one */
+                for(t = (int)(tabl->table_id) - 1; t >= 0 && !prev; t--) {
+                        prev = (struct znode *)(obj->tabl_tail[t]);
+                }
+        }
+        else if(x->key <= znode->key) {
+                prev = x; /* in order, as sub-tables come cyclically */
+        }
+        else {
+                for(t = 1; t <= TS_TABL_PROBE && t <= (int)(tabl->table_id_extension) && !prev; t++) {
+                        prev = (struct znode *)ts_tabl_search(obj, tabl->PID, tabl->table_id,
+                                                              (uint16_t)(tabl->table_id_extension - t),
+                                                              tabl->ext2);
+                }
+                if(prev) {
+                        while(prev->next && prev->next->key <= znode->key) {
+                                prev = prev->next;
+                        }
+                }
+                else {
+                        for(prev = x; prev && prev->key > znode->key; prev = prev->prev) {
+                        }
+                }
+        }
+
+        if(!prev) {
+                zlst_unshift((zhead_t *)&(obj->tabl0), tabl);
+        }
+        else if(!(prev->next)) {
+                zlst_push((zhead_t *)&(obj->tabl0), tabl);
+        }
+        else {
+                znode->next = prev->next;
+                znode->prev = prev;
+                prev->next->prev = znode;
+                prev->next = znode;
+        }
+        if(!(znode->next) || ((struct ts_tabl *)(znode->next))->table_id != tabl->table_id) {
+                obj->tabl_tail[tabl->table_id] = tabl;
+        }
+        return;
+}
+
+/* hash of table store, allocated for the first sub-table, as a TS without SI needs none */
+static int store_hash(struct ts_obj *obj)
+{
+        if(obj->tabl_hash) {
+                return 0;
+        }
+        obj->tabl_hash = (struct ts_tabl **)calloc(TS_TABL_HASH, sizeof(struct ts_tabl *));
+        obj->sect_hash = (struct ts_sect **)calloc(TS_SECT_HASH, sizeof(struct ts_sect *));
+        if(!(obj->tabl_hash) || !(obj->sect_hash)) {
+                RPTERR("malloc hash of table store failed");
+                free(obj->tabl_hash);
+                free(obj->sect_hash);
+                obj->tabl_hash = NULL;
+                obj->sect_hash = NULL;
+                return -1;
+        }
+        return 0;
+}
+
+static void tabl_hash_add(struct ts_obj *obj, struct ts_tabl *tabl)
+{
+        size_t idx = tabl_idx(tabl->PID, tabl->table_id, tabl->table_id_extension, tabl->ext2);
+
+        tabl->hnext = obj->tabl_hash[idx];
+        obj->tabl_hash[idx] = tabl;
+        return;
+}
+
+/* PID of table_id, for table without PID */
+static uint16_t tabl_pid(uint8_t table_id)
+{
+        if(0x01 == table_id) {
+                return 0x0001; /* CAT */
+        }
+        if(0x02 == table_id) {
+                return 0x0000; /* PMT, not in table store */
+        }
+        if(0x03 == table_id) {
+                return 0x0002; /* TSDT */
+        }
+        if(0x40 == table_id || 0x41 == table_id) {
+                return 0x0010; /* NIT */
+        }
+        if(0x42 == table_id || 0x46 == table_id || 0x4A == table_id) {
+                return 0x0011; /* SDT, BAT */
+        }
+        if(0x4E <= table_id && table_id <= 0x6F) {
+                return 0x0012; /* EIT */
+        }
+        if(0x70 <= table_id && table_id <= 0x73) {
+                return 0x0014; /* TDT, TOT */
+        }
+        return 0x0000;
+}
+
+static size_t sect_idx(struct ts_tabl *tabl, uint8_t section_number)
+{
+        uint32_t h;
+
+        h  = (uint32_t)((uintptr_t)tabl >> 4) * 0x9E3779B1U;
+        h ^= section_number * 0x85EBCA6BU;
+        h ^= h >> 16;
+        return (size_t)(h & (TS_SECT_HASH - 1));
+}
+
+static struct ts_sect *sect_search(struct ts_obj *obj, struct ts_tabl *tabl, uint8_t section_number)
+{
+        struct ts_sect *sect;
+
+        for(sect = obj->sect_hash[sect_idx(tabl, section_number)]; sect; sect = sect->hnext) {
+                if(sect->tabl == tabl && sect->section_number == section_number) {
+                        return sect;
+                }
+        }
+        return NULL;
+}
+
+static void sect_hash_add(struct ts_obj *obj, struct ts_tabl *tabl, struct ts_sect *sect)
+{
+        size_t idx = sect_idx(tabl, sect->section_number);
+
+        sect->tabl = tabl;
+        sect->hnext = obj->sect_hash[idx];
+        obj->sect_hash[idx] = sect;
+        return;
+}
+
+static void sect_hash_del(struct ts_obj *obj, struct ts_sect *sect)
+{
+        struct ts_sect **pp;
+
+        if(!(sect->tabl)) {
+                return;
+        }
+        for(pp = &(obj->sect_hash[sect_idx(sect->tabl, sect->section_number)]); *pp; pp = &((*pp)->hnext)) {
+                if(*pp == sect) {
+                        *pp = sect->hnext;
+                        break;
+                }
+        }
+        sect->tabl = NULL;
+        sect->hnext = NULL;
+        return;
+}
+
+/* event idx of EIT section, return 1 if got it, 0 if no such event */
+static int eit_event(struct ts_sect *sect, int idx, struct ts_event *evt)
+{
+        uint8_t *p = sect->section;
+        uint8_t *end = sect->section + 3 + sect->section_length - 4; /* CRC_32 */
+        int desc_len;
+
+        if(sect->section_length < 15) {
+                return 0; /* head only */
+        }
+        evt->table_id = sect->table_id;
+        evt->section_number = sect->section_number;
+        evt->service_id = sect->table_id_extension;
+        evt->transport_stream_id = (p[8] << 8) | p[9];
+        evt->original_network_id = (p[10] << 8) | p[11];
+
+        p += 14; /* first event */
+        while(1) {
+                if(p + 12 > end) {
+                        return 0;
+                }
+                desc_len = ((p[10] & 0x0F) << 8) | p[11];
+                if(p + 12 + desc_len > end) {
+                        return 0; /* bad descriptors_loop_length */
+                }
+                if(0 == idx) {
+                        break;
+                }
+                p += 12 + desc_len;
+                idx--;
+        }
+
+        evt->event_id = (p[0] << 8) | p[1];
+        if(0xFF == p[2] && 0xFF == p[3] && 0xFF == p[4] && 0xFF == p[5] && 0xFF == p[6]) {
+                evt->start_time = -1; /* undefined, e.g. NVOD reference event */
+        }
+        else {
+                int mjd = (p[2] << 8) | p[3];
+
+                evt->start_time = (int64_t)(mjd - 40587) * 86400 +
+                                  ((p[4] >> 4) * 10 + (p[4] & 0x0F)) * 3600 +
+                                  ((p[5] >> 4) * 10 + (p[5] & 0x0F)) * 60 +
+                                  ((p[6] >> 4) * 10 + (p[6] & 0x0F));
+        }
+        evt->duration = ((p[7] >> 4) * 10 + (p[7] & 0x0F)) * 3600 +
+                        ((p[8] >> 4) * 10 + (p[8] & 0x0F)) * 60 +
+                        ((p[9] >> 4) * 10 + (p[9] & 0x0F));
+        evt->running_status = p[10] >> 5;
+        evt->free_CA_mode = (p[10] >> 4) & 0x01;
+        evt->desc_len = desc_len;
+        evt->desc = p + 12;
+        return 1;
+}
+
+static int eit_cmp(const void *a, const void *b)
+{
+        int64_t ta = ((const struct ts_event *)a)->start_time;
+        int64_t tb = ((const struct ts_event *)b)->start_time;
+
+        return (ta > tb) - (ta < tb);
+}
+
+static struct ts_pid *update_pid_list(struct ts_obj *obj, struct ts_pid *new_pid)
+{
+        struct ts_pid *pid;
+
+        pid = (struct ts_pid *)zlst_search((zhead_t *)&(obj->pid0), (int)(new_pid->PID));
+        if(pid) {
+                /* is in pid_list already, just update information */
+                pid->PID = new_pid->PID;
+                pid->prog = new_pid->prog;
+                pid->elem = new_pid->elem;
+                pid->type = new_pid->type;
+                pid->cnt = new_pid->cnt;
+                pid->lcnt = new_pid->lcnt;
+                pid->cnt_es = new_pid->cnt_es;
+                pid->lcnt_es = new_pid->lcnt_es;
+                pid->CC = new_pid->CC;
+                pid->is_CC_sync = new_pid->is_CC_sync;
+        }
+        else {
+                pid = (struct ts_pid *)mp_malloc(obj, sizeof(struct ts_pid));
+                if(!pid) {
+                        RPTERR("malloc pid node failed");
+                        return NULL;
+                }
+                pid->pkt0 = NULL; /* wait to sync with section head */
+                pid->apes = NULL; /* PES assembler start when needed */
+                pid->apes_idx = 0;
+
+                pid->PID = new_pid->PID;
+                pid->type = new_pid->type;
+                pid->prog = new_pid->prog;
+                pid->elem = new_pid->elem;
+                pid->is_CC_sync = new_pid->is_CC_sync;
+                pid->CC = new_pid->CC;
+                pid->cnt = new_pid->cnt;
+                pid->lcnt = new_pid->lcnt;
+                pid->cnt_es = new_pid->cnt_es;
+                pid->lcnt_es = new_pid->lcnt_es;
+
+                RPTDBG("insert 0x%04X in pid_list", (unsigned int)(pid->PID));
+                if(0 != zlst_insert((zhead_t *)&(obj->pid0), pid,
+                                    (int)(pid->PID))) {
+                        free_pid(obj, pid);
+                        return NULL;
                 }
         }
         return pid;
 }
 
+/* as update_pid_list(), but keep statistic and CC of the PID in pid_list */
+static struct ts_pid *link_pid_list(struct ts_obj *obj, struct ts_pid *new_pid)
+{
+        struct ts_pid *pid;
+
+        pid = (struct ts_pid *)zlst_search((zhead_t *)&(obj->pid0), (int)(new_pid->PID));
+        if(!pid) {
+                return update_pid_list(obj, new_pid);
+        }
+        pid->type = new_pid->type;
+        pid->prog = new_pid->prog;
+        pid->elem = new_pid->elem;
+        return pid;
+}
+
+/* PID left its program: keep the node and its statistic, as a PID not in PSI */
+static void unlink_pid(struct ts_obj *obj, struct ts_pid *pid)
+{
+        struct ts_pkt *pkt;
+
+        RPTDBG("unlink 0x%04X", (unsigned int)(pid->PID));
+        pid->type = pid_type(pid->PID);
+        pid->prog = NULL;
+        pid->elem = NULL;
+
+        /* section of old PMT */
+        while(NULL != (pkt = (struct ts_pkt *)zlst_pop((zhead_t *)&(pid->pkt0)))) {
+                mp_free(obj, pkt);
+        }
+        return;
+}
+
+static struct ts_prog *new_prog(struct ts_obj *obj, uint16_t program_number, uint16_t PMT_PID)
+{
+        struct ts_prog *prog;
+
+        prog = (struct ts_prog *)mp_malloc(obj, sizeof(struct ts_prog));
+        if(!prog) {
+                RPTERR("malloc prog node failed");
+                return NULL;
+        }
+
+        prog->program_number = program_number;
+        prog->PMT_PID = PMT_PID;
+        prog->PCR_PID = 0x1FFF; /* wait PMT */
+
+        /* program info */
+        prog->program_info_len = 0;
+        prog->program_info = NULL;
+        prog->ca0 = NULL;
+
+        /* SDT info */
+        prog->service_name_len = 0;
+        prog->service_name = NULL;
+        prog->service_provider_len = 0;
+        prog->service_provider = NULL;
+
+        /* elementary stream list */
+        prog->elem0 = NULL;
+
+        /* PMT table */
+        prog->is_parsed = 0;
+        prog->tabl.sect0 = NULL;
+        prog->tabl.PID = PMT_PID;
+        prog->tabl.table_id = 0x02;
+        prog->tabl.table_id_extension = program_number;
+        prog->tabl.ext2 = 0;
+        prog->tabl.hnext = NULL;
+        prog->tabl.version_number = 0xFF; /* never reached version */
+        prog->tabl.last_section_number = 0; /* no use */
+        prog->tabl.STC = STC_OVF;
+
+        /* for STC calc */
+        prog->ADDa = 0;
+        prog->PCRa = STC_OVF;
+        prog->ADDb = 0;
+        prog->PCRb = STC_OVF;
+        prog->is_STC_sync = 0;
+        prog->is_rate_ok = 0;
+
+        /* for PCR metrics */
+        memset(&(prog->pcrm), 0, sizeof(struct ts_pcrm));
+        return prog;
+}
+
+/* new PAT section: diff prog_list with all PAT sections in table store */
+static int pat_update(struct ts_obj *obj)
+{
+        struct ts_sect *sect = obj->sect;
+        struct ts_tabl *tabl;
+        struct znode *znode;
+        struct znode *next;
+        struct ts_pid ts_new_pid, *new_pid = &ts_new_pid;
+
+        tabl = ts_tabl_search(obj, 0x0000, 0x00, 0x0000, 0);
+        if(!tabl) {
+                return -1;
+        }
+
+        obj->transport_stream_id = sect->table_id_extension;
+        add_evt(obj, TS_EVT_PAT, 0, 0x0000, 0);
+
+        /* new program or new PMT_PID */
+        for(znode = (struct znode *)(tabl->sect0); znode; znode = znode->next) {
+                struct ts_sect *sect_item = (struct ts_sect *)znode;
+                uint8_t *cur = sect_item->section + 8;
+                uint8_t *crc = sect_item->section + 3 + sect_item->section_length - 4;
+
+                for(; cur < crc; cur += 4) {
+                        uint16_t program_number = (cur[0] << 8) | cur[1];
+                        uint16_t PMT_PID = ((cur[2] & 0x1F) << 8) | cur[3];
+                        struct ts_prog *prog;
+
+                        memset(new_pid, 0, sizeof(struct ts_pid));
+                        new_pid->PID = PMT_PID;
+                        if(0 == program_number) {
+                                new_pid->type = TS_TYPE_NIT;
+                                new_pid->prog = obj->prog0;
+                                (void)link_pid_list(obj, new_pid);
+                                continue;
+                        }
+
+                        prog = (struct ts_prog *)zlst_search((zhead_t *)&(obj->prog0), (int)program_number);
+                        if(!prog) {
+                                prog = new_prog(obj, program_number, PMT_PID);
+                                if(!prog) {
+                                        return -1;
+                                }
+                                RPTDBG("insert 0x%04X in prog_list", (unsigned int)program_number);
+                                if(0 != zlst_insert((zhead_t *)&(obj->prog0), prog, (int)program_number)) {
+                                        free_prog(obj, prog);
+                                        return -1;
+                                }
+                                add_evt(obj, TS_EVT_PROG_ADD, program_number, PMT_PID, 0);
+                        }
+                        else if(prog->PMT_PID != PMT_PID) {
+                                struct ts_pid *pid;
+                                struct ts_sect *sect_node;
+
+                                pid = (struct ts_pid *)zlst_search((zhead_t *)&(obj->pid0), (int)(prog->PMT_PID));
+                                if(pid && pid->prog == prog) {
+                                        unlink_pid(obj, pid);
+                                }
+
+                                /* wait PMT on new PID, elem_list is kept to diff with it */
+                                prog->PMT_PID = PMT_PID;
+                                prog->tabl.PID = PMT_PID;
+                                prog->tabl.version_number = 0xFF;
+                                prog->tabl.STC = STC_OVF;
+                                while(NULL != (sect_node = (struct ts_sect *)zlst_pop((zhead_t *)&(prog->tabl.sect0)))) {
+                                        free_sect(obj, sect_node);
+                                }
+                                add_evt(obj, TS_EVT_PMT_PID, program_number, PMT_PID, 0);
+                        }
+                        else {
+                                continue; /* nothing changed */
+                        }
+                        new_pid->type = TS_TYPE_PMT;
+                        new_pid->prog = prog;
+                        (void)link_pid_list(obj, new_pid);
+                }
+        }
+
+        /* program not in PAT any more */
+        for(znode = (struct znode *)(obj->prog0); znode; znode = next) {
+                struct ts_prog *prog = (struct ts_prog *)znode;
+                struct znode *znode_pid;
+
+                next = znode->next;
+                if(pat_has_prog(tabl, prog->program_number)) {
+                        continue;
+                }
+
+                add_evt(obj, TS_EVT_PROG_DEL, prog->program_number, prog->PMT_PID, 0);
+                for(znode_pid = (struct znode *)(obj->pid0); znode_pid; znode_pid = znode_pid->next) {
+                        struct ts_pid *pid = (struct ts_pid *)znode_pid;
+
+                        if(pid->prog == prog && pid->PID >= 0x0020 && pid->PID != 0x1FFF) {
+                                unlink_pid(obj, pid);
+                        }
+                }
+                zlst_delete((zhead_t *)&(obj->prog0), prog);
+                free_prog(obj, prog);
+        }
+
+        /* PID below 0x0020 and 0x1FFF use prog0, which may be changed */
+        for(znode = (struct znode *)(obj->pid0); znode; znode = znode->next) {
+                struct ts_pid *pid = (struct ts_pid *)znode;
+
+                if(pid->PID < 0x0020 || pid->PID == 0x1FFF) {
+                        pid->prog = obj->prog0;
+                }
+        }
+
+        /* wait PMT of new program */
+        obj->is_pat_pmt_parsed = is_all_prog_parsed(obj);
+        return 0;
+}
+
+static int pat_has_prog(struct ts_tabl *tabl, uint16_t program_number)
+{
+        struct znode *znode;
+
+        for(znode = (struct znode *)(tabl->sect0); znode; znode = znode->next) {
+                struct ts_sect *sect = (struct ts_sect *)znode;
+                uint8_t *cur = sect->section + 8;
+                uint8_t *crc = sect->section + 3 + sect->section_length - 4;
+
+                for(; cur < crc; cur += 4) {
+                        if(program_number == ((cur[0] << 8) | cur[1])) {
+                                return 1;
+                        }
+                }
+        }
+        return 0;
+}
+
+static void add_evt(struct ts_obj *obj, int type, uint16_t program_number, uint16_t PID, uint8_t stream_type)
+{
+        struct ts_evt *evt;
+
+        if(obj->evt_cnt >= TS_EVT_BUF) {
+                obj->evt_lost++;
+                return;
+        }
+        evt = obj->evt + obj->evt_cnt;
+        obj->evt_cnt++;
+        obj->has_evt = 1;
+
+        evt->type = type;
+        evt->program_number = program_number;
+        evt->PID = PID;
+        evt->version_number = obj->sect->version_number;
+        evt->stream_type = stream_type;
+        return;
+}
+
 static int is_all_prog_parsed(struct ts_obj *obj)
 {
         struct znode *znode_p; /* znode of program list */
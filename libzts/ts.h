@@ -294,18 +294,53 @@ struct ts_sect {
 
         int check_CRC; /* bool, some table do not need to check CRC_32 */
         int type; /* TS_TYPE_xxx */
+        int skip_cnt; /* CRC skipped since last check of this section */
+
+        /*@temp@*/
+        struct ts_tabl *tabl; /* sub-table in table store, NULL for PMT */
+        /*@temp@*/
+        struct ts_sect *hnext; /* next in bucket of obj->sect_hash */
 };
 
-/* node of PSI/SI table list */
+/* node of PSI/SI table list, one node for each sub-table:
+ *      key: PID, table_id, table_id_extension, ext2
+ *      ext2: EIT: transport_stream_id << 16 | original_network_id
+ *            SDT: original_network_id
+ *            others: 0
+ *      PAT and CAT use 0 as table_id_extension, one table for one TS
+ */
 struct ts_tabl {
-        struct znode cvfl; /* common variable for list */
+        struct znode cvfl; /* common variable for list, key is table_id << 16 | table_id_extension */
 
         /*@temp@*/
         struct ts_sect *sect0; /* section list of this table */
+        uint16_t PID;
         uint8_t table_id; /* 0x00~0xFF */
+        uint16_t table_id_extension;
+        uint32_t ext2;
         uint8_t version_number;
         uint8_t last_section_number;
         int64_t STC; /* for pid->sect_interval */
+
+        /*@temp@*/
+        struct ts_tabl *hnext; /* next in bucket of obj->tabl_hash */
+};
+
+/* event of EIT, see ts_eit_pf() and ts_eit_schedule() */
+struct ts_event {
+        uint16_t original_network_id;
+        uint16_t transport_stream_id;
+        uint16_t service_id;
+        uint16_t event_id;
+        uint8_t table_id;
+        uint8_t section_number;
+        int64_t start_time; /* UTC, second from 1970-01-01 00:00:00, -1 if undefined */
+        int duration; /* second */
+        uint8_t running_status; /* 3-bit */
+        uint8_t free_CA_mode; /* 1-bit */
+        int desc_len;
+        /*@temp@*/
+        uint8_t *desc; /* descriptors in section, valid until the section is freed */
 };
 
 /* node of elementary list */
@@ -328,6 +363,36 @@ struct ts_elem {
         int is_pes_align; /* met first PES head */
 };
 
+/* log2 histogram of PCR metrics, bucket[0]: 0, bucket[n]: [2^(n-1), 2^n) clk */
+#define TS_PCRM_HIST (24) /* bucket[23] holds all |x| >= 2^22 clk(155ms) */
+struct ts_pcrm_hist {
+        uint32_t bucket[TS_PCRM_HIST];
+        uint32_t cnt; /* sample count */
+        int64_t min; /* clk */
+        int64_t max; /* clk */
+};
+
+/* PCR metrics of TR 101 290 Annex I, updated once per PCR of this program
+ * FO, DR and OJ need arrive time of packet(ATS or CTS input), AC need ADDR
+ */
+struct ts_pcrm {
+        /* PCR_FO, PCR_DR, PCR_OJ: PCR against arrive time */
+        int is_sync; /* lPCR and lAT are OK */
+        int n; /* PCR measured since last sync */
+        int64_t lPCR; /* last PCR value */
+        int64_t lAT; /* arrive time of last PCR, ATS or CTS */
+        int64_t phase; /* sum of (dPCR - dAT) since last sync, clk */
+        double phase_est; /* phase tracked by alpha-beta loop, clk */
+        double FO; /* PCR_FO: frequency offset, Hz */
+        double DR; /* PCR_DR: drift rate, Hz/s */
+        int64_t OJ; /* PCR_OJ: overall jitter, clk */
+        struct ts_pcrm_hist OJ_hist;
+
+        /* PCR_AC: PCR against value interpolated with ADDR */
+        int64_t AC; /* PCR_AC: accuracy, clk */
+        struct ts_pcrm_hist AC_hist;
+};
+
 /* node of program list */
 struct ts_prog {
         struct znode cvfl; /* common variable for list */
@@ -360,6 +425,49 @@ struct ts_prog {
         int64_t ADDb; /* PCR packet b: packet address */
         int64_t PCRb; /* PCR packet b: PCR value */
         int is_STC_sync; /* true: PCRa and PCRb OK, STC can be calc */
+        int is_rate_ok; /* true: rate OK, STC can be calc incrementally */
+        int64_t rate; /* (PCRb - PCRa) / (ADDb - ADDa), clk per byte, Q32 fixed-point */
+        int64_t ADDx; /* address of last packet with STC calc */
+        int64_t STCx; /* STC of ADDx minus PCRb, clk */
+        uint32_t STCx_frac; /* fraction part of STCx, Q32 fixed-point */
+
+        /* for PCR metrics */
+        struct ts_pcrm pcrm;
+};
+
+/* scatter-gather fragment, the same layout as "struct iovec" */
+struct ts_iov {
+        void *iov_base;
+        size_t iov_len;
+};
+
+/* hash of PSI/SI table store */
+#define TS_TABL_HASH (1 << 12)
+#define TS_TABL_PROBE (16) /* table_id_extension searched below a new one for its place */
+#define TS_SECT_HASH (1 << 16)
+
+/* PES packet from PES assembler, see TS_APES */
+#define TS_APES_RING (1 << 20) /* byte ring of PES assembler */
+struct ts_apes {
+        uint16_t PID;
+        int64_t ADDR; /* address of the packet with PES head */
+        int64_t STC; /* STC of the packet with PES head */
+        struct ts_pesh pesh; /* PES head, PTS and DTS according to pesh.PTS_DTS_flags */
+        size_t size; /* PES packet size, PES head included */
+        size_t es_offset; /* ES data start in PES packet, 0 if unknown */
+        int is_broken; /* CC lost or PES_packet_length mismatch */
+
+        /* PES data: fragments in ring, or one fragment in buf after ring wrap */
+        int iov_cnt;
+        /*@temp@*/
+        struct ts_iov *iov;
+
+        /* for assembler only */
+        int iov_max;
+        int is_flat; /* data copied into buf */
+        int64_t pos0; /* ring position of first byte */
+        uint8_t *buf;
+        size_t buf_max;
 };
 
 /* node of packet list, for ts2sect() or sect2ts() */
@@ -396,6 +504,10 @@ struct ts_pid {
         uint32_t cnt_es_from_pesh; /* es byte received from last PES head */
         uint32_t cnt_es_of_last_pes; /* es byte received of last PES */
 
+        /* PES assembler: apes[apes_idx] is assembling, NULL if not used */
+        struct ts_apes *apes;
+        int apes_idx;
+
         /* only for PID with PSI/SI */
         /*@temp@*/
         struct ts_pkt *pkt0; /* packets of a section */
@@ -433,6 +545,63 @@ struct ts_cfg {
         int need_pes;  /* not 0: parse PES head(PTS, DTS) */
         int need_pes_align; /* not 0: ignore data before first PES head */
         int need_statistic; /* not 0: need statistic information */
+        int need_timing; /* not 0: count clock of each stage into ts_stat */
+        int need_psi_update; /* not 0: apply new PAT/PMT in place and report in evt[] */
+
+        /* section same as the stored one skips CRC, but check it once
+         * every crc_period times, 0: TS_CRC_PERIOD, 1: check every time
+         */
+        int crc_period;
+};
+
+#define TS_CRC_PERIOD   (64) /* default of ts_cfg.crc_period */
+
+/* PSI change applied in place, see ts_cfg.need_psi_update */
+#define TS_EVT_PAT       (0) /* new PAT */
+#define TS_EVT_PMT       (1) /* new PMT of program_number */
+#define TS_EVT_PROG_ADD  (2) /* PID: PMT_PID */
+#define TS_EVT_PROG_DEL  (3) /* PID: PMT_PID */
+#define TS_EVT_PMT_PID   (4) /* PID: new PMT_PID */
+#define TS_EVT_PCR_PID   (5) /* PID: new PCR_PID */
+#define TS_EVT_ELEM_ADD  (6) /* PID: elementary_PID */
+#define TS_EVT_ELEM_DEL  (7) /* PID: elementary_PID */
+#define TS_EVT_ELEM_TYPE (8) /* PID: elementary_PID, stream_type changed */
+#define TS_EVT_BUF       (256) /* max event of one packet */
+struct ts_evt {
+        int type; /* TS_EVT_xxx */
+        uint16_t program_number; /* 0 for TS_EVT_PAT */
+        uint16_t PID;
+        uint8_t version_number; /* of the new PAT or PMT */
+        uint8_t stream_type; /* new stream_type, for TS_EVT_ELEM_xxx */
+};
+
+/* stage of ts_stat.clk[], each one includes the stages called by it */
+#define TS_STAGE_TSH    (0) /* ts_parse_tsh() */
+#define TS_STAGE_AF     (1) /* adaption field */
+#define TS_STAGE_SECT   (2) /* packet to section */
+#define TS_STAGE_SECP   (3) /* section parse, CRC included */
+#define TS_STAGE_PESH   (4) /* PES head */
+#define TS_STAGE_MAX    (5)
+
+/* hot-path counters of one object, see TS_STAT */
+struct ts_stat {
+        int64_t pkt; /* packet parsed */
+        int64_t byte; /* byte parsed */
+        int64_t sect; /* section assembled */
+        int64_t sect_byte; /* byte of section assembled */
+        int64_t sect_dup; /* section dropped: has the same one already */
+        int64_t sect_drop; /* section dropped: bad head, CRC, no memory, etc */
+        int64_t crc; /* CRC computation */
+        int64_t crc_byte; /* byte of CRC computation */
+        int64_t crc_skip; /* CRC skipped: same as the stored section */
+        int64_t alloc; /* buddy_malloc() */
+        int64_t free; /* buddy_free() */
+        int64_t pesh; /* PES head parsed */
+
+        /* only when cfg.need_timing, unit: CPU cycle or ns, see clk_unit */
+        uint64_t clk[TS_STAGE_MAX];
+        int64_t clk_cnt[TS_STAGE_MAX];
+        const char *clk_unit; /* "cycle" or "ns" */
 };
 
 /* object about one transfer stream */
@@ -526,6 +695,9 @@ struct ts_obj {
         /*@temp@*/
         struct ts_tabl *tabl0; /* PSI/SI table except PMT */
         struct ts_ca *ca0; /* CAT: CA descriptor list of this stream */
+        struct ts_tabl **tabl_hash; /* TS_TABL_HASH buckets, sub-table of tabl0, NULL before the first */
+        struct ts_tabl *tabl_tail[256]; /* last sub-table of each table_id in tabl0 */
+        struct ts_sect **sect_hash; /* TS_SECT_HASH buckets, section of tabl0, with tabl_hash */
 
         /* for bit-rate statistic */
         int64_t aim_interval; /* appointed interval */
@@ -542,6 +714,21 @@ struct ts_obj {
 
         int has_ess; /* es size of last PES packet ready */
 
+        /* PES assembler */
+        int has_apes; /* count of new PES packet ready in apes[], 0 ~ 2 */
+        /*@temp@*/
+        struct ts_apes *apes[2]; /* in stream order, valid until next ts_parse_tsh() */
+        uint8_t apes_map[0x2000 / 8]; /* bit map of PID with PES assembler */
+        uint8_t *apes_ring; /* TS_APES_RING bytes, malloc when first used */
+        int64_t apes_wr; /* write position of apes_ring, never wrap */
+        int64_t apes_low; /* min pos0 of PES in apes_ring, maybe too small */
+
+        /* PSI change, only when cfg.need_psi_update */
+        int has_evt; /* new event ready, valid until next ts_parse_tsh() */
+        int evt_cnt;
+        int64_t evt_lost; /* event dropped because evt[] is full */
+        struct ts_evt evt[TS_EVT_BUF];
+
         /* for CAT_error */
         int has_scrambling; /* meet PID with scrambling */
         int has_CAT; /* meet CAT */
@@ -550,6 +737,9 @@ struct ts_obj {
         int has_err; /* check err struct for detail information */
         struct ts_err err;
 
+        /* hot-path counters */
+        struct ts_stat stat;
+
         /* special variables for ts object */
         int state;
         /*@temp@*/
@@ -571,6 +761,8 @@ int ts_destroy(/*@only@*/ /*@null@*/ struct ts_obj *obj);
 #define TS_INIT         (0) /* init object for new application */
 #define TS_SCFG         (1) /* set ts_cfg to object */
 #define TS_TIDY         (2) /* tidy wild pointer in object */
+#define TS_APES         (3) /* PES assembler for PID *(int *)arg, 0x2000 for any PID, need cfg.need_pes */
+#define TS_STAT         (4) /* copy hot-path counters into *(struct ts_stat *)arg */
 int ts_ioctl(struct ts_obj *obj, int cmd, void *arg);
 
 int ts_parse_tsh(struct ts_obj *obj);
@@ -578,6 +770,28 @@ int ts_parse_tsb(struct ts_obj *obj);
 
 uint32_t ts_crc(void *buf, size_t size, int mode);
 
+/* return: upper bound(clk) of the bucket where permille of samples fall in,
+ *         INT64_MAX if it is the top bucket, 0 if no sample
+ */
+int64_t ts_pcrm_quantile(const struct ts_pcrm_hist *hist, int permille);
+
+/* PSI/SI table store, return NULL if no such sub-table, see struct ts_tabl for key */
+/*@null@*/ /*@dependent@*/
+struct ts_tabl *ts_tabl_search(struct ts_obj *obj, uint16_t PID, uint8_t table_id,
+                               uint16_t table_id_extension, uint32_t ext2);
+
+/* EIT database over the table store, EIT actual first, then EIT other:
+ *      ts_eit_pf(): return BIT(0) if got present, BIT(1) if got following, -1 if bad parameter
+ *      ts_eit_schedule(): return count of event overlap [from, to) in evt[max], by start_time,
+ *                         the earliest max ones if there are more
+ */
+int ts_eit_pf(struct ts_obj *obj, uint16_t original_network_id,
+              uint16_t transport_stream_id, uint16_t service_id,
+              struct ts_event *present, struct ts_event *following);
+int ts_eit_schedule(struct ts_obj *obj, uint16_t original_network_id,
+                    uint16_t transport_stream_id, uint16_t service_id,
+                    int64_t from, int64_t to, struct ts_event *evt, int max);
+
 /* calculate timestamp:
  *      t0: [0, ovf);
  *      t1: [0, ovf);
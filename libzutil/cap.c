@@ -0,0 +1,522 @@
+/* vim: set tabstop=8 shiftwidth=8:
+ * name: cap.c
+ * funx: UDP payload in capture file(pcap or pcapng)
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "config.h" /* for SYS_* macro, generated by configure */
+
+#ifndef SYS_WINDOWS
+#       include <sys/types.h>
+#       include <sys/stat.h> /* for fstat() */
+#       include <sys/mman.h> /* for mmap(), etc */
+#       include <fcntl.h> /* for open() */
+#       include <unistd.h> /* for close() */
+#endif
+
+#include "common.h"
+#include "rtp.h" /* for rtp_head() */
+#include "cap.h"
+
+static int rpt_lvl = WRN_LVL; /* report level: ERR, WRN, INF, DBG */
+
+#define CAP_CLK         (27000000) /* 27MHz, as STC */
+#define CAP_OVF         ((((int64_t)1) << 33) * 300) /* as STC_OVF */
+#define CAP_IF_MAX      (16) /* interface number in pcapng */
+
+/* link type */
+#define LINK_NULL       (0)
+#define LINK_ETHERNET   (1)
+#define LINK_RAW        (101)
+#define LINK_RAW_OLD    (12)
+#define LINK_SLL        (113)
+#define LINK_SLL2       (276)
+
+struct cap_if {
+        int link; /* LINK_XXX */
+        int is_pow2; /* 1: 2^-res second; 0: 10^-res second */
+        int res; /* timestamp resolution */
+};
+
+struct cap {
+        uint8_t *map; /* all the file */
+        size_t len;
+        size_t pos; /* next block or record */
+        int is_ng; /* 1: pcapng; 0: pcap */
+        int is_be; /* 1: big-endian file */
+
+        int if_cnt;
+        struct cap_if cif[CAP_IF_MAX]; /* only cif[0] for pcap */
+
+        int has_addr;
+        uint32_t addr; /* destination IPv4 address, host order */
+        unsigned short port; /* destination UDP port, 0 for any */
+
+        int64_t CTS; /* time of last packet */
+        uint64_t cnt_udp; /* UDP datagram matched */
+        uint64_t cnt_frag; /* IP fragment dropped */
+        uint64_t cnt_rtp; /* RTP datagram */
+};
+
+static uint16_t rd16(struct cap *cap, const uint8_t *p);
+static uint32_t rd32(struct cap *cap, const uint8_t *p);
+static int64_t cap_time(struct cap_if *cif, uint64_t ts);
+static ssize_t cap_udp(struct cap *cap, int link, uint8_t *pkt, size_t len, uint8_t **data);
+static int cap_head(struct cap *cap);
+
+int cap_probe(const char *fname)
+{
+        FILE *fd;
+        uint8_t magic[4];
+        int rslt = 0;
+
+        fd = fopen(fname, "rb");
+        if(NULL == fd) {
+                return 0;
+        }
+        if(4 == fread(magic, 1, 4, fd)) {
+                uint32_t m = ((uint32_t)magic[0] << 24) | (magic[1] << 16) | (magic[2] << 8) | magic[3];
+
+                rslt = (0xA1B2C3D4 == m || 0xD4C3B2A1 == m ||
+                        0xA1B23C4D == m || 0x4D3CB2A1 == m ||
+                        0x0A0D0D0A == m);
+        }
+        fclose(fd);
+        return rslt;
+}
+
+/* addr: "a.b.c.d" or NULL for any, port: 0 for any */
+intptr_t cap_open(const char *fname, const char *addr, unsigned short port)
+{
+        struct cap *cap;
+
+        cap = (struct cap *)malloc(sizeof(struct cap));
+        if(NULL == cap) {
+                RPTERR("malloc failed");
+                return (intptr_t)NULL;
+        }
+        memset(cap, 0, sizeof(struct cap));
+
+        if(addr && '\0' != addr[0]) {
+                unsigned int a, b, c, d;
+
+                if(4 != sscanf(addr, "%u.%u.%u.%u", &a, &b, &c, &d) ||
+                   a > 255 || b > 255 || c > 255 || d > 255) {
+                        RPTERR("bad IPv4 address: %s", addr);
+                        free(cap);
+                        return (intptr_t)NULL;
+                }
+                cap->addr = (a << 24) | (b << 16) | (c << 8) | d;
+                cap->has_addr = 1;
+        }
+        cap->port = port;
+
+#ifndef SYS_WINDOWS
+        {
+                int fd;
+                struct stat st;
+
+                fd = open(fname, O_RDONLY);
+                if(fd < 0 || 0 != fstat(fd, &st) || 0 == st.st_size) {
+                        RPTERR("open \"%s\" failed", fname);
+                        if(fd >= 0) {
+                                close(fd);
+                        }
+                        free(cap);
+                        return (intptr_t)NULL;
+                }
+                cap->len = (size_t)st.st_size;
+                cap->map = (uint8_t *)mmap(NULL, cap->len, PROT_READ, MAP_PRIVATE, fd, 0);
+                close(fd);
+                if(MAP_FAILED == (void *)(cap->map)) {
+                        RPTERR("mmap \"%s\" failed", fname);
+                        free(cap);
+                        return (intptr_t)NULL;
+                }
+                (void)madvise(cap->map, cap->len, MADV_SEQUENTIAL);
+        }
+#else
+        {
+                FILE *fd;
+                long len;
+
+                fd = fopen(fname, "rb");
+                if(NULL == fd) {
+                        RPTERR("open \"%s\" failed", fname);
+                        free(cap);
+                        return (intptr_t)NULL;
+                }
+                fseek(fd, 0, SEEK_END);
+                len = ftell(fd);
+                fseek(fd, 0, SEEK_SET);
+                cap->map = (len > 0) ? (uint8_t *)malloc((size_t)len) : NULL;
+                if(NULL == cap->map || (size_t)len != fread(cap->map, 1, (size_t)len, fd)) {
+                        RPTERR("read \"%s\" failed", fname);
+                        fclose(fd);
+                        free(cap->map);
+                        free(cap);
+                        return (intptr_t)NULL;
+                }
+                cap->len = (size_t)len;
+                fclose(fd);
+        }
+#endif
+
+        if(0 != cap_head(cap)) {
+                cap_close((intptr_t)cap);
+                return (intptr_t)NULL;
+        }
+        return (intptr_t)cap;
+}
+
+int cap_close(intptr_t id)
+{
+        struct cap *cap = (struct cap *)id;
+
+        if(NULL == cap) {
+                RPTERR("bad id");
+                return -1;
+        }
+
+        RPTINF("%llu UDP datagram, %llu RTP, %llu IP fragment dropped",
+               (unsigned long long)cap->cnt_udp,
+               (unsigned long long)cap->cnt_rtp,
+               (unsigned long long)cap->cnt_frag);
+#ifndef SYS_WINDOWS
+        munmap(cap->map, cap->len);
+#else
+        free(cap->map);
+#endif
+        free(cap);
+        return 0;
+}
+
+/* next UDP payload matched, RTP head removed; 0 means end of file */
+ssize_t cap_read(intptr_t id, uint8_t **data, int64_t *CTS)
+{
+        struct cap *cap = (struct cap *)id;
+
+        if(NULL == cap) {
+                RPTERR("bad id");
+                return -1;
+        }
+
+        while(cap->pos < cap->len) {
+                uint8_t *p = cap->map + cap->pos;
+                size_t left = cap->len - cap->pos;
+                struct cap_if *cif = &(cap->cif[0]);
+                uint8_t *pkt;
+                size_t caplen;
+                ssize_t rslt;
+
+                if(!(cap->is_ng)) {
+                        /* pcap record: ts_sec, ts_usec, incl_len, orig_len */
+                        if(left < 16) {
+                                break;
+                        }
+                        caplen = rd32(cap, p + 8);
+                        if(caplen > left - 16) {
+                                RPTWRN("record truncated at %zu", cap->pos);
+                                break;
+                        }
+                        cap->pos += 16 + caplen;
+                        pkt = p + 16;
+                        cap->CTS = cap_time(cif, (uint64_t)rd32(cap, p) *
+                                            ((9 == cif->res) ? 1000000000 : 1000000) + rd32(cap, p + 4));
+                }
+                else {
+                        /* pcapng block: type, total_length, body, total_length */
+                        uint32_t type;
+                        uint32_t blen;
+
+                        if(left < 12) {
+                                break;
+                        }
+                        type = rd32(cap, p);
+                        blen = rd32(cap, p + 4);
+                        if(0x0A0D0D0A == type) {
+                                /* new section, maybe another byte order */
+                                if(0 != cap_head(cap)) {
+                                        break;
+                                }
+                                continue;
+                        }
+                        if(blen < 12 || blen > left || (blen & 0x03)) {
+                                RPTWRN("bad block at %zu", cap->pos);
+                                break;
+                        }
+                        cap->pos += blen;
+
+                        if(1 == type && blen >= 20) {
+                                /* interface description block */
+                                uint8_t *opt = p + 16;
+                                uint8_t *end = p + blen - 4;
+
+                                if(cap->if_cnt >= CAP_IF_MAX) {
+                                        RPTWRN("too many interface");
+                                        continue;
+                                }
+                                cif = &(cap->cif[cap->if_cnt++]);
+                                cif->link = rd16(cap, p + 8);
+                                cif->is_pow2 = 0;
+                                cif->res = 6;
+                                while(opt + 4 <= end) {
+                                        uint16_t code = rd16(cap, opt);
+                                        uint16_t olen = rd16(cap, opt + 2);
+
+                                        if(0 == code) {
+                                                break; /* opt_endofopt */
+                                        }
+                                        if(9 == code && 1 == olen) {
+                                                /* if_tsresol */
+                                                cif->is_pow2 = ((opt[4] & 0x80) ? 1 : 0);
+                                                cif->res = opt[4] & 0x7F;
+                                        }
+                                        opt += 4 + ((olen + 3) & ~3);
+                                }
+                                continue;
+                        }
+                        else if(6 == type && blen >= 32) {
+                                /* enhanced packet block */
+                                uint32_t ifid = rd32(cap, p + 8);
+                                uint64_t ts;
+
+                                if(ifid >= (uint32_t)(cap->if_cnt)) {
+                                        continue;
+                                }
+                                cif = &(cap->cif[ifid]);
+                                ts = ((uint64_t)rd32(cap, p + 12) << 32) | rd32(cap, p + 16);
+                                caplen = rd32(cap, p + 20);
+                                if(caplen > blen - 32) {
+                                        continue;
+                                }
+                                pkt = p + 28;
+                                cap->CTS = cap_time(cif, ts);
+                        }
+                        else if(3 == type && blen >= 16 && cap->if_cnt) {
+                                /* simple packet block, without timestamp */
+                                caplen = rd32(cap, p + 8);
+                                if(caplen > blen - 16) {
+                                        caplen = blen - 16;
+                                }
+                                pkt = p + 12;
+                        }
+                        else {
+                                continue; /* other block */
+                        }
+                }
+
+                rslt = cap_udp(cap, cif->link, pkt, caplen, data);
+                if(rslt > 0) {
+                        *CTS = cap->CTS;
+                        return rslt;
+                }
+        }
+        return 0;
+}
+
+static uint16_t rd16(struct cap *cap, const uint8_t *p)
+{
+        return (cap->is_be) ? (uint16_t)((p[0] << 8) | p[1]) : (uint16_t)((p[1] << 8) | p[0]);
+}
+
+static uint32_t rd32(struct cap *cap, const uint8_t *p)
+{
+        if(cap->is_be) {
+                return ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) | ((uint32_t)p[2] << 8) | p[3];
+        }
+        return ((uint32_t)p[3] << 24) | ((uint32_t)p[2] << 16) | ((uint32_t)p[1] << 8) | p[0];
+}
+
+/* ts in 10^-res or 2^-res second, to 27MHz clk */
+static int64_t cap_time(struct cap_if *cif, uint64_t ts)
+{
+        uint64_t sec;
+        uint64_t frac;
+        int res = cif->res;
+
+        if(cif->is_pow2) {
+                while(res > 32) {
+                        ts >>= 1;
+                        res--;
+                }
+                sec = ts >> res;
+                frac = ((ts & ((((uint64_t)1) << res) - 1)) * CAP_CLK) >> res;
+        }
+        else {
+                uint64_t unit = 1;
+
+                while(res > 9) {
+                        ts /= 10;
+                        res--;
+                }
+                while(res-- > 0) {
+                        unit *= 10;
+                }
+                sec = ts / unit;
+                frac = (ts % unit) * CAP_CLK / unit;
+        }
+        return (int64_t)((sec * CAP_CLK + frac) % CAP_OVF);
+}
+
+/* link layer -> IPv4 -> UDP -> [RTP] -> payload */
+static ssize_t cap_udp(struct cap *cap, int link, uint8_t *pkt, size_t len, uint8_t **data)
+{
+        uint8_t *p = pkt;
+        uint8_t *end = pkt + len;
+        uint16_t proto;
+        size_t ihl;
+        size_t ulen;
+        uint32_t dst;
+
+        switch(link) {
+                case LINK_ETHERNET:
+                        if(len < 14) {
+                                return 0;
+                        }
+                        proto = (uint16_t)((p[12] << 8) | p[13]);
+                        p += 14;
+                        while((0x8100 == proto || 0x88A8 == proto) && p + 4 <= end) {
+                                proto = (uint16_t)((p[2] << 8) | p[3]); /* VLAN */
+                                p += 4;
+                        }
+                        if(0x0800 != proto) {
+                                return 0;
+                        }
+                        break;
+                case LINK_SLL:
+                        if(len < 16 || 0x0800 != ((p[14] << 8) | p[15])) {
+                                return 0;
+                        }
+                        p += 16;
+                        break;
+                case LINK_SLL2:
+                        if(len < 20 || 0x0800 != ((p[0] << 8) | p[1])) {
+                                return 0;
+                        }
+                        p += 20;
+                        break;
+                case LINK_NULL:
+                        if(len < 4 || 2 != rd32(cap, p)) { /* AF_INET */
+                                return 0;
+                        }
+                        p += 4;
+                        break;
+                case LINK_RAW:
+                case LINK_RAW_OLD:
+                        break;
+                default:
+                        return 0;
+        }
+
+        /* IPv4 */
+        if(p + 20 > end || 0x40 != (p[0] & 0xF0) || 17 != p[9]) {
+                return 0;
+        }
+        ihl = (size_t)(p[0] & 0x0F) * 4;
+        if(ihl < 20) {
+                return 0; /* bad IHL */
+        }
+        if(((p[6] << 8) | p[7]) & 0x3FFF) {
+                cap->cnt_frag++; /* MF or fragment_offset */
+                return 0;
+        }
+        dst = ((uint32_t)p[16] << 24) | ((uint32_t)p[17] << 16) | ((uint32_t)p[18] << 8) | p[19];
+        if(cap->has_addr && dst != cap->addr) {
+                return 0;
+        }
+        p += ihl;
+
+        /* UDP */
+        if(p + 8 > end) {
+                return 0;
+        }
+        if(cap->port && cap->port != ((p[2] << 8) | p[3])) {
+                return 0;
+        }
+        ulen = (size_t)((p[4] << 8) | p[5]);
+        p += 8;
+        if(ulen < 8) {
+                return 0;
+        }
+        ulen -= 8;
+        if(p + ulen > end) {
+                ulen = (size_t)(end - p); /* snaplen */
+        }
+        cap->cnt_udp++;
+        if(0 == ulen) {
+                return 0; /* empty datagram */
+        }
+
+        /* RTP: TS after the head */
+        if(0x47 != p[0]) {
+                size_t plen;
+                int hlen = rtp_head(p, ulen, &plen, NULL, NULL);
+
+                if(hlen > 0 && plen > 0 && 0x47 == p[hlen]) {
+                        cap->cnt_rtp++;
+                        p += hlen;
+                        ulen = plen;
+                }
+        }
+
+        *data = p;
+        return (ssize_t)ulen;
+}
+
+/* file head of pcap or section head of pcapng */
+static int cap_head(struct cap *cap)
+{
+        uint8_t *p = cap->map + cap->pos;
+        size_t left = cap->len - cap->pos;
+        uint32_t m;
+
+        if(left < 24) {
+                RPTERR("file too short");
+                return -1;
+        }
+        m = ((uint32_t)p[0] << 24) | (p[1] << 16) | (p[2] << 8) | p[3];
+
+        if(0x0A0D0D0A == m) {
+                uint32_t blen;
+
+                cap->is_ng = 1;
+                if(0x1A2B3C4D == (((uint32_t)p[8] << 24) | (p[9] << 16) | (p[10] << 8) | p[11])) {
+                        cap->is_be = 1;
+                }
+                else if(0x4D3C2B1A == (((uint32_t)p[8] << 24) | (p[9] << 16) | (p[10] << 8) | p[11])) {
+                        cap->is_be = 0;
+                }
+                else {
+                        RPTERR("bad byte-order magic of pcapng");
+                        return -1;
+                }
+                blen = rd32(cap, p + 4);
+                if(blen < 28 || blen > left) {
+                        RPTERR("bad section head block");
+                        return -1;
+                }
+                cap->pos += blen;
+                cap->if_cnt = 0; /* interface ID restart in new section */
+                return 0;
+        }
+
+        cap->is_ng = 0;
+        cap->if_cnt = 1;
+        cap->cif[0].is_pow2 = 0;
+        switch(m) {
+                case 0xA1B2C3D4: cap->is_be = 1; cap->cif[0].res = 6; break;
+                case 0xD4C3B2A1: cap->is_be = 0; cap->cif[0].res = 6; break;
+                case 0xA1B23C4D: cap->is_be = 1; cap->cif[0].res = 9; break;
+                case 0x4D3CB2A1: cap->is_be = 0; cap->cif[0].res = 9; break;
+                default:
+                        RPTERR("not a pcap or pcapng file");
+                        return -1;
+        }
+        cap->cif[0].link = (int)(rd32(cap, p + 20) & 0xFFFF);
+        cap->pos += 24;
+        return 0;
+}
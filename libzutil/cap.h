@@ -0,0 +1,25 @@
+/* vim: set tabstop=8 shiftwidth=8:
+ * name: cap.h
+ * funx: UDP payload in capture file(pcap or pcapng)
+ */
+
+#ifndef _CAP_H
+#define _CAP_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <sys/types.h> /* for ssize_t, etc */
+#include <stdint.h> /* for uint?_t, etc */
+
+int cap_probe(const char *fname); /* 1: it is a capture file */
+intptr_t cap_open(const char *fname, const char *addr, unsigned short port);
+int cap_close(intptr_t id);
+ssize_t cap_read(intptr_t id, uint8_t **data, int64_t *CTS); /* CTS: capture time, 27MHz */
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _CAP_H */
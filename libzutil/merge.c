@@ -0,0 +1,427 @@
+/* vim: set tabstop=8 shiftwidth=8:
+ * name: merge.c
+ * funx: hitless merge of two redundant UDP feeds, SMPTE 2022-7 style
+ *
+ * RTP: datagrams of both paths go into one reorder window keyed by seq,
+ *      the first copy is output, a hole waits for the other path until
+ *      the window is full, or a later seq is out of the window.
+ * UDP: no seq, the first copy is output at once, the other copy is
+ *      found by the hash of datagram. A stream may repeat a datagram
+ *      (e.g. null stuffing), so the n-th copy of one path is paired with
+ *      the n-th copy of the other path, others are output.
+ * hist[] remembers which path brought each datagram, a path is counted
+ * lost when the datagram leaves hist[] without it.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "common.h"
+#include "udp.h"
+#include "rtp.h"
+#include "merge.h"
+
+static int rpt_lvl = WRN_LVL; /* report level: ERR, WRN, INF, DBG */
+
+#define MRG_PATH        (2)
+#define MRG_LENGTH_MAX  (1536) /* as UDP_LENGTH_MAX */
+#define MRG_WIN         (512) /* reorder window, in datagram, bound of path skew */
+#define MRG_JUMP        (0x4000) /* seq this far from next: sender restart, not loss */
+#define MRG_HIST        (4096) /* datagram remembered for path statistic, 65536 % MRG_HIST == 0 */
+#define MRG_MAP         (8192) /* hash -> hist[], for UDP */
+#define MRG_CLK         (300) /* 90kHz RTP clk to 27MHz */
+#define MRG_OVF         ((((int64_t)1) << 33) * 300) /* as STC_OVF */
+
+struct mrg_slot {
+        int is_used;
+        uint16_t seq;
+        uint32_t ts;
+        size_t off; /* RTP head length */
+        size_t len; /* payload length */
+        uint8_t *buf;
+};
+
+struct mrg_hist {
+        int is_used;
+        uint64_t key; /* seq, or hash of datagram */
+        int mask; /* bit N: got it from path N */
+        uint32_t link; /* UDP: n + 1 of the older one in the same map[], 0 for none */
+};
+
+struct mrg_path {
+        intptr_t udp;
+        uint64_t cnt_pkt;
+        uint64_t cnt_lost;
+        uint64_t cnt_late; /* later than MRG_HIST */
+        uint64_t cnt_bad;
+};
+
+struct mrg {
+        int is_rtp;
+        struct mrg_path path[MRG_PATH];
+        intptr_t udp[MRG_PATH]; /* for udp_wait() */
+        int ready; /* mask of path readable */
+        int turn; /* path to read first */
+
+        /* statistic of each datagram */
+        struct mrg_hist hist[MRG_HIST];
+        uint32_t map[MRG_MAP]; /* UDP: hash -> n + 1 of the newest in hist[n % MRG_HIST], 0 for none */
+        uint32_t hist_wr; /* UDP: datagram in hist[] in total */
+
+        /* RTP: reorder window, slot[seq % MRG_WIN] */
+        int is_sync;
+        uint16_t next;
+        uint16_t max_seq; /* max seq received */
+        int cnt_pending;
+        int is_held; /* spare is out of window, wait for the window to move */
+        int held_p; /* path of spare */
+        ssize_t held_len;
+        int out; /* slot output last time, -1 for none */
+        struct mrg_slot slot[MRG_WIN];
+        uint8_t *spare; /* buffer to receive */
+        uint8_t *mem;
+
+        /* RTP timestamp extended to 64-bit */
+        int has_ts;
+        uint32_t lts;
+        int64_t ext;
+
+        uint64_t cnt_out;
+        uint64_t cnt_lost; /* lost on both paths */
+};
+
+static void hist_set(struct mrg *mrg, struct mrg_hist *h, uint64_t key, int mask);
+static ssize_t mrg_recv(struct mrg *mrg, int *p);
+static ssize_t mrg_read_rtp(struct mrg *mrg, uint8_t **data, int64_t *CTS);
+static ssize_t mrg_read_udp(struct mrg *mrg, uint8_t **data, int64_t *CTS);
+
+intptr_t mrg_open(int is_rtp,
+                  char *src_addr0, char *addr0, unsigned short port0,
+                  char *src_addr1, char *addr1, unsigned short port1)
+{
+        struct mrg *mrg;
+        int i;
+
+        mrg = (struct mrg *)malloc(sizeof(struct mrg));
+        if(NULL == mrg) {
+                RPTERR("malloc failed");
+                return (intptr_t)NULL;
+        }
+        memset(mrg, 0, sizeof(struct mrg));
+        mrg->is_rtp = is_rtp;
+        mrg->out = -1;
+
+        /* all buffers at once, no allocation per datagram */
+        mrg->mem = (uint8_t *)malloc((MRG_WIN + 1) * MRG_LENGTH_MAX);
+        if(NULL == mrg->mem) {
+                RPTERR("malloc failed");
+                free(mrg);
+                return (intptr_t)NULL;
+        }
+        mrg->spare = mrg->mem;
+        for(i = 0; i < MRG_WIN; i++) {
+                mrg->slot[i].buf = mrg->mem + (i + 1) * MRG_LENGTH_MAX;
+        }
+
+        mrg->path[0].udp = udp_open(src_addr0, addr0, port0, "rb");
+        mrg->path[1].udp = udp_open(src_addr1, addr1, port1, "rb");
+        if(0 == mrg->path[0].udp || 0 == mrg->path[1].udp) {
+                if(mrg->path[0].udp) {
+                        udp_close(mrg->path[0].udp);
+                }
+                if(mrg->path[1].udp) {
+                        udp_close(mrg->path[1].udp);
+                }
+                free(mrg->mem);
+                free(mrg);
+                return (intptr_t)NULL;
+        }
+        for(i = 0; i < MRG_PATH; i++) {
+                mrg->udp[i] = mrg->path[i].udp;
+        }
+        return (intptr_t)mrg;
+}
+
+int mrg_close(intptr_t id)
+{
+        struct mrg *mrg = (struct mrg *)id;
+        int i;
+
+        if(NULL == mrg) {
+                RPTERR("bad id");
+                return -1;
+        }
+
+        /* the rest in hist[] */
+        for(i = 0; i < MRG_HIST; i++) {
+                hist_set(mrg, &(mrg->hist[i]), 0, -1);
+        }
+        RPTWRN("merged: %llu datagram, %llu lost on both paths",
+               (unsigned long long)mrg->cnt_out,
+               (unsigned long long)mrg->cnt_lost);
+        for(i = 0; i < MRG_PATH; i++) {
+                struct mrg_path *path = &(mrg->path[i]);
+
+                RPTWRN("path %d: %llu datagram, %llu lost, %llu too late, %llu bad", i,
+                       (unsigned long long)path->cnt_pkt,
+                       (unsigned long long)path->cnt_lost,
+                       (unsigned long long)path->cnt_late,
+                       (unsigned long long)path->cnt_bad);
+                udp_close(path->udp);
+        }
+        free(mrg->mem);
+        free(mrg);
+        return 0;
+}
+
+/* next datagram of merged stream; 0 or -1 when receive failed */
+ssize_t mrg_read(intptr_t id, uint8_t **data, int64_t *CTS)
+{
+        struct mrg *mrg = (struct mrg *)id;
+
+        if(NULL == mrg) {
+                RPTERR("bad id");
+                return -1;
+        }
+        if(mrg->is_rtp) {
+                return mrg_read_rtp(mrg, data, CTS);
+        }
+        return mrg_read_udp(mrg, data, CTS);
+}
+
+/* retire the datagram in h, then record key, mask -1: none */
+static void hist_set(struct mrg *mrg, struct mrg_hist *h, uint64_t key, int mask)
+{
+        if(h->is_used) {
+                int i;
+
+                for(i = 0; i < MRG_PATH; i++) {
+                        if(!(h->mask & (1 << i))) {
+                                mrg->path[i].cnt_lost++;
+                        }
+                }
+        }
+        h->is_used = (mask >= 0);
+        h->key = key;
+        h->mask = mask;
+}
+
+/* one datagram into spare from the paths in turn; 0 when wait failed */
+static ssize_t mrg_recv(struct mrg *mrg, int *p)
+{
+        while(1) {
+                ssize_t rslt;
+
+                if(0 == mrg->ready) {
+                        mrg->ready = udp_wait(mrg->udp, MRG_PATH);
+                        if(mrg->ready <= 0) {
+                                mrg->ready = 0;
+                                return 0;
+                        }
+                }
+                if(!(mrg->ready & (1 << mrg->turn))) {
+                        mrg->turn ^= 1;
+                }
+                *p = mrg->turn;
+                mrg->ready &= ~(1 << mrg->turn);
+                mrg->turn ^= 1;
+
+                rslt = udp_read(mrg->udp[*p], mrg->spare);
+                if(rslt > 0) {
+                        mrg->path[*p].cnt_pkt++;
+                        return rslt;
+                }
+        }
+}
+
+static ssize_t mrg_read_rtp(struct mrg *mrg, uint8_t **data, int64_t *CTS)
+{
+        /* data of last output is used now */
+        if(mrg->out >= 0) {
+                mrg->slot[mrg->out].is_used = 0;
+                mrg->out = -1;
+        }
+
+        while(1) {
+                struct mrg_slot *slot;
+                struct mrg_hist *h;
+                ssize_t rslt;
+                int hlen;
+                size_t plen;
+                uint16_t seq;
+                uint32_t ts;
+                int16_t d;
+                int p;
+                uint8_t *buf;
+
+                /* output in seq order */
+                slot = &(mrg->slot[mrg->next % MRG_WIN]);
+                if(mrg->is_sync && slot->is_used && slot->seq == mrg->next) {
+                        if(!(mrg->has_ts)) {
+                                mrg->has_ts = 1;
+                                mrg->ext = slot->ts;
+                        }
+                        else {
+                                mrg->ext += (int32_t)(slot->ts - mrg->lts);
+                        }
+                        mrg->lts = slot->ts;
+                        *CTS = ((mrg->ext * MRG_CLK) % MRG_OVF + MRG_OVF) % MRG_OVF;
+                        *data = slot->buf + slot->off;
+
+                        mrg->out = (int)(mrg->next % MRG_WIN);
+                        mrg->cnt_pending--;
+                        mrg->cnt_out++;
+                        mrg->next++;
+                        return (ssize_t)(slot->len);
+                }
+
+                /* window full or passed: lost on both paths */
+                if(mrg->cnt_pending >= MRG_WIN - 1 ||
+                   (mrg->is_sync && (int16_t)(mrg->max_seq - mrg->next) >= MRG_WIN - 1)) {
+                        h = &(mrg->hist[mrg->next % MRG_HIST]);
+                        if(!(h->is_used && h->key == mrg->next)) {
+                                hist_set(mrg, h, mrg->next, 0);
+                        }
+                        mrg->next++;
+                        mrg->cnt_lost++;
+                        continue;
+                }
+
+                if(mrg->is_held) {
+                        /* the window has moved for it */
+                        mrg->is_held = 0;
+                        p = mrg->held_p;
+                        rslt = mrg->held_len;
+                }
+                else {
+                        rslt = mrg_recv(mrg, &p);
+                        if(rslt <= 0) {
+                                return rslt;
+                        }
+                }
+                hlen = rtp_head(mrg->spare, (size_t)rslt, &plen, &seq, &ts);
+                if(hlen < 0) {
+                        mrg->path[p].cnt_bad++;
+                        continue;
+                }
+
+                if(!(mrg->is_sync)) {
+                        mrg->is_sync = 1;
+                        mrg->next = seq;
+                        mrg->max_seq = seq;
+                }
+                d = (int16_t)(seq - mrg->next);
+                h = &(mrg->hist[seq % MRG_HIST]);
+                if(d >= MRG_JUMP || d <= -MRG_JUMP) {
+                        /* sender restart */
+                        int i;
+
+                        RPTWRN("RTP seq jump: %u -> %u", mrg->next, seq);
+                        for(i = 0; i < MRG_WIN; i++) {
+                                if(i != mrg->out) {
+                                        mrg->slot[i].is_used = 0;
+                                }
+                        }
+                        mrg->cnt_pending = 0;
+                        mrg->next = seq;
+                        mrg->max_seq = seq;
+                        d = 0;
+                }
+                if(d < 0) {
+                        /* copy of the other path, or given up */
+                        if(-d < MRG_HIST - MRG_WIN && h->is_used && h->key == seq) {
+                                h->mask |= (1 << p);
+                        }
+                        else {
+                                mrg->path[p].cnt_late++;
+                        }
+                        continue;
+                }
+                if((int16_t)(seq - mrg->max_seq) > 0) {
+                        mrg->max_seq = seq;
+                }
+                if(d >= MRG_WIN - 1) {
+                        /* out of window, give up holes before it first */
+                        mrg->is_held = 1;
+                        mrg->held_p = p;
+                        mrg->held_len = rslt;
+                        continue;
+                }
+                if(h->is_used && h->key == seq) {
+                        h->mask |= (1 << p);
+                }
+                else {
+                        hist_set(mrg, h, seq, (1 << p));
+                }
+
+                slot = &(mrg->slot[seq % MRG_WIN]);
+                if(slot->is_used) {
+                        continue; /* copy of the other path */
+                }
+                buf = slot->buf;
+                slot->buf = mrg->spare;
+                mrg->spare = buf;
+                slot->is_used = 1;
+                slot->seq = seq;
+                slot->ts = ts;
+                slot->off = (size_t)hlen;
+                slot->len = plen;
+                mrg->cnt_pending++;
+        }
+}
+
+static ssize_t mrg_read_udp(struct mrg *mrg, uint8_t **data, int64_t *CTS)
+{
+        while(1) {
+                struct mrg_hist *h;
+                struct mrg_hist *pair;
+                ssize_t rslt;
+                uint64_t key;
+                uint32_t m;
+                uint32_t n;
+                int p;
+                ssize_t i;
+
+                rslt = mrg_recv(mrg, &p);
+                if(rslt <= 0) {
+                        return rslt;
+                }
+
+                /* FNV-1a, 64-bit */
+                key = 0xCBF29CE484222325ULL;
+                for(i = 0; i < rslt; i++) {
+                        key ^= mrg->spare[i];
+                        key *= 0x100000001B3ULL;
+                }
+
+                /* the oldest one of the other path not paired, in window
+                 * stop at one of this path, the older ones are paired or lost
+                 */
+                pair = NULL;
+                for(m = mrg->map[key % MRG_MAP]; 0 != m && mrg->hist_wr - m < MRG_WIN; m = h->link) {
+                        h = &(mrg->hist[(m - 1) % MRG_HIST]);
+                        if(h->is_used && h->key == key) {
+                                if(h->mask & (1 << p)) {
+                                        break;
+                                }
+                                pair = h;
+                        }
+                }
+                if(pair) {
+                        pair->mask |= (1 << p); /* copy of the other path */
+                        continue;
+                }
+
+                /* first copy, output at once */
+                n = mrg->hist_wr++;
+                h = &(mrg->hist[n % MRG_HIST]);
+                hist_set(mrg, h, key, (1 << p));
+                h->link = mrg->map[key % MRG_MAP];
+                mrg->map[key % MRG_MAP] = n + 1;
+                mrg->cnt_out++;
+                *data = mrg->spare;
+                *CTS = -1;
+                return rslt;
+        }
+}
@@ -0,0 +1,27 @@
+/* vim: set tabstop=8 shiftwidth=8:
+ * name: merge.h
+ * funx: hitless merge of two redundant UDP feeds, SMPTE 2022-7 style
+ */
+
+#ifndef _MERGE_H
+#define _MERGE_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <sys/types.h> /* for ssize_t, etc */
+#include <stdint.h> /* for uint?_t, etc */
+
+/* is_rtp: align by RTP seq, or by datagram hash for plain UDP */
+intptr_t mrg_open(int is_rtp,
+                  char *src_addr0, char *addr0, unsigned short port0,
+                  char *src_addr1, char *addr1, unsigned short port1);
+int mrg_close(intptr_t id);
+ssize_t mrg_read(intptr_t id, uint8_t **data, int64_t *CTS); /* CTS: RTP timestamp, 27MHz, -1 if unknown */
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _MERGE_H */
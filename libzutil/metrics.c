@@ -0,0 +1,355 @@
+/* vim: set tabstop=8 shiftwidth=8:
+ * name: metrics.c
+ * funx: serve text snapshot of metrics over HTTP, for Prometheus scraper
+ *
+ * The caller builds the whole text and hands it over with mtr_update(),
+ * the server thread copies it under the lock and sends the copy, so a
+ * slow scraper only delays the server thread, never the caller.
+ * One connection at a time, HTTP/1.0, "GET /" or "GET /metrics" only.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "config.h" /* for SYS_* macro, generated by configure */
+
+#ifndef SYS_WINDOWS
+#       include <sys/types.h>
+#       include <sys/socket.h>
+#       include <sys/un.h> /* for struct sockaddr_un */
+#       include <netinet/in.h>
+#       include <arpa/inet.h> /* for inet_addr(), etc */
+#       include <unistd.h> /* for close(), unlink() */
+#       include <sys/select.h> /* for select(), etc */
+#       include <sys/time.h> /* for struct timeval */
+#       include <pthread.h>
+#endif
+
+#include "common.h"
+#include "metrics.h"
+
+static int rpt_lvl = WRN_LVL; /* report level: ERR, WRN, INF, DBG */
+
+#ifndef MSG_NOSIGNAL
+#define MSG_NOSIGNAL (0)
+#endif
+
+#define MTR_REQ_MAX     (2048) /* request head we care */
+#define MTR_POLL_MS     (200) /* check is_quit each MTR_POLL_MS */
+#define MTR_IO_MS       (1000) /* give up a slow scraper */
+
+#ifndef SYS_WINDOWS
+struct mtr {
+        int sock;
+        int is_unix;
+        char path[108]; /* as sun_path */
+        pthread_t tid;
+        volatile int is_quit;
+
+        /* snapshot, under mux */
+        pthread_mutex_t mux;
+        char *text;
+        size_t len;
+        size_t max;
+
+        /* copy of snapshot, for server thread only */
+        char *out;
+        size_t out_max;
+};
+
+static void *server(void *arg);
+static void serve(struct mtr *mtr, int sock);
+static int send_all(int sock, const char *buf, size_t len);
+
+intptr_t mtr_open(const char *addr)
+{
+        struct mtr *mtr;
+        int reuseaddr = 1;
+
+        if(NULL == addr) {
+                RPTERR("bad addr");
+                return (intptr_t)NULL;
+        }
+
+        mtr = (struct mtr *)calloc(1, sizeof(struct mtr));
+        if(NULL == mtr) {
+                RPTERR("malloc failed");
+                return (intptr_t)NULL;
+        }
+
+        if(0 == strncmp(addr, "unix:", 5)) {
+                struct sockaddr_un local;
+
+                mtr->is_unix = 1;
+                if(strlen(addr + 5) >= sizeof(local.sun_path) || '\0' == addr[5]) {
+                        RPTERR("bad unix socket path: \"%s\"", addr + 5);
+                        goto mtr_open_failed_with_obj;
+                }
+                strcpy(mtr->path, addr + 5);
+
+                if((mtr->sock = socket(AF_UNIX, SOCK_STREAM, 0)) < 0) {
+                        RPTERR("socket failed");
+                        goto mtr_open_failed_with_obj;
+                }
+                memset(&local, 0, sizeof(local));
+                local.sun_family = AF_UNIX;
+                strcpy(local.sun_path, mtr->path);
+                unlink(mtr->path); /* left by last run */
+                if(bind(mtr->sock, (struct sockaddr *)&local, (socklen_t)sizeof(local)) < 0) {
+                        RPTERR("bind \"%s\" failed", mtr->path);
+                        goto mtr_open_failed_with_sock;
+                }
+        }
+        else {
+                struct sockaddr_in local;
+                char ip[32] = "127.0.0.1"; /* local only by default */
+                const char *colon = strrchr(addr, ':');
+                int port;
+
+                if(NULL == colon) {
+                        RPTERR("no port in \"%s\"", addr);
+                        goto mtr_open_failed_with_obj;
+                }
+                if(colon != addr) {
+                        if((size_t)(colon - addr) >= sizeof(ip)) {
+                                RPTERR("bad ip in \"%s\"", addr);
+                                goto mtr_open_failed_with_obj;
+                        }
+                        memcpy(ip, addr, (size_t)(colon - addr));
+                        ip[colon - addr] = '\0';
+                }
+                port = atoi(colon + 1);
+                if(port <= 0 || port > 65535) {
+                        RPTERR("bad port in \"%s\"", addr);
+                        goto mtr_open_failed_with_obj;
+                }
+
+                if((mtr->sock = socket(AF_INET, SOCK_STREAM, 0)) < 0) {
+                        RPTERR("socket failed");
+                        goto mtr_open_failed_with_obj;
+                }
+                setsockopt(mtr->sock, SOL_SOCKET, SO_REUSEADDR,
+                           (char *)&reuseaddr, (socklen_t)sizeof(int));
+                memset(&local, 0, sizeof(local));
+                local.sin_family = AF_INET;
+                local.sin_addr.s_addr = inet_addr(ip);
+                local.sin_port = htons((unsigned short)port);
+                if(bind(mtr->sock, (struct sockaddr *)&local, (socklen_t)sizeof(local)) < 0) {
+                        RPTERR("bind %s:%d failed", ip, port);
+                        goto mtr_open_failed_with_sock;
+                }
+        }
+
+        if(listen(mtr->sock, 4) < 0) {
+                RPTERR("listen failed");
+                goto mtr_open_failed_with_sock;
+        }
+
+        pthread_mutex_init(&(mtr->mux), NULL);
+        if(0 != pthread_create(&(mtr->tid), NULL, server, mtr)) {
+                RPTERR("create server thread failed");
+                pthread_mutex_destroy(&(mtr->mux));
+                goto mtr_open_failed_with_sock;
+        }
+        return (intptr_t)mtr;
+
+mtr_open_failed_with_sock:
+        close(mtr->sock);
+        if(mtr->is_unix) {
+                unlink(mtr->path);
+        }
+mtr_open_failed_with_obj:
+        free(mtr);
+        return (intptr_t)NULL;
+}
+
+int mtr_close(intptr_t id)
+{
+        struct mtr *mtr = (struct mtr *)id;
+
+        if(NULL == mtr) {
+                RPTERR("bad id");
+                return -1;
+        }
+
+        mtr->is_quit = 1;
+        pthread_join(mtr->tid, NULL);
+        close(mtr->sock);
+        if(mtr->is_unix) {
+                unlink(mtr->path);
+        }
+        pthread_mutex_destroy(&(mtr->mux));
+        if(mtr->text) {
+                free(mtr->text);
+        }
+        if(mtr->out) {
+                free(mtr->out);
+        }
+        free(mtr);
+        return 0;
+}
+
+int mtr_update(intptr_t id, const char *text, size_t len)
+{
+        struct mtr *mtr = (struct mtr *)id;
+
+        if(NULL == mtr) {
+                RPTERR("bad id");
+                return -1;
+        }
+
+        if(0 != pthread_mutex_trylock(&(mtr->mux))) {
+                return 1; /* busy, the next snapshot will do */
+        }
+        if(len > mtr->max) {
+                char *p = (char *)realloc(mtr->text, len);
+
+                if(NULL == p) {
+                        pthread_mutex_unlock(&(mtr->mux));
+                        RPTERR("realloc failed");
+                        return -1;
+                }
+                mtr->text = p;
+                mtr->max = len;
+        }
+        memcpy(mtr->text, text, len);
+        mtr->len = len;
+        pthread_mutex_unlock(&(mtr->mux));
+        return 0;
+}
+
+static void *server(void *arg)
+{
+        struct mtr *mtr = (struct mtr *)arg;
+
+        while(!(mtr->is_quit)) {
+                fd_set rset;
+                struct timeval tv;
+                int sock;
+
+                FD_ZERO(&rset);
+                FD_SET(mtr->sock, &rset);
+                tv.tv_sec = 0;
+                tv.tv_usec = MTR_POLL_MS * 1000;
+                if(select(mtr->sock + 1, &rset, NULL, NULL, &tv) <= 0) {
+                        continue; /* timeout or EINTR */
+                }
+
+                sock = accept(mtr->sock, NULL, NULL);
+                if(sock < 0) {
+                        continue;
+                }
+                tv.tv_sec = MTR_IO_MS / 1000;
+                tv.tv_usec = (MTR_IO_MS % 1000) * 1000;
+                setsockopt(sock, SOL_SOCKET, SO_RCVTIMEO, (char *)&tv, (socklen_t)sizeof(tv));
+                setsockopt(sock, SOL_SOCKET, SO_SNDTIMEO, (char *)&tv, (socklen_t)sizeof(tv));
+                serve(mtr, sock);
+                close(sock);
+        }
+        return NULL;
+}
+
+static void serve(struct mtr *mtr, int sock)
+{
+        char req[MTR_REQ_MAX + 1];
+        char head[256];
+        size_t got = 0;
+        size_t len;
+        int hlen;
+
+        /* request head, till blank line */
+        while(got < MTR_REQ_MAX) {
+                ssize_t rslt = recv(sock, req + got, MTR_REQ_MAX - got, 0);
+
+                if(rslt <= 0) {
+                        return;
+                }
+                got += (size_t)rslt;
+                req[got] = '\0';
+                if(strstr(req, "\r\n\r\n") || strstr(req, "\n\n")) {
+                        break;
+                }
+        }
+        req[got] = '\0';
+
+        if(0 != strncmp(req, "GET ", 4)) {
+                const char *rsp = "HTTP/1.0 405 Method Not Allowed\r\n"
+                                  "Allow: GET\r\n"
+                                  "Content-Length: 0\r\n\r\n";
+
+                send_all(sock, rsp, strlen(rsp));
+                return;
+        }
+        if(0 != strncmp(req + 4, "/ ", 2) &&
+           0 != strncmp(req + 4, "/metrics ", 9) &&
+           0 != strncmp(req + 4, "/metrics?", 9)) {
+                const char *rsp = "HTTP/1.0 404 Not Found\r\n"
+                                  "Content-Length: 0\r\n\r\n";
+
+                send_all(sock, rsp, strlen(rsp));
+                return;
+        }
+
+        /* copy snapshot, then send without lock */
+        pthread_mutex_lock(&(mtr->mux));
+        len = mtr->len;
+        if(len > mtr->out_max) {
+                char *p = (char *)realloc(mtr->out, len);
+
+                if(NULL == p) {
+                        pthread_mutex_unlock(&(mtr->mux));
+                        RPTERR("realloc failed");
+                        return;
+                }
+                mtr->out = p;
+                mtr->out_max = len;
+        }
+        if(len) {
+                memcpy(mtr->out, mtr->text, len);
+        }
+        pthread_mutex_unlock(&(mtr->mux));
+
+        hlen = snprintf(head, sizeof(head),
+                        "HTTP/1.0 200 OK\r\n"
+                        "Content-Type: text/plain; version=0.0.4; charset=utf-8\r\n"
+                        "Content-Length: %zu\r\n"
+                        "\r\n", len);
+        if(0 != send_all(sock, head, (size_t)hlen)) {
+                return;
+        }
+        send_all(sock, mtr->out, len);
+        return;
+}
+
+static int send_all(int sock, const char *buf, size_t len)
+{
+        while(len) {
+                ssize_t rslt = send(sock, buf, len, MSG_NOSIGNAL);
+
+                if(rslt <= 0) {
+                        RPTDBG("send failed");
+                        return -1;
+                }
+                buf += rslt;
+                len -= (size_t)rslt;
+        }
+        return 0;
+}
+#else /* SYS_WINDOWS */
+intptr_t mtr_open(const char *addr)
+{
+        RPTERR("metrics server is not supported on this system: \"%s\"", addr);
+        return (intptr_t)NULL;
+}
+
+int mtr_close(intptr_t id)
+{
+        return -1;
+}
+
+int mtr_update(intptr_t id, const char *text, size_t len)
+{
+        return -1;
+}
+#endif
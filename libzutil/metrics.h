@@ -0,0 +1,29 @@
+/* vim: set tabstop=8 shiftwidth=8:
+ * name: metrics.h
+ * funx: serve text snapshot of metrics over HTTP, for Prometheus scraper
+ */
+
+#ifndef _METRICS_H
+#define _METRICS_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <sys/types.h> /* for size_t, etc */
+#include <stdint.h> /* for intptr_t, etc */
+
+/* addr: "[ip]:port" on TCP, 127.0.0.1 if no ip; "unix:<path>" on unix socket */
+intptr_t mtr_open(const char *addr);
+int mtr_close(intptr_t id);
+
+/* copy text as the snapshot to serve, never wait for the server thread:
+ * return 1 and do nothing if a scraper is copying the old snapshot now
+ */
+int mtr_update(intptr_t id, const char *text, size_t len);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _METRICS_H */
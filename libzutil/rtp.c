@@ -0,0 +1,558 @@
+/* vim: set tabstop=8 shiftwidth=8:
+ * name: rtp.c
+ * funx: RTP access, over UDP, with reorder window and FEC(SMPTE 2022-1)
+ *
+ * FEC: column FEC on port + 2, row FEC on port + 4, used when the sender
+ *      has them. Packets are kept after output for FEC, a lost packet is
+ *      rebuilt when it is the only one missing in a row or column.
+ *      FEC datagram is bad if it is not XOR of payload type 96, its D bit
+ *      is not of its port, or L and D are out of the limits of 2022-1.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "config.h" /* for HAVE_VECTOREXT, generated by configure */
+#include "common.h"
+#include "udp.h"
+#include "rtp.h"
+
+static int rpt_lvl = WRN_LVL; /* report level: ERR, WRN, INF, DBG */
+
+#define RTP_LENGTH_MAX  (1536) /* as UDP_LENGTH_MAX */
+#define RTP_WIN         (32) /* reorder window without FEC, in datagram */
+#define RTP_SLOT        (256) /* reorder window with FEC, and packets kept for FEC */
+#define RTP_FEC_MAX     (64) /* FEC packets kept */
+#define RTP_FEC_HEAD    (16) /* FEC head after RTP head */
+#define RTP_FEC_PT      (96) /* RTP payload type of FEC stream */
+#define RTP_FEC_L_MAX   (20) /* 1 <= L <= 20 */
+#define RTP_FEC_D_MIN   (4) /* 4 <= D <= 20 */
+#define RTP_FEC_D_MAX   (20)
+#define RTP_FEC_LD_MAX  (100) /* L x D <= 100 */
+#define RTP_PATH        (3) /* media, column FEC, row FEC */
+#define RTP_CLK         (300) /* 90kHz RTP clk to 27MHz */
+#define RTP_OVF         ((((int64_t)1) << 33) * 300) /* as STC_OVF */
+
+enum slot_state {
+        SLOT_EMPTY,
+        SLOT_WAIT, /* wait for output */
+        SLOT_DONE /* output or given up, kept for FEC */
+};
+
+struct rtp_slot {
+        int state; /* SLOT_XXX */
+        uint16_t seq;
+        uint32_t ts;
+        size_t off; /* RTP head length */
+        size_t len; /* payload length */
+        uint8_t *buf;
+};
+
+struct rtp_fec {
+        int is_used;
+        uint16_t base; /* SNBase */
+        int offset; /* 1: row, L: column */
+        int na; /* packets protected */
+        uint16_t len_rec; /* length recovery */
+        uint32_t ts_rec; /* TS recovery */
+        size_t len; /* payload length */
+        uint8_t *buf; /* payload at buf + RTP_LENGTH_MAX - len */
+};
+
+struct rtp {
+        intptr_t udp[RTP_PATH];
+        int npath; /* 1: no FEC socket */
+        int ready; /* mask of udp[] readable */
+
+        /* reorder window: slot[seq % RTP_SLOT] */
+        int is_sync;
+        int win; /* RTP_WIN, or more for FEC matrix */
+        uint16_t next; /* seq to output */
+        uint16_t max_seq; /* max seq received */
+        int cnt_pending; /* datagram in slot[] */
+        struct rtp_slot slot[RTP_SLOT];
+        uint8_t *spare; /* buffer to receive */
+        uint8_t *mem;
+
+        /* FEC */
+        struct rtp_fec fec[RTP_FEC_MAX];
+        int fec_wr;
+
+        /* RTP timestamp extended to 64-bit */
+        int has_ts;
+        uint32_t lts;
+        int64_t ext;
+
+        /* statistic */
+        uint64_t cnt_pkt;
+        uint64_t cnt_lost; /* not recovered */
+        uint64_t cnt_fec; /* FEC packets */
+        uint64_t cnt_recover; /* recovered by FEC */
+        uint64_t cnt_reorder;
+        uint64_t cnt_dup;
+        uint64_t cnt_late;
+        uint64_t cnt_bad;
+};
+
+static void xor_buf(uint8_t *dst, const uint8_t *src, size_t len);
+static struct rtp_slot *slot_get(struct rtp *rtp, uint16_t seq);
+static void fec_push(struct rtp *rtp, struct rtp_fec *f, size_t len, int is_row);
+static void fec_recover(struct rtp *rtp);
+
+int rtp_head(const uint8_t *buf, size_t len, size_t *plen, uint16_t *seq, uint32_t *ts)
+{
+        size_t hlen;
+        size_t pad = 0;
+
+        if(len < 12 || 0x80 != (buf[0] & 0xC0)) {
+                return -1; /* not version 2 */
+        }
+        hlen = 12 + (size_t)(buf[0] & 0x0F) * 4; /* CSRC */
+        if(buf[0] & 0x10) {
+                /* header extension */
+                if(hlen + 4 > len) {
+                        return -1;
+                }
+                hlen += 4 + (size_t)((buf[hlen + 2] << 8) | buf[hlen + 3]) * 4;
+        }
+        if(buf[0] & 0x20) {
+                pad = buf[len - 1];
+        }
+        if(hlen + pad > len) {
+                return -1;
+        }
+
+        if(plen) {
+                *plen = len - hlen - pad;
+        }
+        if(seq) {
+                *seq = (uint16_t)((buf[2] << 8) | buf[3]);
+        }
+        if(ts) {
+                *ts = ((uint32_t)buf[4] << 24) | ((uint32_t)buf[5] << 16) | ((uint32_t)buf[6] << 8) | buf[7];
+        }
+        return (int)hlen;
+}
+
+intptr_t rtp_open(char *src_addr, char *addr, unsigned short port)
+{
+        struct rtp *rtp;
+        uint8_t *p;
+        int i;
+
+        rtp = (struct rtp *)malloc(sizeof(struct rtp));
+        if(NULL == rtp) {
+                RPTERR("malloc failed");
+                return (intptr_t)NULL;
+        }
+        memset(rtp, 0, sizeof(struct rtp));
+        rtp->win = RTP_WIN;
+
+        /* one more buffer to receive */
+        rtp->mem = (uint8_t *)malloc((RTP_SLOT + 1 + RTP_FEC_MAX) * RTP_LENGTH_MAX);
+        if(NULL == rtp->mem) {
+                RPTERR("malloc failed");
+                free(rtp);
+                return (intptr_t)NULL;
+        }
+        p = rtp->mem;
+        rtp->spare = p;
+        p += RTP_LENGTH_MAX;
+        for(i = 0; i < RTP_SLOT; i++, p += RTP_LENGTH_MAX) {
+                rtp->slot[i].buf = p;
+        }
+        for(i = 0; i < RTP_FEC_MAX; i++, p += RTP_LENGTH_MAX) {
+                rtp->fec[i].buf = p;
+        }
+
+        rtp->udp[0] = udp_open(src_addr, addr, port, "rb");
+        if(0 == rtp->udp[0]) {
+                free(rtp->mem);
+                free(rtp);
+                return (intptr_t)NULL;
+        }
+        rtp->npath = 1;
+        if(port <= 65535 - 4) {
+                /* FEC of the sender, if any */
+                rtp->udp[1] = udp_open(src_addr, addr, port + 2, "rb");
+                rtp->udp[2] = udp_open(src_addr, addr, port + 4, "rb");
+                if(rtp->udp[1] && rtp->udp[2]) {
+                        rtp->npath = RTP_PATH;
+                }
+                else {
+                        RPTWRN("no FEC: port %u or %u busy", port + 2, port + 4);
+                        if(rtp->udp[1]) {
+                                udp_close(rtp->udp[1]);
+                        }
+                        if(rtp->udp[2]) {
+                                udp_close(rtp->udp[2]);
+                        }
+                }
+        }
+        return (intptr_t)rtp;
+}
+
+int rtp_close(intptr_t id)
+{
+        struct rtp *rtp = (struct rtp *)id;
+        int i;
+
+        if(NULL == rtp) {
+                RPTERR("bad id");
+                return -1;
+        }
+
+        if(rtp->cnt_lost || rtp->cnt_recover || rtp->cnt_reorder || rtp->cnt_dup || rtp->cnt_late || rtp->cnt_bad) {
+                RPTWRN("RTP: %llu datagram, %llu lost, %llu reordered, %llu duplicate, %llu late, %llu bad",
+                       (unsigned long long)rtp->cnt_pkt,
+                       (unsigned long long)rtp->cnt_lost,
+                       (unsigned long long)rtp->cnt_reorder,
+                       (unsigned long long)rtp->cnt_dup,
+                       (unsigned long long)rtp->cnt_late,
+                       (unsigned long long)rtp->cnt_bad);
+        }
+        if(rtp->cnt_fec) {
+                RPTWRN("FEC: %llu packet, %llu recovered, %llu unrecoverable",
+                       (unsigned long long)rtp->cnt_fec,
+                       (unsigned long long)rtp->cnt_recover,
+                       (unsigned long long)rtp->cnt_lost);
+        }
+        for(i = 0; i < rtp->npath; i++) {
+                udp_close(rtp->udp[i]);
+        }
+        free(rtp->mem);
+        free(rtp);
+        return 0;
+}
+
+/* next payload in seq order; 0 or -1 when udp_read failed */
+ssize_t rtp_read(intptr_t id, uint8_t **data, int64_t *CTS)
+{
+        struct rtp *rtp = (struct rtp *)id;
+
+        if(NULL == rtp) {
+                RPTERR("bad id");
+                return -1;
+        }
+
+        while(1) {
+                struct rtp_slot *slot;
+                ssize_t rslt;
+                int hlen;
+                size_t plen;
+                uint16_t seq;
+                uint32_t ts;
+                int16_t d;
+                int p;
+                uint8_t *buf;
+
+                /* output in seq order */
+                slot = slot_get(rtp, rtp->next);
+                if(rtp->is_sync && slot && SLOT_WAIT == slot->state) {
+                        if(!(rtp->has_ts)) {
+                                rtp->has_ts = 1;
+                                rtp->ext = slot->ts;
+                        }
+                        else {
+                                rtp->ext += (int32_t)(slot->ts - rtp->lts);
+                        }
+                        rtp->lts = slot->ts;
+                        *CTS = ((rtp->ext * RTP_CLK) % RTP_OVF + RTP_OVF) % RTP_OVF;
+                        *data = slot->buf + slot->off;
+
+                        slot->state = SLOT_DONE;
+                        rtp->cnt_pending--;
+                        rtp->next++;
+                        return (ssize_t)(slot->len);
+                }
+
+                /* window full or passed: try FEC, then give up the lost one */
+                if(rtp->cnt_pending >= rtp->win - 1 ||
+                   (rtp->cnt_pending && (int16_t)(rtp->max_seq - rtp->next) >= rtp->win)) {
+                        if(rtp->cnt_fec) {
+                                fec_recover(rtp);
+                                slot = slot_get(rtp, rtp->next);
+                                if(slot && SLOT_WAIT == slot->state) {
+                                        continue;
+                                }
+                        }
+                        rtp->next++;
+                        rtp->cnt_lost++;
+                        continue;
+                }
+
+                /* receive, media first */
+                if(0 == rtp->ready) {
+                        rtp->ready = ((1 == rtp->npath) ? 1 : udp_wait(rtp->udp, rtp->npath));
+                        if(rtp->ready <= 0) {
+                                rtp->ready = 0;
+                                return 0;
+                        }
+                }
+                for(p = 0; !(rtp->ready & (1 << p)); p++) {
+                }
+                rtp->ready &= ~(1 << p);
+
+                if(p > 0) {
+                        /* FEC, overwrite the oldest */
+                        struct rtp_fec *f = &(rtp->fec[rtp->fec_wr]);
+
+                        rslt = udp_read(rtp->udp[p], f->buf);
+                        if(rslt > 0) {
+                                fec_push(rtp, f, (size_t)rslt, (2 == p));
+                        }
+                        continue;
+                }
+
+                rslt = udp_read(rtp->udp[0], rtp->spare);
+                if(rslt <= 0) {
+                        return rslt;
+                }
+                hlen = rtp_head(rtp->spare, (size_t)rslt, &plen, &seq, &ts);
+                if(hlen < 0) {
+                        rtp->cnt_bad++;
+                        continue;
+                }
+                rtp->cnt_pkt++;
+
+                if(!(rtp->is_sync)) {
+                        rtp->is_sync = 1;
+                        rtp->next = seq;
+                        rtp->max_seq = seq;
+                }
+                d = (int16_t)(seq - rtp->next);
+                if(d < 0) {
+                        slot = slot_get(rtp, seq);
+                        if(slot) {
+                                rtp->cnt_dup++;
+                        }
+                        else {
+                                rtp->cnt_late++; /* it has been given up */
+                        }
+                        continue;
+                }
+                if(d >= RTP_SLOT - 1) {
+                        /* sender restart or too much lost, restart the window */
+                        int i;
+
+                        RPTWRN("RTP seq jump: %u -> %u", rtp->next, seq);
+                        rtp->cnt_lost += (uint64_t)d;
+                        for(i = 0; i < RTP_SLOT; i++) {
+                                rtp->slot[i].state = SLOT_EMPTY;
+                        }
+                        for(i = 0; i < RTP_FEC_MAX; i++) {
+                                rtp->fec[i].is_used = 0;
+                        }
+                        rtp->cnt_pending = 0;
+                        rtp->next = seq;
+                        rtp->max_seq = seq;
+                }
+                if((int16_t)(seq - rtp->max_seq) < 0) {
+                        rtp->cnt_reorder++;
+                }
+                else {
+                        rtp->max_seq = seq;
+                }
+
+                slot = &(rtp->slot[seq % RTP_SLOT]);
+                if(SLOT_WAIT == slot->state && slot->seq == seq) {
+                        rtp->cnt_dup++;
+                        continue;
+                }
+                buf = slot->buf;
+                slot->buf = rtp->spare;
+                rtp->spare = buf;
+                slot->state = SLOT_WAIT;
+                slot->seq = seq;
+                slot->ts = ts;
+                slot->off = (size_t)hlen;
+                slot->len = plen;
+                rtp->cnt_pending++;
+        }
+}
+
+/* dst ^= src */
+static void xor_buf(uint8_t *dst, const uint8_t *src, size_t len)
+{
+        size_t i = 0;
+
+#ifdef HAVE_VECTOREXT
+        typedef uint8_t v16u8 __attribute__ ((vector_size (16)));
+
+        for(; i + 16 <= len; i += 16) {
+                v16u8 a;
+                v16u8 b;
+
+                memcpy(&a, dst + i, 16); /* unaligned load */
+                memcpy(&b, src + i, 16);
+                a ^= b;
+                memcpy(dst + i, &a, 16);
+        }
+#endif
+        for(; i < len; i++) {
+                dst[i] ^= src[i];
+        }
+}
+
+/* slot with packet of seq, NULL if not here */
+static struct rtp_slot *slot_get(struct rtp *rtp, uint16_t seq)
+{
+        struct rtp_slot *slot = &(rtp->slot[seq % RTP_SLOT]);
+
+        return ((SLOT_EMPTY != slot->state && slot->seq == seq) ? slot : NULL);
+}
+
+/* check FEC datagram in f->buf, keep it
+ * is_row: 0, column FEC from port + 2; 1, row FEC from port + 4
+ */
+static void fec_push(struct rtp *rtp, struct rtp_fec *f, size_t len, int is_row)
+{
+        uint8_t *h;
+        int hlen;
+        size_t plen;
+        int need;
+
+        hlen = rtp_head(f->buf, len, &plen, NULL, NULL);
+        if(hlen < 0 || plen <= RTP_FEC_HEAD || RTP_FEC_PT != (f->buf[1] & 0x7F)) {
+                rtp->cnt_bad++;
+                return;
+        }
+        h = f->buf + hlen;
+        if(is_row != ((h[12] >> 6) & 0x01) || /* D: 0, column; 1, row */
+           0 != ((h[12] >> 3) & 0x07)) { /* type: 0, XOR */
+                rtp->cnt_bad++;
+                return;
+        }
+        f->base = (uint16_t)((h[0] << 8) | h[1]);
+        f->len_rec = (uint16_t)((h[2] << 8) | h[3]);
+        f->ts_rec = ((uint32_t)h[8] << 24) | ((uint32_t)h[9] << 16) | ((uint32_t)h[10] << 8) | h[11];
+        f->offset = h[13];
+        f->na = h[14];
+        f->len = plen - RTP_FEC_HEAD;
+        if(f->len_rec > f->len) {
+                rtp->cnt_bad++;
+                return;
+        }
+        if(is_row) {
+                /* offset 1, NA is L */
+                if(1 != f->offset || f->na < 1 || f->na > RTP_FEC_L_MAX) {
+                        rtp->cnt_bad++;
+                        return;
+                }
+        }
+        else {
+                /* offset is L, NA is D */
+                if(f->offset < 1 || f->offset > RTP_FEC_L_MAX ||
+                   f->na < RTP_FEC_D_MIN || f->na > RTP_FEC_D_MAX ||
+                   f->offset * f->na > RTP_FEC_LD_MAX) {
+                        rtp->cnt_bad++;
+                        return;
+                }
+        }
+
+        /* payload to the end of buffer, room for recover */
+        memmove(f->buf + RTP_LENGTH_MAX - f->len, h + RTP_FEC_HEAD, f->len);
+        f->is_used = 1;
+        rtp->fec_wr = (rtp->fec_wr + 1) % RTP_FEC_MAX;
+        rtp->cnt_fec++;
+
+        /* wait for the whole matrix and its column FEC */
+        need = 2 * f->offset * f->na + f->offset;
+        if(need > rtp->win) {
+                rtp->win = ((need < RTP_SLOT - 1) ? need : (RTP_SLOT - 1));
+                RPTINF("FEC: %d x %d, window %d", f->offset, f->na, rtp->win);
+        }
+
+        /* a hole for output? */
+        if(rtp->cnt_pending && NULL == slot_get(rtp, rtp->next)) {
+                fec_recover(rtp);
+        }
+}
+
+/* rebuild packets which are the only one missing in a FEC group, repeat for 2D */
+static void fec_recover(struct rtp *rtp)
+{
+        int progress = 1;
+
+        while(progress) {
+                int i;
+
+                progress = 0;
+                for(i = 0; i < RTP_FEC_MAX; i++) {
+                        struct rtp_fec *f = &(rtp->fec[i]);
+                        struct rtp_slot *slot;
+                        int missing = 0;
+                        uint16_t lost = 0;
+                        uint16_t len_rec;
+                        uint32_t ts_rec;
+                        uint8_t *buf;
+                        int16_t d;
+                        int k;
+
+                        if(!(f->is_used)) {
+                                continue;
+                        }
+                        for(k = 0; k < f->na && missing < 2; k++) {
+                                uint16_t seq = (uint16_t)(f->base + k * f->offset);
+
+                                if(NULL == slot_get(rtp, seq)) {
+                                        missing++;
+                                        lost = seq;
+                                }
+                        }
+                        if(0 == missing) {
+                                f->is_used = 0; /* all here */
+                                continue;
+                        }
+                        d = (int16_t)(lost - rtp->next);
+                        if(1 != missing || d >= rtp->win || d < rtp->win - RTP_SLOT ||
+                           (int16_t)(rtp->max_seq - lost) >= RTP_SLOT - 1) {
+                                continue;
+                        }
+
+                        /* slot of a newer packet, waiting or kept for FEC: too late for lost */
+                        slot = &(rtp->slot[lost % RTP_SLOT]);
+                        if(SLOT_EMPTY != slot->state && (int16_t)(slot->seq - lost) > 0) {
+                                continue;
+                        }
+
+                        /* payload ^ all others */
+                        buf = slot->buf;
+                        memcpy(buf, f->buf + RTP_LENGTH_MAX - f->len, f->len);
+                        len_rec = f->len_rec;
+                        ts_rec = f->ts_rec;
+                        for(k = 0; k < f->na; k++) {
+                                uint16_t seq = (uint16_t)(f->base + k * f->offset);
+                                struct rtp_slot *s;
+
+                                if(seq == lost) {
+                                        continue;
+                                }
+                                s = slot_get(rtp, seq);
+                                xor_buf(buf, s->buf + s->off, ((s->len < f->len) ? s->len : f->len));
+                                len_rec ^= (uint16_t)(s->len);
+                                ts_rec ^= s->ts;
+                        }
+                        if(len_rec > f->len) {
+                                f->is_used = 0;
+                                continue;
+                        }
+
+                        slot->seq = lost;
+                        slot->ts = ts_rec;
+                        slot->off = 0;
+                        slot->len = len_rec;
+                        if(d >= 0) {
+                                slot->state = SLOT_WAIT;
+                                rtp->cnt_pending++;
+                        }
+                        else {
+                                slot->state = SLOT_DONE; /* too late, for other FEC */
+                        }
+                        f->is_used = 0;
+                        rtp->cnt_recover++;
+                        progress = 1;
+                }
+        }
+}
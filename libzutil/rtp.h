@@ -0,0 +1,27 @@
+/* vim: set tabstop=8 shiftwidth=8:
+ * name: rtp.h
+ * funx: RTP access, over UDP
+ */
+
+#ifndef _RTP_H
+#define _RTP_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <sys/types.h> /* for ssize_t, etc */
+#include <stdint.h> /* for uint?_t, etc */
+
+/* RTP head length, -1 if not RTP; plen: payload length without padding */
+int rtp_head(const uint8_t *buf, size_t len, size_t *plen, uint16_t *seq, uint32_t *ts);
+
+intptr_t rtp_open(char *src_addr, char *addr, unsigned short port);
+int rtp_close(intptr_t id);
+ssize_t rtp_read(intptr_t id, uint8_t **data, int64_t *CTS); /* CTS: RTP timestamp, 27MHz */
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _RTP_H */
@@ -0,0 +1,521 @@
+/* vim: set tabstop=8 shiftwidth=8:
+ * name: tshift.c
+ * funx: time-shift store, circular file of TS packets with PCR time index
+ *
+ * file: | head(4KB) | index[TSH_IDX_MAX] | TS data ring(size) |
+ * head and index are mapped shared, readers follow the writer with them
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "config.h" /* for SYS_* macro, generated by configure */
+
+#ifndef SYS_WINDOWS
+#       include <sys/types.h>
+#       include <sys/stat.h>
+#       include <sys/mman.h> /* for mmap(), etc */
+#       include <sys/time.h> /* for gettimeofday() */
+#       include <fcntl.h> /* for open(), posix_fallocate() */
+#       include <unistd.h> /* for pread(), pwrite(), usleep(), etc */
+#endif
+
+#include "common.h"
+#include "tshift.h"
+
+static int rpt_lvl = WRN_LVL; /* report level: ERR, WRN, INF, DBG */
+
+#define TSH_MAGIC       "TSSHIFT"
+#define TSH_PKT         (188)
+#define TSH_HEAD        (4096)
+#define TSH_IDX_MAX     (1 << 18) /* 7 hours with TSH_IDX_GAP */
+#define TSH_IDX_GAP     (100 * 27000) /* 100ms, 27MHz clk */
+#define TSH_IDX_SAFE    (1024) /* index entries the writer may touch before publish */
+#define TSH_SAFE        (TSH_PKT * 4096) /* data the writer may touch before publish */
+#define TSH_RBUF        (TSH_PKT * 1024) /* read buffer of reader */
+#define TSH_CLK         (27000000)
+#define TSH_OVF         ((((int64_t)1) << 33) * 300) /* as STC_OVF */
+#define TSH_JUMP        (TSH_CLK) /* PCR jump: discontinuity or wrap back */
+#define TSH_POLL        (10000) /* us, reader wait for writer */
+
+struct tsh_head {
+        char magic[8];
+        int64_t size; /* TS data ring, N * TSH_PKT */
+        int64_t data_off; /* data ring in file */
+        int64_t idx_max;
+        volatile int64_t wr; /* TS data written in total */
+        volatile int64_t idx_wr; /* index entries written in total */
+        volatile int64_t is_live; /* writer is running */
+};
+
+struct tsh_idx {
+        int64_t pos; /* packet with PCR, in total TS data */
+        int64_t t; /* 27MHz clk, from PCR, no wrap */
+};
+
+struct tsh {
+        int is_writer;
+        int fd;
+        struct tsh_head *head; /* mapped */
+        struct tsh_idx *idx; /* mapped */
+        size_t map_len;
+
+        /* writer: time from PCR */
+        int pcr_pid; /* -1: lock on first PID with PCR */
+        int has_t;
+        int64_t lPCR;
+        int64_t t;
+        int64_t idx_t; /* t of last index entry */
+        int64_t lwall; /* us, for PCR jump */
+
+        /* reader */
+        uint8_t *buf;
+        int64_t pos; /* buf[0] in total TS data */
+        size_t blen;
+        size_t bpos;
+        int64_t k; /* index entry before current packet, -1 for none */
+};
+
+#ifndef SYS_WINDOWS
+static int64_t wall_us(void);
+static int idx_get(struct tsh *tsh, int64_t n, struct tsh_idx *e);
+static int64_t tsh_oldest(struct tsh *tsh, int64_t wr);
+static int64_t tsh_seek(struct tsh *tsh, int back);
+static int64_t tsh_cts(struct tsh *tsh, int64_t p);
+
+intptr_t tsh_create(const char *fname, int64_t size)
+{
+        struct tsh *tsh;
+        int64_t data_off = TSH_HEAD + (int64_t)TSH_IDX_MAX * sizeof(struct tsh_idx);
+
+        size -= size % TSH_SAFE;
+        if(size < 2 * TSH_SAFE) {
+                RPTERR("time-shift size too small");
+                return (intptr_t)NULL;
+        }
+
+        tsh = (struct tsh *)malloc(sizeof(struct tsh));
+        if(NULL == tsh) {
+                RPTERR("malloc failed");
+                return (intptr_t)NULL;
+        }
+        memset(tsh, 0, sizeof(struct tsh));
+        tsh->is_writer = 1;
+        tsh->pcr_pid = -1;
+
+        /* no O_TRUNC, readers may have it mapped */
+        tsh->fd = open(fname, O_RDWR | O_CREAT, 0644);
+        if(tsh->fd < 0 ||
+           0 != ftruncate(tsh->fd, (off_t)(data_off + size)) ||
+           0 != posix_fallocate(tsh->fd, 0, (off_t)(data_off + size))) {
+                RPTERR("create \"%s\" failed", fname);
+                if(tsh->fd >= 0) {
+                        close(tsh->fd);
+                }
+                free(tsh);
+                return (intptr_t)NULL;
+        }
+
+        tsh->map_len = (size_t)data_off;
+        tsh->head = (struct tsh_head *)mmap(NULL, tsh->map_len, PROT_READ | PROT_WRITE, MAP_SHARED, tsh->fd, 0);
+        if(MAP_FAILED == (void *)(tsh->head)) {
+                RPTERR("mmap \"%s\" failed", fname);
+                close(tsh->fd);
+                free(tsh);
+                return (intptr_t)NULL;
+        }
+        tsh->idx = (struct tsh_idx *)((uint8_t *)(tsh->head) + TSH_HEAD);
+
+        tsh->head->wr = 0; /* readers restart with it */
+        tsh->head->idx_wr = 0;
+        __sync_synchronize();
+        memcpy(tsh->head->magic, TSH_MAGIC, 8);
+        tsh->head->size = size;
+        tsh->head->data_off = data_off;
+        tsh->head->idx_max = TSH_IDX_MAX;
+        tsh->head->is_live = 1;
+        return (intptr_t)tsh;
+}
+
+ssize_t tsh_write(intptr_t id, const uint8_t *buf, size_t len)
+{
+        struct tsh *tsh = (struct tsh *)id;
+        struct tsh_head *head;
+        int64_t wr;
+        int64_t idx_wr;
+        int64_t off;
+        size_t n1;
+        size_t i;
+
+        if(NULL == tsh || !(tsh->is_writer)) {
+                RPTERR("bad id");
+                return -1;
+        }
+        head = tsh->head;
+        wr = head->wr;
+        idx_wr = head->idx_wr;
+        len -= len % TSH_PKT;
+        if(len > TSH_SAFE) {
+                /* readers keep TSH_SAFE away from the writer */
+                size_t done;
+
+                for(done = 0; done < len; done += TSH_SAFE) {
+                        size_t n = ((len - done < TSH_SAFE) ? (len - done) : TSH_SAFE);
+
+                        if((ssize_t)n != tsh_write(id, buf + done, n)) {
+                                return -1;
+                        }
+                }
+                return (ssize_t)len;
+        }
+
+        /* index: PCR of one PID */
+        for(i = 0; i < len; i += TSH_PKT) {
+                const uint8_t *p = buf + i;
+                int pid = ((p[1] & 0x1F) << 8) | p[2];
+                int64_t PCR;
+                int64_t dt;
+
+                if(0x47 != p[0] || !(p[3] & 0x20) || p[4] < 7 || !(p[5] & 0x10)) {
+                        continue; /* no PCR */
+                }
+                if(tsh->pcr_pid < 0) {
+                        tsh->pcr_pid = pid;
+                }
+                if(pid != tsh->pcr_pid) {
+                        continue;
+                }
+                PCR = ((int64_t)p[6] << 25) | ((int64_t)p[7] << 17) | ((int64_t)p[8] << 9) |
+                      ((int64_t)p[9] << 1) | (p[10] >> 7);
+                PCR = PCR * 300 + (((p[10] & 0x01) << 8) | p[11]);
+
+                if(!(tsh->has_t)) {
+                        tsh->has_t = 1;
+                        tsh->t = 0;
+                        tsh->idx_t = -TSH_IDX_GAP;
+                }
+                else {
+                        dt = (PCR - tsh->lPCR + TSH_OVF) % TSH_OVF;
+                        if(dt > TSH_JUMP) {
+                                /* discontinuity, go on with wall-clock */
+                                dt = (wall_us() - tsh->lwall) * (TSH_CLK / 1000000);
+                                RPTWRN("PCR jump, use wall-clock: +%lldms", (long long)(dt / 27000));
+                        }
+                        tsh->t += dt;
+                }
+                tsh->lPCR = PCR;
+                tsh->lwall = wall_us();
+
+                if(tsh->t - tsh->idx_t >= TSH_IDX_GAP) {
+                        struct tsh_idx *e = &(tsh->idx[idx_wr % TSH_IDX_MAX]);
+
+                        e->pos = wr + (int64_t)i;
+                        e->t = tsh->t;
+                        tsh->idx_t = tsh->t;
+                        idx_wr++;
+                }
+        }
+
+        /* data, maybe two pieces at the end of ring */
+        off = wr % head->size;
+        n1 = (size_t)(head->size - off);
+        if(n1 > len) {
+                n1 = len;
+        }
+        if((ssize_t)n1 != pwrite(tsh->fd, buf, n1, (off_t)(head->data_off + off)) ||
+           (len > n1 && (ssize_t)(len - n1) != pwrite(tsh->fd, buf + n1, len - n1, (off_t)(head->data_off)))) {
+                RPTERR("write time-shift data failed");
+                return -1;
+        }
+
+        /* publish */
+        __sync_synchronize();
+        head->idx_wr = idx_wr;
+        head->wr = wr + (int64_t)len;
+        return (ssize_t)len;
+}
+
+intptr_t tsh_open(const char *fname, int back)
+{
+        struct tsh *tsh;
+        struct tsh_head h;
+
+        tsh = (struct tsh *)malloc(sizeof(struct tsh));
+        if(NULL == tsh) {
+                RPTERR("malloc failed");
+                return (intptr_t)NULL;
+        }
+        memset(tsh, 0, sizeof(struct tsh));
+
+        tsh->fd = open(fname, O_RDONLY);
+        if(tsh->fd < 0 ||
+           sizeof(h) != pread(tsh->fd, &h, sizeof(h), 0) ||
+           0 != memcmp(h.magic, TSH_MAGIC, 8) ||
+           TSH_IDX_MAX != h.idx_max) {
+                RPTERR("\"%s\" is not a time-shift file", fname);
+                if(tsh->fd >= 0) {
+                        close(tsh->fd);
+                }
+                free(tsh);
+                return (intptr_t)NULL;
+        }
+
+        tsh->map_len = (size_t)(h.data_off);
+        tsh->head = (struct tsh_head *)mmap(NULL, tsh->map_len, PROT_READ, MAP_SHARED, tsh->fd, 0);
+        tsh->buf = (uint8_t *)malloc(TSH_RBUF);
+        if(MAP_FAILED == (void *)(tsh->head) || NULL == tsh->buf) {
+                RPTERR("map \"%s\" failed", fname);
+                close(tsh->fd);
+                free(tsh->buf);
+                free(tsh);
+                return (intptr_t)NULL;
+        }
+        tsh->idx = (struct tsh_idx *)((uint8_t *)(tsh->head) + TSH_HEAD);
+
+        tsh->pos = tsh_seek(tsh, back);
+        tsh->k = -1;
+        return (intptr_t)tsh;
+}
+
+ssize_t tsh_read(intptr_t id, uint8_t **data, int64_t *CTS)
+{
+        struct tsh *tsh = (struct tsh *)id;
+        struct tsh_head *head;
+
+        if(NULL == tsh || tsh->is_writer) {
+                RPTERR("bad id");
+                return -1;
+        }
+        head = tsh->head;
+
+        /* refill */
+        while(tsh->bpos >= tsh->blen) {
+                int64_t wr;
+                int64_t avail;
+                int64_t off;
+                size_t n;
+                size_t n1;
+
+                tsh->pos += (int64_t)(tsh->blen);
+                tsh->blen = 0;
+                tsh->bpos = 0;
+
+                wr = head->wr;
+                __sync_synchronize();
+                if(wr < tsh->pos) {
+                        RPTWRN("time-shift writer restarted");
+                        tsh->pos = 0;
+                        tsh->k = -1;
+                }
+                if(tsh->pos < tsh_oldest(tsh, wr)) {
+                        RPTWRN("time-shift overrun, skip %lld-byte",
+                               (long long)(tsh_oldest(tsh, wr) - tsh->pos));
+                        tsh->pos = tsh_oldest(tsh, wr);
+                        tsh->k = -1;
+                }
+                avail = wr - tsh->pos;
+                if(0 == avail) {
+                        if(!(head->is_live)) {
+                                return 0; /* end of record */
+                        }
+                        usleep(TSH_POLL); /* live */
+                        continue;
+                }
+
+                n = (size_t)((avail < TSH_RBUF) ? avail : TSH_RBUF);
+                off = tsh->pos % head->size;
+                n1 = (size_t)(head->size - off);
+                if(n1 > n) {
+                        n1 = n;
+                }
+                if((ssize_t)n1 != pread(tsh->fd, tsh->buf, n1, (off_t)(head->data_off + off)) ||
+                   (n > n1 && (ssize_t)(n - n1) != pread(tsh->fd, tsh->buf + n1, n - n1, (off_t)(head->data_off)))) {
+                        RPTERR("read time-shift data failed");
+                        return -1;
+                }
+
+                /* overwritten during pread? */
+                __sync_synchronize();
+                if(tsh->pos < tsh_oldest(tsh, head->wr)) {
+                        continue;
+                }
+                tsh->blen = n;
+        }
+
+        *data = tsh->buf + tsh->bpos;
+        *CTS = tsh_cts(tsh, tsh->pos + (int64_t)(tsh->bpos));
+        tsh->bpos += TSH_PKT;
+        return TSH_PKT;
+}
+
+int tsh_close(intptr_t id)
+{
+        struct tsh *tsh = (struct tsh *)id;
+
+        if(NULL == tsh) {
+                RPTERR("bad id");
+                return -1;
+        }
+
+        if(tsh->is_writer) {
+                tsh->head->is_live = 0;
+                (void)msync(tsh->head, tsh->map_len, MS_ASYNC);
+        }
+        munmap(tsh->head, tsh->map_len);
+        close(tsh->fd);
+        free(tsh->buf);
+        free(tsh);
+        return 0;
+}
+
+static int64_t wall_us(void)
+{
+        struct timeval tv;
+
+        gettimeofday(&tv, NULL);
+        return (int64_t)tv.tv_sec * 1000000 + tv.tv_usec;
+}
+
+/* copy of entry n, -1 if not written or overwritten */
+static int idx_get(struct tsh *tsh, int64_t n, struct tsh_idx *e)
+{
+        int64_t idx_wr = tsh->head->idx_wr;
+
+        __sync_synchronize();
+        if(n < 0 || n >= idx_wr || n < idx_wr - TSH_IDX_MAX + TSH_IDX_SAFE) {
+                return -1;
+        }
+        *e = tsh->idx[n % TSH_IDX_MAX];
+        __sync_synchronize();
+        if(n < tsh->head->idx_wr - TSH_IDX_MAX + TSH_IDX_SAFE) {
+                return -1;
+        }
+        return 0;
+}
+
+/* oldest data safe to read */
+static int64_t tsh_oldest(struct tsh *tsh, int64_t wr)
+{
+        int64_t pos = wr - tsh->head->size + TSH_SAFE;
+
+        return ((pos > 0) ? pos : 0); /* N * TSH_PKT */
+}
+
+/* packet position back seconds before live */
+static int64_t tsh_seek(struct tsh *tsh, int back)
+{
+        int64_t oldest = tsh_oldest(tsh, tsh->head->wr);
+        int64_t idx_wr = tsh->head->idx_wr;
+        int64_t lo;
+        int64_t hi;
+        int64_t target;
+        struct tsh_idx e;
+
+        lo = idx_wr - TSH_IDX_MAX + TSH_IDX_SAFE;
+        lo = ((lo > 0) ? lo : 0);
+        hi = idx_wr - 1;
+        if(back < 0 || 0 != idx_get(tsh, hi, &e)) {
+                return oldest;
+        }
+
+        /* first entry: t >= target */
+        target = e.t - (int64_t)back * TSH_CLK;
+        while(lo < hi) {
+                int64_t mid = lo + (hi - lo) / 2;
+
+                if(0 != idx_get(tsh, mid, &e)) {
+                        return oldest;
+                }
+                if(e.t < target) {
+                        lo = mid + 1;
+                }
+                else {
+                        hi = mid;
+                }
+        }
+        if(0 != idx_get(tsh, lo, &e) || e.pos < oldest) {
+                RPTWRN("not so much data, from the oldest");
+                return oldest;
+        }
+        return e.pos;
+}
+
+/* time of packet at p, from the index around it */
+static int64_t tsh_cts(struct tsh *tsh, int64_t p)
+{
+        struct tsh_idx e0;
+        struct tsh_idx e1;
+
+        if(tsh->k < 0 || 0 != idx_get(tsh, tsh->k, &e0) || e0.pos > p) {
+                /* search again: last entry with pos <= p */
+                int64_t idx_wr = tsh->head->idx_wr;
+                int64_t lo = idx_wr - TSH_IDX_MAX + TSH_IDX_SAFE;
+                int64_t hi = idx_wr - 1;
+
+                lo = ((lo > 0) ? lo : 0);
+                tsh->k = -1;
+                while(lo <= hi) {
+                        int64_t mid = lo + (hi - lo) / 2;
+
+                        if(0 != idx_get(tsh, mid, &e0)) {
+                                return -1;
+                        }
+                        if(e0.pos <= p) {
+                                tsh->k = mid;
+                                lo = mid + 1;
+                        }
+                        else {
+                                hi = mid - 1;
+                        }
+                }
+                if(tsh->k < 0 || 0 != idx_get(tsh, tsh->k, &e0)) {
+                        tsh->k = -1;
+                        return -1;
+                }
+        }
+        while(0 == idx_get(tsh, tsh->k + 1, &e1) && e1.pos <= p) {
+                tsh->k++;
+                e0 = e1;
+        }
+
+        /* rate of the interval, or of the last one at live edge */
+        if(0 == idx_get(tsh, tsh->k + 1, &e1)) {
+                return (e0.t + (p - e0.pos) * (e1.t - e0.t) / (e1.pos - e0.pos)) % TSH_OVF;
+        }
+        if(0 == idx_get(tsh, tsh->k - 1, &e1) && e0.pos > e1.pos) {
+                return (e0.t + (p - e0.pos) * (e0.t - e1.t) / (e0.pos - e1.pos)) % TSH_OVF;
+        }
+        return e0.t % TSH_OVF;
+}
+
+#else /* SYS_WINDOWS */
+
+intptr_t tsh_create(const char *fname, int64_t size)
+{
+        RPTERR("time-shift is not supported");
+        return (intptr_t)NULL;
+}
+
+ssize_t tsh_write(intptr_t id, const uint8_t *buf, size_t len)
+{
+        return -1;
+}
+
+intptr_t tsh_open(const char *fname, int back)
+{
+        RPTERR("time-shift is not supported");
+        return (intptr_t)NULL;
+}
+
+ssize_t tsh_read(intptr_t id, uint8_t **data, int64_t *CTS)
+{
+        return -1;
+}
+
+int tsh_close(intptr_t id)
+{
+        return -1;
+}
+
+#endif
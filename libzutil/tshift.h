@@ -0,0 +1,30 @@
+/* vim: set tabstop=8 shiftwidth=8:
+ * name: tshift.h
+ * funx: time-shift store, circular file of TS packets with PCR time index
+ */
+
+#ifndef _TSHIFT_H
+#define _TSHIFT_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <sys/types.h> /* for ssize_t, etc */
+#include <stdint.h> /* for uint?_t, etc */
+
+/* writer: size of TS data in byte, one writer per file */
+intptr_t tsh_create(const char *fname, int64_t size);
+ssize_t tsh_write(intptr_t id, const uint8_t *buf, size_t len); /* len: N * 188 */
+
+/* reader: back: second before live, -1 for the oldest; run with writer */
+intptr_t tsh_open(const char *fname, int back);
+ssize_t tsh_read(intptr_t id, uint8_t **data, int64_t *CTS); /* one packet, CTS: -1 if unknown */
+
+int tsh_close(intptr_t id);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _TSHIFT_H */
@@ -149,6 +149,16 @@ intptr_t udp_open(char *src_addr, char *addr, unsigned short port, char *mode)
                 }
         }
 
+#ifdef IP_MULTICAST_ALL
+        /* only the group joined by this socket, e.g. two groups on one port */
+        if(IN_MULTICAST(ntohl(inet_addr(udp->addr)))) {
+                int all = 0;
+
+                setsockopt(udp->sock, IPPROTO_IP, IP_MULTICAST_ALL,
+                           (char *)&all, (socklen_t)sizeof(int));
+        }
+#endif
+
         udp->socklen = (socklen_t)sizeof(struct sockaddr_in);
         return (intptr_t)udp;
 }
@@ -215,6 +225,11 @@ ssize_t udp_read(intptr_t id, void *buf)
         FD_ZERO(&fds);
         FD_SET(udp->sock, &fds);
         if(select(udp->sock + 1, &fds, NULL, NULL, NULL) < 0) {
+#ifndef SYS_WINDOWS
+                if(EINTR == errno) {
+                        return 0; /* signal, e.g. Ctrl-C */
+                }
+#endif
                 report("select failed");
                 return 0;
         }
@@ -228,6 +243,39 @@ ssize_t udp_read(intptr_t id, void *buf)
         return rslt;
 }
 
+int udp_wait(const intptr_t *id, int n)
+{
+        fd_set fds;
+        int max = -1;
+        int mask = 0;
+        int i;
+
+        FD_ZERO(&fds);
+        for(i = 0; i < n; i++) {
+                struct udp *udp = (struct udp *)(id[i]);
+
+                FD_SET(udp->sock, &fds);
+                max = ((udp->sock > max) ? udp->sock : max);
+        }
+        if(select(max + 1, &fds, NULL, NULL, NULL) < 0) {
+#ifndef SYS_WINDOWS
+                if(EINTR == errno) {
+                        return -1; /* signal, e.g. Ctrl-C */
+                }
+#endif
+                report("select failed");
+                return -1;
+        }
+        for(i = 0; i < n; i++) {
+                struct udp *udp = (struct udp *)(id[i]);
+
+                if(FD_ISSET(udp->sock, &fds)) {
+                        mask |= (1 << i);
+                }
+        }
+        return mask;
+}
+
 ssize_t udp_write(intptr_t id, const void *buf, size_t len)
 {
         struct udp *udp = (struct udp *)id;
@@ -16,6 +16,7 @@ extern "C" {
 intptr_t udp_open(char *src_addr, char *addr, unsigned short port, char *mode);
 int udp_close(intptr_t id);
 ssize_t udp_read(intptr_t id, void *buf);
+int udp_wait(const intptr_t *id, int n); /* bit mask of readable id[i], -1 for error */
 ssize_t udp_write(intptr_t id, const void *buf, size_t len);
 
 #ifdef __cplusplus
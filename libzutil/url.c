@@ -19,6 +19,7 @@ static int parse_url(struct url *url, const char *str);
 struct url *url_open(const char *str, char *mode)
 {
         struct url *url;
+        struct url *alt = NULL; /* the other feed for SCH_MERGE */
 
         url = (struct url *)malloc(sizeof(struct url));
         if(NULL == url) {
@@ -32,11 +33,41 @@ struct url *url_open(const char *str, char *mode)
         url->port = 0;
         url->disk = NULL;
         url->path_fname = NULL;
-
-        if(0 != parse_url(url, str)) {
+        url->has_cts = 0;
+        url->CTS = 0;
+        url->back = -1;
+
+        if(NULL != strchr(str, '+') && 'r' == mode[0] &&
+           (0 == strncmp(str, "udp://", 6) || 0 == strncmp(str, "rtp://", 6))) {
+                /* two feeds: udp://maddr0:port0+maddr1:port1 */
+                char one[MAX_STRING_LENGTH];
+                char two[MAX_STRING_LENGTH];
+                const char *plus = strchr(str, '+');
+
+                alt = (struct url *)malloc(sizeof(struct url));
+                if(NULL == alt) {
+                        RPTERR("malloc 'struct url' failed");
+                        free(url);
+                        return NULL;
+                }
+                memcpy(alt, url, sizeof(struct url));
+                snprintf(one, sizeof(one), "%.*s", (int)(plus - str), str);
+                snprintf(two, sizeof(two), "%.6s%s", str, plus + 1);
+                if(0 != parse_url(url, one) || 0 != parse_url(alt, two)) {
+                        free(alt);
+                        free(url);
+                        return NULL;
+                }
+                url->is_rtp = (SCH_RTP == url->scheme);
+                url->scheme = SCH_MERGE;
+        }
+        else if(0 != parse_url(url, str)) {
                 free(url);
                 return NULL;
         }
+        if(SCH_LFILE == url->scheme && 'r' == mode[0] && cap_probe(url->path_fname)) {
+                url->scheme = SCH_PCAP; /* any UDP in local capture file */
+        }
 
         switch(url->scheme) {
                 case SCH_UDP:
@@ -49,6 +80,48 @@ struct url *url_open(const char *str, char *mode)
                                 url = NULL;
                         }
                         break;
+                case SCH_RTP:
+                        url->pbuf = NULL;
+                        url->ts_cnt = 0;
+                        url->rtp = rtp_open(url->user, url->host, url->port);
+                        if(0 == url->rtp) {
+                                printf("Socket error!\n");
+                                free(url);
+                                url = NULL;
+                        }
+                        break;
+                case SCH_MERGE:
+                        url->pbuf = NULL;
+                        url->ts_cnt = 0;
+                        url->mrg = mrg_open(url->is_rtp,
+                                            url->user, url->host, url->port,
+                                            alt->user, alt->host, alt->port);
+                        if(0 == url->mrg) {
+                                printf("Socket error!\n");
+                                free(url);
+                                url = NULL;
+                        }
+                        break;
+                case SCH_SHIFT:
+                        url->pbuf = NULL;
+                        url->ts_cnt = 0;
+                        url->tsh = tsh_open(url->path_fname, url->back);
+                        if(0 == url->tsh) {
+                                printf("Can not open time-shift file \"%s\"!\n", url->path_fname);
+                                free(url);
+                                url = NULL;
+                        }
+                        break;
+                case SCH_PCAP:
+                        url->pbuf = NULL;
+                        url->ts_cnt = 0;
+                        url->cap = cap_open(url->path_fname, url->host, url->port);
+                        if(0 == url->cap) {
+                                printf("Can not open capture file \"%s\"!\n", url->path_fname);
+                                free(url);
+                                url = NULL;
+                        }
+                        break;
                 default: /* SCH_FILE */
                         url->fd = fopen(url->path_fname, mode);
                         if(NULL == url->fd) {
@@ -59,6 +132,9 @@ struct url *url_open(const char *str, char *mode)
                         break;
         }
 
+        if(alt) {
+                free(alt);
+        }
         return url;
 }
 
@@ -73,6 +149,18 @@ int url_close(struct url *url)
                 case SCH_UDP:
                         udp_close(url->udp);
                         break;
+                case SCH_RTP:
+                        rtp_close(url->rtp);
+                        break;
+                case SCH_SHIFT:
+                        tsh_close(url->tsh);
+                        break;
+                case SCH_MERGE:
+                        mrg_close(url->mrg);
+                        break;
+                case SCH_PCAP:
+                        cap_close(url->cap);
+                        break;
                 default: /* SCH_FILE */
                         fclose(url->fd);
                         break;
@@ -93,6 +181,10 @@ int url_seek(struct url *url, long offset, int origin)
 
         switch(url->scheme) {
                 case SCH_UDP:
+                case SCH_RTP:
+                case SCH_SHIFT:
+                case SCH_MERGE:
+                case SCH_PCAP:
                         /* do nothing! */
                         break;
                 default: /* SCH_FILE */
@@ -114,6 +206,10 @@ int url_getc(struct url *url)
 
         switch(url->scheme) {
                 case SCH_UDP:
+                case SCH_RTP:
+                case SCH_SHIFT:
+                case SCH_MERGE:
+                case SCH_PCAP:
                         rslt = 0x47; /* to cheat host */
                         break;
                 default: /* SCH_FILE */
@@ -159,6 +255,43 @@ size_t url_read(void *buf, size_t size, size_t nobj, struct url *url)
                                 cobj = url->ts_cnt;
                         }
                         break;
+                case SCH_RTP:
+                case SCH_SHIFT:
+                case SCH_MERGE:
+                case SCH_PCAP:
+                        /* data in capture file, RTP window or time-shift buffer, no copy until here */
+                        cobj = 0;
+                        while(url->ts_cnt < byte_needed) {
+                                ssize_t rslt;
+                                uint8_t *data;
+
+                                if(SCH_RTP == url->scheme) {
+                                        rslt = rtp_read(url->rtp, &data, &(url->CTS));
+                                }
+                                else if(SCH_SHIFT == url->scheme) {
+                                        rslt = tsh_read(url->tsh, &data, &(url->CTS));
+                                }
+                                else if(SCH_MERGE == url->scheme) {
+                                        rslt = mrg_read(url->mrg, &data, &(url->CTS));
+                                }
+                                else {
+                                        rslt = cap_read(url->cap, &data, &(url->CTS));
+                                }
+                                if(rslt <= 0) {
+                                        url->ts_cnt = 0;
+                                        break;
+                                }
+                                url->pbuf = (char *)data;
+                                url->ts_cnt = (size_t)rslt;
+                                url->has_cts = (url->CTS >= 0);
+                        }
+                        if(url->ts_cnt >= byte_needed) {
+                                memcpy(buf, url->pbuf, byte_needed);
+                                url->pbuf += byte_needed;
+                                url->ts_cnt -= byte_needed;
+                                cobj = nobj;
+                        }
+                        break;
                 default: /* SCH_FILE */
                         cobj = fread(buf, size, nobj, url->fd);
                         break;
@@ -169,7 +302,20 @@ size_t url_read(void *buf, size_t size, size_t nobj, struct url *url)
 
 size_t url_write(const void *buf, size_t size, size_t nobj, struct url *url)
 {
-        return udp_write(url->udp, buf, size * nobj);
+        size_t cobj = 0;
+
+        switch(url->scheme) {
+                case SCH_UDP:
+                        if(udp_write(url->udp, buf, size * nobj) == (ssize_t)(size * nobj)) {
+                                cobj = nobj; /* one datagram */
+                        }
+                        break;
+                default: /* SCH_FILE */
+                        cobj = fwrite(buf, size, nobj, url->fd);
+                        break;
+        }
+
+        return cobj;
 }
 
 #define RFC1738 "[<scheme>://[[<user>[:<password>]@]<host>[:<port>]]][[/<disk>:]*[/<dir>]/<fname>]"
@@ -210,11 +356,12 @@ static int parse_url(struct url *url, const char *str)
         else {
                 RPTDBG("scheme: file");
                 url->scheme = SCH_LFILE;
+                url->path_fname = url->url;
         }
 
-        /* UDP scheme */
-        if(0 == strcmp(url->url, "udp")) {
-                url->scheme = SCH_UDP;
+        /* UDP scheme, and RTP over UDP */
+        if(0 == strcmp(url->url, "udp") || 0 == strcmp(url->url, "rtp")) {
+                url->scheme = (('r' == url->url[0]) ? SCH_RTP : SCH_UDP);
 
                 if(0 == memcmp(pattern, "*://*:*", 7)) { /* udp://host:port */
                         rslt = strtok(NULL, ":");
@@ -254,6 +401,50 @@ static int parse_url(struct url *url, const char *str)
                         return -1;
                 }
         }
+        else if(0 == strcmp(url->url, "pcap")) {
+                /* pcap:///.../cap.pcap, pcap://maddr:port/.../cap.pcapng, pcap://:port/... */
+                char *auth = (char *)str + 7; /* pass "pcap://" */
+                char *path = strchr(auth, '/');
+                char *colon;
+
+                url->scheme = SCH_PCAP;
+                if(!path) {
+                        fprintf(stderr, "URL syntax error for PCAP scheme!\n");
+                        fprintf(stderr, "    pcap://[<maddr>][:<port>]/<path>/<fname>\n");
+                        return -1;
+                }
+                strncpy(url->url, auth, MAX_STRING_LENGTH - 2); /* 1 more byte for '\0' after host */
+                url->url[MAX_STRING_LENGTH - 2] = '\0';
+                url->url[path - auth] = '\0';
+                url->path_fname = url->url + (path - auth) + 1;
+                memmove(url->path_fname, path, strlen(path) + 1); /* with '/' */
+
+                colon = strchr(url->url, ':');
+                if(colon) {
+                        *colon = '\0';
+                        url->port = (uint16_t)atoi(colon + 1);
+                }
+                url->host = ((url->url[0]) ? url->url : NULL);
+                RPTDBG("host: %s, port: %d, file: %s",
+                       (url->host ? url->host : "any"), url->port, url->path_fname);
+        }
+        else if(0 == strcmp(url->url, "shift")) {
+                /* shift:///.../ch1.tsh, shift://600/.../ch1.tsh: 600s before live */
+                char *auth = (char *)str + 8; /* pass "shift://" */
+                char *path = strchr(auth, '/');
+
+                url->scheme = SCH_SHIFT;
+                if(!path) {
+                        fprintf(stderr, "URL syntax error for SHIFT scheme!\n");
+                        fprintf(stderr, "    shift://[<second>]/<path>/<fname>\n");
+                        return -1;
+                }
+                url->back = ((path != auth) ? atoi(auth) : -1);
+                strncpy(url->url, path, MAX_STRING_LENGTH - 1); /* with '/' */
+                url->url[MAX_STRING_LENGTH - 1] = '\0';
+                url->path_fname = url->url;
+                RPTDBG("back: %ds, file: %s", url->back, url->path_fname);
+        }
         else if(0 == strcmp(url->url, "file")) {
                 /* file:///.../stream.ts */
                 /* file:///E:/.../stream.ts */
@@ -14,12 +14,20 @@ extern "C" {
 #include <stdint.h> /* for uint?_t, etc */
 
 #include "udp.h"
+#include "rtp.h"
+#include "merge.h"
+#include "cap.h"
+#include "tshift.h"
 
 #define MAX_STRING_LENGTH 256
 
 enum scheme {
         SCH_UDP,  /* udp://... */
         SCH_FILE, /* file://... */
+        SCH_PCAP, /* pcap://..., or local pcap/pcapng file */
+        SCH_RTP,  /* rtp://... */
+        SCH_MERGE, /* udp://...+..., rtp://...+..., two feeds merged */
+        SCH_SHIFT, /* shift://..., time-shift file */
         SCH_LFILE /* local file, without "file://" scheme prefix */
 };
 
@@ -38,6 +46,17 @@ struct url {
         /* id */
         FILE *fd;
         intptr_t udp;
+        intptr_t cap;
+        intptr_t rtp;
+        intptr_t tsh;
+        intptr_t mrg;
+        int back; /* second before live, -1 for oldest, for SCH_SHIFT */
+        int is_rtp; /* RTP feeds, for SCH_MERGE */
+
+        /* time of data, 27MHz clk: capture time for SCH_PCAP, RTP timestamp for SCH_RTP,
+         * PCR time for SCH_SHIFT */
+        int has_cts;
+        int64_t CTS;
 
         /* data buffer */
         char buf[8*188]; /* for UDP data */
@@ -77,16 +77,17 @@ int main(int argc, char *argv[])
                 pt = tbuf;
                 ats = NULL;
                 while(0 == next_tag(&tag, &pt)) {
-                        if(0 == strcmp(tag, "*ats")) {
+                        if(0 == strcmp(tag, "*ats") ||
+                           (0 == strcmp(tag, "*cts") && !ats)) {
                                 next_nuint_hex(&data, &pt, 1);
-                                ATS = (int64_t)data;
+                                ATS = (int64_t)data % ATS_OVF; /* CTS: 27MHz as ATS */
                                 ats = &ATS;
                                 dATS = ts_timestamp_diff(ATS, lATS, ATS_OVF);
                                 lATS = ATS;
                         }
                 }
                 if(!ats) {
-                        RPTERR("TS packet without ATS");
+                        RPTERR("TS packet without ATS or CTS");
                         url_close(fd_o);
                         return -1;
                 }
@@ -105,12 +106,13 @@ int main(int argc, char *argv[])
                                 cnt = next_nbyte_hex(pb, &pt, LINE_LENGTH_MAX / 3);
                                 pb += cnt;
                         }
-                        if(0 == strcmp(tag, "*ats")) {
+                        if(0 == strcmp(tag, "*ats") ||
+                           (0 == strcmp(tag, "*cts") && !ats)) {
                                 struct timeval dtv;
                                 struct timeval tv_new;
 
                                 next_nuint_hex(&data, &pt, 1);
-                                ATS = (int64_t)data;
+                                ATS = (int64_t)data % ATS_OVF; /* CTS: 27MHz as ATS */
                                 ats = &ATS;
                                 dATS = ts_timestamp_diff(ATS, lATS, ATS_OVF);
                                 if(0 < dATS && dATS < 100 * ATS_MS) {
@@ -130,12 +132,16 @@ int main(int argc, char *argv[])
                         }
                 }
                 if(!ats) {
-                        RPTERR("TS packet without ATS");
+                        RPTERR("TS packet without ATS or CTS");
                         url_close(fd_o);
                         return -1;
                 }
                 if((pb - bbuf) >= (188 * 7)) {
-                        url_write(bbuf, pb - bbuf, 1, fd_o);
+                        if(1 != url_write(bbuf, pb - bbuf, 1, fd_o)) {
+                                RPTERR("write \"%s\" failed", file_o);
+                                url_close(fd_o);
+                                return -1;
+                        }
                         pb = bbuf;
                         if(timercmp(&tv_pkt, &tv_cur, >)) {
                                 struct timeval delay; /* send interval */
@@ -204,6 +210,7 @@ static void show_help()
                 "  catts *.mts | toip udp://@:1234\n\n"
                 "  catts *.mts | toip udp://@224.165.54.210:1234\n\n"
                 "  catts *.ts | tsana -ts -ats | toip udp://@:1234\n\n"
+                "  catip shift://600/data/ch1.tsh | toip udp://@224.165.54.210:1234\n\n"
                 "\n"
                 "Report bugs to <zhoucheng@tsinghua.org.cn>.\n");
         return;
@@ -37,7 +37,10 @@ struct pdesc pd_sect[] = {
 };
 
 struct pdesc pd_tabl[] = {
+        {0, 0, 1, PT_UINTX_SS(struct ts_tabl, PID, uint16_t), "PID", NULL, 0},
         {0, 0, 1, PT_UINTX_SS(struct ts_tabl, table_id, uint8_t), "table_id", NULL, 0},
+        {0, 0, 1, PT_UINTX_SS(struct ts_tabl, table_id_extension, uint16_t), "table_id_extension", NULL, 0},
+        {0, 0, 1, PT_UINTX_SS(struct ts_tabl, ext2, uint32_t), "ext2", NULL, 0},
         {0, 0, 1, PT_UINTX_SS(struct ts_tabl, version_number, uint8_t), "version_number", NULL, 0},
         {0, 0, 1, PT_UINTX_SS(struct ts_tabl, last_section_number, uint8_t), "last_section_number", NULL, 0},
 #if 0
@@ -74,6 +77,24 @@ struct pdesc pd_ts[] = {
         {0, 0, 0, PT_NULL, "", NULL, 0} /* PT_NULL means tail of struct pdesc array */
 };
 
+struct pdesc pd_stat[] = {
+        {0, 0, 1, PT_SINT__SS(struct ts_stat, pkt, int64_t), "pkt", NULL, 0},
+        {0, 0, 1, PT_SINT__SS(struct ts_stat, byte, int64_t), "byte", NULL, 0},
+        {0, 0, 1, PT_SINT__SS(struct ts_stat, sect, int64_t), "sect", NULL, 0},
+        {0, 0, 1, PT_SINT__SS(struct ts_stat, sect_byte, int64_t), "sect_byte", NULL, 0},
+        {0, 0, 1, PT_SINT__SS(struct ts_stat, sect_dup, int64_t), "sect_dup", NULL, 0},
+        {0, 0, 1, PT_SINT__SS(struct ts_stat, sect_drop, int64_t), "sect_drop", NULL, 0},
+        {0, 0, 1, PT_SINT__SS(struct ts_stat, crc, int64_t), "crc", NULL, 0},
+        {0, 0, 1, PT_SINT__SS(struct ts_stat, crc_byte, int64_t), "crc_byte", NULL, 0},
+        {0, 0, 1, PT_SINT__SS(struct ts_stat, crc_skip, int64_t), "crc_skip", NULL, 0},
+        {0, 0, 1, PT_SINT__SS(struct ts_stat, alloc, int64_t), "alloc", NULL, 0},
+        {0, 0, 1, PT_SINT__SS(struct ts_stat, free, int64_t), "free", NULL, 0},
+        {0, 0, 1, PT_SINT__SS(struct ts_stat, pesh, int64_t), "pesh", NULL, 0},
+        {0, 0, TS_STAGE_MAX, PT_UINTu_SS(struct ts_stat, clk, uint64_t), "clk", NULL, 0},
+        {0, 0, TS_STAGE_MAX, PT_SINT__SS(struct ts_stat, clk_cnt, int64_t), "clk_cnt", NULL, 0},
+        {0, 0, 0, PT_NULL, "", NULL, 0} /* PT_NULL means tail of struct pdesc array */
+};
+
 #ifdef __cplusplus
 }
 #endif
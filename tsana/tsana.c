@@ -10,6 +10,8 @@
 #include <time.h> /* for localtime(), etc */
 #include<sys/time.h> /* for gettimeofday() */
 #include <inttypes.h> /* for uint?_t, PRIX64, etc */
+#include <stdarg.h> /* for va_list, etc */
+#include <math.h> /* for HUGE_VAL */
 
 #include "config.h" /* for SYS_* macro, generated by configure */
 #ifndef SYS_WINDOWS
@@ -19,11 +21,14 @@
 #include "tstool_config.h"
 #include "common.h"
 #include "if.h"
+#include "metrics.h"
 #include "buddy.h" /* for BUDDY_ORDER_MAX */
 #include "ts.h" /* has "list.h" already */
 #include "zconv.h"
 
 #include "param_xml.h"
+#include "param_bin.h"
+#include "param_json.h"
 #include "ts_desc.h"
 
 #ifndef timersub /* for mingw */
@@ -52,6 +57,9 @@ static int rpt_lvl = WRN_LVL; /* report level: ERR, WRN, INF, DBG */
 
 #define MP_ORDER_DEFAULT (20) /* default memory pool size: (1 << MP_ORDER_DEFAULT) */
 
+#define OUT_MAX                         (16) /* max number of -es-out and -pes-out files */
+#define OUT_BUF                         (1 << 20) /* write buffer size of each output file */
+
 struct pid_type_table {
         int   type; /* TS_TYPE_xxx */
         char *sdes; /* short description */
@@ -161,6 +169,7 @@ struct aim {
         int cts;
         int stc;
         int pcr;
+        int pcrm; /* PCR metrics of TR 101 290 Annex I */
         int pts;
         int tsh;
         int ts;
@@ -176,6 +185,51 @@ struct aim {
         int rats;
         int ratp;
         int err;
+        int evt; /* PSI change applied by libzts */
+};
+
+/* TR 101 290 indicator counted for -metrics */
+enum {
+        CNT_1_1,
+        CNT_1_2,
+        CNT_1_3,
+        CNT_1_4,
+        CNT_1_5,
+        CNT_1_6,
+        CNT_2_1,
+        CNT_2_2,
+        CNT_2_3A,
+        CNT_2_3B,
+        CNT_2_4,
+        CNT_2_5,
+        CNT_2_6,
+        CNT_OTHER,
+        CNT_MAX
+};
+
+static const char *CNT_NAME[CNT_MAX][2] = {
+        {"1.1", "TS_sync_loss"},
+        {"1.2", "Sync_byte_error"},
+        {"1.3", "PAT_error"},
+        {"1.4", "Continuity_count_error"},
+        {"1.5", "PMT_error"},
+        {"1.6", "PID_error"},
+        {"2.1", "Transport_error"},
+        {"2.2", "CRC_error"},
+        {"2.3a", "PCR_repetition_error"},
+        {"2.3b", "PCR_discontinuity_indicator_error"},
+        {"2.4", "PCR_accuracy_error"},
+        {"2.5", "PTS_error"},
+        {"2.6", "CAT_error"},
+        {"4.x", "other_error"}
+};
+
+struct out_file {
+        uint16_t pid; /* ANY_PID: data of any PID */
+        int is_pes; /* 0: ES data; 1: PES data */
+        FILE *fd;
+        uint8_t *buf; /* OUT_BUF bytes, written to fd when full */
+        size_t len;
 };
 
 static void *mp; /* id of buddy memory pool, for list malloc and free */
@@ -186,8 +240,21 @@ struct tsana_obj {
         struct aim aim;
 
         int is_impsi; /* import PSI/SI from psi.xml */
+        int is_exbin; /* -expsi into psi.bin instead of psi.xml */
+        int is_imbin; /* -impsi from psi.bin instead of psi.xml */
+        int is_exjson; /* -expsi into psi.json instead of psi.xml */
         int is_dump; /* output packet directly */
         int mp_level; /* memory pool status report level */
+        int is_stat; /* report counters of libzts before exit */
+
+        /* -metrics */
+        intptr_t mtr; /* metrics server, 0 if not used */
+        char *mtr_addr;
+        char *mtr_buf; /* text of snapshot */
+        size_t mtr_len;
+        size_t mtr_max;
+        time_t mtr_sec; /* wall clock second of last snapshot */
+        int64_t err_cnt[CNT_MAX];
         uint64_t aim_start; /* ignore some packets fisrt, default: 0(no ignore) */
         uint64_t aim_count; /* stop after analyse some packets, default: 0(no stop) */
         uint16_t aim_pid;
@@ -208,6 +275,8 @@ struct tsana_obj {
         struct timeval ltv; /* last arrive time */
 
         uint64_t cnt; /* packet analysed */
+        int out_cnt; /* number of -es-out and -pes-out files */
+        struct out_file out[OUT_MAX];
         char tbuf[PKT_TBUF];
         char tbak[PKT_TBUF];
 
@@ -264,6 +333,13 @@ static void show_psi(struct tsana_obj *obj);
 
 static int export_psi(struct tsana_obj *obj);
 static int import_psi(struct tsana_obj *obj);
+static int export_psi_bin(struct tsana_obj *obj);
+static int import_psi_bin(struct tsana_obj *obj);
+static int export_psi_json(struct tsana_obj *obj);
+
+static int out_open(struct tsana_obj *obj, const char *name, int is_pes);
+static void out_data(struct tsana_obj *obj);
+static void out_close(struct tsana_obj *obj);
 
 static void show_pkt(struct tsana_obj *obj);
 static void show_time(struct tsana_obj *obj);
@@ -271,6 +347,8 @@ static void show_addr(struct tsana_obj *obj);
 static void show_cts(struct tsana_obj *obj);
 static void show_stc(struct tsana_obj *obj);
 static void show_pcr(struct tsana_obj *obj);
+static void show_pcrm(struct tsana_obj *obj);
+static double pcrm_q99(const struct ts_pcrm_hist *hist);
 static void show_pts(struct tsana_obj *obj);
 static void show_tsh(struct tsana_obj *obj);
 static void show_ts(struct tsana_obj *obj);
@@ -281,11 +359,15 @@ static void show_pes(struct tsana_obj *obj);
 static void show_es(struct tsana_obj *obj);
 static void show_ess(struct tsana_obj *obj);
 static void show_sec(struct tsana_obj *obj);
+static void show_evt(struct tsana_obj *obj);
 static void show_si(struct tsana_obj *obj);
 static void show_rate(struct tsana_obj *obj);
 static void show_rats(struct tsana_obj *obj);
 static void show_ratp(struct tsana_obj *obj);
 static int digest_ts_err(struct tsana_obj *obj, int print);
+static void show_stat(struct tsana_obj *obj);
+static void mtr_snapshot(struct tsana_obj *obj);
+static void mtr_printf(struct tsana_obj *obj, const char *fmt, ...);
 
 static void table_info_PAT(struct ts_sect *sect);
 static void table_info_CAT(struct ts_sect *sect);
@@ -358,6 +440,9 @@ int main(int argc, char *argv[])
                 if(obj->is_dump) {
                         show_pkt(obj);
                 }
+                if(obj->mtr && (ts->has_rate || obj->tv.tv_sec != obj->mtr_sec)) {
+                        mtr_snapshot(obj);
+                }
                 obj->cnt++;
                 if((0 != obj->aim_count) && (obj->cnt >= obj->aim_count)) {
                         break;
@@ -406,10 +491,16 @@ static int state_parse_each(struct tsana_obj *obj)
         struct ts_pid *pid = ts->pid;
         struct ts_sect *sect = ts->sect;
 
+        /* output ES or PES data, with its own PID */
+        if(obj->out_cnt) {
+                out_data(obj);
+        }
+
         /* filter for some mode */
         if(obj->aim.sec         ||
            obj->aim.si          ||
            obj->aim.pcr         ||
+           obj->aim.pcrm        ||
            obj->aim.pts         ||
            obj->aim.af          ||
            obj->aim.pesh        ||
@@ -462,6 +553,9 @@ static int state_parse_each(struct tsana_obj *obj)
         if(obj->aim.pcr && ts->has_pcr) {
                 has_report = 1;
         }
+        if(obj->aim.pcrm && ts->has_pcr) {
+                has_report = 1;
+        }
         if(obj->aim.ts) {
                 has_report = 1;
         }
@@ -498,6 +592,9 @@ static int state_parse_each(struct tsana_obj *obj)
         if(obj->aim.err && ts->has_err) {
                 has_report = 1;
         }
+        if(obj->aim.evt && ts->has_evt) {
+                has_report = 1;
+        }
 
         /* report */
         if(obj->aim.time && has_report) {
@@ -518,6 +615,9 @@ static int state_parse_each(struct tsana_obj *obj)
         if(obj->aim.pcr && has_report) {
                 show_pcr(obj);
         }
+        if(obj->aim.pcrm && has_report) {
+                show_pcrm(obj);
+        }
         if(obj->aim.tsh && has_report) {
                 show_tsh(obj);
         }
@@ -548,6 +648,9 @@ static int state_parse_each(struct tsana_obj *obj)
         if(obj->aim.si && ts->sect) {
                 show_si(obj);
         }
+        if(obj->aim.evt && ts->has_evt) {
+                show_evt(obj);
+        }
         if(obj->aim.rate && ts->has_rate) {
                 show_rate(obj);
         }
@@ -587,10 +690,25 @@ static struct tsana_obj *create(int argc, char *argv[])
         memset(&(obj->aim), 0, sizeof(struct aim));
 
         memset(&cfg, 1, sizeof(struct ts_cfg));
+        cfg.need_timing = 0;
+        cfg.crc_period = 0; /* TS_CRC_PERIOD */
+        cfg.need_psi_update = 1; /* survive PAT or PMT change */
         obj->is_impsi = 0;
+        obj->is_exbin = 0;
+        obj->is_imbin = 0;
+        obj->is_exjson = 0;
         obj->is_dump = 0;
         obj->mp_level = BUDDY_REPORT_NONE;
+        obj->is_stat = 0;
+        obj->mtr = (intptr_t)NULL;
+        obj->mtr_addr = NULL;
+        obj->mtr_buf = NULL;
+        obj->mtr_len = 0;
+        obj->mtr_max = 0;
+        obj->mtr_sec = 0;
+        memset(obj->err_cnt, 0, sizeof(obj->err_cnt));
         obj->cnt = 0;
+        obj->out_cnt = 0;
         obj->aim_start = 0;
         obj->aim_count = 0;
         obj->aim_pid = ANY_PID;
@@ -624,6 +742,18 @@ static struct tsana_obj *create(int argc, char *argv[])
                         else if(0 == strcmp(argv[i], "-impsi")) {
                                 obj->is_impsi = 1;
                         }
+                        else if(0 == strcmp(argv[i], "-exbin")) {
+                                obj->mode = MODE_EXPSI;
+                                obj->is_exbin = 1;
+                        }
+                        else if(0 == strcmp(argv[i], "-exjson")) {
+                                obj->mode = MODE_EXPSI;
+                                obj->is_exjson = 1;
+                        }
+                        else if(0 == strcmp(argv[i], "-imbin")) {
+                                obj->is_impsi = 1;
+                                obj->is_imbin = 1;
+                        }
                         else if(0 == strcmp(argv[i], "-dump")) {
                                 obj->is_dump = 1;
                                 obj->mode = MODE_ALL;
@@ -650,6 +780,19 @@ static struct tsana_obj *create(int argc, char *argv[])
                                                 argv[i]);
                                 }
                         }
+                        else if(0 == strcmp(argv[i], "-stat")) {
+                                obj->is_stat = 1;
+                                cfg.need_timing = 1;
+                        }
+                        else if(0 == strcmp(argv[i], "-metrics")) {
+                                i++;
+                                if(i >= argc) {
+                                        fprintf(stderr, "no parameter for '-metrics'!\n");
+                                        goto create_failed_with_obj;
+                                }
+                                obj->mtr_addr = argv[i];
+                                obj->mode = MODE_ALL; /* keep running */
+                        }
                         else if(0 == strcmp(argv[i], "-time")) {
                                 obj->aim.time = 1;
                                 obj->mode = MODE_ALL;
@@ -670,6 +813,10 @@ static struct tsana_obj *create(int argc, char *argv[])
                                 obj->aim.pcr = 1;
                                 obj->mode = MODE_ALL;
                         }
+                        else if(0 == strcmp(argv[i], "-pcrm")) {
+                                obj->aim.pcrm = 1;
+                                obj->mode = MODE_ALL;
+                        }
                         else if(0 == strcmp(argv[i], "-pts")) {
                                 obj->aim.pts = 1;
                                 obj->mode = MODE_ALL;
@@ -702,6 +849,20 @@ static struct tsana_obj *create(int argc, char *argv[])
                                 obj->aim.es = 1;
                                 obj->mode = MODE_ALL;
                         }
+                        else if(0 == strcmp(argv[i], "-es-out") ||
+                                0 == strcmp(argv[i], "-pes-out")) {
+                                int is_pes = (0 == strcmp(argv[i], "-pes-out"));
+
+                                i++;
+                                if(i >= argc) {
+                                        fprintf(stderr, "no parameter for '%s'!\n", argv[i - 1]);
+                                        goto create_failed_with_obj;
+                                }
+                                if(0 != out_open(obj, argv[i], is_pes)) {
+                                        goto create_failed_with_obj;
+                                }
+                                obj->mode = MODE_ALL;
+                        }
                         else if(0 == strcmp(argv[i], "-ess")) {
                                 obj->aim.ess = 1;
                                 obj->mode = MODE_ALL;
@@ -730,6 +891,10 @@ static struct tsana_obj *create(int argc, char *argv[])
                                 obj->aim.err = 1;
                                 obj->mode = MODE_ALL;
                         }
+                        else if(0 == strcmp(argv[i], "-evt")) {
+                                obj->aim.evt = 1;
+                                obj->mode = MODE_ALL;
+                        }
                         else if(0 == strcmp(argv[i], "-c") ||
                                 0 == strcmp(argv[i], "-color")) {
 #ifdef SYS_WINDOWS
@@ -933,11 +1098,22 @@ static struct tsana_obj *create(int argc, char *argv[])
                 goto create_failed_with_mp;
         }
         ts_ioctl(obj->ts, TS_SCFG, &cfg);
+
+        /* metrics server */
+        if(obj->mtr_addr) {
+                obj->mtr = mtr_open(obj->mtr_addr);
+                if(!(obj->mtr)) {
+                        RPTERR("open metrics server on \"%s\" failed", obj->mtr_addr);
+                        ts_destroy(obj->ts);
+                        goto create_failed_with_mp;
+                }
+        }
         return obj;
 
 create_failed_with_mp:
         buddy_destroy(mp); /* return the memory to OS */
 create_failed_with_obj:
+        out_close(obj);
         free(obj);
         return NULL;
 }
@@ -948,12 +1124,22 @@ static int destroy(struct tsana_obj *obj)
                 return 0;
         }
 
+        if(obj->is_stat) {
+                show_stat(obj);
+        }
+        if(obj->mtr) {
+                mtr_close(obj->mtr);
+        }
+        if(obj->mtr_buf) {
+                free(obj->mtr_buf);
+        }
         buddy_report(mp, obj->mp_level, "before ts destroy");
         ts_destroy(obj->ts);
         buddy_report(mp, obj->mp_level, "after ts destroy");
 
         buddy_destroy(mp); /* return the memory to OS */
 
+        out_close(obj);
         free(obj);
 
         return 1;
@@ -1008,9 +1194,14 @@ static void show_help()
 #if 1
                 " -expsi           export PSI information into psi.xml\n"
                 " -impsi           import PSI information from psi.xml before analyse\n"
+                " -exbin           export PSI information into psi.bin, binary snapshot\n"
+                " -imbin           import PSI information from psi.bin before analyse, fast\n"
+                " -exjson          export PSI information and counters into psi.json\n"
 #endif
                 " -dump            dump cared packet\n"
                 " -mem             memory pool status show level[none|total|detail], default: none\n"
+                " -metrics <addr>  serve Prometheus text on [ip]:port(127.0.0.1 if no ip) or unix:<path>\n"
+                " -stat            \"*stat, pkt, n, ..., \" and \"*clk, unit, stage, n, clock/op, ..., \" before exit\n"
                 "\n"
                 " -time            \"*time, YYYY-mm-dd HH:MM:SS, second, usecond, delta_time(ms), \"\n"
                 " -addr            \"*addr, address(hex), address(dec), PID, \"\n"
@@ -1018,6 +1209,7 @@ static void show_help()
                 " -cts             \"*cts, CTS, BASE, \"\n"
                 " -stc             \"*stc, STC, BASE, \"\n"
                 " -pcr             \"*pcr, PCR, BASE, EXT, dSTC(ms), dPCR(ms), PCR-STC(ns), \"\n"
+                " -pcrm            \"*pcrm, FO(Hz), DR(Hz/s), OJ(ns), AC(ns), OJ99(ns), AC99(ns), \", TR 101 290 Annex I\n"
                 " -pts             \"*pts, PTS, dPTS(ms), PTS-PCR(ms), DTS, dDTS(ms), DTS-PCR(ms), \"\n"
                 " -tsh             \"*tsh, 47, xx, xx, xx, \"\n"
                 " -ts              \"*ts, 47, ..., xx, \"\n"
@@ -1026,12 +1218,15 @@ static void show_help()
                 " -pes             \"*pes, xx, ..., xx, \", PES fragment in this TS packet\n"
                 " -es              \"*es, xx, ..., xx, \", ES fragment in this TS packet\n"
                 " -ess             \"*ess, xxx, \", ES size of last PES packet\n"
+                " -es-out <file>   write ES data of PID set by -pid before into file, binary\n"
+                " -pes-out <file>  write PES data of PID set by -pid before into file, binary\n"
                 " -sec             \"*sec, interval(ms), head, body, \"\n"
                 " -si              \"*si, interval(ms), head, information of body, \"\n"
                 " -rate            \"*rate, interval(ms), PID, rate, [es_rate, ]..., PID, rate, [es_rate, ]\"\n"
                 " -rats            \"*rats, interval(ms), SYS, rate, PSI-SI, rate, 0x1FFF, rate, \"\n"
                 " -ratp            \"*ratp, interval(ms), PSI-SI, rate, PID, rate, ..., PID, rate, \"\n"
                 " -err             \"*err, TR-101-290, datail, \"\n"
+                " -evt             \"*evt, change, program_number, PID, version, stream_type, \" when PAT or PMT changed\n"
                 "\n"
                 " -c -color        enable colour effect to help read, default: mono\n"
                 " -start <x>       analyse from packet(x), default: 0(first packet)\n"
@@ -1048,6 +1243,7 @@ static void show_help()
                 "\n"
                 "Examples:\n"
                 "  \"catts xxx.ts | tsana -c -time -addr -pcr -pts\" -- report all PCR/PTS/DTS information\n"
+                "  \"catts xxx.ts | tsana -pid 0x100 -es-out v.es -pid 0x101 -es-out a.es\" -- extract ES\n"
                 "\n"
                 "Report bugs to <zhoucheng@tsinghua.org.cn>.\n",
                 BUDDY_ORDER_MAX, MP_ORDER_DEFAULT, MP_ORDER_DEFAULT);
@@ -1344,6 +1540,12 @@ static int export_psi(struct tsana_obj *obj)
         if(!(ts->is_psi_si_parsed)) {
                 return -1;
         }
+        if(obj->is_exbin) {
+                return export_psi_bin(obj);
+        }
+        if(obj->is_exjson) {
+                return export_psi_json(obj);
+        }
 
         xmlDocPtr doc;
         xmlNodePtr root;
@@ -1379,11 +1581,12 @@ static int export_psi(struct tsana_obj *obj)
 static int import_psi(struct tsana_obj *obj)
 {
         struct ts_obj *ts = obj->ts;
-        xmlDocPtr doc;
-        xmlNodePtr root;
+
+        if(obj->is_imbin) {
+                return import_psi_bin(obj);
+        }
 
         buddy_report(mp, obj->mp_level, "before xml init");
-        doc = xmlParseFile("psi.xml");
         if(!xmlFree) {
                 /* FIXME: libxml2@mingw problem */
                 RPTERR("xmlFree: %p, xmlMalloc: %p, xmlRealloc: %p, xmlMemStrdup: %p",
@@ -1395,35 +1598,206 @@ static int import_psi(struct tsana_obj *obj)
                 RPTERR("  xfree: %p,   xmalloc: %p,   xrealloc: %p,      xstrdup: %p",
                     xfree, xmalloc, xrealloc, xstrdup);
         }
-        if(doc == NULL) {
-                RPTERR("parse psi.xml failed\n");
+
+        /* streaming, no DOM of whole psi.xml in memory pool */
+        if(0 != xml2param_file(ts, "psi.xml", "ts", pd_ts)) {
+                RPTERR("parse psi.xml failed");
+                xmlCleanupParser();
                 return -1;
         }
+        buddy_report(mp, obj->mp_level, "after xml2param");
+        xmlCleanupParser();
+        buddy_report(mp, obj->mp_level, "after xml clean");
 
-        root = xmlDocGetRootElement(doc);
-        if(root == NULL) {
-                RPTERR("empty document\n");
-                xmlFreeDoc(doc);
-                xmlCleanupParser();
+        ts_ioctl(ts, TS_TIDY, 0);
+        return 0;
+}
+
+static int export_psi_bin(struct tsana_obj *obj)
+{
+        struct ts_obj *ts = obj->ts;
+        FILE *fd;
+        uint8_t *buf;
+        size_t len;
+
+        if(0 != param2bin(ts, pd_ts, &buf, &len)) {
+                RPTERR("param2bin failed");
                 return -1;
         }
+        buddy_report(mp, obj->mp_level, "after param2bin");
 
-        if (xmlStrcmp(root->name, (const xmlChar *) "ts")) {
-                RPTERR("psi.xml: root node != ts");
-                xmlFreeDoc(doc);
-                xmlCleanupParser();
+        fd = fopen("psi.bin", "wb");
+        if(NULL == fd) {
+                RPTERR("open psi.bin failed");
+                free(buf);
                 return -1;
         }
-        xml2param(ts, root, pd_ts);
-        buddy_report(mp, obj->mp_level, "after xml2param");
-        xmlFreeDoc(doc);
-        xmlCleanupParser();
-        buddy_report(mp, obj->mp_level, "after xml clean");
+        if(1 != fwrite(buf, len, 1, fd)) {
+                RPTERR("write psi.bin failed");
+        }
+        fclose(fd);
+        free(buf);
+
+        output_prog(obj);
+        return 0;
+}
+
+/* {"ts":{...},"stat":{...}}, written straight into one buffer, no DOM */
+static int export_psi_json(struct tsana_obj *obj)
+{
+        struct ts_obj *ts = obj->ts;
+        struct ts_stat stat;
+        struct pjson pj = {NULL, 0, 0};
+        FILE *fd;
+
+        ts_ioctl(ts, TS_STAT, &stat);
+        if(0 != pjson_cat(&pj, "{\"ts\":") ||
+           0 != param2json(ts, pd_ts, &pj) ||
+           0 != pjson_cat(&pj, ",\"stat\":") ||
+           0 != param2json(&stat, pd_stat, &pj) ||
+           0 != pjson_cat(&pj, "}\n")) {
+                RPTERR("param2json failed");
+                free(pj.buf);
+                return -1;
+        }
+        buddy_report(mp, obj->mp_level, "after param2json");
+
+        fd = fopen("psi.json", "wb");
+        if(NULL == fd) {
+                RPTERR("open psi.json failed");
+                free(pj.buf);
+                return -1;
+        }
+        if(1 != fwrite(pj.buf, pj.len, 1, fd)) {
+                RPTERR("write psi.json failed");
+        }
+        fclose(fd);
+        free(pj.buf);
+
+        output_prog(obj);
+        return 0;
+}
+
+/* one read, no DOM: for warm start with big MPTS */
+static int import_psi_bin(struct tsana_obj *obj)
+{
+        struct ts_obj *ts = obj->ts;
+        FILE *fd;
+        uint8_t *buf;
+        long len;
+
+        fd = fopen("psi.bin", "rb");
+        if(NULL == fd) {
+                RPTERR("open psi.bin failed");
+                return -1;
+        }
+        fseek(fd, 0, SEEK_END);
+        len = ftell(fd);
+        fseek(fd, 0, SEEK_SET);
+        if(len <= 0 || NULL == (buf = (uint8_t *)malloc((size_t)len))) {
+                RPTERR("bad psi.bin or malloc failed");
+                fclose(fd);
+                return -1;
+        }
+        if(1 != fread(buf, (size_t)len, 1, fd)) {
+                RPTERR("read psi.bin failed");
+                free(buf);
+                fclose(fd);
+                return -1;
+        }
+        fclose(fd);
+
+        buddy_report(mp, obj->mp_level, "before bin2param");
+        if(0 != bin2param(ts, pd_ts, buf, (size_t)len)) {
+                RPTERR("psi.bin: bin2param failed");
+                free(buf);
+                return -1;
+        }
+        buddy_report(mp, obj->mp_level, "after bin2param");
+        free(buf);
 
         ts_ioctl(ts, TS_TIDY, 0);
         return 0;
 }
 
+/* output file for PID set by -pid before, data is buffered and written in big block */
+static int out_open(struct tsana_obj *obj, const char *name, int is_pes)
+{
+        struct out_file *out;
+
+        if(obj->out_cnt >= OUT_MAX) {
+                fprintf(stderr, "too many output files, %d at most!\n", OUT_MAX);
+                return -1;
+        }
+        out = &(obj->out[obj->out_cnt]);
+
+        out->buf = (uint8_t *)malloc(OUT_BUF);
+        if(NULL == out->buf) {
+                RPTERR("malloc failed");
+                return -1;
+        }
+        out->fd = fopen(name, "wb");
+        if(NULL == out->fd) {
+                fprintf(stderr, "open \"%s\" failed!\n", name);
+                free(out->buf);
+                return -1;
+        }
+        setvbuf(out->fd, NULL, _IONBF, 0); /* out->buf is big enough */
+        out->pid = obj->aim_pid;
+        out->is_pes = is_pes;
+        out->len = 0;
+        obj->out_cnt++;
+        return 0;
+}
+
+static void out_data(struct tsana_obj *obj)
+{
+        int i;
+        struct ts_obj *ts = obj->ts;
+
+        for(i = 0; i < obj->out_cnt; i++) {
+                struct out_file *out = &(obj->out[i]);
+                uint8_t *data = (out->is_pes ? ts->PES : ts->ES);
+                size_t len = (size_t)(out->is_pes ? ts->PES_len : ts->ES_len);
+
+                if(0 == len || !(out->fd) ||
+                   (ANY_PID != out->pid && ts->PID != out->pid)) {
+                        continue;
+                }
+                if(out->len + len > OUT_BUF) {
+                        if(out->len != fwrite(out->buf, 1, out->len, out->fd)) {
+                                RPTERR("write failed, stop output");
+                                fclose(out->fd);
+                                out->fd = NULL;
+                                continue;
+                        }
+                        out->len = 0;
+                }
+                memcpy(out->buf + out->len, data, len);
+                out->len += len;
+        }
+        return;
+}
+
+static void out_close(struct tsana_obj *obj)
+{
+        int i;
+
+        for(i = 0; i < obj->out_cnt; i++) {
+                struct out_file *out = &(obj->out[i]);
+
+                if(out->fd) {
+                        if(out->len != fwrite(out->buf, 1, out->len, out->fd)) {
+                                RPTERR("write failed");
+                        }
+                        fclose(out->fd);
+                }
+                free(out->buf);
+        }
+        obj->out_cnt = 0;
+        return;
+}
+
 static void show_psi(struct tsana_obj *obj)
 {
         struct ts_obj *ts = obj->ts;
@@ -1513,6 +1887,38 @@ static void show_pcr(struct tsana_obj *obj)
         return;
 }
 
+static void show_pcrm(struct tsana_obj *obj)
+{
+        struct ts_obj *ts = obj->ts;
+        struct ts_prog *prog = ((ts->pid) ? ts->pid->prog : NULL);
+
+        if(ts->has_pcr && prog) {
+                struct ts_pcrm *pcrm = &(prog->pcrm);
+
+                fprintf(stdout, "%s*pcrm%s, %+8.2f, %+8.4f, %+6.0f, %+6.0f, %6.0f, %6.0f, ",
+                        obj->color_green, obj->color_off,
+                        pcrm->FO,
+                        pcrm->DR,
+                        (double)(pcrm->OJ) * 1e3 / STC_US,
+                        (double)(pcrm->AC) * 1e3 / STC_US,
+                        pcrm_q99(&(pcrm->OJ_hist)),
+                        pcrm_q99(&(pcrm->AC_hist)));
+        }
+        else {
+                fprintf(stdout, "%s*pcrm%s,          ,          ,        ,        ,       ,       , ",
+                        obj->color_green, obj->color_off);
+        }
+        return;
+}
+
+/* 99% quantile in ns, inf if over the histogram */
+static double pcrm_q99(const struct ts_pcrm_hist *hist)
+{
+        int64_t q = ts_pcrm_quantile(hist, 990);
+
+        return ((INT64_MAX == q) ? HUGE_VAL : (double)q * 1e3 / STC_US);
+}
+
 static void show_pts(struct tsana_obj *obj)
 {
         struct ts_obj *ts = obj->ts;
@@ -1654,6 +2060,29 @@ static void show_sec(struct tsana_obj *obj)
         return;
 }
 
+static void show_evt(struct tsana_obj *obj)
+{
+        struct ts_obj *ts = obj->ts;
+        int i;
+        static const char *name[] = {
+                "pat", "pmt", "prog_add", "prog_del", "pmt_pid",
+                "pcr_pid", "elem_add", "elem_del", "elem_type"
+        };
+
+        for(i = 0; i < ts->evt_cnt; i++) {
+                struct ts_evt *evt = &(ts->evt[i]);
+
+                fprintf(stdout, "%s*evt%s, %s, %5u, 0x%04X, %2u, 0x%02X, ",
+                        obj->color_green, obj->color_off,
+                        name[evt->type],
+                        (unsigned int)(evt->program_number),
+                        (unsigned int)(evt->PID),
+                        (unsigned int)(evt->version_number),
+                        (unsigned int)(evt->stream_type));
+        }
+        return;
+}
+
 static void show_si(struct tsana_obj *obj)
 {
         struct ts_obj *ts = obj->ts;
@@ -1894,6 +2323,7 @@ static int digest_ts_err(struct tsana_obj *obj, int print)
                 err->has_level1_error = 0;
 
                 if(err->TS_sync_loss) {
+                        obj->err_cnt[CNT_1_1]++;
                         EPRINTF(print, "1.1, TS_sync_loss, ");
                         if(err->Sync_byte_error > 10) {
                                 EPRINTF(print, "\nToo many continual Sync_byte_error packet, EXIT!\n");
@@ -1903,10 +2333,12 @@ static int digest_ts_err(struct tsana_obj *obj, int print)
                         return 0;
                 }
                 if(err->Sync_byte_error) {
+                        obj->err_cnt[CNT_1_2]++;
                         EPRINTF(print, "1.2 , Sync_byte_error, ");
                         /* do NOT clear this error */
                 }
                 if(err->PAT_error) {
+                        obj->err_cnt[CNT_1_3]++;
                         if(ERR_1_3_0 & err->PAT_error) {
                                 EPRINTF(print, "1.3a, PAT(section_interval > 0.5s), ");
                         }
@@ -1919,11 +2351,13 @@ static int digest_ts_err(struct tsana_obj *obj, int print)
                         err->PAT_error = 0;
                 }
                 if(err->Continuity_count_error) {
+                        obj->err_cnt[CNT_1_4]++;
                         EPRINTF(print, "1.4 , CC(%X-%X=%2u), ",
                                 ts->CC_find, ts->CC_wait, ts->CC_lost);
                         /* do NOT need to clear this error */
                 }
                 if(err->PMT_error) {
+                        obj->err_cnt[CNT_1_5]++;
                         if(ERR_1_5_0 & err->PMT_error) {
                                 EPRINTF(print, "1.5a, PMT section_interval(%+7.3f ms): (0, 500)ms, ",
                                         (double)(ts->sect_interval) / STC_MS);
@@ -1934,6 +2368,7 @@ static int digest_ts_err(struct tsana_obj *obj, int print)
                         err->PMT_error = 0;
                 }
                 if(err->PID_error) {
+                        obj->err_cnt[CNT_1_6]++;
                         EPRINTF(print, "1.6 , PID_error, ");
                         err->PID_error = 0;
                 }
@@ -1944,35 +2379,42 @@ static int digest_ts_err(struct tsana_obj *obj, int print)
                 err->has_level2_error = 0;
 
                 if(err->Transport_error) {
+                        obj->err_cnt[CNT_2_1]++;
                         EPRINTF(print, "2.1 , Transport, ");
                         err->Transport_error = 0;
                 }
                 if(err->CRC_error) {
+                        obj->err_cnt[CNT_2_2]++;
                         EPRINTF(print, "2.2 , CRC(0x%08X! 0x%08X?), ",
                                 ts->CRC_32_calc, ts->CRC_32);
                         err->CRC_error = 0;
                 }
                 if(err->PCR_repetition_error) {
+                        obj->err_cnt[CNT_2_3A]++;
                         EPRINTF(print, "2.3a, PCR_repetition(%+7.3f ms), ",
                                 (double)(ts->PCR_repetition) / STC_MS);
                         err->PCR_repetition_error = 0;
                 }
                 if(err->PCR_discontinuity_indicator_error) {
+                        obj->err_cnt[CNT_2_3B]++;
                         EPRINTF(print, "2.3b, PCR_discontinuity_indicator(%+7.3f ms), ",
                                 (double)(ts->PCR_continuity) / STC_MS);
                         err->PCR_discontinuity_indicator_error = 0;
                 }
                 if(err->PCR_accuracy_error) {
+                        obj->err_cnt[CNT_2_4]++;
                         EPRINTF(print, "2.4 , PCR_accuracy(%+4.0f ns), ",
                                 (double)(ts->PCR_jitter) * 1e3 / STC_US);
                         err->PCR_accuracy_error = 0;
                 }
                 if(err->PTS_error) {
+                        obj->err_cnt[CNT_2_5]++;
                         EPRINTF(print, "2.5 , PTS_repetition(%+7.3f ms > 700ms), ",
                                 (double)(ts->PTS_repetition) / STC_MS);
                         err->PTS_error = 0;
                 }
                 if(err->CAT_error) {
+                        obj->err_cnt[CNT_2_6]++;
                         if(ERR_2_6_0 & err->CAT_error) {
                                 EPRINTF(print, "2.6 , CAT(scrambling program without CAT), ");
                         }
@@ -1992,6 +2434,7 @@ static int digest_ts_err(struct tsana_obj *obj, int print)
         /* other errors */
         if(err->has_other_error) {
                 err->has_other_error = 0;
+                obj->err_cnt[CNT_OTHER]++;
 
                 if(err->adaption_field_control_error) {
                         EPRINTF(print, "4.x , adaption_field_control(00) illegal, ");
@@ -2083,8 +2526,9 @@ static int digest_ts_err(struct tsana_obj *obj, int print)
                         if(ERR_4_0_2 & err->section_crc32_error) {
                                 EPRINTF(print, "4.0 , PMT CRC_32 changed, ");
                         }
-                        if((ERR_4_0_0 | ERR_4_0_2) & err->section_crc32_error) {
-                                /* PAT or PMT changed */
+                        if(((ERR_4_0_0 | ERR_4_0_2) & err->section_crc32_error) &&
+                           !(ts->cfg.need_psi_update)) {
+                                /* PAT or PMT changed, libzts does not apply it */
                                 ts_ioctl(ts, TS_INIT, 0);
                                 obj->state = STATE_PARSE_PSI;
                         }
@@ -2095,6 +2539,170 @@ static int digest_ts_err(struct tsana_obj *obj, int print)
         return 0;
 }
 
+static void show_stat(struct tsana_obj *obj)
+{
+        int i;
+        struct ts_stat stat;
+        static const char *stage[TS_STAGE_MAX] = {"tsh", "af", "sect", "secp", "pesh"};
+
+        ts_ioctl(obj->ts, TS_STAT, &stat);
+        fprintf(stdout, "%s*stat%s, ", obj->color_green, obj->color_off);
+        fprintf(stdout, "pkt, %"PRId64", byte, %"PRId64", ", stat.pkt, stat.byte);
+        fprintf(stdout, "sect, %"PRId64", sect_byte, %"PRId64", ", stat.sect, stat.sect_byte);
+        fprintf(stdout, "sect_dup, %"PRId64", sect_drop, %"PRId64", ", stat.sect_dup, stat.sect_drop);
+        fprintf(stdout, "crc, %"PRId64", crc_byte, %"PRId64", ", stat.crc, stat.crc_byte);
+        fprintf(stdout, "crc_skip, %"PRId64", ", stat.crc_skip);
+        fprintf(stdout, "alloc, %"PRId64", free, %"PRId64", ", stat.alloc, stat.free);
+        fprintf(stdout, "pesh, %"PRId64", \n", stat.pesh);
+
+        fprintf(stdout, "%s*clk%s, %s, ", obj->color_green, obj->color_off, stat.clk_unit);
+        for(i = 0; i < TS_STAGE_MAX; i++) {
+                fprintf(stdout, "%s, %"PRId64", %.1f, ", stage[i], stat.clk_cnt[i],
+                        (stat.clk_cnt[i]) ? ((double)stat.clk[i] / stat.clk_cnt[i]) : 0.0);
+        }
+        fprintf(stdout, "\n");
+        return;
+}
+
+/* build text of metrics in Prometheus format, and hand it to metrics server */
+static void mtr_snapshot(struct tsana_obj *obj)
+{
+        int i;
+        struct ts_obj *ts = obj->ts;
+        struct znode *znode;
+        struct ts_stat stat;
+        size_t used;
+        size_t total;
+
+        obj->mtr_sec = obj->tv.tv_sec;
+        obj->mtr_len = 0;
+        ts_ioctl(ts, TS_STAT, &stat);
+
+        mtr_printf(obj, "# HELP tsana_packets_total TS packets analysed.\n");
+        mtr_printf(obj, "# TYPE tsana_packets_total counter\n");
+        mtr_printf(obj, "tsana_packets_total %"PRId64"\n", stat.pkt);
+        mtr_printf(obj, "# HELP tsana_sections_total PSI/SI sections assembled, by result.\n");
+        mtr_printf(obj, "# TYPE tsana_sections_total counter\n");
+        mtr_printf(obj, "tsana_sections_total{result=\"all\"} %"PRId64"\n", stat.sect);
+        mtr_printf(obj, "tsana_sections_total{result=\"dup\"} %"PRId64"\n", stat.sect_dup);
+        mtr_printf(obj, "tsana_sections_total{result=\"drop\"} %"PRId64"\n", stat.sect_drop);
+
+        mtr_printf(obj, "# HELP tsana_tr101290_errors_total TR 101 290 indicators met.\n");
+        mtr_printf(obj, "# TYPE tsana_tr101290_errors_total counter\n");
+        for(i = 0; i < CNT_MAX; i++) {
+                mtr_printf(obj, "tsana_tr101290_errors_total{indicator=\"%s\",name=\"%s\"} %"PRId64"\n",
+                           CNT_NAME[i][0], CNT_NAME[i][1], obj->err_cnt[i]);
+        }
+
+        if(ts->last_interval > 0) {
+                mtr_printf(obj, "# HELP tsana_bitrate_bps Bitrate of last interval, by part of TS.\n");
+                mtr_printf(obj, "# TYPE tsana_bitrate_bps gauge\n");
+                mtr_printf(obj, "tsana_bitrate_bps{part=\"total\"} %.0f\n",
+                           ts->last_sys_cnt * 188 * 8 * 27e6 / (ts->last_interval));
+                mtr_printf(obj, "tsana_bitrate_bps{part=\"psi_si\"} %.0f\n",
+                           ts->last_psi_cnt * 188 * 8 * 27e6 / (ts->last_interval));
+                mtr_printf(obj, "tsana_bitrate_bps{part=\"null\"} %.0f\n",
+                           ts->last_nul_cnt * 188 * 8 * 27e6 / (ts->last_interval));
+
+                mtr_printf(obj, "# HELP tsana_pid_bitrate_bps Bitrate of last interval, by PID.\n");
+                mtr_printf(obj, "# TYPE tsana_pid_bitrate_bps gauge\n");
+                for(znode = (struct znode *)(ts->pid0); znode; znode = znode->next) {
+                        struct ts_pid *pid = (struct ts_pid *)znode;
+                        const char *sdes = ts_pid_type(pid->type)->sdes;
+
+                        mtr_printf(obj, "tsana_pid_bitrate_bps{pid=\"0x%04X\",program=\"%u\",type=\"%.*s\"} %.0f\n",
+                                   pid->PID,
+                                   (pid->PID >= 0x0020 && 0x1FFF != pid->PID && pid->prog) ?
+                                   (unsigned int)(pid->prog->program_number) : 0U,
+                                   (int)strcspn(sdes, " "), sdes,
+                                   pid->lcnt * 188 * 8 * 27e6 / (ts->last_interval));
+                }
+                mtr_printf(obj, "# HELP tsana_pid_es_bitrate_bps ES bitrate of last interval, by PID.\n");
+                mtr_printf(obj, "# TYPE tsana_pid_es_bitrate_bps gauge\n");
+                for(znode = (struct znode *)(ts->pid0); znode; znode = znode->next) {
+                        struct ts_pid *pid = (struct ts_pid *)znode;
+
+                        if(0 == pid->lcnt_es) {
+                                continue;
+                        }
+                        mtr_printf(obj, "tsana_pid_es_bitrate_bps{pid=\"0x%04X\"} %.0f\n",
+                                   pid->PID, pid->lcnt_es * 8 * 27e6 / (ts->last_interval));
+                }
+        }
+
+        mtr_printf(obj, "# HELP tsana_pcr_metric PCR metrics of TR 101 290 Annex I, by program.\n");
+        mtr_printf(obj, "# TYPE tsana_pcr_metric gauge\n");
+        for(znode = (struct znode *)(ts->prog0); znode; znode = znode->next) {
+                struct ts_prog *prog = (struct ts_prog *)znode;
+                struct ts_pcrm *pcrm = &(prog->pcrm);
+                unsigned int pn = prog->program_number;
+
+                if(prog->is_STC_sync) {
+                        mtr_printf(obj, "tsana_pcr_metric{program=\"%u\",name=\"ac_ns\"} %.0f\n", pn,
+                                   (double)(pcrm->AC) * 1e3 / STC_US);
+                        mtr_printf(obj, "tsana_pcr_metric{program=\"%u\",name=\"ac99_ns\"} %.0f\n", pn,
+                                   pcrm_q99(&(pcrm->AC_hist)));
+                }
+                if(pcrm->n) {
+                        /* need arrive time: ATS or CTS */
+                        mtr_printf(obj, "tsana_pcr_metric{program=\"%u\",name=\"fo_hz\"} %.2f\n", pn, pcrm->FO);
+                        mtr_printf(obj, "tsana_pcr_metric{program=\"%u\",name=\"dr_hz_per_s\"} %.4f\n", pn, pcrm->DR);
+                        mtr_printf(obj, "tsana_pcr_metric{program=\"%u\",name=\"oj_ns\"} %.0f\n", pn,
+                                   (double)(pcrm->OJ) * 1e3 / STC_US);
+                        mtr_printf(obj, "tsana_pcr_metric{program=\"%u\",name=\"oj99_ns\"} %.0f\n", pn,
+                                   pcrm_q99(&(pcrm->OJ_hist)));
+                }
+        }
+
+        if(0 == buddy_usage(mp, &used, &total)) {
+                mtr_printf(obj, "# HELP tsana_mp_bytes Memory pool of libzts, by state.\n");
+                mtr_printf(obj, "# TYPE tsana_mp_bytes gauge\n");
+                mtr_printf(obj, "tsana_mp_bytes{state=\"used\"} %zu\n", used);
+                mtr_printf(obj, "tsana_mp_bytes{state=\"total\"} %zu\n", total);
+        }
+        mtr_printf(obj, "# HELP tsana_mp_ops_total Memory pool operations of libzts.\n");
+        mtr_printf(obj, "# TYPE tsana_mp_ops_total counter\n");
+        mtr_printf(obj, "tsana_mp_ops_total{op=\"alloc\"} %"PRId64"\n", stat.alloc);
+        mtr_printf(obj, "tsana_mp_ops_total{op=\"free\"} %"PRId64"\n", stat.free);
+
+        mtr_update(obj->mtr, obj->mtr_buf, obj->mtr_len);
+        return;
+}
+
+static void mtr_printf(struct tsana_obj *obj, const char *fmt, ...)
+{
+        va_list ap;
+        int len;
+
+        while(1) {
+                size_t left = obj->mtr_max - obj->mtr_len;
+
+                va_start(ap, fmt);
+                len = vsnprintf(obj->mtr_buf + obj->mtr_len, left, fmt, ap);
+                va_end(ap);
+                if(len < 0) {
+                        return;
+                }
+                if((size_t)len < left) {
+                        obj->mtr_len += (size_t)len;
+                        return;
+                }
+
+                /* not enough, double it */
+                {
+                        size_t max = (obj->mtr_max) ? (2 * obj->mtr_max) : (64 * 1024);
+                        char *p = (char *)realloc(obj->mtr_buf, max);
+
+                        if(NULL == p) {
+                                RPTERR("realloc failed");
+                                return;
+                        }
+                        obj->mtr_buf = p;
+                        obj->mtr_max = max;
+                }
+        }
+}
+
 static void table_info_PAT(struct ts_sect *sect)
 {
         uint8_t *cur = sect->section + 8;
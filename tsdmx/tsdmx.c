@@ -0,0 +1,648 @@
+/* vim: set tabstop=8 shiftwidth=8:
+ * name: tsdmx.c
+ * funx: demux bin ts file into many files(TS of PID or program, SPTS, PES, ES) in one pass
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h> /* for strcmp, etc */
+#include <inttypes.h> /* for uintN_t, PRIX64, etc */
+
+#include "tstool_config.h"
+#include "common.h"
+#include "buddy.h"
+#include "ts.h"
+
+static int rpt_lvl = WRN_LVL; /* report level: ERR, WRN, INF, DBG */
+
+#define ANY_PID                         (0x2000) /* any PID of [0x0000,0x1FFF] */
+
+#define OUT_MAX                         (256) /* max number of output files */
+#define OUT_BUF_MIN                     (64 * 1024) /* min write buffer of each output file */
+#define OUT_BUF_ALIGN                   (4096) /* write buffer size is times of it */
+#define MEM_DEFAULT                     (64) /* default memory budget of write buffers, MB */
+#define IN_BUF                          (1 << 20) /* read buffer of input file */
+#define PKT_MAX                         (204) /* max packet size: 188, 192 or 204 */
+#define SYNC_TIME                       (3) /* SYNC_TIME syncs means TS sync */
+
+enum OUT_TYPE
+{
+        OUT_TS, /* TS packets of PID set */
+        OUT_PROG, /* TS packets of PAT and one program */
+        OUT_SPTS, /* TS packets of one program, with new PAT of this program only */
+        OUT_PES, /* PES data of PID set */
+        OUT_ES /* ES data of PID set */
+};
+
+struct out_file {
+        int type; /* OUT_XXX */
+        uint16_t prog; /* program_number, for OUT_PROG and OUT_SPTS */
+        uint16_t PCR_PID; /* PCR_PID of prog, maybe shared with other program */
+        uint8_t CC; /* continuity_counter of new PAT */
+        uint8_t map[0x2000 / 8]; /* PID set, for OUT_TS, OUT_PES and OUT_ES */
+        char *name;
+        FILE *fd;
+        uint8_t *buf; /* part of out_mem */
+        size_t max;
+        size_t len;
+        int64_t cnt; /* bytes written */
+};
+
+static /*@null@*/ FILE *fd_i = NULL;
+static char file_i[FILENAME_MAX] = "";
+static int out_cnt = 0;
+static struct out_file out[OUT_MAX];
+static /*@null@*/ uint8_t *out_mem = NULL;
+static size_t mem_budget = (size_t)MEM_DEFAULT << 20; /* bytes */
+static int pkt_size = 188;
+static int pkt_off = 0; /* offset of sync-byte in packet, 4 for MTS */
+static int need_pes = 0; /* any OUT_PES or OUT_ES */
+static int has_werr = 0; /* any output write error */
+
+static int deal_with_parameter(int argc, char *argv[]);
+static int show_help();
+static int show_version();
+static int add_out(int type, const char *set, const char *name);
+static int out_init();
+static void out_pkt(struct ts_obj *obj, uint8_t *ts);
+static void out_write(struct out_file *of, const uint8_t *data, size_t len);
+static int is_prog_pid(struct ts_obj *obj, struct out_file *of);
+static void prog_pcr_pid(struct ts_obj *obj, struct out_file *of);
+static int make_pat(struct ts_obj *obj, struct out_file *of, uint8_t *pkt);
+static void out_close();
+static int judge_type(const uint8_t *buf, int len);
+
+int main(int argc, char *argv[])
+{
+        void *mp;
+        struct ts_obj *obj;
+        struct ts_cfg cfg;
+        uint8_t *ibuf;
+        size_t ilen = 0; /* data in ibuf */
+        size_t ipos = 0; /* packet position in ibuf */
+        size_t cnt;
+        int64_t addr = 0; /* address of ibuf[0] in input file */
+        int64_t lost = 0; /* bytes passed without sync */
+        int is_type_ok = 0;
+
+        if(0 != deal_with_parameter(argc, argv)) {
+                return -1;
+        }
+
+        fd_i = fopen(file_i, "rb");
+        if(NULL == fd_i) {
+                RPTERR("open \"%s\" failed", file_i);
+                return -1;
+        }
+        ibuf = (uint8_t *)malloc(IN_BUF + PKT_MAX * SYNC_TIME);
+        if(NULL == ibuf) {
+                RPTERR("malloc failed");
+                fclose(fd_i);
+                return -1;
+        }
+        if(0 != out_init()) {
+                free(ibuf);
+                fclose(fd_i);
+                return -1;
+        }
+
+        mp = buddy_create(20, 6); /* for PSI of libzts */
+        obj = ts_create(mp);
+        if(!obj) {
+                RPTERR("malloc ts object failed");
+                out_close();
+                free(ibuf);
+                fclose(fd_i);
+                return -1;
+        }
+        memset(&cfg, 0, sizeof(struct ts_cfg));
+        cfg.need_cc = 1;
+        cfg.need_af = 1; /* to locate payload */
+        cfg.need_psi = 1; /* for program and PID type */
+        cfg.need_pes = need_pes;
+        cfg.need_pes_align = 1;
+        ts_ioctl(obj, TS_SCFG, &cfg);
+
+        while(1) {
+                uint8_t *pkt;
+
+                /* refill */
+                if(ilen - ipos < (size_t)(pkt_size * SYNC_TIME)) {
+                        memmove(ibuf, ibuf + ipos, ilen - ipos);
+                        addr += ipos;
+                        ilen -= ipos;
+                        ipos = 0;
+                        cnt = fread(ibuf + ilen, 1, IN_BUF + PKT_MAX * SYNC_TIME - ilen, fd_i);
+                        ilen += cnt;
+                        if(ilen < (size_t)pkt_size) {
+                                break;
+                        }
+                        if(!is_type_ok) {
+                                is_type_ok = 1;
+                                if(0 != judge_type(ibuf, (int)ilen)) {
+                                        RPTWRN("unknown packet size, use 188");
+                                }
+                        }
+                }
+
+                /* sync */
+                pkt = ibuf + ipos;
+                if(0x47 != pkt[pkt_off] ||
+                   (ipos + pkt_size + pkt_off < ilen && 0x47 != pkt[pkt_size + pkt_off])) {
+                        ipos++;
+                        lost++;
+                        continue;
+                }
+                if(lost) {
+                        RPTWRN("pass %"PRId64"-byte before 0x%"PRIX64, lost, addr + (int64_t)ipos);
+                        lost = 0;
+                }
+
+                memcpy(obj->ipt.TS, pkt + pkt_off, TS_PKT_SIZE);
+                obj->ipt.ADDR = addr + (int64_t)ipos;
+                obj->ipt.has_ts = 1;
+                obj->ipt.has_addr = 1;
+                if(0 != ts_parse_tsh(obj)) {
+                        break;
+                }
+                ts_parse_tsb(obj);
+                out_pkt(obj, pkt + pkt_off);
+
+                /* errors are not reported here */
+                memset(&(obj->err), 0, sizeof(struct ts_err));
+                obj->has_err = 0;
+
+                ipos += pkt_size;
+        }
+
+        ts_destroy(obj);
+        buddy_destroy(mp);
+        out_close();
+        free(ibuf);
+        fclose(fd_i);
+        return (has_werr ? -1 : 0);
+}
+
+static int deal_with_parameter(int argc, char *argv[])
+{
+        int i;
+        intmax_t dat;
+
+        if(1 == argc) {
+                /* no parameter */
+                RPTERR("No binary file to process...\n\n");
+                show_help();
+                return -1;
+        }
+
+        for(i = 1; i < argc; i++) {
+                if('-' == argv[i][0]) {
+                        if(0 == strcmp(argv[i], "-ts") ||
+                           0 == strcmp(argv[i], "-prog") ||
+                           0 == strcmp(argv[i], "-spts") ||
+                           0 == strcmp(argv[i], "-pes") ||
+                           0 == strcmp(argv[i], "-es")) {
+                                int type;
+
+                                if(i + 2 >= argc) {
+                                        RPTERR("no parameter for '%s'!\n", argv[i]);
+                                        return -1;
+                                }
+                                type = ((0 == strcmp(argv[i], "-ts")) ? OUT_TS :
+                                        (0 == strcmp(argv[i], "-prog")) ? OUT_PROG :
+                                        (0 == strcmp(argv[i], "-spts")) ? OUT_SPTS :
+                                        (0 == strcmp(argv[i], "-pes")) ? OUT_PES : OUT_ES);
+                                if(0 != add_out(type, argv[i + 1], argv[i + 2])) {
+                                        return -1;
+                                }
+                                i += 2;
+                        }
+                        else if(0 == strcmp(argv[i], "-m") ||
+                                0 == strcmp(argv[i], "--mem")) {
+                                i++;
+                                if(i >= argc) {
+                                        RPTERR("no parameter for 'mem'!\n");
+                                        return -1;
+                                }
+                                sscanf(argv[i], "%"SCNiMAX, &dat);
+                                if(0 < dat && dat <= 65536) {
+                                        mem_budget = (size_t)dat << 20;
+                                }
+                                else {
+                                        RPTERR("bad variable for 'mem': %jd(0 < x <= 65536), use %d instead!\n",
+                                               dat, MEM_DEFAULT);
+                                }
+                        }
+                        else if(0 == strcmp(argv[i], "-l"))
+                        {
+                                i++;
+                                if(i >= argc)
+                                {
+                                        RPTERR("no parameter for '-l'!");
+                                        exit(EXIT_FAILURE);
+                                }
+                                if(0 == strcmp(argv[i], "dbg"))
+                                {
+                                        rpt_lvl = DBG_LVL;
+                                        RPTINF("repot level: 'dbg'");
+                                }
+                                else if(0 == strcmp(argv[i], "inf"))
+                                {
+                                        rpt_lvl = INF_LVL;
+                                        RPTINF("repot level: 'inf'");
+                                }
+                                else if(0 == strcmp(argv[i], "wrn"))
+                                {
+                                        rpt_lvl = WRN_LVL;
+                                        RPTINF("repot level: 'wrn'");
+                                }
+                                else
+                                {
+                                        rpt_lvl = ERR_LVL;
+                                        RPTINF("repot level: 'err'");
+                                }
+                        }
+                        else if(0 == strcmp(argv[i], "-h") ||
+                                0 == strcmp(argv[i], "--help")) {
+                                show_help();
+                                return -1;
+                        }
+                        else if(0 == strcmp(argv[i], "-v") ||
+                                0 == strcmp(argv[i], "--version")) {
+                                show_version();
+                                return -1;
+                        }
+                        else {
+                                RPTERR("Wrong parameter: %s", argv[i]);
+                                return -1;
+                        }
+                }
+                else {
+                        strcpy(file_i, argv[i]);
+                }
+        }
+
+        if(0 == out_cnt) {
+                RPTERR("No output file...\n\n");
+                show_help();
+                return -1;
+        }
+        return 0;
+}
+
+static int show_help()
+{
+        fprintf(stdout,
+                "'tsdmx' read binary ts file once, write data of PIDs or programs to many files.\n"
+                "\n"
+                "Usage: tsdmx [OPTION] file [OPTION]\n"
+                "\n"
+                "Options:\n"
+                "\n"
+                " -ts <pids> <file>        TS packets of PID list, e.g. 0x100,0x101; 0x2000 for any PID\n"
+                " -prog <prog> <file>      TS packets of PAT and program prog\n"
+                " -spts <prog> <file>      TS packets of program prog, with PAT of prog only\n"
+                " -pes <pids> <file>       PES data of PID list\n"
+                " -es <pids> <file>        ES data of PID list\n"
+                " -m, --mem <n>            n-MB memory for write buffers of all files, default: %d\n"
+                "\n"
+                " -l <level>               set report level(dbg|inf|wrn|err), default: wrn\n"
+                " -h, --help               display this information\n"
+                " -v, --version            display my version\n"
+                "\n"
+                "Examples:\n"
+                "  tsdmx xxx.ts -prog 1 p1.ts -prog 2 p2.ts -es 0x100 v.es -es 0x101 a.es\n"
+                "  tsdmx xxx.ts -spts 1 p1.ts\n"
+                "\n"
+                "Report bugs to <zhoucheng@tsinghua.org.cn>.\n",
+                MEM_DEFAULT);
+        return 0;
+}
+
+static int show_version()
+{
+        fprintf(stdout,
+                "tsdmx of tstools v%s (%s)\n"
+                "Build time: %s %s\n"
+                "\n"
+                "Copyright (C) 2009,2010,2011,2012,2013,2014 ZHOU Cheng.\n"
+                "License GPLv3+: GNU GPL version 3 or later <http://gnu.org/licenses/gpl.html>\n"
+                "This is free software; contact author for additional information.\n"
+                "There is NO warranty; not even for MERCHANTABILITY or FITNESS FOR\n"
+                "A PARTICULAR PURPOSE.\n"
+                "\n"
+                "Written by ZHOU Cheng.\n",
+                VERSION_STR, REVISION, __DATE__, __TIME__);
+        return 0;
+}
+
+/* set: "0x100,0x101,..." for PID list, or "1" for program_number */
+static int add_out(int type, const char *set, const char *name)
+{
+        struct out_file *of;
+        const char *p = set;
+        int dat;
+
+        if(out_cnt >= OUT_MAX) {
+                RPTERR("too many output files, %d at most", OUT_MAX);
+                return -1;
+        }
+        of = &(out[out_cnt]);
+        memset(of, 0, sizeof(struct out_file));
+        of->type = type;
+        of->name = (char *)name;
+
+        if(OUT_PROG == type || OUT_SPTS == type) {
+                if(1 != sscanf(set, "%i", &dat) || dat <= 0x0000 || 0xFFFF < dat) {
+                        RPTERR("bad program_number: \"%s\"", set);
+                        return -1;
+                }
+                of->prog = (uint16_t)dat;
+        }
+        else {
+                while(*p) {
+                        char *end;
+
+                        dat = (int)strtol(p, &end, 0);
+                        if(end == p || dat < 0x0000 || ANY_PID < dat) {
+                                RPTERR("bad PID list: \"%s\"", set);
+                                return -1;
+                        }
+                        if(ANY_PID == dat) {
+                                memset(of->map, 0xFF, sizeof(of->map));
+                        }
+                        else {
+                                of->map[dat >> 3] |= (uint8_t)(1 << (dat & 0x07));
+                        }
+                        p = ((',' == *end) ? end + 1 : end);
+                }
+        }
+
+        if(OUT_PES == type || OUT_ES == type) {
+                need_pes = 1;
+        }
+        out_cnt++;
+        return 0;
+}
+
+/* share mem_budget with all output files */
+static int out_init()
+{
+        int i;
+        size_t max;
+
+        max = mem_budget / out_cnt;
+        max -= max % OUT_BUF_ALIGN;
+        if(max < OUT_BUF_MIN) {
+                RPTWRN("%d-MB too small for %d files, use %d-KB for each",
+                       (int)(mem_budget >> 20), out_cnt, OUT_BUF_MIN >> 10);
+                max = OUT_BUF_MIN;
+        }
+
+        out_mem = (uint8_t *)malloc(max * out_cnt);
+        if(NULL == out_mem) {
+                RPTERR("malloc %d * %d-byte failed", out_cnt, (int)max);
+                return -1;
+        }
+
+        for(i = 0; i < out_cnt; i++) {
+                struct out_file *of = &(out[i]);
+
+                of->fd = fopen(of->name, "wb");
+                if(NULL == of->fd) {
+                        RPTERR("open \"%s\" failed", of->name);
+                        out_close();
+                        return -1;
+                }
+                setvbuf(of->fd, NULL, _IONBF, 0); /* of->buf is big enough */
+                of->buf = out_mem + max * i;
+                of->max = max;
+                of->len = 0;
+        }
+        return 0;
+}
+
+static void out_pkt(struct ts_obj *obj, uint8_t *ts)
+{
+        int i;
+        uint16_t PID = obj->PID;
+        int is_pid = 0; /* PID in map */
+
+        for(i = 0; i < out_cnt; i++) {
+                struct out_file *of = &(out[i]);
+
+                if(!(of->fd)) {
+                        continue;
+                }
+                if(OUT_PROG != of->type && OUT_SPTS != of->type) {
+                        is_pid = (of->map[PID >> 3] & (1 << (PID & 0x07)));
+                }
+                else {
+                        prog_pcr_pid(obj, of);
+                }
+
+                switch(of->type) {
+                        case OUT_TS:
+                                if(is_pid) {
+                                        out_write(of, ts, TS_PKT_SIZE);
+                                }
+                                break;
+                        case OUT_PROG:
+                                if(0x0000 == PID || is_prog_pid(obj, of)) {
+                                        out_write(of, ts, TS_PKT_SIZE);
+                                }
+                                break;
+                        case OUT_SPTS:
+                                if(0x0000 == PID) {
+                                        uint8_t pat[TS_PKT_SIZE];
+
+                                        /* one new PAT for each PAT section, keep the interval */
+                                        if(obj->tsh.payload_unit_start_indicator &&
+                                           0 == make_pat(obj, of, pat)) {
+                                                out_write(of, pat, TS_PKT_SIZE);
+                                        }
+                                }
+                                else if(0 != of->PCR_PID && is_prog_pid(obj, of)) {
+                                        out_write(of, ts, TS_PKT_SIZE);
+                                }
+                                break;
+                        case OUT_PES:
+                                if(is_pid && obj->PES_len) {
+                                        out_write(of, obj->PES, (size_t)(obj->PES_len));
+                                }
+                                break;
+                        default: /* OUT_ES */
+                                if(is_pid && obj->ES_len) {
+                                        out_write(of, obj->ES, (size_t)(obj->ES_len));
+                                }
+                                break;
+                }
+        }
+        return;
+}
+
+static void out_write(struct out_file *of, const uint8_t *data, size_t len)
+{
+        if(of->len + len > of->max) {
+                if(of->len != fwrite(of->buf, 1, of->len, of->fd)) {
+                        RPTERR("write \"%s\" failed, stop it", of->name);
+                        has_werr = 1;
+                        fclose(of->fd);
+                        of->fd = NULL;
+                        return;
+                }
+                of->len = 0;
+        }
+        memcpy(of->buf + of->len, data, len);
+        of->len += len;
+        of->cnt += len;
+        return;
+}
+
+static int is_prog_pid(struct ts_obj *obj, struct out_file *of)
+{
+        uint16_t PID = obj->PID;
+
+        if(PID < 0x0020 || 0x1FFF == PID) {
+                return 0; /* PID without program belongs to prog0 in libzts */
+        }
+        if(PID == of->PCR_PID) {
+                return 1;
+        }
+        return (obj->pid && obj->pid->prog && obj->pid->prog->program_number == of->prog);
+}
+
+/* of->PCR_PID from PAT or PMT of of->prog, PMT_PID before PMT parsed, 0 before PAT */
+static void prog_pcr_pid(struct ts_obj *obj, struct out_file *of)
+{
+        struct znode *znode;
+        struct ts_prog *prog = NULL;
+
+        if(0x0000 == obj->PID) {
+                if(!(obj->tsh.payload_unit_start_indicator)) {
+                        return;
+                }
+                for(znode = (struct znode *)(obj->prog0); znode; znode = znode->next) {
+                        if(((struct ts_prog *)znode)->program_number == of->prog) {
+                                prog = (struct ts_prog *)znode;
+                                break;
+                        }
+                }
+        }
+        else if(obj->pid && obj->pid->prog &&
+                obj->pid->prog->program_number == of->prog &&
+                obj->PID == obj->pid->prog->PMT_PID) {
+                prog = obj->pid->prog;
+        }
+        if(prog) {
+                of->PCR_PID = (prog->is_parsed ? prog->PCR_PID : prog->PMT_PID);
+        }
+        return;
+}
+
+/* PAT with of->prog only, 0 if OK */
+static int make_pat(struct ts_obj *obj, struct out_file *of, uint8_t *pkt)
+{
+        struct znode *znode;
+        struct ts_prog *prog = NULL;
+        struct ts_tabl *tabl;
+        uint8_t *p = pkt;
+        uint8_t *sect;
+        uint32_t crc;
+
+        for(znode = (struct znode *)(obj->prog0); znode; znode = znode->next) {
+                if(((struct ts_prog *)znode)->program_number == of->prog) {
+                        prog = (struct ts_prog *)znode;
+                        break;
+                }
+        }
+        tabl = ts_tabl_search(obj, 0x0000, 0x00, 0x0000, 0);
+        if(!prog || !tabl) {
+                return -1; /* PAT not parsed or prog not in PAT */
+        }
+
+        *p++ = 0x47;
+        *p++ = 0x40; /* payload_unit_start_indicator, PID 0x0000 */
+        *p++ = 0x00;
+        *p++ = 0x10 | of->CC; /* payload only */
+        of->CC = (of->CC + 1) & 0x0F;
+        *p++ = 0x00; /* pointer_field */
+
+        sect = p;
+        *p++ = 0x00; /* table_id */
+        *p++ = 0xB0; /* section_length: 5 + 4 + 4 */
+        *p++ = 13;
+        *p++ = (uint8_t)(obj->transport_stream_id >> 8);
+        *p++ = (uint8_t)(obj->transport_stream_id);
+        *p++ = 0xC1 | ((tabl->version_number & 0x1F) << 1); /* current_next_indicator */
+        *p++ = 0x00; /* section_number */
+        *p++ = 0x00; /* last_section_number */
+        *p++ = (uint8_t)(prog->program_number >> 8);
+        *p++ = (uint8_t)(prog->program_number);
+        *p++ = 0xE0 | (uint8_t)(prog->PMT_PID >> 8);
+        *p++ = (uint8_t)(prog->PMT_PID);
+
+        crc = ts_crc(sect, (size_t)(p - sect), 32);
+        *p++ = (uint8_t)(crc >> 24);
+        *p++ = (uint8_t)(crc >> 16);
+        *p++ = (uint8_t)(crc >> 8);
+        *p++ = (uint8_t)(crc);
+
+        memset(p, 0xFF, TS_PKT_SIZE - (p - pkt));
+        return 0;
+}
+
+static void out_close()
+{
+        int i;
+
+        for(i = 0; i < out_cnt; i++) {
+                struct out_file *of = &(out[i]);
+
+                if(!(of->fd)) {
+                        continue;
+                }
+                if(of->len != fwrite(of->buf, 1, of->len, of->fd)) {
+                        RPTERR("write \"%s\" failed", of->name);
+                        has_werr = 1;
+                }
+                if(0 != fclose(of->fd)) {
+                        RPTERR("close \"%s\" failed", of->name);
+                        has_werr = 1;
+                }
+                of->fd = NULL;
+                RPTINF("%s: %"PRId64"-byte", of->name, of->cnt);
+        }
+        if(out_mem) {
+                free(out_mem);
+                out_mem = NULL;
+        }
+        return;
+}
+
+/* packet size and sync-byte offset: TS(188), MTS(4 + 188) or TSRS(188 + 16) */
+static int judge_type(const uint8_t *buf, int len)
+{
+        static const int size[] = {188, 192, 204};
+        static const int off[] = {0, 4, 0};
+        int start;
+        int i;
+        int k;
+
+        for(start = 0; start + PKT_MAX * SYNC_TIME < len && start < 4096; start++) {
+                for(i = 0; i < 3; i++) {
+                        for(k = 0; k < SYNC_TIME; k++) {
+                                if(0x47 != buf[start + off[i] + size[i] * k]) {
+                                        break;
+                                }
+                        }
+                        if(SYNC_TIME == k) {
+                                pkt_size = size[i];
+                                pkt_off = off[i];
+                                RPTINF("packet size: %d", pkt_size);
+                                return 0;
+                        }
+                }
+        }
+        return -1;
+}
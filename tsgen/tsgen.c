@@ -0,0 +1,859 @@
+/* vim: set tabstop=8 shiftwidth=8:
+ * name: tsgen.c
+ * funx: generate synthetic TS with many programs, EIT load and faults, for load test
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h> /* for strcmp, memset, memcpy, etc */
+#include <inttypes.h> /* for uintN_t, PRId64, etc */
+#include <time.h> /* for clock_gettime(), nanosleep() */
+
+#include "tstool_config.h"
+#include "common.h"
+#include "ts.h"
+#include "url.h"
+
+static int rpt_lvl = WRN_LVL; /* report level: ERR, WRN, INF, DBG */
+
+#define PROG_MAX                        (1000)
+#define PAT_PID                         (0x0000)
+#define SDT_PID                         (0x0011)
+#define EIT_PID                         (0x0012)
+#define NUL_PID                         (0x1FFF)
+#define PMT_PID(i)                      (0x0100 + (i))
+#define VID_PID(i)                      (0x1000 + 2 * (i))
+#define AUD_PID(i)                      (0x1001 + 2 * (i))
+#define TSID                            (1)
+#define ONID                            (1)
+
+#define PSI_MS                          (100) /* PAT and PMT interval */
+#define SDT_MS                          (500)
+#define AUD_BPS                         (128000)
+#define AUD_FRAME                       (AUD_BPS / 8 * 24 / 1000) /* 24ms */
+#define FPS                             (25)
+#define PTS_DELAY                       (500 * STC_MS) /* PTS - PCR */
+#define SECT_BODY_MAX                   (1021 - 5 - 4) /* section_length - head - CRC */
+#define UDP_PKT                         (7) /* one datagram */
+#define FILE_PKT                        (2048) /* one fwrite() */
+#define PPM                             (1000000)
+
+enum strm_type {
+        STRM_PSI, /* repeat packets of tables */
+        STRM_VID,
+        STRM_AUD
+};
+
+struct strm {
+        int type; /* STRM_XXX */
+        uint16_t pid;
+        uint8_t cc;
+        int64_t due; /* Q16, packet index to send next */
+        int64_t step; /* Q16, packets between two send */
+
+        /* STRM_PSI */
+        uint8_t *pkt;
+        int npkt;
+        int ipkt;
+
+        /* STRM_VID, STRM_AUD */
+        int prog;
+        int64_t frame; /* byte per PES */
+        int64_t left; /* byte left of this PES */
+        int64_t pcr_next; /* clk, STRM_VID only */
+};
+
+static char file_o[FILENAME_MAX] = "";
+static int nprog = 4;
+static int64_t rate = 38000000; /* bps */
+static int pcr_ms = 30;
+static int eit_kbps = 64; /* 0: no EIT */
+static int64_t npkt_total = 0; /* 0: from duration */
+static int duration = 10; /* second */
+static uint64_t seed = 1;
+static int fcc = 0; /* fault per million packet */
+static int fcrc = 0;
+static int fpcr = 0;
+static int is_fast = 0; /* no pacing for udp:// */
+
+static struct strm *strm = NULL;
+static int nstrm = 0;
+static int *heap = NULL; /* index of strm, min due first */
+static int64_t *pcr_off = NULL; /* clk, PCR of program = packet time + pcr_off */
+static uint64_t rng_state;
+
+/* pending and injected faults */
+static int is_fcc = 0;
+static int is_fcrc = 0;
+static int is_fpcr = 0;
+static int64_t cnt_fcc = 0;
+static int64_t cnt_fcrc = 0;
+static int64_t cnt_fpcr = 0;
+
+static int deal_with_parameter(int argc, char *argv[]);
+static int show_help();
+static int show_version();
+static uint64_t rng(void);
+static int64_t now_ns(void);
+static struct strm *new_strm(int type, uint16_t pid);
+static int make_sect(uint8_t *sect, uint8_t table_id, uint16_t ext, int sec, int last, const uint8_t *body, int len);
+static int add_sect(struct strm *s, const uint8_t *sect, int len);
+static int make_tables(void);
+static int put_desc_str(uint8_t *p, const char *str);
+static int sdt_body(uint8_t *body, int *i);
+static void heap_down(int i);
+static void emit_psi(uint8_t *p, struct strm *s);
+static void emit_es(uint8_t *p, struct strm *s, int64_t t);
+
+static const uint8_t nul_pkt[4] = {0x47, NUL_PID >> 8, NUL_PID & 0xFF, 0x10};
+
+int main(int argc, char *argv[])
+{
+        struct url *fd_o;
+        uint8_t *buf;
+        int buf_pkt;
+        int cnt = 0;
+        int64_t k;
+        int64_t clk_per_pkt; /* Q16 */
+        int64_t t0;
+        int64_t t;
+        int64_t psi_bps = 0;
+        int64_t vid_bps;
+        int i;
+
+        if(0 != deal_with_parameter(argc, argv)) {
+                return -1;
+        }
+        rng_state = seed * 0x9E3779B97F4A7C15ULL + 1; /* never 0 */
+
+        /* streams: PAT, SDT, EIT, then PMT, video and audio of each program */
+        strm = (struct strm *)calloc(3 + 3 * nprog, sizeof(struct strm));
+        heap = (int *)malloc((3 + 3 * nprog) * sizeof(int));
+        pcr_off = (int64_t *)malloc(nprog * sizeof(int64_t));
+        if(NULL == strm || NULL == heap || NULL == pcr_off) {
+                RPTERR("malloc failed");
+                return -1;
+        }
+        if(0 != make_tables()) {
+                return -1;
+        }
+
+        /* rate of PSI streams: npkt per period, EIT by eit_kbps */
+        for(i = 0; i < nstrm; i++) {
+                struct strm *s = &strm[i];
+                double pps; /* packet per second */
+                int ms = ((SDT_PID == s->pid) ? SDT_MS : PSI_MS);
+
+                if(STRM_PSI != s->type) {
+                        continue;
+                }
+                pps = ((EIT_PID == s->pid) ?
+                       (double)eit_kbps * 1000 / (8 * TS_PKT_SIZE) :
+                       (double)s->npkt * 1000 / ms);
+                s->step = (int64_t)(65536.0 * ((double)rate / (8 * TS_PKT_SIZE)) / pps);
+                psi_bps += (int64_t)(pps * 8 * TS_PKT_SIZE);
+        }
+
+        /* the rest for video */
+        vid_bps = (rate - psi_bps - (int64_t)nprog * AUD_BPS) / nprog;
+        if(vid_bps < 100000) {
+                RPTERR("bitrate too low for %d programs, need more than %" PRId64 " bps",
+                       nprog, psi_bps + (int64_t)nprog * (AUD_BPS + 100000));
+                return -1;
+        }
+        for(i = 0; i < nstrm; i++) {
+                struct strm *s = &strm[i];
+
+                if(STRM_VID == s->type) {
+                        s->step = (rate << 16) / vid_bps;
+                        s->frame = vid_bps / 8 / FPS;
+                }
+                else if(STRM_AUD == s->type) {
+                        s->step = (rate << 16) / AUD_BPS;
+                        s->frame = AUD_FRAME;
+                }
+                s->due = (int64_t)(rng() % (uint64_t)s->step); /* spread */
+        }
+        for(i = 0; i < nprog; i++) {
+                pcr_off[i] = (int64_t)(rng() % (uint64_t)STC_OVF);
+        }
+        for(i = 0; i < nstrm; i++) {
+                heap[i] = i;
+        }
+        for(i = nstrm / 2 - 1; i >= 0; i--) {
+                heap_down(i);
+        }
+
+        if(0 == npkt_total) {
+                npkt_total = rate * duration / (8 * TS_PKT_SIZE);
+        }
+        clk_per_pkt = ((int64_t)8 * TS_PKT_SIZE * STC_1S << 16) / rate;
+
+        fd_o = url_open(file_o, "wb");
+        if(NULL == fd_o) {
+                RPTERR("open \"%s\" failed", file_o);
+                return -1;
+        }
+        buf_pkt = ((SCH_UDP == fd_o->scheme) ? UDP_PKT : FILE_PKT);
+        buf = (uint8_t *)malloc(buf_pkt * TS_PKT_SIZE);
+        if(NULL == buf) {
+                RPTERR("malloc failed");
+                url_close(fd_o);
+                return -1;
+        }
+
+        t0 = now_ns();
+        for(k = 0; k < npkt_total; k++) {
+                struct strm *s = &strm[heap[0]];
+                uint8_t *p = buf + cnt * TS_PKT_SIZE;
+
+                t = (k * clk_per_pkt) >> 16;
+                if(fcc && rng() % PPM < (uint64_t)fcc) {
+                        is_fcc = 1;
+                }
+                if(fcrc && rng() % PPM < (uint64_t)fcrc) {
+                        is_fcrc = 1;
+                }
+                if(fpcr && rng() % PPM < (uint64_t)fpcr) {
+                        is_fpcr = 1;
+                }
+
+                if(s->due <= (k << 16)) {
+                        if(STRM_PSI == s->type) {
+                                emit_psi(p, s);
+                        }
+                        else {
+                                emit_es(p, s, t);
+                        }
+                        s->due += s->step;
+                        heap_down(0);
+                }
+                else {
+                        memcpy(p, nul_pkt, 4);
+                        memset(p + 4, 0xFF, TS_PKT_SIZE - 4);
+                }
+
+                cnt++;
+                if(cnt < buf_pkt && k + 1 < npkt_total) {
+                        continue;
+                }
+                if((size_t)cnt != url_write(buf, TS_PKT_SIZE, cnt, fd_o)) {
+                        RPTERR("write \"%s\" failed", file_o);
+                        free(buf);
+                        url_close(fd_o);
+                        return -1;
+                }
+                cnt = 0;
+
+                /* pacing by packet time */
+                if(SCH_UDP == fd_o->scheme && !is_fast) {
+                        int64_t ahead = t * 1000 / STC_US - (now_ns() - t0);
+
+                        if(ahead > 1000000) {
+                                struct timespec ts;
+
+                                ts.tv_sec = ahead / 1000000000;
+                                ts.tv_nsec = ahead % 1000000000;
+                                nanosleep(&ts, NULL);
+                        }
+                }
+        }
+        t = now_ns() - t0;
+        url_close(fd_o);
+
+        fprintf(stderr, "%" PRId64 " packets, %d programs, %.3f s, %.3f Gbit/s\n",
+                npkt_total, nprog, (double)t / 1e9,
+                (double)npkt_total * 8 * TS_PKT_SIZE / (double)(t + 1));
+        if(fcc || fcrc || fpcr) {
+                fprintf(stderr, "fault: %" PRId64 " CC, %" PRId64 " CRC, %" PRId64 " PCR\n",
+                        cnt_fcc, cnt_fcrc, cnt_fpcr);
+        }
+
+        for(i = 0; i < nstrm; i++) {
+                free(strm[i].pkt);
+        }
+        free(strm);
+        free(heap);
+        free(pcr_off);
+        free(buf);
+        return 0;
+}
+
+static int deal_with_parameter(int argc, char *argv[])
+{
+        int i;
+        intmax_t dat;
+
+        if(1 == argc) {
+                /* no parameter */
+                fprintf(stderr, "No URL to write...\n\n");
+                show_help();
+                return -1;
+        }
+
+        for(i = 1; i < argc; i++) {
+                if('-' == argv[i][0]) {
+                        if(0 == strcmp(argv[i], "-p")) {
+                                i++;
+                                if(i >= argc) {
+                                        RPTERR("no parameter for 'p'!\n");
+                                        return -1;
+                                }
+                                sscanf(argv[i], "%"SCNiMAX, &dat);
+                                if(1 <= dat && dat <= PROG_MAX) {
+                                        nprog = (int)dat;
+                                }
+                                else {
+                                        RPTERR("bad variable for 'p': %jd(1 <= x <= %d)!\n", dat, PROG_MAX);
+                                        return -1;
+                                }
+                        }
+                        else if(0 == strcmp(argv[i], "-r")) {
+                                i++;
+                                if(i >= argc) {
+                                        RPTERR("no parameter for 'r'!\n");
+                                        return -1;
+                                }
+                                sscanf(argv[i], "%"SCNiMAX, &dat);
+                                if(1 <= dat && dat <= 40000) {
+                                        rate = (int64_t)dat * 1000000;
+                                }
+                                else {
+                                        RPTERR("bad variable for 'r': %jd(1 <= x <= 40000)!\n", dat);
+                                        return -1;
+                                }
+                        }
+                        else if(0 == strcmp(argv[i], "-pcr")) {
+                                i++;
+                                if(i >= argc) {
+                                        RPTERR("no parameter for 'pcr'!\n");
+                                        return -1;
+                                }
+                                sscanf(argv[i], "%"SCNiMAX, &dat);
+                                if(1 <= dat && dat <= 1000) {
+                                        pcr_ms = (int)dat;
+                                }
+                                else {
+                                        RPTERR("bad variable for 'pcr': %jd(1 <= x <= 1000)!\n", dat);
+                                        return -1;
+                                }
+                        }
+                        else if(0 == strcmp(argv[i], "-eit")) {
+                                i++;
+                                if(i >= argc) {
+                                        RPTERR("no parameter for 'eit'!\n");
+                                        return -1;
+                                }
+                                sscanf(argv[i], "%"SCNiMAX, &dat);
+                                if(0 <= dat && dat <= 100000) {
+                                        eit_kbps = (int)dat;
+                                }
+                                else {
+                                        RPTERR("bad variable for 'eit': %jd(0 <= x <= 100000)!\n", dat);
+                                        return -1;
+                                }
+                        }
+                        else if(0 == strcmp(argv[i], "-t")) {
+                                i++;
+                                if(i >= argc) {
+                                        RPTERR("no parameter for 't'!\n");
+                                        return -1;
+                                }
+                                sscanf(argv[i], "%"SCNiMAX, &dat);
+                                if(1 <= dat && dat <= 7 * 24 * 3600) {
+                                        duration = (int)dat;
+                                }
+                                else {
+                                        RPTERR("bad variable for 't': %jd(1 <= x <= 604800)!\n", dat);
+                                        return -1;
+                                }
+                        }
+                        else if(0 == strcmp(argv[i], "-n")) {
+                                i++;
+                                if(i >= argc) {
+                                        RPTERR("no parameter for 'n'!\n");
+                                        return -1;
+                                }
+                                sscanf(argv[i], "%"SCNiMAX, &dat);
+                                if(1 <= dat) {
+                                        npkt_total = (int64_t)dat;
+                                }
+                                else {
+                                        RPTERR("bad variable for 'n': %jd(1 <= x)!\n", dat);
+                                        return -1;
+                                }
+                        }
+                        else if(0 == strcmp(argv[i], "-seed")) {
+                                i++;
+                                if(i >= argc) {
+                                        RPTERR("no parameter for 'seed'!\n");
+                                        return -1;
+                                }
+                                sscanf(argv[i], "%"SCNiMAX, &dat);
+                                seed = (uint64_t)dat;
+                        }
+                        else if(0 == strcmp(argv[i], "-fcc") ||
+                                0 == strcmp(argv[i], "-fcrc") ||
+                                0 == strcmp(argv[i], "-fpcr")) {
+                                const char *opt = argv[i] + 1;
+
+                                i++;
+                                if(i >= argc) {
+                                        RPTERR("no parameter for '%s'!\n", opt);
+                                        return -1;
+                                }
+                                sscanf(argv[i], "%"SCNiMAX, &dat);
+                                if(dat < 0 || dat > PPM) {
+                                        RPTERR("bad variable for '%s': %jd(0 <= x <= %d)!\n", opt, dat, PPM);
+                                        return -1;
+                                }
+                                if(0 == strcmp(opt, "fcc")) {
+                                        fcc = (int)dat;
+                                }
+                                else if(0 == strcmp(opt, "fcrc")) {
+                                        fcrc = (int)dat;
+                                }
+                                else {
+                                        fpcr = (int)dat;
+                                }
+                        }
+                        else if(0 == strcmp(argv[i], "-fast")) {
+                                is_fast = 1;
+                        }
+                        else if(0 == strcmp(argv[i], "-h") ||
+                                0 == strcmp(argv[i], "--help")) {
+                                show_help();
+                                return -1;
+                        }
+                        else if(0 == strcmp(argv[i], "-v") ||
+                                0 == strcmp(argv[i], "--version")) {
+                                show_version();
+                                return -1;
+                        }
+                        else {
+                                RPTERR("wrong parameter: %s", argv[i]);
+                                return -1;
+                        }
+                }
+                else {
+                        strcpy(file_o, argv[i]);
+                }
+        }
+
+        if('\0' == file_o[0]) {
+                RPTERR("no URL to write");
+                return -1;
+        }
+        return 0;
+}
+
+static int show_help()
+{
+        fprintf(stdout,
+                "'tsgen' generate synthetic TS for load test, same seed same stream.\n"
+                "\n"
+                "Usage: tsgen [OPTION] <file> [OPTION]\n"
+                "       tsgen [OPTION] udp://*:* [OPTION]\n"
+                "\n"
+                "Options:\n"
+                "\n"
+                " -p <n>           program count, default: 4\n"
+                " -r <Mbps>        total bitrate, default: 38\n"
+                " -pcr <ms>        PCR interval, default: 30\n"
+                " -eit <kbps>      EIT p/f bitrate, 0 for no EIT, default: 64\n"
+                " -t <second>      duration of stream, default: 10\n"
+                " -n <packet>      packet count, instead of -t\n"
+                " -seed <n>        seed of random, default: 1\n"
+                " -fcc <ppm>       CC gap per million packets, default: 0\n"
+                " -fcrc <ppm>      CRC error per million packets, default: 0\n"
+                " -fpcr <ppm>      PCR jump per million packets, default: 0\n"
+                " -fast            no pacing for udp://, send as fast as possible\n"
+                "\n"
+                " -h, --help       print this information only\n"
+                " -v, --version    print my version only\n"
+                "\n"
+                "Each program has PMT, video with PCR and audio, with SDT and EIT p/f.\n"
+                "Video of each program gets the bitrate left, udp:// is paced by bitrate.\n"
+                "\n"
+                "Examples:\n"
+                "  tsgen -p 300 -r 1000 -eit 2000 -t 60 big.ts\n\n"
+                "  tsgen -p 20 -r 2000 udp://224.165.54.31:1234\n\n"
+                "  tsgen -seed 7 -fcc 20 -fcrc 10 -fpcr 5 bad.ts\n\n"
+                "\n"
+                "Report bugs to <zhoucheng@tsinghua.org.cn>.\n");
+        return 0;
+}
+
+static int show_version()
+{
+        fprintf(stdout,
+                "tsgen of tstools v%s (%s)\n"
+                "Build time: %s %s\n"
+                "\n"
+                "Copyright (C) 2009,2010,2011,2012,2013,2014 ZHOU Cheng.\n"
+                "License GPLv3+: GNU GPL version 3 or later <http://gnu.org/licenses/gpl.html>\n"
+                "This is free software; contact author for additional information.\n"
+                "There is NO warranty; not even for MERCHANTABILITY or FITNESS FOR\n"
+                "A PARTICULAR PURPOSE.\n"
+                "\n"
+                "Written by ZHOU Cheng.\n",
+                VERSION_STR, REVISION, __DATE__, __TIME__);
+        return 0;
+}
+
+/* xorshift64*, same sequence on every platform */
+static uint64_t rng(void)
+{
+        rng_state ^= rng_state >> 12;
+        rng_state ^= rng_state << 25;
+        rng_state ^= rng_state >> 27;
+        return rng_state * 0x2545F4914F6CDD1DULL;
+}
+
+static int64_t now_ns(void)
+{
+        struct timespec ts;
+
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+        return (int64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+static struct strm *new_strm(int type, uint16_t pid)
+{
+        struct strm *s = &strm[nstrm++];
+
+        s->type = type;
+        s->pid = pid;
+        return s;
+}
+
+/* long form section, return byte count */
+static int make_sect(uint8_t *sect, uint8_t table_id, uint16_t ext, int sec, int last, const uint8_t *body, int len)
+{
+        uint8_t *p = sect;
+        int section_length = 5 + len + 4;
+        uint32_t crc;
+
+        *p++ = table_id;
+        *p++ = ((table_id >= 0x40) ? 0xF0 : 0xB0) | (section_length >> 8); /* SI: private_indicator */
+        *p++ = section_length & 0xFF;
+        *p++ = ext >> 8;
+        *p++ = ext & 0xFF;
+        *p++ = 0xC1; /* version_number 0, current_next_indicator 1 */
+        *p++ = (uint8_t)sec;
+        *p++ = (uint8_t)last;
+        memcpy(p, body, len);
+        p += len;
+
+        crc = ts_crc(sect, p - sect, 32);
+        *p++ = (crc >> 24) & 0xFF;
+        *p++ = (crc >> 16) & 0xFF;
+        *p++ = (crc >> 8) & 0xFF;
+        *p++ = crc & 0xFF;
+        return (int)(p - sect);
+}
+
+/* section from a new packet, stuffing 0xFF after it */
+static int add_sect(struct strm *s, const uint8_t *sect, int len)
+{
+        int n = (len + 1 + TS_PKT_SIZE - 4 - 1) / (TS_PKT_SIZE - 4); /* with pointer_field */
+        uint8_t *pkt;
+        int i;
+
+        pkt = (uint8_t *)realloc(s->pkt, (s->npkt + n) * TS_PKT_SIZE);
+        if(NULL == pkt) {
+                RPTERR("malloc failed");
+                return -1;
+        }
+        s->pkt = pkt;
+        pkt += s->npkt * TS_PKT_SIZE;
+        for(i = 0; i < n; i++, pkt += TS_PKT_SIZE) {
+                uint8_t *p = pkt;
+                int cnt;
+
+                *p++ = 0x47;
+                *p++ = ((0 == i) ? 0x40 : 0x00) | (s->pid >> 8);
+                *p++ = s->pid & 0xFF;
+                *p++ = 0x10; /* payload only, CC when sent */
+                if(0 == i) {
+                        *p++ = 0x00; /* pointer_field */
+                }
+                cnt = (int)(TS_PKT_SIZE - (p - pkt));
+                cnt = ((len < cnt) ? len : cnt);
+                memcpy(p, sect, cnt);
+                sect += cnt;
+                len -= cnt;
+                p += cnt;
+                memset(p, 0xFF, TS_PKT_SIZE - (p - pkt));
+        }
+        s->npkt += n;
+        return 0;
+}
+
+static int put_desc_str(uint8_t *p, const char *str)
+{
+        int len = (int)strlen(str);
+
+        *p++ = (uint8_t)len;
+        memcpy(p, str, len);
+        return 1 + len;
+}
+
+static int make_tables(void)
+{
+        uint8_t sect[1024];
+        uint8_t body[SECT_BODY_MAX];
+        struct strm *pat;
+        struct strm *sdt;
+        struct strm *eit = NULL;
+        int len;
+        int nsect;
+        int sec;
+        int i;
+
+        pat = new_strm(STRM_PSI, PAT_PID);
+        sdt = new_strm(STRM_PSI, SDT_PID);
+        if(eit_kbps) {
+                eit = new_strm(STRM_PSI, EIT_PID);
+        }
+
+        /* PAT */
+        nsect = (nprog + SECT_BODY_MAX / 4 - 1) / (SECT_BODY_MAX / 4);
+        for(sec = 0, i = 0; sec < nsect; sec++) {
+                for(len = 0; i < nprog && len + 4 <= SECT_BODY_MAX; i++) {
+                        body[len++] = (uint8_t)((i + 1) >> 8); /* program_number */
+                        body[len++] = (uint8_t)((i + 1) & 0xFF);
+                        body[len++] = 0xE0 | (PMT_PID(i) >> 8);
+                        body[len++] = PMT_PID(i) & 0xFF;
+                }
+                len = make_sect(sect, 0x00, TSID, sec, nsect - 1, body, len);
+                if(0 != add_sect(pat, sect, len)) {
+                        return -1;
+                }
+        }
+
+        /* PMT, video and audio */
+        for(i = 0; i < nprog; i++) {
+                struct strm *pmt = new_strm(STRM_PSI, PMT_PID(i));
+                uint8_t *p = body;
+
+                *p++ = 0xE0 | (VID_PID(i) >> 8); /* PCR_PID */
+                *p++ = VID_PID(i) & 0xFF;
+                *p++ = 0xF0; /* program_info_length */
+                *p++ = 0x00;
+                *p++ = 0x02; /* MPEG-2 video */
+                *p++ = 0xE0 | (VID_PID(i) >> 8);
+                *p++ = VID_PID(i) & 0xFF;
+                *p++ = 0xF0; /* ES_info_length */
+                *p++ = 0x00;
+                *p++ = 0x04; /* MPEG-2 audio */
+                *p++ = 0xE0 | (AUD_PID(i) >> 8);
+                *p++ = AUD_PID(i) & 0xFF;
+                *p++ = 0xF0;
+                *p++ = 0x00;
+                len = make_sect(sect, 0x02, (uint16_t)(i + 1), 0, 0, body, (int)(p - body));
+                if(0 != add_sect(pmt, sect, len)) {
+                        return -1;
+                }
+                new_strm(STRM_VID, VID_PID(i))->prog = i;
+                new_strm(STRM_AUD, AUD_PID(i))->prog = i;
+        }
+
+        /* SDT actual: count sections, then build */
+        for(i = 0, nsect = 0; i < nprog; nsect++) {
+                sdt_body(body, &i);
+        }
+        if(nsect > 256) {
+                RPTERR("too many SDT sections");
+                return -1;
+        }
+        for(i = 0, sec = 0; sec < nsect; sec++) {
+                len = sdt_body(body, &i);
+                len = make_sect(sect, 0x42, TSID, sec, nsect - 1, body, len);
+                if(0 != add_sect(sdt, sect, len)) {
+                        return -1;
+                }
+        }
+
+        /* EIT p/f actual: present and following event of each service */
+        for(i = 0; eit && i < nprog; i++) {
+                for(sec = 0; sec < 2; sec++) {
+                        uint8_t *p = body;
+                        uint8_t *desc;
+                        char str[128];
+                        int hour = (i + sec) % 24;
+
+                        *p++ = TSID >> 8;
+                        *p++ = TSID & 0xFF;
+                        *p++ = ONID >> 8;
+                        *p++ = ONID & 0xFF;
+                        *p++ = 0x01; /* segment_last_section_number */
+                        *p++ = 0x4E; /* last_table_id */
+                        *p++ = (uint8_t)((2 * i + sec) >> 8); /* event_id */
+                        *p++ = (uint8_t)((2 * i + sec) & 0xFF);
+                        *p++ = 56658 >> 8; /* start_time: MJD of 2014-01-01 */
+                        *p++ = 56658 & 0xFF;
+                        *p++ = (uint8_t)(((hour / 10) << 4) | (hour % 10));
+                        *p++ = 0x00;
+                        *p++ = 0x00;
+                        *p++ = 0x01; /* duration: 01:00:00 */
+                        *p++ = 0x00;
+                        *p++ = 0x00;
+                        desc = p;
+                        p += 2;
+                        *p++ = 0x4D; /* short_event_descriptor */
+                        p++;
+                        *p++ = 'e';
+                        *p++ = 'n';
+                        *p++ = 'g';
+                        sprintf(str, "Event %d of program %d", sec, i + 1);
+                        p += put_desc_str(p, str);
+                        sprintf(str, "Synthetic event for load test, program %d, %s event.",
+                                i + 1, (sec ? "following" : "present"));
+                        p += put_desc_str(p, str);
+                        desc[3] = (uint8_t)(p - desc - 4);
+                        desc[0] = (uint8_t)(((sec ? 0x01 : 0x04) << 5) | (((p - desc - 2) >> 8) & 0x0F));
+                        desc[1] = (uint8_t)((p - desc - 2) & 0xFF);
+                        len = make_sect(sect, 0x4E, (uint16_t)(i + 1), sec, 1, body, (int)(p - body));
+                        if(0 != add_sect(eit, sect, len)) {
+                                return -1;
+                        }
+                }
+        }
+        return 0;
+}
+
+/* services from *i, as many as fit in one section */
+static int sdt_body(uint8_t *body, int *i)
+{
+        uint8_t *p = body;
+
+        *p++ = ONID >> 8; /* original_network_id */
+        *p++ = ONID & 0xFF;
+        *p++ = 0xFF; /* reserved_future_use */
+        for(; *i < nprog && (p - body) + 64 <= SECT_BODY_MAX; (*i)++) {
+                uint8_t *desc;
+                char name[32];
+
+                *p++ = (uint8_t)((*i + 1) >> 8); /* service_id */
+                *p++ = (uint8_t)((*i + 1) & 0xFF);
+                *p++ = 0xFD; /* EIT_present_following_flag */
+                desc = p;
+                p += 2;
+                *p++ = 0x48; /* service_descriptor */
+                p++;
+                *p++ = 0x01; /* digital television service */
+                p += put_desc_str(p, "tsgen");
+                sprintf(name, "Program %d", *i + 1);
+                p += put_desc_str(p, name);
+                desc[3] = (uint8_t)(p - desc - 4);
+                desc[0] = 0x80 | (((p - desc - 2) >> 8) & 0x0F); /* running, descriptors_loop_length */
+                desc[1] = (uint8_t)((p - desc - 2) & 0xFF);
+        }
+        return (int)(p - body);
+}
+
+static void heap_down(int i)
+{
+        while(1) {
+                int l = 2 * i + 1;
+                int m = i;
+                int tmp;
+
+                if(l < nstrm && strm[heap[l]].due < strm[heap[m]].due) {
+                        m = l;
+                }
+                if(l + 1 < nstrm && strm[heap[l + 1]].due < strm[heap[m]].due) {
+                        m = l + 1;
+                }
+                if(m == i) {
+                        return;
+                }
+                tmp = heap[i];
+                heap[i] = heap[m];
+                heap[m] = tmp;
+                i = m;
+        }
+}
+
+static void emit_psi(uint8_t *p, struct strm *s)
+{
+        memcpy(p, s->pkt + s->ipkt * TS_PKT_SIZE, TS_PKT_SIZE);
+        s->ipkt = (s->ipkt + 1) % s->npkt;
+
+        p[3] |= s->cc;
+        s->cc = (s->cc + 1) & 0x0F;
+        if(is_fcrc && (p[1] & 0x40)) {
+                p[5 + 3] ^= 0x01; /* table_id_extension, break CRC */
+                is_fcrc = 0;
+                cnt_fcrc++;
+        }
+}
+
+/* t: packet time, clk */
+static void emit_es(uint8_t *p, struct strm *s, int64_t t)
+{
+        uint8_t *q = p + 4;
+        int is_start = (s->left <= 0);
+        int64_t PCR;
+
+        if(is_fcc) {
+                s->cc = (s->cc + 1) & 0x0F; /* skip one */
+                is_fcc = 0;
+                cnt_fcc++;
+        }
+        p[0] = 0x47;
+        p[1] = (is_start ? 0x40 : 0x00) | (s->pid >> 8);
+        p[2] = s->pid & 0xFF;
+        p[3] = 0x10 | s->cc;
+        s->cc = (s->cc + 1) & 0x0F;
+
+        if(STRM_VID == s->type && t >= s->pcr_next) {
+                int64_t base;
+                int ext;
+
+                if(is_fpcr) {
+                        int64_t jump = (int64_t)(1 + rng() % 10) * STC_1S;
+
+                        pcr_off[s->prog] += ((rng() & 1) ? jump : STC_OVF - jump);
+                        pcr_off[s->prog] %= STC_OVF;
+                        is_fpcr = 0;
+                        cnt_fpcr++;
+                }
+                PCR = (t + pcr_off[s->prog]) % STC_OVF;
+                base = PCR / 300;
+                ext = (int)(PCR % 300);
+                p[3] |= 0x20; /* AF */
+                *q++ = 7; /* adaption_field_length */
+                *q++ = 0x10; /* PCR_flag */
+                *q++ = (base >> 25) & 0xFF;
+                *q++ = (base >> 17) & 0xFF;
+                *q++ = (base >> 9) & 0xFF;
+                *q++ = (base >> 1) & 0xFF;
+                *q++ = ((base & 0x01) << 7) | 0x7E | (ext >> 8);
+                *q++ = ext & 0xFF;
+                s->pcr_next = t + (int64_t)pcr_ms * STC_MS;
+        }
+
+        if(is_start) {
+                int64_t PTS = (t + pcr_off[s->prog] + PTS_DELAY) / 300 % STC_BASE_OVF;
+
+                *q++ = 0x00; /* packet_start_code_prefix */
+                *q++ = 0x00;
+                *q++ = 0x01;
+                *q++ = (STRM_VID == s->type) ? 0xE0 : 0xC0; /* stream_id */
+                *q++ = 0x00; /* PES_packet_length: 0 */
+                *q++ = 0x00;
+                *q++ = 0x80;
+                *q++ = 0x80; /* PTS only */
+                *q++ = 5; /* PES_header_data_length */
+                *q++ = 0x21 | ((PTS >> 29) & 0x0E);
+                *q++ = (PTS >> 22) & 0xFF;
+                *q++ = 0x01 | ((PTS >> 14) & 0xFE);
+                *q++ = (PTS >> 7) & 0xFF;
+                *q++ = 0x01 | ((PTS << 1) & 0xFE);
+                s->left = s->frame;
+        }
+        memset(q, 0xA5, TS_PKT_SIZE - (q - p)); /* ES data */
+        s->left -= TS_PKT_SIZE - (q - p);
+}
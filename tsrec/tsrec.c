@@ -0,0 +1,506 @@
+/* vim: set tabstop=8 shiftwidth=8:
+ * name: tsrec.c
+ * funx: record TS over IP into segment files, with writer thread
+ */
+
+#define _GNU_SOURCE /* for fallocate() */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h> /* for strcmp, etc */
+#include <inttypes.h> /* for uintN_t, PRIX64, etc */
+#include <time.h> /* for time(), strftime(), etc */
+#include <signal.h> /* for signal() */
+#include <pthread.h>
+#include <sys/types.h>
+#include <fcntl.h> /* for open(), fallocate() */
+#include <unistd.h> /* for write(), ftruncate(), close() */
+
+#include "config.h" /* for SYS_* macro, generated by configure */
+#include "tstool_config.h"
+#include "common.h"
+#include "url.h"
+
+static int rpt_lvl = WRN_LVL; /* report level: ERR, WRN, INF, DBG */
+
+#define PKT_SIZE                        (188)
+#define BLK_PKT                         (4096) /* BLK_SIZE is 4KB aligned */
+#define BLK_SIZE                        (BLK_PKT * PKT_SIZE) /* one write() */
+#define BLK_ALIGN                       (4096)
+
+struct blk {
+        uint8_t *buf;
+        size_t len;
+        int is_new; /* first block of segment */
+        int is_last; /* close segment after this block */
+        time_t t; /* start time of segment, for is_new */
+};
+
+static /*@null@*/ struct url *fd_i = NULL;
+static char file_i[FILENAME_MAX] = "";
+static char prefix[FILENAME_MAX] = "rec";
+static int64_t seg_bytes = (int64_t)1024 * 1024 * 1024; /* rotate by size */
+static int seg_time = 0; /* rotate by wall-clock, second, 0: no */
+static int ring_mb = 64;
+static int64_t shift_bytes = 0; /* time-shift file instead of segments, 0: no */
+static intptr_t tsh = 0;
+static volatile sig_atomic_t is_stop = 0;
+
+/* ring: blk[rd] ... blk[wr - 1] is full, cnt blocks */
+static struct blk *blk = NULL;
+static int nblk = 0;
+static int rd = 0;
+static int wr = 0;
+static int cnt = 0;
+static int is_end = 0;
+static pthread_mutex_t mux = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t cnd = PTHREAD_COND_INITIALIZER;
+
+/* receive side */
+static struct blk *cur = NULL; /* block being filled, blk[wr] */
+static time_t cur_t; /* time of first packet in cur */
+static int has_seg = 0;
+static time_t seg_t;
+static int64_t seg_len = 0;
+static int64_t cnt_pkt = 0;
+static int64_t cnt_drop = 0; /* packets dropped for ring full */
+static int64_t cnt_bad = 0; /* packets without sync-byte */
+static int is_dropping = 0;
+
+/* writer side */
+static int cnt_seg = 0;
+static int64_t cnt_werr = 0; /* bytes failed to write */
+
+static int deal_with_parameter(int argc, char *argv[]);
+static int show_help();
+static int show_version();
+static void on_signal(int sig);
+static void *writer(void *arg);
+static int put_pkt(const uint8_t *pkt, time_t now);
+static void push_blk();
+
+int main(int argc, char *argv[])
+{
+        pthread_t tid;
+        uint8_t pkt[PKT_SIZE];
+        int i;
+
+        if(0 != deal_with_parameter(argc, argv)) {
+                return -1;
+        }
+
+        nblk = (int)(((int64_t)ring_mb << 20) / BLK_SIZE);
+        if(nblk < 2) {
+                nblk = 2;
+        }
+        blk = (struct blk *)calloc((size_t)nblk, sizeof(struct blk));
+        if(NULL == blk) {
+                RPTERR("malloc failed");
+                return -1;
+        }
+        for(i = 0; i < nblk; i++) {
+                void *p;
+
+                if(0 != posix_memalign(&p, BLK_ALIGN, BLK_SIZE)) {
+                        RPTERR("malloc failed");
+                        return -1;
+                }
+                blk[i].buf = (uint8_t *)p;
+        }
+
+        if(shift_bytes) {
+                char fname[FILENAME_MAX + 8];
+
+                snprintf(fname, sizeof(fname), "%s.tsh", prefix);
+                tsh = tsh_create(fname, shift_bytes);
+                if(0 == tsh) {
+                        return -1;
+                }
+        }
+
+        fd_i = url_open(file_i, "rb");
+        if(NULL == fd_i) {
+                RPTERR("open \"%s\" failed", file_i);
+                return -1;
+        }
+
+        if(0 != pthread_create(&tid, NULL, writer, NULL)) {
+                RPTERR("create writer thread failed");
+                url_close(fd_i);
+                return -1;
+        }
+        (void)signal(SIGINT, on_signal);
+        (void)signal(SIGTERM, on_signal);
+
+        /* receive path: never wait for disk */
+        while(!is_stop && 1 == url_read(pkt, PKT_SIZE, 1, fd_i)) {
+                if(0x47 != pkt[0]) {
+                        cnt_bad++;
+                        continue;
+                }
+                cnt_pkt++;
+                if(0 != put_pkt(pkt, time(NULL))) {
+                        cnt_drop++;
+                }
+        }
+
+        if(cur) {
+                cur->is_last = 1;
+                push_blk();
+        }
+        (void)pthread_mutex_lock(&mux);
+        is_end = 1;
+        (void)pthread_cond_signal(&cnd);
+        (void)pthread_mutex_unlock(&mux);
+        (void)pthread_join(tid, NULL);
+
+        fprintf(stderr, "%"PRId64" packets, %"PRId64" dropped, %"PRId64" bad, %d segments\n",
+                cnt_pkt, cnt_drop, cnt_bad, (tsh ? 1 : cnt_seg));
+        if(cnt_werr) {
+                RPTERR("%"PRId64" bytes lost for write error", cnt_werr);
+        }
+
+        if(tsh) {
+                tsh_close(tsh);
+        }
+        url_close(fd_i);
+        for(i = 0; i < nblk; i++) {
+                free(blk[i].buf);
+        }
+        free(blk);
+        return (cnt_werr ? -1 : 0);
+}
+
+static int deal_with_parameter(int argc, char *argv[])
+{
+        int i;
+        intmax_t dat;
+
+        if(1 == argc) {
+                /* no parameter */
+                fprintf(stderr, "No URL to process...\n\n");
+                show_help();
+                return -1;
+        }
+
+        for(i = 1; i < argc; i++) {
+                if('-' == argv[i][0]) {
+                        if(0 == strcmp(argv[i], "-o")) {
+                                i++;
+                                if(i >= argc) {
+                                        RPTERR("no parameter for 'o'!\n");
+                                        return -1;
+                                }
+                                strcpy(prefix, argv[i]);
+                        }
+                        else if(0 == strcmp(argv[i], "-s")) {
+                                i++;
+                                if(i >= argc) {
+                                        RPTERR("no parameter for 's'!\n");
+                                        return -1;
+                                }
+                                sscanf(argv[i], "%"SCNiMAX, &dat);
+                                if(1 <= dat && dat <= 1024 * 1024) {
+                                        seg_bytes = (int64_t)dat << 20;
+                                }
+                                else {
+                                        RPTERR("bad variable for 's': %jd(1 <= x <= 1048576)!\n", dat);
+                                        return -1;
+                                }
+                        }
+                        else if(0 == strcmp(argv[i], "-t")) {
+                                i++;
+                                if(i >= argc) {
+                                        RPTERR("no parameter for 't'!\n");
+                                        return -1;
+                                }
+                                sscanf(argv[i], "%"SCNiMAX, &dat);
+                                if(0 <= dat && dat <= 7 * 24 * 3600) {
+                                        seg_time = (int)dat;
+                                }
+                                else {
+                                        RPTERR("bad variable for 't': %jd(0 <= x <= 604800)!\n", dat);
+                                        return -1;
+                                }
+                        }
+                        else if(0 == strcmp(argv[i], "-shift")) {
+                                i++;
+                                if(i >= argc) {
+                                        RPTERR("no parameter for 'shift'!\n");
+                                        return -1;
+                                }
+                                sscanf(argv[i], "%"SCNiMAX, &dat);
+                                if(2 <= dat && dat <= 16 * 1024 * 1024) {
+                                        shift_bytes = (int64_t)dat << 20;
+                                }
+                                else {
+                                        RPTERR("bad variable for 'shift': %jd(2 <= x <= 16777216)!\n", dat);
+                                        return -1;
+                                }
+                        }
+                        else if(0 == strcmp(argv[i], "-m")) {
+                                i++;
+                                if(i >= argc) {
+                                        RPTERR("no parameter for 'm'!\n");
+                                        return -1;
+                                }
+                                sscanf(argv[i], "%"SCNiMAX, &dat);
+                                if(2 <= dat && dat <= 4096) {
+                                        ring_mb = (int)dat;
+                                }
+                                else {
+                                        RPTERR("bad variable for 'm': %jd(2 <= x <= 4096)!\n", dat);
+                                        return -1;
+                                }
+                        }
+                        else if(0 == strcmp(argv[i], "-h") ||
+                                0 == strcmp(argv[i], "--help")) {
+                                show_help();
+                                return -1;
+                        }
+                        else if(0 == strcmp(argv[i], "-v") ||
+                                0 == strcmp(argv[i], "--version")) {
+                                show_version();
+                                return -1;
+                        }
+                        else {
+                                RPTERR("wrong parameter: %s", argv[i]);
+                                return -1;
+                        }
+                }
+                else {
+                        strcpy(file_i, argv[i]);
+                }
+        }
+
+        /* full blocks fit in segment */
+        seg_bytes -= seg_bytes % BLK_SIZE;
+        if(seg_bytes < BLK_SIZE) {
+                seg_bytes = BLK_SIZE;
+        }
+        return 0;
+}
+
+static int show_help()
+{
+        fprintf(stdout,
+                "'tsrec' record TS over IP into segment files, with writer thread.\n"
+                "\n"
+                "Usage: tsrec [OPTION] udp://*@*:* [OPTION]\n"
+                "\n"
+                "Options:\n"
+                "\n"
+                " -o <prefix>      segment file: <prefix>-YYYYMMDD-HHMMSS-N.ts, default: rec\n"
+                " -s <MB>          rotate when segment reach the size, default: 1024\n"
+                " -t <second>      rotate when segment reach the duration, default: 0(no)\n"
+                " -m <MB>          ring buffer between receive and disk, default: 64\n"
+                " -shift <MB>      time-shift: keep the last <MB> in <prefix>.tsh, no segment\n"
+                "\n"
+                " -h, --help       print this information only\n"
+                " -v, --version    print my version only\n"
+                "\n"
+                "Segment file is preallocated, and written in %d-packet block.\n"
+                "Packets are dropped and counted when disk can not follow, Ctrl-C to stop.\n"
+                "Time-shift file can be read while recording: catip shift://<second>/<file>\n"
+                "\n"
+                "Examples:\n"
+                "  tsrec udp://224.165.54.31:1234 -o /data/ch1 -t 3600\n\n"
+                "  tsrec rtp://192.165.54.36@224.165.54.31:1234 -o ch2 -s 4096\n\n"
+                "  tsrec udp://224.165.54.31:1234 -o /data/ch1 -shift 8192\n\n"
+                "  catip shift://600/data/ch1.tsh | tsana -pcr\n\n"
+                "\n"
+                "Report bugs to <zhoucheng@tsinghua.org.cn>.\n",
+                BLK_PKT);
+        return 0;
+}
+
+static int show_version()
+{
+        fprintf(stdout,
+                "tsrec of tstools v%s (%s)\n"
+                "Build time: %s %s\n"
+                "\n"
+                "Copyright (C) 2009,2010,2011,2012,2013,2014 ZHOU Cheng.\n"
+                "License GPLv3+: GNU GPL version 3 or later <http://gnu.org/licenses/gpl.html>\n"
+                "This is free software; contact author for additional information.\n"
+                "There is NO warranty; not even for MERCHANTABILITY or FITNESS FOR\n"
+                "A PARTICULAR PURPOSE.\n"
+                "\n"
+                "Written by ZHOU Cheng.\n",
+                VERSION_STR, REVISION, __DATE__, __TIME__);
+        return 0;
+}
+
+static void on_signal(int sig)
+{
+        (void)sig;
+        is_stop = 1; /* select() in udp_read() returns with EINTR */
+}
+
+/* copy packet into ring, -1 if ring full */
+static int put_pkt(const uint8_t *pkt, time_t now)
+{
+        int is_time;
+
+        /* rotate by wall-clock, on packet boundary */
+        is_time = (has_seg && seg_time && now - seg_t >= seg_time);
+        if(is_time && cur) {
+                cur->is_last = 1;
+                push_blk();
+        }
+
+        if(!cur) {
+                (void)pthread_mutex_lock(&mux);
+                if(cnt < nblk) {
+                        cur = &(blk[wr]);
+                }
+                (void)pthread_mutex_unlock(&mux);
+                if(!cur) {
+                        if(!is_dropping) {
+                                is_dropping = 1;
+                                RPTWRN("ring full, disk too slow, drop packet");
+                        }
+                        return -1;
+                }
+                is_dropping = 0;
+                cur->len = 0;
+                cur->is_new = 0;
+                cur->is_last = 0;
+
+                if(is_time && has_seg) {
+                        /* last block was pushed, close segment with an empty one */
+                        cur->is_last = 1;
+                        push_blk();
+                        return put_pkt(pkt, now);
+                }
+        }
+
+        if(!has_seg) {
+                has_seg = 1;
+                seg_t = now;
+                seg_len = 0;
+                cur->is_new = 1;
+                cur->t = now;
+        }
+
+        if(0 == cur->len) {
+                cur_t = now;
+        }
+        memcpy(cur->buf + cur->len, pkt, PKT_SIZE);
+        cur->len += PKT_SIZE;
+        seg_len += PKT_SIZE;
+        if(tsh && BLK_SIZE != cur->len && now != cur_t) {
+                /* time-shift readers follow live within 1s */
+                push_blk();
+        }
+        else if(BLK_SIZE == cur->len) {
+                /* rotate by size, on block boundary */
+                if(seg_len + PKT_SIZE > seg_bytes) {
+                        cur->is_last = 1;
+                }
+                push_blk();
+        }
+        return 0;
+}
+
+/* hand cur to writer */
+static void push_blk()
+{
+        if(cur->is_last) {
+                has_seg = 0;
+        }
+        (void)pthread_mutex_lock(&mux);
+        wr = (wr + 1) % nblk;
+        cnt++;
+        (void)pthread_cond_signal(&cnd);
+        (void)pthread_mutex_unlock(&mux);
+        cur = NULL;
+}
+
+static void *writer(void *arg)
+{
+        int fd = -1;
+        int64_t len = 0; /* bytes in segment file */
+
+        (void)arg;
+        while(1) {
+                struct blk *b;
+                size_t pos;
+
+                (void)pthread_mutex_lock(&mux);
+                while(0 == cnt && !is_end) {
+                        (void)pthread_cond_wait(&cnd, &mux);
+                }
+                if(0 == cnt) {
+                        (void)pthread_mutex_unlock(&mux);
+                        break;
+                }
+                b = &(blk[rd]);
+                (void)pthread_mutex_unlock(&mux);
+
+                if(tsh) {
+                        /* time-shift: one circular file */
+                        if(b->len > 0 && (ssize_t)(b->len) != tsh_write(tsh, b->buf, b->len)) {
+                                cnt_werr += (int64_t)(b->len);
+                        }
+                }
+                else {
+                        if((b->is_new || fd < 0) && b->len > 0) {
+                                char fname[FILENAME_MAX + 64];
+                                char stamp[32];
+                                time_t t = (b->is_new ? b->t : time(NULL));
+
+                                if(fd >= 0) {
+                                        (void)ftruncate(fd, len);
+                                        close(fd);
+                                }
+                                strftime(stamp, sizeof(stamp), "%Y%m%d-%H%M%S", localtime(&t));
+                                snprintf(fname, sizeof(fname), "%s-%s-%d.ts", prefix, stamp, cnt_seg);
+                                fd = open(fname, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+                                if(fd < 0) {
+                                        RPTERR("open \"%s\" failed", fname);
+                                }
+                                else {
+#ifdef SYS_LINUX
+                                        /* keep file size, space reserved */
+                                        if(0 != fallocate(fd, FALLOC_FL_KEEP_SIZE, 0, (off_t)seg_bytes)) {
+                                                RPTWRN("fallocate \"%s\" failed", fname);
+                                        }
+#endif
+                                        cnt_seg++;
+                                        RPTINF("new segment: %s", fname);
+                                }
+                                len = 0;
+                        }
+
+                        for(pos = 0; fd >= 0 && pos < b->len; ) {
+                                ssize_t rslt = write(fd, b->buf + pos, b->len - pos);
+
+                                if(rslt <= 0) {
+                                        RPTERR("write failed");
+                                        break;
+                                }
+                                pos += (size_t)rslt;
+                        }
+                        cnt_werr += (int64_t)(b->len - pos);
+                        len += (int64_t)pos;
+
+                        if(b->is_last && fd >= 0) {
+                                /* release space not used */
+                                (void)ftruncate(fd, len);
+                                close(fd);
+                                fd = -1;
+                        }
+                }
+
+                (void)pthread_mutex_lock(&mux);
+                rd = (rd + 1) % nblk;
+                cnt--;
+                (void)pthread_mutex_unlock(&mux);
+        }
+
+        if(fd >= 0) {
+                (void)ftruncate(fd, len);
+                close(fd);
+        }
+        return NULL;
+}
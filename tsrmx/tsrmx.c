@@ -0,0 +1,587 @@
+/* vim: set tabstop=8 shiftwidth=8:
+ * name: tsrmx.c
+ * funx: remux bin ts file: strip null packets with ATS, or CBR with null packets and PCR restamp
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h> /* for strcmp, etc */
+#include <inttypes.h> /* for uintN_t, PRIX64, etc */
+
+#include "tstool_config.h"
+#include "common.h"
+#include "buddy.h"
+#include "ts.h"
+
+static int rpt_lvl = WRN_LVL; /* report level: ERR, WRN, INF, DBG */
+
+#define ANY_PID                         (0x2000) /* any PID of [0x0000,0x1FFF] */
+#define NUL_PID                         (0x1FFF)
+
+#define IN_BUF                          (1 << 20) /* read buffer of input file */
+#define OUT_BUF                         (1 << 20) /* write buffer of output file */
+#define PKT_MAX                         (204) /* max packet size: 188, 192 or 204 */
+#define SYNC_TIME                       (3) /* SYNC_TIME syncs means TS sync */
+#define QUE_MAX                         (1 << 16) /* packets wait for time between two PCR */
+#define LATE_MAX                        (100 * STC_MS) /* packet later than it means CBR too low */
+
+enum RMX_MODE
+{
+        RMX_STRIP, /* drop null packets, MTS output with ATS */
+        RMX_CBR /* add null packets, TS output at constant bitrate */
+};
+
+struct qpkt {
+        uint8_t TS[TS_PKT_SIZE];
+        int64_t ADDR; /* address in input file */
+        int64_t t; /* arrive time in input, 27MHz clk, no wrap */
+        int has_pcr;
+        int64_t PCR;
+};
+
+static /*@null@*/ FILE *fd_i = NULL;
+static /*@null@*/ FILE *fd_o = NULL;
+static char file_i[FILENAME_MAX] = "";
+static char file_o[FILENAME_MAX] = "";
+static int mode = RMX_STRIP;
+static int64_t bps = 0; /* bitrate of CBR output */
+static int pcr_pid = ANY_PID; /* time base for TS input, ANY_PID: first PID with PCR */
+static int pkt_size = 188;
+static int pkt_off = 0; /* offset of sync-byte in packet, 4 for MTS */
+
+/* packet queue: [que_rd, que_tm) has time, [que_tm, que_wr) wait for next PCR */
+static struct qpkt *que = NULL;
+static int64_t que_rd = 0;
+static int64_t que_tm = 0;
+static int64_t que_wr = 0;
+
+/* time base */
+static int has_base = 0;
+static int64_t base_ADDR; /* TS input: ADDR of last PCR */
+static int64_t base_val; /* TS input: last PCR; MTS input: last ATS */
+static int64_t base_t; /* time of base_ADDR */
+static int64_t rate = 0; /* TS input: clk per byte of last PCR interval, Q16 */
+
+/* CBR output */
+static int has_slot = 0;
+static int64_t slot_t; /* time of next output slot */
+static uint32_t slot_frac; /* fraction part of slot_t, Q16 */
+static int64_t slot_clk; /* clk per packet, Q16 */
+static int is_late = 0;
+static uint8_t nul_pkt[TS_PKT_SIZE];
+static int64_t cnt_drop = 0; /* null packets dropped */
+static int64_t cnt_add = 0; /* null packets added */
+static int has_werr = 0; /* output write error */
+
+static int deal_with_parameter(int argc, char *argv[]);
+static int show_help();
+static int show_version();
+static int judge_type(const uint8_t *buf, int len);
+static void que_push(struct ts_obj *obj, const uint8_t *pkt, int64_t ADDR);
+static void que_time(int64_t end, int64_t t0, int64_t ADDR0, int64_t t1, int64_t ADDR1);
+static void que_pop();
+static void out_pkt(const struct qpkt *q);
+static void out_write(const uint8_t *data, size_t len);
+static void set_pcr(uint8_t *ts, int64_t PCR);
+
+int main(int argc, char *argv[])
+{
+        void *mp;
+        struct ts_obj *obj;
+        struct ts_cfg cfg;
+        uint8_t *ibuf;
+        size_t ilen = 0; /* data in ibuf */
+        size_t ipos = 0; /* packet position in ibuf */
+        size_t cnt;
+        int64_t addr = 0; /* address of ibuf[0] in input file */
+        int64_t lost = 0; /* bytes passed without sync */
+        int is_type_ok = 0;
+        int ret = -1;
+
+        if(0 != deal_with_parameter(argc, argv)) {
+                return -1;
+        }
+
+        fd_i = fopen(file_i, "rb");
+        if(NULL == fd_i) {
+                RPTERR("open \"%s\" failed", file_i);
+                return -1;
+        }
+        fd_o = fopen(file_o, "wb");
+        if(NULL == fd_o) {
+                RPTERR("open \"%s\" failed", file_o);
+                fclose(fd_i);
+                return -1;
+        }
+        setvbuf(fd_o, NULL, _IOFBF, OUT_BUF);
+        ibuf = (uint8_t *)malloc(IN_BUF + PKT_MAX * SYNC_TIME);
+        que = (struct qpkt *)malloc(QUE_MAX * sizeof(struct qpkt));
+        if(NULL == ibuf || NULL == que) {
+                RPTERR("malloc failed");
+                goto main_return;
+        }
+
+        memset(nul_pkt, 0xFF, TS_PKT_SIZE);
+        nul_pkt[0] = 0x47;
+        nul_pkt[1] = (uint8_t)(NUL_PID >> 8);
+        nul_pkt[2] = (uint8_t)(NUL_PID);
+        nul_pkt[3] = 0x10; /* payload only, CC is meaningless for null packet */
+        slot_clk = (((int64_t)TS_PKT_SIZE * 8 * STC_1S) << 16) / ((bps > 0) ? bps : 1);
+
+        mp = buddy_create(16, 6);
+        if(!mp) {
+                RPTERR("malloc memory pool failed");
+                goto main_return;
+        }
+        obj = ts_create(mp);
+        if(!obj) {
+                RPTERR("malloc ts object failed");
+                buddy_destroy(mp);
+                goto main_return;
+        }
+        memset(&cfg, 0, sizeof(struct ts_cfg));
+        cfg.need_af = 1; /* for PCR */
+        ts_ioctl(obj, TS_SCFG, &cfg);
+
+        while(!has_werr) {
+                uint8_t *pkt;
+
+                /* refill */
+                if(ilen - ipos < (size_t)(pkt_size * SYNC_TIME)) {
+                        memmove(ibuf, ibuf + ipos, ilen - ipos);
+                        addr += ipos;
+                        ilen -= ipos;
+                        ipos = 0;
+                        cnt = fread(ibuf + ilen, 1, IN_BUF + PKT_MAX * SYNC_TIME - ilen, fd_i);
+                        ilen += cnt;
+                        if(ilen < (size_t)pkt_size) {
+                                break;
+                        }
+                        if(!is_type_ok) {
+                                is_type_ok = 1;
+                                if(0 != judge_type(ibuf, (int)ilen)) {
+                                        RPTWRN("unknown packet size, use 188");
+                                }
+                        }
+                }
+
+                /* sync */
+                pkt = ibuf + ipos;
+                if(0x47 != pkt[pkt_off] ||
+                   (ipos + pkt_size + pkt_off < ilen && 0x47 != pkt[pkt_size + pkt_off])) {
+                        ipos++;
+                        lost++;
+                        continue;
+                }
+                if(lost) {
+                        RPTWRN("pass %"PRId64"-byte before 0x%"PRIX64, lost, addr + (int64_t)ipos);
+                        lost = 0;
+                }
+
+                memcpy(obj->ipt.TS, pkt + pkt_off, TS_PKT_SIZE);
+                obj->ipt.ADDR = addr + (int64_t)ipos;
+                obj->ipt.has_ts = 1;
+                obj->ipt.has_addr = 1;
+                if(0 != ts_parse_tsh(obj)) {
+                        break;
+                }
+                que_push(obj, pkt, addr + (int64_t)ipos);
+                memset(&(obj->err), 0, sizeof(struct ts_err));
+                obj->has_err = 0;
+
+                ipos += pkt_size;
+        }
+
+        /* packets after last PCR */
+        if(que_tm < que_wr && has_base && rate > 0) {
+                int64_t ADDR = que[(que_wr - 1) % QUE_MAX].ADDR;
+
+                que_time(que_wr, base_t, base_ADDR, base_t + ((rate * (ADDR - base_ADDR)) >> 16), ADDR);
+        }
+        while(que_rd < que_tm) {
+                que_pop();
+        }
+        if(que_rd < que_wr) {
+                RPTWRN("drop %"PRId64" packets without time", que_wr - que_rd);
+        }
+        RPTINF("drop %"PRId64" null packets, add %"PRId64" null packets", cnt_drop, cnt_add);
+
+        ts_destroy(obj);
+        buddy_destroy(mp);
+        ret = (has_werr ? -1 : 0);
+main_return:
+        if(que) {
+                free(que);
+        }
+        if(ibuf) {
+                free(ibuf);
+        }
+        if(0 != fclose(fd_o)) {
+                RPTERR("close \"%s\" failed", file_o);
+                ret = -1;
+        }
+        fclose(fd_i);
+        return ret;
+}
+
+static int deal_with_parameter(int argc, char *argv[])
+{
+        int i;
+        intmax_t dat;
+
+        if(1 == argc) {
+                /* no parameter */
+                RPTERR("No binary file to process...\n\n");
+                show_help();
+                return -1;
+        }
+
+        for(i = 1; i < argc; i++) {
+                if('-' == argv[i][0]) {
+                        if(0 == strcmp(argv[i], "-strip")) {
+                                mode = RMX_STRIP;
+                        }
+                        else if(0 == strcmp(argv[i], "-cbr")) {
+                                i++;
+                                if(i >= argc) {
+                                        RPTERR("no parameter for 'cbr'!\n");
+                                        return -1;
+                                }
+                                sscanf(argv[i], "%"SCNiMAX, &dat);
+                                if(100000 <= dat && dat <= 1000000000) {
+                                        bps = (int64_t)dat;
+                                        mode = RMX_CBR;
+                                }
+                                else {
+                                        RPTERR("bad variable for 'cbr': %jd(100000 <= x <= 1000000000)!\n", dat);
+                                        return -1;
+                                }
+                        }
+                        else if(0 == strcmp(argv[i], "-pcr")) {
+                                i++;
+                                if(i >= argc) {
+                                        RPTERR("no parameter for 'pcr'!\n");
+                                        return -1;
+                                }
+                                sscanf(argv[i], "%"SCNiMAX, &dat);
+                                if(0x0000 <= dat && dat <= ANY_PID) {
+                                        pcr_pid = (int)dat;
+                                }
+                                else {
+                                        RPTERR("bad variable for 'pcr': 0x%jX, use 0x2000(first PCR PID) instead!\n", dat);
+                                }
+                        }
+                        else if(0 == strcmp(argv[i], "-o")) {
+                                i++;
+                                if(i >= argc) {
+                                        RPTERR("no parameter for '-o'!\n");
+                                        return -1;
+                                }
+                                strcpy(file_o, argv[i]);
+                        }
+                        else if(0 == strcmp(argv[i], "-l"))
+                        {
+                                i++;
+                                if(i >= argc)
+                                {
+                                        RPTERR("no parameter for '-l'!");
+                                        exit(EXIT_FAILURE);
+                                }
+                                if(0 == strcmp(argv[i], "dbg"))
+                                {
+                                        rpt_lvl = DBG_LVL;
+                                        RPTINF("repot level: 'dbg'");
+                                }
+                                else if(0 == strcmp(argv[i], "inf"))
+                                {
+                                        rpt_lvl = INF_LVL;
+                                        RPTINF("repot level: 'inf'");
+                                }
+                                else if(0 == strcmp(argv[i], "wrn"))
+                                {
+                                        rpt_lvl = WRN_LVL;
+                                        RPTINF("repot level: 'wrn'");
+                                }
+                                else
+                                {
+                                        rpt_lvl = ERR_LVL;
+                                        RPTINF("repot level: 'err'");
+                                }
+                        }
+                        else if(0 == strcmp(argv[i], "-h") ||
+                                0 == strcmp(argv[i], "--help")) {
+                                show_help();
+                                return -1;
+                        }
+                        else if(0 == strcmp(argv[i], "-v") ||
+                                0 == strcmp(argv[i], "--version")) {
+                                show_version();
+                                return -1;
+                        }
+                        else {
+                                RPTERR("Wrong parameter: %s", argv[i]);
+                                return -1;
+                        }
+                }
+                else {
+                        strcpy(file_i, argv[i]);
+                }
+        }
+
+        if('\0' == file_o[0]) {
+                RPTERR("No output file...\n\n");
+                show_help();
+                return -1;
+        }
+        return 0;
+}
+
+static int show_help()
+{
+        fprintf(stdout,
+                "'tsrmx' read binary ts file, strip null packets or make it CBR, write to file.\n"
+                "\n"
+                "Usage: tsrmx [OPTION] file [OPTION]\n"
+                "\n"
+                "Options:\n"
+                "\n"
+                " -o <file>                output file\n"
+                " -strip                   drop null packets, output MTS(4-byte ATS + 188), default\n"
+                " -cbr <bps>               output TS at bps with null packets, PCR restamped\n"
+                " -pcr <pid>               PCR PID as time base of TS input, default: 0x2000(first PCR PID)\n"
+                "\n"
+                " -l <level>               set report level(dbg|inf|wrn|err), default: wrn\n"
+                " -h, --help               display this information\n"
+                " -v, --version            display my version\n"
+                "\n"
+                "Examples:\n"
+                "  tsrmx xxx.ts -strip -o xxx.mts\n"
+                "  tsrmx xxx.mts -cbr 8000000 -o yyy.ts\n"
+                "\n"
+                "Report bugs to <zhoucheng@tsinghua.org.cn>.\n");
+        return 0;
+}
+
+static int show_version()
+{
+        fprintf(stdout,
+                "tsrmx of tstools v%s (%s)\n"
+                "Build time: %s %s\n"
+                "\n"
+                "Copyright (C) 2009,2010,2011,2012,2013,2014 ZHOU Cheng.\n"
+                "License GPLv3+: GNU GPL version 3 or later <http://gnu.org/licenses/gpl.html>\n"
+                "This is free software; contact author for additional information.\n"
+                "There is NO warranty; not even for MERCHANTABILITY or FITNESS FOR\n"
+                "A PARTICULAR PURPOSE.\n"
+                "\n"
+                "Written by ZHOU Cheng.\n",
+                VERSION_STR, REVISION, __DATE__, __TIME__);
+        return 0;
+}
+
+/* packet size and sync-byte offset: TS(188), MTS(4 + 188) or TSRS(188 + 16) */
+static int judge_type(const uint8_t *buf, int len)
+{
+        static const int size[] = {188, 192, 204};
+        static const int off[] = {0, 4, 0};
+        int start;
+        int i;
+        int k;
+
+        for(start = 0; start + PKT_MAX * SYNC_TIME < len && start < 4096; start++) {
+                for(i = 0; i < 3; i++) {
+                        for(k = 0; k < SYNC_TIME; k++) {
+                                if(0x47 != buf[start + off[i] + size[i] * k]) {
+                                        break;
+                                }
+                        }
+                        if(SYNC_TIME == k) {
+                                pkt_size = size[i];
+                                pkt_off = off[i];
+                                RPTINF("packet size: %d", pkt_size);
+                                return 0;
+                        }
+                }
+        }
+        return -1;
+}
+
+/* pkt: packet in input file, with ATS for MTS */
+static void que_push(struct ts_obj *obj, const uint8_t *pkt, int64_t ADDR)
+{
+        struct qpkt *q;
+
+        if(NUL_PID == obj->PID) {
+                cnt_drop++; /* null packets are dropped, and re-inserted for CBR */
+                return;
+        }
+        if(que_wr - que_rd >= QUE_MAX) {
+                RPTWRN("no PCR in %d packets, drop them", QUE_MAX);
+                que_rd = que_wr;
+                que_tm = que_wr;
+        }
+
+        q = &(que[que_wr % QUE_MAX]);
+        memcpy(q->TS, pkt + pkt_off, TS_PKT_SIZE);
+        q->ADDR = ADDR;
+        q->has_pcr = obj->has_pcr;
+        if(q->has_pcr) {
+                q->PCR = obj->af.program_clock_reference_base * 300 +
+                         obj->af.program_clock_reference_extension;
+        }
+        que_wr++;
+
+        if(4 == pkt_off) {
+                /* MTS: time from ATS */
+                int64_t ATS = (((int64_t)pkt[0] << 24) | (pkt[1] << 16) | (pkt[2] << 8) | pkt[3]) & (ATS_OVF - 1);
+
+                if(!has_base) {
+                        has_base = 1;
+                        base_t = ATS;
+                }
+                else {
+                        base_t += ts_timestamp_diff(ATS, base_val, ATS_OVF);
+                }
+                base_val = ATS;
+                base_ADDR = ADDR;
+                que_time(que_wr, base_t, ADDR, base_t, ADDR);
+        }
+        else if(q->has_pcr && (ANY_PID == pcr_pid || obj->PID == pcr_pid)) {
+                /* TS: time from PCR, packets between two PCR use byte position */
+                int64_t dPCR;
+                int64_t t0 = base_t;
+                int64_t ADDR0 = base_ADDR;
+
+                pcr_pid = obj->PID;
+                if(!has_base) {
+                        has_base = 1;
+                        if(que_wr - 1 > que_rd) {
+                                RPTINF("drop %"PRId64" packets before first PCR", que_wr - 1 - que_rd);
+                        }
+                        que_rd = que_wr - 1;
+                        que_tm = que_rd;
+                        base_t = q->PCR;
+                        t0 = base_t;
+                        ADDR0 = ADDR;
+                }
+                else {
+                        dPCR = ts_timestamp_diff(q->PCR, base_val, STC_OVF);
+                        if(0 < dPCR && dPCR <= STC_1S && ADDR > base_ADDR) {
+                                rate = (dPCR << 16) / (ADDR - base_ADDR);
+                        }
+                        else {
+                                RPTWRN("PCR discontinuity at 0x%"PRIX64", use last rate", ADDR);
+                        }
+                        base_t += ((rate * (ADDR - base_ADDR)) >> 16);
+                }
+                base_val = q->PCR;
+                base_ADDR = ADDR;
+                que_time(que_wr, t0, ADDR0, base_t, ADDR);
+        }
+
+        while(que_rd < que_tm) {
+                que_pop();
+        }
+        return;
+}
+
+/* set time of [que_tm, end) on the line of (ADDR0, t0) and (ADDR1, t1) */
+static void que_time(int64_t end, int64_t t0, int64_t ADDR0, int64_t t1, int64_t ADDR1)
+{
+        for(; que_tm < end; que_tm++) {
+                struct qpkt *q = &(que[que_tm % QUE_MAX]);
+
+                if(ADDR1 == ADDR0) {
+                        q->t = t1;
+                }
+                else {
+                        q->t = t0 + (t1 - t0) * (q->ADDR - ADDR0) / (ADDR1 - ADDR0);
+                }
+        }
+        return;
+}
+
+static void que_pop()
+{
+        struct qpkt *q = &(que[que_rd % QUE_MAX]);
+
+        out_pkt(q);
+        que_rd++;
+        return;
+}
+
+static void out_pkt(const struct qpkt *q)
+{
+        uint8_t ats[4];
+        uint8_t ts[TS_PKT_SIZE];
+        int64_t late;
+
+        if(RMX_STRIP == mode) {
+                int64_t ATS = q->t & (ATS_OVF - 1);
+
+                ats[0] = (uint8_t)(ATS >> 24);
+                ats[1] = (uint8_t)(ATS >> 16);
+                ats[2] = (uint8_t)(ATS >> 8);
+                ats[3] = (uint8_t)(ATS);
+                out_write(ats, 4);
+                out_write(q->TS, TS_PKT_SIZE);
+                return;
+        }
+
+        /* CBR: null packets before this packet */
+        if(!has_slot) {
+                has_slot = 1;
+                slot_t = q->t;
+                slot_frac = 0;
+        }
+        while(slot_t < q->t) {
+                out_write(nul_pkt, TS_PKT_SIZE);
+                cnt_add++;
+                slot_frac += (uint32_t)(slot_clk & 0xFFFF);
+                slot_t += (slot_clk >> 16) + (slot_frac >> 16);
+                slot_frac &= 0xFFFF;
+        }
+
+        /* maybe later than input for burst, restamp PCR to keep PCR_accuracy */
+        late = slot_t - q->t;
+        if(late > LATE_MAX && !is_late) {
+                is_late = 1;
+                RPTWRN("%"PRId64"ms late at 0x%"PRIX64", bitrate too low?", late / STC_MS, q->ADDR);
+        }
+        memcpy(ts, q->TS, TS_PKT_SIZE);
+        if(q->has_pcr && late) {
+                set_pcr(ts, ts_timestamp_add(q->PCR, late, STC_OVF));
+        }
+        out_write(ts, TS_PKT_SIZE);
+        slot_frac += (uint32_t)(slot_clk & 0xFFFF);
+        slot_t += (slot_clk >> 16) + (slot_frac >> 16);
+        slot_frac &= 0xFFFF;
+        return;
+}
+
+static void out_write(const uint8_t *data, size_t len)
+{
+        if(has_werr) {
+                return;
+        }
+        if(len != fwrite(data, 1, len, fd_o)) {
+                RPTERR("write \"%s\" failed, stop", file_o);
+                has_werr = 1;
+        }
+        return;
+}
+
+static void set_pcr(uint8_t *ts, int64_t PCR)
+{
+        int64_t base = PCR / 300;
+        int ext = (int)(PCR % 300);
+        uint8_t *p = ts + 6; /* 4-byte head, adaption_field_length, flags */
+
+        *p++ = (uint8_t)(base >> 25);
+        *p++ = (uint8_t)(base >> 17);
+        *p++ = (uint8_t)(base >> 9);
+        *p++ = (uint8_t)(base >> 1);
+        *p++ = (uint8_t)(((base & 0x01) << 7) | 0x7E | (ext >> 8));
+        *p++ = (uint8_t)(ext);
+        return;
+}
@@ -0,0 +1,8 @@
+#define TSTOOL_XML 1
+
+#define VER_MAJOR 1
+#define VER_MINOR 1
+#define VER_PATCH 44
+#define VERSION 1.1.44
+#define VERSION_STR "1.1.44"
+#define REVISION "0+44 52f51dae"